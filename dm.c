@@ -48,6 +48,24 @@ dm_array_real dm_rand(long *idum)
     return((dm_array_real)ans);
 }
 
+/*------------------------------------------------------------*/
+void dm_rand_philox(u_int32_t *ptr_counter,
+                    u_int32_t *ptr_key,
+                    u_int32_t *ptr_out)
+{
+    u_int32_t c0, c1, c2, c3;
+
+    c0 = *(ptr_counter+0);
+    c1 = *(ptr_counter+1);
+    c2 = *(ptr_counter+2);
+    c3 = *(ptr_counter+3);
+    DM_PHILOX4X32_10(c0,c1,c2,c3,*(ptr_key+0),*(ptr_key+1));
+    *(ptr_out+0) = c0;
+    *(ptr_out+1) = c1;
+    *(ptr_out+2) = c2;
+    *(ptr_out+3) = c3;
+}
+
 /*------------------------------------------------------------*/
 void dm_time(dm_time_t *this_time)
 {
@@ -73,6 +73,13 @@ typedef float dm_array_real;
     __struct->local_npix = __npixels/__np;				\
   }
 
+/* Bit arrays hold 64 pixels per word, so round up the word count */
+#define DM_ARRAY_BIT_STRUCT_INIT(__struct,__npixels,__np) {		\
+    (__struct->bit_array) = (u_int64_t *)calloc(((__npixels/__np)+63)/64, \
+						sizeof(u_int64_t));	\
+    __struct->local_npix = __npixels/__np;				\
+  }
+
 #define DM_ARRAY_INT_STRUCT_INIT(__struct,__npixels,__np) {		\
     (__struct->int_array) = (int *)malloc(sizeof(int)*			\
 					   (__npixels/__np));		\
@@ -209,6 +216,20 @@ typedef struct {
   dm_array_index_t local_offset;
 } dm_array_byte_struct;
 
+/* A mask with one bit per pixel: local pixel ipix is bit (ipix%64)
+ * of word ipix/64 of bit_array, and the bits past local_npix in the
+ * last word are kept at 0.
+ */
+typedef struct { 
+  u_int64_t *bit_array; 
+  int nx;
+  int ny;
+  int nz;
+  dm_array_index_t npix;
+  dm_array_index_t local_npix;
+  dm_array_index_t local_offset;
+} dm_array_bit_struct;
+
 typedef struct { 
   int *int_array; 
   int nx;
@@ -293,6 +314,8 @@ typedef struct {
   u_int32_t iterate_count;
 } dm_itn_struct;
 
+#define DM_ITN_HISTORY_VERSION 1
+
 typedef struct {
   char *string_array;
   char *specimen_name;
@@ -317,6 +340,56 @@ void dm_exit();
  */
 dm_array_real dm_rand(long *idum);
 
+/* The Philox4x32-10 counter-based generator of Salmon et al. (SC11,
+ * "Parallel random numbers: as easy as 1, 2, 3"). Ten rounds turn 
+ * the four 32-bit counter words __c0..__c3 (which are overwritten)
+ * into four random words under the two key words __k0 and __k1. 
+ * Every counter value gives independent numbers, so a pixel can get
+ * its numbers from its global index without any state being passed
+ * along, and a loop over pixels can be vectorized.
+ */
+#define DM_PHILOX_M0 ((u_int64_t)0xD2511F53)
+#define DM_PHILOX_M1 ((u_int64_t)0xCD9E8D57)
+#define DM_PHILOX_W0 ((u_int32_t)0x9E3779B9)
+#define DM_PHILOX_W1 ((u_int32_t)0xBB67AE85)
+#define DM_PHILOX_ROUND(__c0,__c1,__c2,__c3,__k0,__k1) {		\
+    u_int64_t __p0 = DM_PHILOX_M0*(u_int64_t)(__c0);			\
+    u_int64_t __p1 = DM_PHILOX_M1*(u_int64_t)(__c2);			\
+    (__c0) = (u_int32_t)(__p1 >> 32) ^ (__c1) ^ (__k0);		\
+    (__c2) = (u_int32_t)(__p0 >> 32) ^ (__c3) ^ (__k1);		\
+    (__c1) = (u_int32_t)__p1;						\
+    (__c3) = (u_int32_t)__p0;						\
+  }
+#define DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1) {		\
+    DM_PHILOX_ROUND(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    (__k0) += DM_PHILOX_W0;						\
+    (__k1) += DM_PHILOX_W1;						\
+  }
+/* The rounds are written out so that a loop around this can be 
+ * vectorized.
+ */
+#define DM_PHILOX4X32_10(__c0,__c1,__c2,__c3,__key0,__key1) {		\
+    u_int32_t __k0 = (__key0), __k1 = (__key1);				\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_BUMP(__c0,__c1,__c2,__c3,__k0,__k1);			\
+    DM_PHILOX_ROUND(__c0,__c1,__c2,__c3,__k0,__k1);			\
+  }
+
+/** This routine returns in ptr_out the four 32-bit random words of
+    DM_PHILOX4X32_10() for the counter words in ptr_counter and the
+    key words in ptr_key.
+ */
+void dm_rand_philox(u_int32_t *ptr_counter,
+                    u_int32_t *ptr_key,
+                    u_int32_t *ptr_out);
+
 /** These routines are for timing purposes */
 void dm_time(dm_time_t *time);
 double dm_time_diff(dm_time_t start,
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <pthread.h>
  
 
 /*------------------------------------------------------------*/
@@ -124,57 +125,167 @@ void dm_array_transfer_magnitudes(dm_array_complex_struct *ptr_cas_dest,
                                   dm_array_real_struct *ptr_ras_errors,
 				  int zero_if_not_known)
 {
-  dm_array_index_t ipix;
-  dm_array_real this_old_mag, this_re, this_im, this_new_mag;
-  dm_array_real this_error;
-  int with_errors = 1;
-  
   if (ptr_cas_dest->npix != ptr_ras_mags->npix) return;
-
-  if (ptr_ras_errors == NULL) {
-      with_errors = 0;
-  } else { 
+  if (ptr_ras_errors != NULL) { 
       if (ptr_cas_dest->npix != ptr_ras_errors->npix) return;      
   }
+
+  dm_array_transfer_magnitudes_kernel(ptr_cas_dest,ptr_ras_mags,
+				      ptr_ras_errors,zero_if_not_known,
+				      NULL);
   
-  for (ipix=0; ipix<ptr_cas_dest->local_npix; ipix++) {
-      /* Only if we actually measured the other magnitudes */
-      if (*(ptr_ras_mags->real_array+ipix)) {
-          this_re = c_re(ptr_cas_dest->complex_array,ipix);
-          this_im = c_im(ptr_cas_dest->complex_array,ipix);
-          this_old_mag = sqrt(this_re*this_re + this_im*this_im);
-          this_new_mag = *(ptr_ras_mags->real_array+ipix);
-          if (with_errors) {
-              this_error = *(ptr_ras_errors->real_array+ipix);
-              
-              if (this_old_mag > (this_new_mag+this_error)) {
-                  this_new_mag += this_error;
-              } else if (this_old_mag < (this_new_mag-this_error)) {
-                  this_new_mag -= this_error;
-              } else {
-                  this_new_mag = this_old_mag;
-              }
-          }        
-	  /* Unlikely that old_mag will be 0 but just in case */
-	  if (this_old_mag) {
-	    c_re(ptr_cas_dest->complex_array,ipix) *= 
-              this_new_mag/this_old_mag;
-	    c_im(ptr_cas_dest->complex_array,ipix) *= 
-              this_new_mag/this_old_mag;
-	  } else {
-	    c_re(ptr_cas_dest->complex_array,ipix) += this_new_mag;
-	  }
-      } else {
-	if (zero_if_not_known) {
-	  c_re(ptr_cas_dest->complex_array,ipix) = 0.0; 
-	  c_im(ptr_cas_dest->complex_array,ipix) = 0.0;
-	}
-      }
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+}
+
+/*------------------------------------------------------------*/
+dm_array_real dm_array_transfer_magnitudes_error(dm_array_complex_struct *ptr_cas_dest, 
+						 dm_array_real_struct *ptr_ras_mags,
+						 dm_array_real_struct *ptr_ras_errors,
+						 int zero_if_not_known)
+{
+  double local_sums[2], total_sums[2];
+
+  if (ptr_cas_dest->npix != ptr_ras_mags->npix) return(0.);
+  if (ptr_ras_errors != NULL) { 
+      if (ptr_cas_dest->npix != ptr_ras_errors->npix) return(0.);      
   }
+
+  dm_array_transfer_magnitudes_kernel(ptr_cas_dest,ptr_ras_mags,
+				      ptr_ras_errors,zero_if_not_known,
+				      local_sums);
   
 #if USE_MPI
-  MPI_Barrier(MPI_COMM_WORLD);
+  MPI_Allreduce(local_sums,total_sums,2,MPI_DOUBLE,MPI_SUM,
+		MPI_COMM_WORLD);
+#else
+  total_sums[0] = local_sums[0];
+  total_sums[1] = local_sums[1];
+#endif
+
+  if (total_sums[1] <= 0.) return(0.);
+  return((dm_array_real)(total_sums[0]/total_sums[1]));
+}
+
+/*------------------------------------------------------------*/
+/* One pixel of dm_array_transfer_magnitudes_kernel(), written with
+ * selects only. The new magnitude is the old one clamped to 
+ * [mag-error,mag+error], a pixel with an old magnitude of 0 gets the
+ * new magnitude as its real part, and unknown pixels (mag of 0) are 
+ * multiplied by keep_unknown.
+ */
+#ifdef DM_ARRAY_DOUBLE
+#define DM_ARRAY_SQRT(x) sqrt(x)
+#else
+#define DM_ARRAY_SQRT(x) sqrtf(x)
 #endif
+#define DM_ARRAY_LANES 8
+#define DM_ARRAY_TRANSFER_BLOCK 256
+#define DM_ARRAY_TRANSFER_MAGNITUDE(__i) {				\
+    this_re = c_re(block_array,block_offset+(__i));			\
+    this_im = c_im(block_array,block_offset+(__i));			\
+    this_old_mag = DM_ARRAY_SQRT(this_re*this_re+this_im*this_im);	\
+    this_mag = *(block_mags+(__i));					\
+    this_error = with_errors ? *(block_errors+(__i)) : zero_value;	\
+    this_new_mag = (this_old_mag > (this_mag+this_error)) ?		\
+      (this_mag+this_error) : this_old_mag;				\
+    this_new_mag = (this_new_mag < (this_mag-this_error)) ?		\
+      (this_mag-this_error) : this_new_mag;				\
+    this_scale = this_new_mag/						\
+      ((this_old_mag > zero_value) ? this_old_mag : one_value);		\
+    this_scale = (this_old_mag > zero_value) ? this_scale : one_value;	\
+    this_re = (this_old_mag > zero_value) ? this_re : this_new_mag;	\
+    this_known = (this_mag != zero_value) ? one_value : zero_value;	\
+    this_scale = (this_mag != zero_value) ? this_scale : keep_unknown;	\
+    c_re(block_array,block_offset+(__i)) = this_re*this_scale;		\
+    c_im(block_array,block_offset+(__i)) = this_im*this_scale;		\
+    this_diff = this_known*(this_old_mag-this_new_mag);		\
+    diff_block[(__i)] = this_diff*this_diff;				\
+    mag_block[(__i)] = this_mag*this_mag;				\
+  }
+
+/*------------------------------------------------------------*/
+void dm_array_transfer_magnitudes_kernel(dm_array_complex_struct *ptr_cas_dest, 
+					 dm_array_real_struct *ptr_ras_mags,
+					 dm_array_real_struct *ptr_ras_errors,
+					 int zero_if_not_known,
+					 double *ptr_sums)
+{
+  dm_array_complex *block_array;
+  dm_array_real *block_mags, *block_errors;
+  dm_array_real this_re, this_im, this_old_mag, this_new_mag, this_mag;
+  dm_array_real this_error, this_scale, this_known, this_diff;
+  dm_array_real keep_unknown, zero_value, one_value;
+  dm_array_real diff_block[DM_ARRAY_TRANSFER_BLOCK];
+  dm_array_real mag_block[DM_ARRAY_TRANSFER_BLOCK];
+  dm_array_real diff_lanes[DM_ARRAY_LANES], mag_lanes[DM_ARRAY_LANES];
+  long i, i_lane, block_start, block_npix, block_offset, local_npix;
+  int with_errors;
+
+  with_errors = (ptr_ras_errors != NULL);
+  zero_value = 0.;
+  one_value = 1.;
+  keep_unknown = zero_if_not_known ? zero_value : one_value;
+  local_npix = (long)ptr_cas_dest->local_npix;
+  if (ptr_sums != NULL) {
+    *(ptr_sums+0) = 0.;
+    *(ptr_sums+1) = 0.;
+  }
+
+  /* The tests of the scalar version (is the magnitude known, is it
+   * inside the error band, is the old magnitude 0) are all done as
+   * selects so that the pixel loop has no branches and can be turned
+   * into vector instructions (gcc needs -fno-math-errno and 
+   * -fno-trapping-math, or -ffast-math, for that). Working on blocks
+   * of DM_ARRAY_TRANSFER_BLOCK pixels from pointers to the start of 
+   * the block keeps the indices simple enough for the vectorizer. The
+   * error terms go into a buffer that is then summed DM_ARRAY_LANES
+   * at a time, and into double precision once per block.
+   */
+  for (block_start=0; block_start<local_npix; 
+       block_start+=DM_ARRAY_TRANSFER_BLOCK) {
+    block_npix = local_npix-block_start;
+    if (block_npix > DM_ARRAY_TRANSFER_BLOCK) {
+      block_npix = DM_ARRAY_TRANSFER_BLOCK;
+    }
+#if DM_ARRAY_SPLIT
+    /* Split arrays can only be indexed from the start */
+    block_array = ptr_cas_dest->complex_array;
+    block_offset = block_start;
+#else
+    block_array = ptr_cas_dest->complex_array+block_start;
+    block_offset = 0;
+#endif /* DM_ARRAY_SPLIT */
+    block_mags = ptr_ras_mags->real_array+block_start;
+    block_errors = with_errors ? 
+      (ptr_ras_errors->real_array+block_start) : NULL;
+
+    for (i=0; i<block_npix; i++) {
+      DM_ARRAY_TRANSFER_MAGNITUDE(i);
+    }
+    
+    if (ptr_sums != NULL) {
+      for (i=block_npix; i<DM_ARRAY_TRANSFER_BLOCK; i++) {
+	diff_block[i] = 0.;
+	mag_block[i] = 0.;
+      }
+      for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+	diff_lanes[i_lane] = 0.;
+	mag_lanes[i_lane] = 0.;
+      }
+      for (i=0; i<block_npix; i+=DM_ARRAY_LANES) {
+	for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+	  diff_lanes[i_lane] += diff_block[i+i_lane];
+	  mag_lanes[i_lane] += mag_block[i+i_lane];
+	}
+      }
+      for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+	*(ptr_sums+0) += diff_lanes[i_lane];
+	*(ptr_sums+1) += mag_lanes[i_lane];
+      }
+    }
+  }
 }
 
 /*------------------------------------------------------------*/
@@ -502,6 +613,205 @@ void dm_array_phase(dm_array_real_struct *ptr_ras,
 #endif /* USE_MPI */
 }
 
+/*------------------------------------------------------------*/
+/* Polynomials for atan(a) = a*P(a^2), fitted for the smallest 
+ * relative error. DM_ARRAY_ATAN_FINE is used by DM_ARRAY_MATH_FAST.
+ * In float builds it is valid on [0,1] (maximum relative error 1.5e-8)
+ * and in double builds on [0,tan(pi/8)] (3.3e-17), with the argument
+ * first reduced from [tan(pi/8),1] by atan(a) = pi/4+atan((a-1)/(a+1)).
+ * DM_ARRAY_ATAN_COARSE is valid on [0,1] with a relative error of 3e-5.
+ */
+#define DM_ARRAY_C(x) ((dm_array_real)(x))
+#define DM_ARRAY_PI DM_ARRAY_C(3.14159265358979323846)
+#define DM_ARRAY_PI_2 DM_ARRAY_C(1.57079632679489661923)
+#define DM_ARRAY_PI_4 DM_ARRAY_C(0.78539816339744830962)
+#define DM_ARRAY_TAN_PI_8 DM_ARRAY_C(0.41421356237309504880)
+#ifdef DM_ARRAY_DOUBLE
+#define DM_ARRAY_ATAN_FINE(s)						\
+  (DM_ARRAY_C(9.9999999999999996687849e-01)+(s)*			\
+   (DM_ARRAY_C(-3.3333333333328617662162e-01)+(s)*			\
+    (DM_ARRAY_C(1.9999999998889321516426e-01)+(s)*			\
+     (DM_ARRAY_C(-1.4285714183516024814798e-01)+(s)*			\
+      (DM_ARRAY_C(1.1111106276281228783988e-01)+(s)*			\
+       (DM_ARRAY_C(-9.0907751529619087625255e-02)+(s)*			\
+	(DM_ARRAY_C(7.6899809462891801691001e-02)+(s)*			\
+	 (DM_ARRAY_C(-6.6404584197607494618157e-02)+(s)*		\
+	  (DM_ARRAY_C(5.6894589991674830629772e-02)+(s)*		\
+	   (DM_ARRAY_C(-4.3510903275204792430149e-02)+(s)*		\
+	    DM_ARRAY_C(2.1170728359965375401396e-02)))))))))))
+#else
+#define DM_ARRAY_ATAN_FINE(s)						\
+  (DM_ARRAY_C(9.9999998477468410020681e-01)+(s)*			\
+   (DM_ARRAY_C(-3.3333073388173143350670e-01)+(s)*			\
+    (DM_ARRAY_C(1.9992619998783671241235e-01)+(s)*			\
+     (DM_ARRAY_C(-1.4203648299228620594099e-01)+(s)*			\
+      (DM_ARRAY_C(1.0640946844643707742576e-01)+(s)*			\
+       (DM_ARRAY_C(-7.5043188461428218517659e-02)+(s)*			\
+	(DM_ARRAY_C(4.2691781639994114188055e-02)+(s)*			\
+	 (DM_ARRAY_C(-1.6068779173916383538817e-02)+(s)*		\
+	  DM_ARRAY_C(2.8499250233396717985401e-03)))))))))
+#endif /* DM_ARRAY_DOUBLE */
+#define DM_ARRAY_ATAN_COARSE(s)						\
+  (DM_ARRAY_C(9.9997005037372539210428e-01)+(s)*			\
+   (DM_ARRAY_C(-3.3170106084433427381162e-01)+(s)*			\
+    (DM_ARRAY_C(1.8521647474690384894834e-01)+(s)*			\
+     (DM_ARRAY_C(-9.1927646954827891868232e-02)+(s)*			\
+      DM_ARRAY_C(2.3863883256198474503125e-02)))))
+#ifdef DM_ARRAY_DOUBLE
+#define DM_ARRAY_COPYSIGN(x,y) copysign(x,y)
+#else
+#define DM_ARRAY_COPYSIGN(x,y) copysignf(x,y)
+#endif
+
+/*------------------------------------------------------------*/
+void dm_array_phase_fast(dm_array_real_struct *ptr_ras,
+			 dm_array_complex_struct *ptr_cas,
+			 int accuracy)
+{
+  dm_array_complex *complex_array;
+  dm_array_real *real_array;
+  dm_array_real temp_re, temp_im, abs_re, abs_im, abs_hi, abs_lo;
+  dm_array_real ratio, ratio_sq;
+  dm_array_real this_phase;
+  long ipix, local_npix;
+#ifdef DM_ARRAY_DOUBLE
+  dm_array_real phase_offset;
+  int is_reduced;
+#endif
+  
+  if ((ptr_ras->npix) != (ptr_cas->npix)) return;
+
+  if (accuracy == DM_ARRAY_MATH_LIBM) {
+    dm_array_phase(ptr_ras,ptr_cas);
+    return;
+  }
+
+  complex_array = ptr_cas->complex_array;
+  real_array = ptr_ras->real_array;
+  local_npix = (long)ptr_ras->local_npix;
+
+  /* atan2() is reduced to atan() of min(|re|,|im|)/max(|re|,|im|) 
+   * in [0,1] and the octant is put back with selects, so that there
+   * are no branches in the loops.
+   */
+  if (accuracy == DM_ARRAY_MATH_FASTEST) {
+    for (ipix=0; ipix<local_npix; ipix++) {
+      temp_re = c_re(complex_array,ipix);
+      temp_im = c_im(complex_array,ipix);
+      abs_re = fabs(temp_re);
+      abs_im = fabs(temp_im);
+      abs_hi = (abs_re > abs_im) ? abs_re : abs_im;
+      abs_lo = (abs_re > abs_im) ? abs_im : abs_re;
+      ratio = abs_lo/((abs_hi > DM_ARRAY_C(0.)) ? abs_hi : DM_ARRAY_C(1.));
+      ratio_sq = ratio*ratio;
+      this_phase = ratio*DM_ARRAY_ATAN_COARSE(ratio_sq);
+      this_phase = (abs_im > abs_re) ? (DM_ARRAY_PI_2-this_phase) : this_phase;
+      this_phase = (temp_re < DM_ARRAY_C(0.)) ? 
+	(DM_ARRAY_PI-this_phase) : this_phase;
+      *(real_array+ipix) = DM_ARRAY_COPYSIGN(this_phase,temp_im);
+    }
+  } else {
+    for (ipix=0; ipix<local_npix; ipix++) {
+      temp_re = c_re(complex_array,ipix);
+      temp_im = c_im(complex_array,ipix);
+      abs_re = fabs(temp_re);
+      abs_im = fabs(temp_im);
+      abs_hi = (abs_re > abs_im) ? abs_re : abs_im;
+      abs_lo = (abs_re > abs_im) ? abs_im : abs_re;
+      ratio = abs_lo/((abs_hi > DM_ARRAY_C(0.)) ? abs_hi : DM_ARRAY_C(1.));
+#ifdef DM_ARRAY_DOUBLE
+      is_reduced = (ratio > DM_ARRAY_TAN_PI_8);
+      phase_offset = is_reduced ? DM_ARRAY_PI_4 : DM_ARRAY_C(0.);
+      ratio = is_reduced ? 
+	((ratio-DM_ARRAY_C(1.))/(ratio+DM_ARRAY_C(1.))) : ratio;
+      ratio_sq = ratio*ratio;
+      this_phase = phase_offset+ratio*DM_ARRAY_ATAN_FINE(ratio_sq);
+#else
+      ratio_sq = ratio*ratio;
+      this_phase = ratio*DM_ARRAY_ATAN_FINE(ratio_sq);
+#endif /* DM_ARRAY_DOUBLE */
+      this_phase = (abs_im > abs_re) ? (DM_ARRAY_PI_2-this_phase) : this_phase;
+      this_phase = (temp_re < DM_ARRAY_C(0.)) ? 
+	(DM_ARRAY_PI-this_phase) : this_phase;
+      *(real_array+ipix) = DM_ARRAY_COPYSIGN(this_phase,temp_im);
+    }
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_magnitude_complex_fast(dm_array_real_struct *ptr_ras,
+				     dm_array_complex_struct *ptr_cas,
+				     int accuracy)
+{
+  dm_array_complex *complex_array;
+  dm_array_real *real_array;
+  dm_array_real temp_re, temp_im;
+  long ipix, local_npix;
+  
+  if ((ptr_ras->npix) != (ptr_cas->npix)) return;
+
+  if (accuracy == DM_ARRAY_MATH_LIBM) {
+    dm_array_magnitude_complex(ptr_ras,ptr_cas);
+    return;
+  }
+
+  complex_array = ptr_cas->complex_array;
+  real_array = ptr_ras->real_array;
+  local_npix = (long)ptr_ras->local_npix;
+
+  /* A correctly rounded sqrt() in dm_array_real precision is already
+   * a single vector instruction, so both fast levels use it and only
+   * give up the double precision intermediate.
+   */
+  for (ipix=0; ipix<local_npix; ipix++) {
+    temp_re = c_re(complex_array,ipix);
+    temp_im = c_im(complex_array,ipix);
+    *(real_array+ipix) = DM_ARRAY_SQRT(temp_re*temp_re+temp_im*temp_im);
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_polar(dm_array_real_struct *ptr_ras_mag,
+		    dm_array_real_struct *ptr_ras_phase,
+		    dm_array_complex_struct *ptr_cas)
+{
+  dm_array_index_t ipix;
+  double temp_re, temp_im;
+
+  /* With only one output there is nothing to share */
+  if (ptr_ras_phase == NULL) {
+    if (ptr_ras_mag != NULL) dm_array_magnitude_complex(ptr_ras_mag,ptr_cas);
+    return;
+  } else if (ptr_ras_mag == NULL) {
+    dm_array_phase(ptr_ras_phase,ptr_cas);
+    return;
+  }
+  
+  if (((ptr_ras_mag->npix) != (ptr_cas->npix)) ||
+      ((ptr_ras_phase->npix) != (ptr_cas->npix))) return;
+  
+  for (ipix=0; ipix<ptr_cas->local_npix; ipix++) {
+    temp_re = (double)c_re(ptr_cas->complex_array,ipix);
+    temp_im = (double)c_im(ptr_cas->complex_array,ipix);
+    *(ptr_ras_mag->real_array+ipix) = 
+      (dm_array_real)sqrt(temp_re*temp_re+temp_im*temp_im);
+    *(ptr_ras_phase->real_array+ipix) = 
+      (dm_array_real)atan2(temp_im,temp_re);
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
 /*------------------------------------------------------------*/
 dm_array_real dm_array_global_phase(dm_array_complex_struct *ptr_cas)
 {
@@ -534,6 +844,193 @@ dm_array_real dm_array_global_phase(dm_array_complex_struct *ptr_cas)
     return(global_phase);
 }
 
+/*------------------------------------------------------------*/
+/* Runs the worker on each of the n_threads tasks, which are
+ * task_size bytes apart. The first task, and any task that could not
+ * be given to a thread, is done by the calling thread.
+ */
+static void dm_array_run_tasks(void *(*worker)(void *),
+			       void *tasks,
+			       size_t task_size,
+			       int n_threads)
+{
+  pthread_t *threads;
+  int i_thread, n_started;
+
+  threads = (pthread_t *)malloc(n_threads*sizeof(pthread_t));
+
+  n_started = 1;
+  if (threads != NULL) {
+    for (i_thread=1; i_thread<n_threads; i_thread++) {
+      if (pthread_create(threads+i_thread,NULL,worker,
+			 (char *)tasks+i_thread*task_size) != 0) {
+	break;
+      }
+      n_started++;
+    }
+  }
+  /* Whatever could not be given to a thread is done here */
+  worker(tasks);
+  for (i_thread=n_started; i_thread<n_threads; i_thread++) {
+    worker((char *)tasks+i_thread*task_size);
+  }
+  for (i_thread=1; i_thread<n_started; i_thread++) {
+    pthread_join(*(threads+i_thread),NULL);
+  }
+
+  if (threads != NULL) free(threads);
+}
+
+/*------------------------------------------------------------*/
+dm_array_real dm_array_remove_global_phase(dm_array_complex_struct *ptr_cas,
+					   dm_array_byte_struct *ptr_bas_support,
+					   int n_threads)
+{
+  dm_array_phase_task_struct *tasks;
+  double local_sums[2], global_sums[2], global_phase;
+  dm_array_index_t pix_per_thread;
+  int i_thread, i_pass;
+
+  if ((ptr_bas_support != NULL) && 
+      ((ptr_bas_support->npix) != (ptr_cas->npix))) return(0.);
+
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > ptr_cas->local_npix) n_threads = ptr_cas->local_npix;
+  if (n_threads < 1) n_threads = 1;
+  tasks = (dm_array_phase_task_struct *)
+    malloc(n_threads*sizeof(dm_array_phase_task_struct));
+
+  pix_per_thread = (ptr_cas->local_npix+n_threads-1)/n_threads;
+  for (i_thread=0; i_thread<n_threads; i_thread++) {
+    (tasks+i_thread)->ptr_cas = ptr_cas;
+    (tasks+i_thread)->byte_array = (ptr_bas_support != NULL) ?
+      ptr_bas_support->byte_array : NULL;
+    (tasks+i_thread)->pix_start = i_thread*pix_per_thread;
+    (tasks+i_thread)->pix_stop = (i_thread+1)*pix_per_thread;
+    if ((tasks+i_thread)->pix_stop > ptr_cas->local_npix) {
+      (tasks+i_thread)->pix_stop = ptr_cas->local_npix;
+    }
+    if ((tasks+i_thread)->pix_start > (tasks+i_thread)->pix_stop) {
+      (tasks+i_thread)->pix_start = (tasks+i_thread)->pix_stop;
+    }
+    (tasks+i_thread)->is_rotation = 0;
+  }
+
+  global_phase = 0.;
+  for (i_pass=0; i_pass<2; i_pass++) {
+    dm_array_run_tasks(dm_array_global_phase_worker,tasks,
+		       sizeof(*tasks),n_threads);
+    if (i_pass == 1) break;
+
+    local_sums[0] = 0.;
+    local_sums[1] = 0.;
+    for (i_thread=0; i_thread<n_threads; i_thread++) {
+      local_sums[0] += (tasks+i_thread)->sum_re;
+      local_sums[1] += (tasks+i_thread)->sum_im;
+    }
+#if USE_MPI
+    MPI_Allreduce(local_sums,global_sums,2,MPI_DOUBLE,MPI_SUM,
+		  MPI_COMM_WORLD);
+#else
+    global_sums[0] = local_sums[0];
+    global_sums[1] = local_sums[1];
+#endif /* USE_MPI */
+
+    /* All processes got the same sums, so they all stop here or all
+     * go on to the rotation.
+     */
+    if ((global_sums[0] == 0.) && (global_sums[1] == 0.)) break;
+    global_phase = atan2(global_sums[1],global_sums[0]);
+    for (i_thread=0; i_thread<n_threads; i_thread++) {
+      (tasks+i_thread)->is_rotation = 1;
+      (tasks+i_thread)->rot_re = (dm_array_real)cos(global_phase);
+      (tasks+i_thread)->rot_im = (dm_array_real)(-sin(global_phase));
+    }
+  }
+
+  free(tasks);
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  return((dm_array_real)global_phase);
+}
+
+/*------------------------------------------------------------*/
+void *dm_array_global_phase_worker(void *ptr_arg)
+{
+  dm_array_phase_task_struct *ptr_task;
+  dm_array_complex *complex_array;
+  u_int8_t *byte_array;
+  dm_array_real temp_re, temp_im, rot_re, rot_im, weight;
+  double sum_re, sum_im;
+  double sum_re_lanes[DM_ARRAY_LANES], sum_im_lanes[DM_ARRAY_LANES];
+  long ipix, i_lane, pix_start, pix_stop, full_stop;
+
+  ptr_task = (dm_array_phase_task_struct *)ptr_arg;
+  complex_array = ptr_task->ptr_cas->complex_array;
+  byte_array = ptr_task->byte_array;
+  pix_stop = (long)ptr_task->pix_stop;
+
+  if (ptr_task->is_rotation) {
+    rot_re = ptr_task->rot_re;
+    rot_im = ptr_task->rot_im;
+    for (ipix=(long)ptr_task->pix_start; ipix<pix_stop; ipix++) {
+      temp_re = c_re(complex_array,ipix);
+      temp_im = c_im(complex_array,ipix);
+      c_re(complex_array,ipix) = temp_re*rot_re-temp_im*rot_im;
+      c_im(complex_array,ipix) = temp_re*rot_im+temp_im*rot_re;
+    }
+  } else {
+    /* DM_ARRAY_LANES separate sums keep the additions in order for 
+     * each of them, so that they can be done as vector instructions 
+     * without -ffast-math. The support only weights the pixels.
+     */
+    for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+      sum_re_lanes[i_lane] = 0.;
+      sum_im_lanes[i_lane] = 0.;
+    }
+    pix_start = (long)ptr_task->pix_start;
+    full_stop = pix_start+((pix_stop-pix_start)/DM_ARRAY_LANES)*DM_ARRAY_LANES;
+    if (byte_array == NULL) {
+      for (ipix=pix_start; ipix<full_stop; ipix+=DM_ARRAY_LANES) {
+	for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+	  sum_re_lanes[i_lane] += (double)c_re(complex_array,ipix+i_lane);
+	  sum_im_lanes[i_lane] += (double)c_im(complex_array,ipix+i_lane);
+	}
+      }
+    } else {
+      for (ipix=pix_start; ipix<full_stop; ipix+=DM_ARRAY_LANES) {
+	for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+	  weight = (*(byte_array+ipix+i_lane) != 0) ? 
+	    (dm_array_real)1. : (dm_array_real)0.;
+	  sum_re_lanes[i_lane] += 
+	    (double)(weight*c_re(complex_array,ipix+i_lane));
+	  sum_im_lanes[i_lane] += 
+	    (double)(weight*c_im(complex_array,ipix+i_lane));
+	}
+      }
+    }
+    sum_re = 0.;
+    sum_im = 0.;
+    for (i_lane=0; i_lane<DM_ARRAY_LANES; i_lane++) {
+      sum_re += sum_re_lanes[i_lane];
+      sum_im += sum_im_lanes[i_lane];
+    }
+    for (ipix=full_stop; ipix<pix_stop; ipix++) {
+      weight = ((byte_array == NULL) || (*(byte_array+ipix) != 0)) ?
+	(dm_array_real)1. : (dm_array_real)0.;
+      sum_re += (double)(weight*c_re(complex_array,ipix));
+      sum_im += (double)(weight*c_im(complex_array,ipix));
+    }
+    ptr_task->sum_re = sum_re;
+    ptr_task->sum_im = sum_im;
+  }
+
+  return(NULL);
+}
+
 /*------------------------------------------------------------*/
 /** This routine puts the intensity (square) of complex_array 
     into real_array */
@@ -556,6 +1053,39 @@ void dm_array_intensity(dm_array_real_struct *ptr_ras,
 #endif /* USE_MPI */
 }
 
+/*------------------------------------------------------------*/
+void dm_array_intensity_magnitude(dm_array_real_struct *ptr_ras_intens,
+				  dm_array_real_struct *ptr_ras_mag,
+				  dm_array_complex_struct *ptr_cas)
+{
+  dm_array_index_t ipix;
+  double temp_re, temp_im, temp_intens;
+
+  /* With only one output there is nothing to share */
+  if (ptr_ras_mag == NULL) {
+    if (ptr_ras_intens != NULL) dm_array_intensity(ptr_ras_intens,ptr_cas);
+    return;
+  } else if (ptr_ras_intens == NULL) {
+    dm_array_magnitude_complex(ptr_ras_mag,ptr_cas);
+    return;
+  }
+  
+  if (((ptr_ras_intens->npix) != (ptr_cas->npix)) ||
+      ((ptr_ras_mag->npix) != (ptr_cas->npix))) return;
+  
+  for (ipix=0; ipix<ptr_cas->local_npix; ipix++) {
+    temp_re = (double)c_re(ptr_cas->complex_array,ipix);
+    temp_im = (double)c_im(ptr_cas->complex_array,ipix);
+    temp_intens = temp_re*temp_re+temp_im*temp_im;
+    *(ptr_ras_intens->real_array+ipix) = (dm_array_real)temp_intens;
+    *(ptr_ras_mag->real_array+ipix) = (dm_array_real)sqrt(temp_intens);
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
 /*------------------------------------------------------------*/
 void dm_array_zero_complex(dm_array_complex_struct *ptr_cas)
 {
@@ -772,21 +1302,139 @@ dm_array_real dm_array_min_real(dm_array_real_struct *ptr_ras,
 void dm_array_rand(dm_array_complex_struct *ptr_cas,
 		   int imaginary_too)
 {
-    dm_array_index_t ipix;
-    time_t seed = time(NULL);
+    dm_array_index_t global_offset;
+    u_int64_t seed;
+    int my_rank;
 
-    for (ipix=0;ipix<ptr_cas->local_npix;ipix++) {
-      c_re(ptr_cas->complex_array,ipix) = dm_rand(&seed);
-      if (imaginary_too) {
-	c_im(ptr_cas->complex_array,ipix) = dm_rand(&seed);
-      }
-    }
+    /* Every process has to use the same seed so that the slabs
+     * continue each other instead of repeating.
+     */
+    seed = (u_int64_t)time(NULL);
+#if USE_MPI
+    MPI_Bcast(&seed,1,MPI_UNSIGNED_LONG_LONG,0,MPI_COMM_WORLD);
+    MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+#else
+    my_rank = 0;
+#endif /* USE_MPI */
+    global_offset = (dm_array_index_t)my_rank*ptr_cas->local_npix;
+
+    dm_array_rand_offset(ptr_cas,imaginary_too,seed,global_offset,1);
+
+#if USE_MPI
+    MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_rand_seeded(dm_array_complex_struct *ptr_cas,
+			  int imaginary_too,
+			  u_int64_t seed,
+			  int n_threads)
+{
+    dm_array_rand_offset(ptr_cas,imaginary_too,seed,
+			 ptr_cas->local_offset,n_threads);
 
 #if USE_MPI
     MPI_Barrier(MPI_COMM_WORLD);
 #endif /* USE_MPI */
 }
 
+/*------------------------------------------------------------*/
+void dm_array_rand_offset(dm_array_complex_struct *ptr_cas,
+			  int imaginary_too,
+			  u_int64_t seed,
+			  dm_array_index_t global_offset,
+			  int n_threads)
+{
+  dm_array_rand_task_struct *tasks;
+  dm_array_index_t pix_per_thread;
+  int i_thread;
+
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > ptr_cas->local_npix) n_threads = ptr_cas->local_npix;
+  if (n_threads < 1) n_threads = 1;
+  tasks = (dm_array_rand_task_struct *)
+    malloc(n_threads*sizeof(dm_array_rand_task_struct));
+
+  pix_per_thread = (ptr_cas->local_npix+n_threads-1)/n_threads;
+  for (i_thread=0; i_thread<n_threads; i_thread++) {
+    (tasks+i_thread)->ptr_cas = ptr_cas;
+    (tasks+i_thread)->imaginary_too = imaginary_too;
+    (tasks+i_thread)->seed = seed;
+    (tasks+i_thread)->global_offset = global_offset;
+    (tasks+i_thread)->pix_start = i_thread*pix_per_thread;
+    (tasks+i_thread)->pix_stop = (i_thread+1)*pix_per_thread;
+    if ((tasks+i_thread)->pix_stop > ptr_cas->local_npix) {
+      (tasks+i_thread)->pix_stop = ptr_cas->local_npix;
+    }
+    if ((tasks+i_thread)->pix_start > (tasks+i_thread)->pix_stop) {
+      (tasks+i_thread)->pix_start = (tasks+i_thread)->pix_stop;
+    }
+  }
+
+  dm_array_run_tasks(dm_array_rand_worker,tasks,sizeof(*tasks),n_threads);
+
+  free(tasks);
+}
+
+/*------------------------------------------------------------*/
+/* A uniform number in [0,1) from two random 32-bit words: 24 bits
+ * of the first one for float, 53 bits of both for double.
+ */
+#ifdef DM_ARRAY_DOUBLE
+#define DM_ARRAY_RAND_UNIFORM(__w0,__w1)				\
+  ((dm_array_real)((double)((((u_int64_t)((__w0) >> 5)) << 26) |	\
+			    (u_int64_t)((__w1) >> 6))*			\
+		   (1./9007199254740992.)))
+#else
+#define DM_ARRAY_RAND_UNIFORM(__w0,__w1)				\
+  ((dm_array_real)((__w0) >> 8)*(dm_array_real)(1./16777216.))
+#endif /* DM_ARRAY_DOUBLE */
+
+void *dm_array_rand_worker(void *ptr_arg)
+{
+  dm_array_rand_task_struct *ptr_task;
+  dm_array_complex *complex_array;
+  u_int64_t global_pix;
+  u_int32_t c0, c1, c2, c3, key0, key1;
+  long ipix, pix_stop;
+
+  ptr_task = (dm_array_rand_task_struct *)ptr_arg;
+  complex_array = ptr_task->ptr_cas->complex_array;
+  key0 = (u_int32_t)ptr_task->seed;
+  key1 = (u_int32_t)(ptr_task->seed >> 32);
+  pix_stop = (long)ptr_task->pix_stop;
+
+  /* The counter is the global index of the pixel, so the numbers
+   * do not depend on how the array is split up between processes
+   * and threads.
+   */
+  if (ptr_task->imaginary_too) {
+    for (ipix=(long)ptr_task->pix_start; ipix<pix_stop; ipix++) {
+      global_pix = (u_int64_t)ptr_task->global_offset+(u_int64_t)ipix;
+      c0 = (u_int32_t)global_pix;
+      c1 = (u_int32_t)(global_pix >> 32);
+      c2 = 0;
+      c3 = 0;
+      DM_PHILOX4X32_10(c0,c1,c2,c3,key0,key1);
+      c_re(complex_array,ipix) = DM_ARRAY_RAND_UNIFORM(c0,c1);
+      c_im(complex_array,ipix) = DM_ARRAY_RAND_UNIFORM(c2,c3);
+    }
+  } else {
+    for (ipix=(long)ptr_task->pix_start; ipix<pix_stop; ipix++) {
+      global_pix = (u_int64_t)ptr_task->global_offset+(u_int64_t)ipix;
+      c0 = (u_int32_t)global_pix;
+      c1 = (u_int32_t)(global_pix >> 32);
+      c2 = 0;
+      c3 = 0;
+      DM_PHILOX4X32_10(c0,c1,c2,c3,key0,key1);
+      c_re(complex_array,ipix) = DM_ARRAY_RAND_UNIFORM(c0,c1);
+    }
+  }
+
+  return(NULL);
+}
+
 /*------------------------------------------------------------*/
 void dm_array_load_gaussian(dm_array_complex_struct *ptr_cas,
 			    dm_array_real sigma_x,
@@ -797,181 +1445,176 @@ void dm_array_load_gaussian(dm_array_complex_struct *ptr_cas,
                             int p,
                             int my_rank)
 {
-  dm_array_index_t ix, iy, iz, yoffset, zoffset, offset, local_n;
-  dm_array_index_t local_nx, local_ny, local_nz;
   dm_array_real *xarr, *yarr, *zarr;
-  dm_array_real inverse_sigma_x, inverse_sigma_y, inverse_sigma_z;
-  dm_array_real this_x, this_y, this_z;
-  dm_array_real half_nx, half_ny, half_nz;
-
-#if USE_MPI
-  local_n = ptr_cas->npix/p;
-  if (ptr_cas->ny == 1) {
-      local_nx = ptr_cas->nx/p;
-      local_ny = 1;
-      local_nz = 1;
-  } else if (ptr_cas->nz == 1) {
-      local_nx = ptr_cas->nx;
-      local_ny = ptr_cas->ny/p;
-      local_nz = 1;
-  } else {
-      local_nx = ptr_cas->nx;
-      local_ny = ptr_cas->ny;
-      local_nz = ptr_cas->nz/p;
-  }
-#else
-  local_n = ptr_cas->npix;
-  local_nx = ptr_cas->nx;
-  local_ny = ptr_cas->ny;
-  local_nz = ptr_cas->nz;
-#endif /* USE_MPI */
-  
-  inverse_sigma_x = 0.;
-  inverse_sigma_y = 0.;
-  inverse_sigma_z = 0.;
-  if (sigma_x != 0.) inverse_sigma_x = 0.5/(sigma_x*sigma_x);
-  if (sigma_y != 0.) inverse_sigma_y = 0.5/(sigma_y*sigma_y);
-  if (sigma_z != 0.) inverse_sigma_z = 0.5/(sigma_z*sigma_z);
-
-  /* Pre-calculate arrays for each dimension.  Otherwise we'd
+
+  /* Pre-calculate the profile along each dimension.  Otherwise we'd
      calculate the X contribution (ny*nz) times, and the Y
-     contribution (nz) times. Take MPI into account by using local_*.
+     contribution (nz) times. The profiles cover the whole array, so
+     that every process can look up its own pixels in them.
   */
-  xarr = (dm_array_real *)malloc(local_nx*sizeof(dm_array_real));
-  yarr = (dm_array_real *)malloc(local_ny*sizeof(dm_array_real));
-  zarr = (dm_array_real *)malloc(local_nz*sizeof(dm_array_real));
+  xarr = (dm_array_real *)malloc(ptr_cas->nx*sizeof(dm_array_real));
+  yarr = (dm_array_real *)malloc(ptr_cas->ny*sizeof(dm_array_real));
+  zarr = (dm_array_real *)malloc(ptr_cas->nz*sizeof(dm_array_real));
+  dm_array_gaussian_profile(xarr,ptr_cas->nx,sigma_x,fft_centered);
+  dm_array_gaussian_profile(yarr,ptr_cas->ny,sigma_y,fft_centered);
+  dm_array_gaussian_profile(zarr,ptr_cas->nz,sigma_z,fft_centered);
+
+  /* Arrays from DM_ARRAY_COMPLEX_STRUCT_INIT() start at 
+   * my_rank*local_npix, and local_offset is not always set for them.
+   */
+  dm_array_load_separable_offset(ptr_cas,xarr,yarr,zarr,inverse,
+				 (dm_array_index_t)my_rank*ptr_cas->local_npix,1);
   
-  if (local_ny == 1) {
-      if (local_nx > 1) {
-	/* Center of Gaussian is in the absolute center of array 
-	 * if data-centered, otherwise it is at f(0,0,0)
-	 */
-	for (ix=0; ix<local_nx; ix++) {
-	  if (fft_centered == 1) {
-	    this_x = (my_rank*local_nx+ix);
-	    (this_x<ptr_cas->nx/2)?(this_x=this_x):(this_x=this_x-ptr_cas->nx);
-	  } else {
-	    this_x = (my_rank*local_nx+ix) - ptr_cas->nx/2;
-	  }
-	  *(xarr+ix) = exp(-this_x*this_x*inverse_sigma_x);
-	}
-      } else {
-	*(xarr+0) = 1.;
-      }
-      *(yarr+0) = 1.;
-      *(zarr+0) = 1.;
-  } else if (local_nz == 1) {
-      if (local_nx > 1) {
-	/* Center of Gaussian is in the absolute center of array 
-	 * if data-centered, otherwise it is at f(0,0,0)
-	 */
-	for (ix=0; ix<local_nx; ix++) {
-	  if (fft_centered == 1) {
-	    this_x = ix;
-	    (this_x<ptr_cas->nx/2)?(this_x=this_x):(this_x=this_x-ptr_cas->nx);
-	  } else {
-	    this_x = ix - ptr_cas->nx/2;
-	  }
-	  *(xarr+ix) = exp(-this_x*this_x*inverse_sigma_x);
-	}
-      } else {
-          *(xarr+0) = 1.;
-      }
-      if (local_ny > 1) {
-	/* Center of Gaussian is in the absolute center of array 
-	 * if data-centered, otherwise it is at f(0,0,0)
-	 */
-	for (iy=0; iy<local_ny; iy++) {
-	  if (fft_centered == 1) {
-	    this_y = (my_rank*local_ny+iy);
-	    (this_y<ptr_cas->ny/2)?(this_y=this_y):(this_y=this_y-ptr_cas->ny);
-	  } else {
-	    this_y = (my_rank*local_ny+iy) - ptr_cas->ny/2;
-	  }
-	  *(yarr+iy) = exp(-this_y*this_y*inverse_sigma_y);
-	}
-      } else {
-	*(yarr+0) = 1.;
-      }
-      *(zarr+0) = 1.;
-  } else {
-    if (local_nx > 1) {
-      /* Center of Gaussian is in the absolute center of array 
-       * if data-centered, otherwise it is at f(0,0,0)
-       */
-      for (ix=0; ix<local_nx; ix++) {
-	if (fft_centered == 1) {
-	  this_x = ix;
-	  (this_x<ptr_cas->nx/2)?(this_x=this_x):(this_x=this_x-ptr_cas->nx);
-	} else {
-	  this_x = ix - ptr_cas->nx/2;
-	}
-	*(xarr+ix) = exp(-this_x*this_x*inverse_sigma_x);
-      }
-    } else {
-      *(xarr+0) = 1.;
-    }
-    if (local_ny > 1) {
-      /* Center of Gaussian is in the absolute center of array 
-       * if data-centered, otherwise it is at f(0,0,0)
-       */
-      for (iy=0; iy<local_ny; iy++) {
-	if (fft_centered == 1) {
-	  this_y = iy;
-	  (this_y<ptr_cas->ny/2)?(this_y=this_y):(this_y=this_y-ptr_cas->ny);
-	} else {
-	  this_y = iy - ptr_cas->ny/2;
-	}
-	*(yarr+iy) = exp(-this_y*this_y*inverse_sigma_y);
-      }
+  free(xarr);
+  free(yarr);
+  free(zarr);
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+  
+}
+
+/*------------------------------------------------------------*/
+void dm_array_gaussian_profile(dm_array_real *profile,
+			       int n,
+			       dm_array_real sigma,
+			       int fft_centered)
+{
+  dm_array_real inverse_sigma, this_x;
+  int ix;
+
+  inverse_sigma = 0.;
+  if (sigma != 0.) inverse_sigma = 0.5/(sigma*sigma);
+
+  if (n == 1) {
+    *(profile+0) = 1.;
+    return;
+  }
+
+  /* Center of Gaussian is in the absolute center of array 
+   * if data-centered, otherwise it is at f(0,0,0)
+   */
+  for (ix=0; ix<n; ix++) {
+    if (fft_centered == 1) {
+      this_x = (ix < n/2) ? ix : (ix-n);
     } else {
-      *(yarr+0) = 1.;
+      this_x = ix - n/2;
     }
-    if (local_nz > 1) {
-      /* Center of Gaussian is in the absolute center of array 
-       * if data-centered, otherwise it is at f(0,0,0)
-       */
-      for (iz=0; iz<local_nz; iz++) {
-	if (fft_centered == 1) {
-	  this_z = (my_rank*local_nz+iz);
-	  (this_z<ptr_cas->nz/2)?(this_z=this_z):(this_z=this_z-ptr_cas->nz);
-	} else {
-	  this_z = (my_rank*local_nz+iz) - ptr_cas->nz/2;
-	}
-	*(zarr+iz) = exp(-this_z*this_z*inverse_sigma_z);
-      }
-    } else {
-      *(zarr+0) = 1.;
+    *(profile+ix) = exp(-this_x*this_x*inverse_sigma);
+  }
+}
+
+/*------------------------------------------------------------*/
+void dm_array_load_separable(dm_array_complex_struct *ptr_cas,
+			     dm_array_real *x_profile,
+			     dm_array_real *y_profile,
+			     dm_array_real *z_profile,
+			     int inverse,
+			     int n_threads)
+{
+  dm_array_load_separable_offset(ptr_cas,x_profile,y_profile,z_profile,
+				 inverse,ptr_cas->local_offset,n_threads);
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_load_separable_offset(dm_array_complex_struct *ptr_cas,
+				    dm_array_real *x_profile,
+				    dm_array_real *y_profile,
+				    dm_array_real *z_profile,
+				    int inverse,
+				    dm_array_index_t global_offset,
+				    int n_threads)
+{
+  dm_array_separable_task_struct *tasks;
+  dm_array_index_t pix_per_thread;
+  int i_thread;
+
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > ptr_cas->local_npix) n_threads = ptr_cas->local_npix;
+  if (n_threads < 1) n_threads = 1;
+  tasks = (dm_array_separable_task_struct *)
+    malloc(n_threads*sizeof(dm_array_separable_task_struct));
+
+  pix_per_thread = (ptr_cas->local_npix+n_threads-1)/n_threads;
+  for (i_thread=0; i_thread<n_threads; i_thread++) {
+    (tasks+i_thread)->ptr_cas = ptr_cas;
+    (tasks+i_thread)->x_profile = x_profile;
+    (tasks+i_thread)->y_profile = y_profile;
+    (tasks+i_thread)->z_profile = z_profile;
+    (tasks+i_thread)->inverse = inverse;
+    (tasks+i_thread)->global_offset = global_offset;
+    (tasks+i_thread)->pix_start = i_thread*pix_per_thread;
+    (tasks+i_thread)->pix_stop = (i_thread+1)*pix_per_thread;
+    if ((tasks+i_thread)->pix_stop > ptr_cas->local_npix) {
+      (tasks+i_thread)->pix_stop = ptr_cas->local_npix;
+    }
+    if ((tasks+i_thread)->pix_start > (tasks+i_thread)->pix_stop) {
+      (tasks+i_thread)->pix_start = (tasks+i_thread)->pix_stop;
     }
   }
-  
-  for (iz=0; iz<local_nz; iz++) {
-    zoffset = local_nx*local_ny*iz;
-    this_z = *(zarr+iz);
-    for (iy=0; iy<local_ny; iy++) {
-      yoffset = local_nx*iy+zoffset;
-      this_y = *(yarr+iy);
-      for (ix=0; ix<local_nx; ix++) {
-	offset = ix+yoffset;
-        if (inverse) {
-            c_re(ptr_cas->complex_array,offset) =
-                1-(*(xarr+ix))*this_y*this_z;
-        } else {
-            c_re(ptr_cas->complex_array,offset) =
-                (*(xarr+ix))*this_y*this_z;
-        }
-        c_im(ptr_cas->complex_array,offset) = 0.;
+
+  dm_array_run_tasks(dm_array_load_separable_worker,tasks,
+		     sizeof(*tasks),n_threads);
+
+  free(tasks);
+}
+
+/*------------------------------------------------------------*/
+void *dm_array_load_separable_worker(void *ptr_arg)
+{
+  dm_array_separable_task_struct *ptr_task;
+  dm_array_complex *complex_array;
+  dm_array_real *x_profile;
+  dm_array_real this_yz, sign, base;
+  long nx, ny, ipix, pix_stop, global_pix, ix, iy, iz, row_npix, i;
+
+  ptr_task = (dm_array_separable_task_struct *)ptr_arg;
+  complex_array = ptr_task->ptr_cas->complex_array;
+  x_profile = ptr_task->x_profile;
+  nx = (long)ptr_task->ptr_cas->nx;
+  ny = (long)ptr_task->ptr_cas->ny;
+  pix_stop = (long)ptr_task->pix_stop;
+
+  /* inverse gives 1-x*y*z */
+  sign = ptr_task->inverse ? (dm_array_real)-1. : (dm_array_real)1.;
+  base = ptr_task->inverse ? (dm_array_real)1. : (dm_array_real)0.;
+
+  /* Go through the local pixels a row (or the part of a row that 
+   * is local) at a time, with the global row and plane worked out 
+   * from the global index of the first pixel. Each row is then a
+   * scaled copy of x_profile.
+   */
+  ipix = (long)ptr_task->pix_start;
+  while (ipix < pix_stop) {
+    global_pix = (long)ptr_task->global_offset+ipix;
+    ix = global_pix % nx;
+    iy = (global_pix/nx) % ny;
+    iz = global_pix/(nx*ny);
+    row_npix = nx-ix;
+    if (row_npix > (pix_stop-ipix)) row_npix = pix_stop-ipix;
+
+    this_yz = sign;
+    if (ptr_task->y_profile != NULL) this_yz *= *(ptr_task->y_profile+iy);
+    if (ptr_task->z_profile != NULL) this_yz *= *(ptr_task->z_profile+iz);
+
+    if (x_profile != NULL) {
+      for (i=0; i<row_npix; i++) {
+	c_re(complex_array,ipix+i) = base+this_yz*(*(x_profile+ix+i));
+	c_im(complex_array,ipix+i) = 0.;
+      }
+    } else {
+      for (i=0; i<row_npix; i++) {
+	c_re(complex_array,ipix+i) = base+this_yz;
+	c_im(complex_array,ipix+i) = 0.;
       }
     }
+    ipix += row_npix;
   }
 
-  free(xarr);
-  free(yarr);
-  free(zarr);
-#if USE_MPI
-  MPI_Barrier(MPI_COMM_WORLD);
-#endif
-  
+  return(NULL);
 }
 
 /*------------------------------------------------------------*/
@@ -1024,6 +1667,383 @@ void dm_array_multiply_complex_byte(dm_array_complex_struct *ptr_cas,
 #endif /*USE_MPI*/
 }
   
+/*------------------------------------------------------------*/
+void dm_array_byte_to_bit(dm_array_bit_struct *ptr_bits,
+			  dm_array_byte_struct *ptr_bas)
+{
+  dm_array_index_t iword, n_words, first, n_in_word, ibit;
+  u_int64_t word;
+  u_int8_t *ptr_bytes;
+
+  if (ptr_bits->npix != ptr_bas->npix) return;
+
+  n_words = (ptr_bas->local_npix+63)/64;
+  for (iword=0; iword<n_words; iword++) {
+    first = iword*64;
+    n_in_word = ptr_bas->local_npix-first;
+    if (n_in_word > 64) n_in_word = 64;
+    ptr_bytes = ptr_bas->byte_array+first;
+    word = 0;
+    for (ibit=0; ibit<n_in_word; ibit++) {
+      word |= ((u_int64_t)(*(ptr_bytes+ibit) != 0)) << ibit;
+    }
+    *(ptr_bits->bit_array+iword) = word;
+  }
+}
+
+/*------------------------------------------------------------*/
+void dm_array_bit_to_byte(dm_array_byte_struct *ptr_bas,
+			  dm_array_bit_struct *ptr_bits)
+{
+  dm_array_index_t iword, n_words, first, n_in_word, ibit;
+  u_int64_t word;
+  u_int8_t *ptr_bytes;
+
+  if (ptr_bits->npix != ptr_bas->npix) return;
+
+  n_words = (ptr_bas->local_npix+63)/64;
+  for (iword=0; iword<n_words; iword++) {
+    first = iword*64;
+    n_in_word = ptr_bas->local_npix-first;
+    if (n_in_word > 64) n_in_word = 64;
+    ptr_bytes = ptr_bas->byte_array+first;
+    word = *(ptr_bits->bit_array+iword);
+    for (ibit=0; ibit<n_in_word; ibit++) {
+      *(ptr_bytes+ibit) = (u_int8_t)((word >> ibit) & 1);
+    }
+  }
+}
+
+/*------------------------------------------------------------*/
+void dm_array_multiply_complex_bit(dm_array_complex_struct *ptr_cas,
+				   dm_array_bit_struct *ptr_bits)
+{
+  dm_array_index_t iword, n_words, first, last, ipix;
+  dm_array_real this_bit;
+  u_int64_t word;
+
+  if (ptr_cas->npix != ptr_bits->npix) return;
+
+  /* Whole words inside the mask are left alone and whole words 
+   * outside are just zeroed. Only words on the edge of the mask need
+   * the bits, and those loops have no branches so that the compiler
+   * can vectorize them.
+   */
+  n_words = (ptr_cas->local_npix+63)/64;
+  for (iword=0; iword<n_words; iword++) {
+    word = *(ptr_bits->bit_array+iword);
+    if (word == ~(u_int64_t)0) continue;
+    first = iword*64;
+    last = first+64;
+    if (last > ptr_cas->local_npix) last = ptr_cas->local_npix;
+    if (word == 0) {
+      for (ipix=first; ipix<last; ipix++) {
+	c_re(ptr_cas->complex_array,ipix) = 0.;
+	c_im(ptr_cas->complex_array,ipix) = 0.;
+      }
+    } else {
+      for (ipix=first; ipix<last; ipix++) {
+	this_bit = (dm_array_real)((word >> (ipix-first)) & 1);
+	c_re(ptr_cas->complex_array,ipix) *= this_bit;
+	c_im(ptr_cas->complex_array,ipix) *= this_bit;
+      }
+    }
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /*USE_MPI*/
+}
+
+/*------------------------------------------------------------*/
+dm_array_real dm_array_total_power_complex_bit(dm_array_complex_struct *ptr_cas,
+					       dm_array_bit_struct *ptr_bits,
+					       int inverse)
+{
+  dm_array_index_t iword, n_words, first, last, ipix;
+  double local_power, total_power, word_power;
+  dm_array_real this_re, this_im, this_bit;
+  u_int64_t word;
+
+  if (ptr_cas->npix != ptr_bits->npix) return(0.);
+
+  local_power = 0.;
+  n_words = (ptr_cas->local_npix+63)/64;
+  for (iword=0; iword<n_words; iword++) {
+    word = *(ptr_bits->bit_array+iword);
+    first = iword*64;
+    last = first+64;
+    if (last > ptr_cas->local_npix) {
+      last = ptr_cas->local_npix;
+      /* Pixels past the end count as outside of the mask */
+      if (inverse) word |= ~(u_int64_t)0 << (last-first);
+    }
+    if (inverse) word = ~word;
+    if (word == 0) continue;
+    word_power = 0.;
+    if (word == ~(u_int64_t)0) {
+      for (ipix=first; ipix<last; ipix++) {
+	this_re = c_re(ptr_cas->complex_array,ipix);
+	this_im = c_im(ptr_cas->complex_array,ipix);
+	word_power += this_re*this_re+this_im*this_im;
+      }
+    } else {
+      for (ipix=first; ipix<last; ipix++) {
+	this_bit = (dm_array_real)((word >> (ipix-first)) & 1);
+	this_re = c_re(ptr_cas->complex_array,ipix);
+	this_im = c_im(ptr_cas->complex_array,ipix);
+	word_power += this_bit*(this_re*this_re+this_im*this_im);
+      }
+    }
+    local_power += word_power;
+  }
+
+#if USE_MPI
+  MPI_Allreduce(&local_power,&total_power,1,MPI_DOUBLE,MPI_SUM,
+		MPI_COMM_WORLD);
+#else 
+  total_power = local_power;
+#endif /* USE_MPI */
+
+  return((dm_array_real)total_power);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_copy_complex_bit(dm_array_complex_struct *ptr_cas_dest, 
+			       dm_array_complex_struct *ptr_cas_src,
+			       dm_array_bit_struct *ptr_bits)
+{
+  dm_array_index_t iword, n_words, first, last, ipix;
+  u_int64_t word, this_bit;
+
+  if ((ptr_cas_dest->npix != ptr_cas_src->npix) ||
+      (ptr_cas_dest->npix != ptr_bits->npix)) return;
+
+  n_words = (ptr_cas_dest->local_npix+63)/64;
+  for (iword=0; iword<n_words; iword++) {
+    word = *(ptr_bits->bit_array+iword);
+    if (word == 0) continue;
+    first = iword*64;
+    last = first+64;
+    if (last > ptr_cas_dest->local_npix) last = ptr_cas_dest->local_npix;
+    if (word == ~(u_int64_t)0) {
+      for (ipix=first; ipix<last; ipix++) {
+	c_re(ptr_cas_dest->complex_array,ipix) = 
+	  c_re(ptr_cas_src->complex_array,ipix);
+	c_im(ptr_cas_dest->complex_array,ipix) = 
+	  c_im(ptr_cas_src->complex_array,ipix);
+      }
+    } else {
+      for (ipix=first; ipix<last; ipix++) {
+	this_bit = (word >> (ipix-first)) & 1;
+	c_re(ptr_cas_dest->complex_array,ipix) = this_bit ?
+	  c_re(ptr_cas_src->complex_array,ipix) :
+	  c_re(ptr_cas_dest->complex_array,ipix);
+	c_im(ptr_cas_dest->complex_array,ipix) = this_bit ?
+	  c_im(ptr_cas_src->complex_array,ipix) :
+	  c_im(ptr_cas_dest->complex_array,ipix);
+      }
+    }
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /*USE_MPI*/
+}
+  
+/*------------------------------------------------------------*/
+int dm_array_span_init(dm_array_span_struct *ptr_spans,
+		       dm_array_byte_struct *ptr_bas)
+{
+  dm_array_index_t ipix, row_length, n_spans, n_inside, i_span;
+  u_int8_t *byte_array;
+  int inside;
+
+  /* 1D arrays are one long row */
+  row_length = (ptr_bas->ny > 1) ? ptr_bas->nx : ptr_bas->local_npix;
+  byte_array = ptr_bas->byte_array;
+  ptr_spans->npix = ptr_bas->npix;
+  ptr_spans->local_npix = ptr_bas->local_npix;
+  ptr_spans->span_starts = NULL;
+  ptr_spans->span_lengths = NULL;
+
+  /* Count the spans first so that the arrays are allocated once */
+  n_spans = 0;
+  n_inside = 0;
+  inside = 0;
+  for (ipix=0; ipix<ptr_bas->local_npix; ipix++) {
+    if ((ipix%row_length) == 0) inside = 0;
+    if (*(byte_array+ipix) != 0) {
+      if (!inside) n_spans++;
+      inside = 1;
+      n_inside++;
+    } else {
+      inside = 0;
+    }
+  }
+  ptr_spans->n_spans = n_spans;
+  ptr_spans->n_inside = n_inside;
+  if (n_spans == 0) return(0);
+
+  ptr_spans->span_starts = 
+    (dm_array_index_t *)malloc(n_spans*sizeof(dm_array_index_t));
+  ptr_spans->span_lengths = 
+    (dm_array_index_t *)malloc(n_spans*sizeof(dm_array_index_t));
+  if ((ptr_spans->span_starts == NULL) || 
+      (ptr_spans->span_lengths == NULL)) {
+    dm_array_span_free(ptr_spans);
+    return(-1);
+  }
+
+  i_span = 0;
+  inside = 0;
+  for (ipix=0; ipix<ptr_bas->local_npix; ipix++) {
+    if ((ipix%row_length) == 0) inside = 0;
+    if (*(byte_array+ipix) != 0) {
+      if (!inside) {
+	*(ptr_spans->span_starts+i_span) = ipix;
+	*(ptr_spans->span_lengths+i_span) = 0;
+	i_span++;
+      }
+      (*(ptr_spans->span_lengths+i_span-1))++;
+      inside = 1;
+    } else {
+      inside = 0;
+    }
+  }
+
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_span_free(dm_array_span_struct *ptr_spans)
+{
+  if (ptr_spans->span_starts != NULL) free(ptr_spans->span_starts);
+  if (ptr_spans->span_lengths != NULL) free(ptr_spans->span_lengths);
+  ptr_spans->span_starts = NULL;
+  ptr_spans->span_lengths = NULL;
+  ptr_spans->n_spans = 0;
+  ptr_spans->n_inside = 0;
+}
+
+/*------------------------------------------------------------*/
+void dm_array_multiply_complex_span(dm_array_complex_struct *ptr_cas,
+				    dm_array_span_struct *ptr_spans)
+{
+  dm_array_index_t i_span, gap_start, gap_stop;
+
+  if (ptr_cas->npix != ptr_spans->npix) return;
+
+  /* Only the gaps between the spans are touched, and each gap is
+   * one memset() for interleaved arrays or two for split ones.
+   */
+  gap_start = 0;
+  for (i_span=0; i_span<=ptr_spans->n_spans; i_span++) {
+    if (i_span < ptr_spans->n_spans) {
+      gap_stop = *(ptr_spans->span_starts+i_span);
+    } else {
+      gap_stop = ptr_cas->local_npix;
+    }
+    if (gap_stop > gap_start) {
+#if DM_ARRAY_SPLIT
+      memset(&c_re(ptr_cas->complex_array,gap_start),0,
+	     (gap_stop-gap_start)*sizeof(dm_array_real));
+      memset(&c_im(ptr_cas->complex_array,gap_start),0,
+	     (gap_stop-gap_start)*sizeof(dm_array_real));
+#else
+      memset(&c_re(ptr_cas->complex_array,gap_start),0,
+	     2*(gap_stop-gap_start)*sizeof(dm_array_real));
+#endif /* DM_ARRAY_SPLIT */
+    }
+    if (i_span < ptr_spans->n_spans) {
+      gap_start = gap_stop+*(ptr_spans->span_lengths+i_span);
+    }
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /*USE_MPI*/
+}
+
+/*------------------------------------------------------------*/
+dm_array_real dm_array_total_power_complex_span(dm_array_complex_struct *ptr_cas,
+						dm_array_span_struct *ptr_spans,
+						int inverse)
+{
+  dm_array_index_t i_span, first, last, ipix;
+  double local_power, total_power, span_power;
+  dm_array_real this_re, this_im;
+
+  if (ptr_cas->npix != ptr_spans->npix) return(0.);
+
+  /* Sum over the spans, or over the gaps between them if inverse 
+   * is set.
+   */
+  local_power = 0.;
+  first = 0;
+  for (i_span=0; i_span<=ptr_spans->n_spans; i_span++) {
+    if (inverse) {
+      last = (i_span < ptr_spans->n_spans) ? 
+	*(ptr_spans->span_starts+i_span) : ptr_cas->local_npix;
+    } else {
+      if (i_span == ptr_spans->n_spans) break;
+      first = *(ptr_spans->span_starts+i_span);
+      last = first+*(ptr_spans->span_lengths+i_span);
+    }
+    span_power = 0.;
+    for (ipix=first; ipix<last; ipix++) {
+      this_re = c_re(ptr_cas->complex_array,ipix);
+      this_im = c_im(ptr_cas->complex_array,ipix);
+      span_power += this_re*this_re+this_im*this_im;
+    }
+    local_power += span_power;
+    if (inverse && (i_span < ptr_spans->n_spans)) {
+      first = last+*(ptr_spans->span_lengths+i_span);
+    }
+  }
+
+#if USE_MPI
+  MPI_Allreduce(&local_power,&total_power,1,MPI_DOUBLE,MPI_SUM,
+		MPI_COMM_WORLD);
+#else 
+  total_power = local_power;
+#endif /* USE_MPI */
+
+  return((dm_array_real)total_power);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_copy_complex_span(dm_array_complex_struct *ptr_cas_dest, 
+				dm_array_complex_struct *ptr_cas_src,
+				dm_array_span_struct *ptr_spans)
+{
+  dm_array_index_t i_span, first, length;
+
+  if ((ptr_cas_dest->npix != ptr_cas_src->npix) ||
+      (ptr_cas_dest->npix != ptr_spans->npix)) return;
+
+  for (i_span=0; i_span<ptr_spans->n_spans; i_span++) {
+    first = *(ptr_spans->span_starts+i_span);
+    length = *(ptr_spans->span_lengths+i_span);
+#if DM_ARRAY_SPLIT
+    memcpy(&c_re(ptr_cas_dest->complex_array,first),
+	   &c_re(ptr_cas_src->complex_array,first),
+	   length*sizeof(dm_array_real));
+    memcpy(&c_im(ptr_cas_dest->complex_array,first),
+	   &c_im(ptr_cas_src->complex_array,first),
+	   length*sizeof(dm_array_real));
+#else
+    memcpy(&c_re(ptr_cas_dest->complex_array,first),
+	   &c_re(ptr_cas_src->complex_array,first),
+	   2*length*sizeof(dm_array_real));
+#endif /* DM_ARRAY_SPLIT */
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /*USE_MPI*/
+}
+  
 /*------------------------------------------------------------*/
 void dm_array_fft(dm_array_complex_struct *ptr_cas,
 		  int p,
@@ -1336,9 +2356,11 @@ void dm_array_fft(dm_array_complex_struct *ptr_cas,
     //MPI_Barrier(MPI_COMM_WORLD);
     
     /* renormalization */
-    for(ic=0; ic<local_size; ic++){
-      c_re(ptr_cas->complex_array,ic) *= norm_factor;
-      c_im(ptr_cas->complex_array,ic) *= norm_factor;
+    if ((fft_options & DM_ARRAY_FFT_UNNORMALIZED) == 0) {
+      for(ic=0; ic<local_size; ic++){
+	c_re(ptr_cas->complex_array,ic) *= norm_factor;
+	c_im(ptr_cas->complex_array,ic) *= norm_factor;
+      }
     }
     /* Need to use DIST_FFT version since we used it to allocate
      * the workspace.
@@ -1448,9 +2470,2464 @@ void dm_array_fft(dm_array_complex_struct *ptr_cas,
 #endif
     }
     /* renormalization */
-    dm_array_multiply_real_scalar(ptr_cas,norm_factor);
+    if ((fft_options & DM_ARRAY_FFT_UNNORMALIZED) == 0) {
+      dm_array_multiply_real_scalar(ptr_cas,norm_factor);
+    }
 #endif /* End of dist_fft/FFTW ifdef */
   } /* FFT section */
 }
 
 
+
+/*------------------------------------------------------------*/
+int dm_array_median_filter(dm_array_real_struct *ptr_ras,
+			   dm_adi_struct *ptr_adi_struct,
+			   int n_threads,
+			   dm_array_index_t *ptr_n_replaced,
+			   int my_rank,
+			   int p)
+{
+  dm_array_median_task_struct *tasks;
+  dm_array_halo_struct halo;
+  dm_array_real *padded_array;
+  dm_array_index_t slab_npix, n_replaced, local_replaced;
+  size_t window_npix, band_npix;
+  int width, half_width, n_slabs, local_slabs, halo_lo, halo_hi;
+  int i_thread, slabs_per_thread, n_padded_slabs, chunk_slabs;
+  int is_ranked, status;
+
+  if (ptr_n_replaced != NULL) *ptr_n_replaced = 0;
+  width = (int)floor(ptr_adi_struct->median_filter_width+0.5);
+  if (width < 2) return(0);
+  half_width = width/2;
+
+  /* The array is split up between processes along its slowest 
+   * axis, so work in slabs that are one z-plane of a 3D array, one
+   * row of a 2D array or one pixel of a 1D array.
+   */
+  if (ptr_ras->nz > 1) {
+    n_slabs = ptr_ras->nz;
+  } else if (ptr_ras->ny > 1) {
+    n_slabs = ptr_ras->ny;
+  } else {
+    n_slabs = ptr_ras->nx;
+  }
+  slab_npix = ptr_ras->npix/n_slabs;
+  local_slabs = ptr_ras->local_npix/slab_npix;
+
+  /* Windows larger than the array are clipped to it anyway */
+  window_npix = 1;
+  if (ptr_ras->nx > 1) {
+    window_npix *= (2*half_width+1 < ptr_ras->nx) ? 
+      (2*half_width+1) : ptr_ras->nx;
+  }
+  if (ptr_ras->ny > 1) {
+    window_npix *= (2*half_width+1 < ptr_ras->ny) ? 
+      (2*half_width+1) : ptr_ras->ny;
+  }
+  if (ptr_ras->nz > 1) {
+    window_npix *= (2*half_width+1 < ptr_ras->nz) ? 
+      (2*half_width+1) : ptr_ras->nz;
+  }
+  /* A 1D window slides along the slabs, so it is always selected */
+  is_ranked = ((slab_npix > 1) && 
+	       (window_npix > DM_ARRAY_MEDIAN_MAX_SELECT));
+  
+  /* Every process has to know that all of them can go ahead before
+   * the halos are exchanged and again before any pixel is changed.
+   */
+  status = dm_array_halo_init(&halo,DM_ARRAY_HALO_REAL,ptr_ras->nx,
+			      ptr_ras->ny,ptr_ras->nz,ptr_ras->local_npix,
+			      half_width,my_rank,p);
+#if USE_MPI
+  MPI_Allreduce(MPI_IN_PLACE,&status,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+  if (status != 0) {
+    dm_array_halo_free(&halo);
+    return(-1);
+  }
+
+  /* Start fetching the neighbouring slabs and copy the local ones
+   * into the middle of the padded array while they are on their way.
+   */
+  dm_array_halo_exchange_real(ptr_ras,&halo);
+  halo_lo = halo.halo_lo;
+  halo_hi = halo.halo_hi;
+  n_padded_slabs = halo_lo+local_slabs+halo_hi;
+  
+  padded_array = (dm_array_real *)
+    malloc((size_t)n_padded_slabs*slab_npix*sizeof(dm_array_real));
+  if (padded_array != NULL) {
+    memcpy(padded_array+(size_t)halo_lo*slab_npix,ptr_ras->real_array,
+	   (size_t)ptr_ras->local_npix*sizeof(dm_array_real));
+  }
+  dm_array_halo_wait(&halo);
+  if (padded_array != NULL) {
+    memcpy(padded_array,halo.lo_array,
+	   (size_t)halo_lo*slab_npix*sizeof(dm_array_real));
+    memcpy(padded_array+(size_t)(halo_lo+local_slabs)*slab_npix,
+	   halo.hi_array,(size_t)halo_hi*slab_npix*sizeof(dm_array_real));
+  }
+  dm_array_halo_free(&halo);
+  
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > local_slabs) n_threads = local_slabs;
+  if (n_threads < 1) n_threads = 1;
+  tasks = (dm_array_median_task_struct *)
+    calloc(n_threads,sizeof(dm_array_median_task_struct));
+  status = ((padded_array == NULL) || (tasks == NULL)) ? -1 : 0;
+
+  /* Ranked windows go through bands of their own slabs and the
+   * half_width slabs on either side, and these are made long enough
+   * that sorting them does not take over for thin slabs.
+   */
+  chunk_slabs = 2*half_width+1;
+  if (chunk_slabs*slab_npix < (1 << 18)) chunk_slabs = (1 << 18)/slab_npix;
+  if (chunk_slabs > local_slabs) chunk_slabs = local_slabs;
+  band_npix = (size_t)(chunk_slabs+2*half_width)*slab_npix;
+  if (band_npix > (size_t)n_padded_slabs*slab_npix) {
+    band_npix = (size_t)n_padded_slabs*slab_npix;
+  }
+  
+  slabs_per_thread = (local_slabs+n_threads-1)/n_threads;
+  for (i_thread=0; (status == 0) && (i_thread<n_threads); i_thread++) {
+    (tasks+i_thread)->padded_array = padded_array;
+    (tasks+i_thread)->real_array = ptr_ras->real_array;
+    if (ptr_ras->nz > 1) {
+      (tasks+i_thread)->nx = ptr_ras->nx;
+      (tasks+i_thread)->ny = ptr_ras->ny;
+    } else if (ptr_ras->ny > 1) {
+      (tasks+i_thread)->nx = ptr_ras->nx;
+      (tasks+i_thread)->ny = 1;
+    } else {
+      (tasks+i_thread)->nx = 1;
+      (tasks+i_thread)->ny = 1;
+    }
+    (tasks+i_thread)->n_padded_slabs = n_padded_slabs;
+    (tasks+i_thread)->halo_lo = halo_lo;
+    (tasks+i_thread)->half_width = half_width;
+    (tasks+i_thread)->threshold = 
+      (dm_array_real)ptr_adi_struct->median_filter_threshold;
+    (tasks+i_thread)->slab_start = i_thread*slabs_per_thread;
+    (tasks+i_thread)->slab_stop = (i_thread+1)*slabs_per_thread;
+    if ((tasks+i_thread)->slab_stop > local_slabs) {
+      (tasks+i_thread)->slab_stop = local_slabs;
+    }
+    (tasks+i_thread)->n_replaced = 0;
+
+    if (is_ranked) {
+      (tasks+i_thread)->band_slabs = band_npix/slab_npix;
+      (tasks+i_thread)->sorted = (dm_array_median_rank_struct *)
+	malloc(band_npix*sizeof(dm_array_median_rank_struct));
+      (tasks+i_thread)->ranks = (dm_array_index_t *)
+	malloc(band_npix*sizeof(dm_array_index_t));
+      (tasks+i_thread)->rank_bits = (u_int64_t *)
+	calloc((band_npix+63)/64,sizeof(u_int64_t));
+      (tasks+i_thread)->word_counts = (int *)
+	calloc((band_npix+63)/64,sizeof(int));
+      (tasks+i_thread)->block_counts = (int *)
+	calloc((band_npix+4095)/4096,sizeof(int));
+      if (((tasks+i_thread)->sorted == NULL) ||
+	  ((tasks+i_thread)->ranks == NULL) ||
+	  ((tasks+i_thread)->rank_bits == NULL) ||
+	  ((tasks+i_thread)->word_counts == NULL) ||
+	  ((tasks+i_thread)->block_counts == NULL)) status = -1;
+    } else {
+      (tasks+i_thread)->window = (dm_array_real *)
+	malloc(window_npix*sizeof(dm_array_real));
+      if ((tasks+i_thread)->window == NULL) status = -1;
+      /* Sorted columns for 3x3 windows in 2D */
+      if ((half_width == 1) && (ptr_ras->nz == 1) && (ptr_ras->ny > 1) && 
+	  (ptr_ras->nx > 2)) {
+	(tasks+i_thread)->columns = (dm_array_real *)
+	  malloc(3*(size_t)ptr_ras->nx*sizeof(dm_array_real));
+	if ((tasks+i_thread)->columns == NULL) status = -1;
+      }
+    }
+  }
+#if USE_MPI
+  MPI_Allreduce(MPI_IN_PLACE,&status,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  local_replaced = 0;
+  if (status == 0) {
+    dm_array_run_tasks(dm_array_median_worker,tasks,
+		       sizeof(dm_array_median_task_struct),n_threads);
+    for (i_thread=0; i_thread<n_threads; i_thread++) {
+      local_replaced += (tasks+i_thread)->n_replaced;
+    }
+  }
+
+  if (tasks != NULL) {
+    for (i_thread=0; i_thread<n_threads; i_thread++) {
+      if ((tasks+i_thread)->window != NULL) free((tasks+i_thread)->window);
+      if ((tasks+i_thread)->columns != NULL) free((tasks+i_thread)->columns);
+      if ((tasks+i_thread)->sorted != NULL) free((tasks+i_thread)->sorted);
+      if ((tasks+i_thread)->ranks != NULL) free((tasks+i_thread)->ranks);
+      if ((tasks+i_thread)->rank_bits != NULL) {
+	free((tasks+i_thread)->rank_bits);
+      }
+      if ((tasks+i_thread)->word_counts != NULL) {
+	free((tasks+i_thread)->word_counts);
+      }
+      if ((tasks+i_thread)->block_counts != NULL) {
+	free((tasks+i_thread)->block_counts);
+      }
+    }
+    free(tasks);
+  }
+  if (padded_array != NULL) free(padded_array);
+  if (status != 0) return(-1);
+
+#if USE_MPI
+  MPI_Allreduce(&local_replaced,&n_replaced,1,MPI_UNSIGNED,MPI_SUM,
+		MPI_COMM_WORLD);
+#else
+  n_replaced = local_replaced;
+#endif /* USE_MPI */
+
+  if (ptr_n_replaced != NULL) *ptr_n_replaced = n_replaced;
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+/* Branch-free helpers for the median filter kernels */
+#define DM_ARRAY_SORT2(a,b) {				\
+    dm_array_real __t = ((a) < (b)) ? (a) : (b);	\
+    (b) = ((a) < (b)) ? (b) : (a);			\
+    (a) = __t;						\
+  }
+#define DM_ARRAY_MIN2(a,b) (((a) < (b)) ? (a) : (b))
+#define DM_ARRAY_MAX2(a,b) (((a) < (b)) ? (b) : (a))
+#define DM_ARRAY_MIN3(a,b,c) DM_ARRAY_MIN2(DM_ARRAY_MIN2(a,b),c)
+#define DM_ARRAY_MAX3(a,b,c) DM_ARRAY_MAX2(DM_ARRAY_MAX2(a,b),c)
+#define DM_ARRAY_MEDIAN3(a,b,c)						\
+  DM_ARRAY_MAX2(DM_ARRAY_MIN2(a,b),DM_ARRAY_MIN2(DM_ARRAY_MAX2(a,b),c))
+
+void *dm_array_median_worker(void *ptr_arg)
+{
+  dm_array_median_task_struct *ptr_task;
+  dm_array_real *window, *ptr_slab, *ptr_out;
+  dm_array_real *column_lo, *column_mid, *column_hi;
+  dm_array_real *ptr_below, *ptr_above;
+  dm_array_real this_value, median, deviation, a, b, c;
+  dm_array_index_t slab_npix, n_replaced;
+  int ix, iy, iz, jx, jy, jz, n_window, h, rows_3x3, x_first, x_step;
+  int x0, x1, y0, y1, z0, z1;
+  
+  ptr_task = (dm_array_median_task_struct *)ptr_arg;
+  if (ptr_task->sorted != NULL) {
+    ptr_task->n_replaced = dm_array_median_ranked(ptr_task);
+    return(NULL);
+  }
+  h = ptr_task->half_width;
+  slab_npix = (dm_array_index_t)ptr_task->nx*ptr_task->ny;
+  window = ptr_task->window;
+  n_replaced = 0;
+
+  /* For a 3x3 window in 2D each column of three pixels is sorted 
+   * once per row, and the median of the window is then the median
+   * of the largest low, the median middle and the smallest high
+   * value of its three columns.
+   */
+  rows_3x3 = (ptr_task->columns != NULL);
+  column_lo = column_mid = column_hi = NULL;
+  if (rows_3x3) {
+    column_lo = ptr_task->columns;
+    column_mid = column_lo+ptr_task->nx;
+    column_hi = column_mid+ptr_task->nx;
+  }
+  
+  for (iz=ptr_task->slab_start+ptr_task->halo_lo; 
+       iz<ptr_task->slab_stop+ptr_task->halo_lo; iz++) {
+    z0 = (iz-h < 0) ? 0 : (iz-h);
+    z1 = (iz+h >= ptr_task->n_padded_slabs) ? 
+      (ptr_task->n_padded_slabs-1) : (iz+h);
+    ptr_slab = ptr_task->padded_array+(size_t)iz*slab_npix;
+    ptr_out = ptr_task->real_array+
+      (size_t)(iz-ptr_task->halo_lo)*slab_npix;
+
+    if (rows_3x3 && (z0 == (iz-1)) && (z1 == (iz+1))) {
+      ptr_below = ptr_slab-ptr_task->nx;
+      ptr_above = ptr_slab+ptr_task->nx;
+      for (ix=0; ix<ptr_task->nx; ix++) {
+	a = *(ptr_below+ix);
+	b = *(ptr_slab+ix);
+	c = *(ptr_above+ix);
+	DM_ARRAY_SORT2(a,b);
+	DM_ARRAY_SORT2(b,c);
+	DM_ARRAY_SORT2(a,b);
+	*(column_lo+ix) = a;
+	*(column_mid+ix) = b;
+	*(column_hi+ix) = c;
+      }
+      for (ix=1; ix<(ptr_task->nx-1); ix++) {
+	a = DM_ARRAY_MAX3(*(column_lo+ix-1),*(column_lo+ix),
+			  *(column_lo+ix+1));
+	b = DM_ARRAY_MEDIAN3(*(column_mid+ix-1),*(column_mid+ix),
+			     *(column_mid+ix+1));
+	c = DM_ARRAY_MIN3(*(column_hi+ix-1),*(column_hi+ix),
+			  *(column_hi+ix+1));
+	median = DM_ARRAY_MEDIAN3(a,b,c);
+	
+	this_value = *(ptr_slab+ix);
+	deviation = this_value-median;
+	if (deviation < 0.) deviation = -deviation;
+	if ((ptr_task->threshold <= 0.) ||
+	    (deviation > ptr_task->threshold*fabs(median))) {
+	  if (this_value != median) n_replaced++;
+	  this_value = median;
+	}
+	*(ptr_out+ix) = this_value;
+      }
+      /* The two edge pixels of the row go through the general code */
+      x_first = 0;
+      x_step = ptr_task->nx-1;
+    } else {
+      x_first = 0;
+      x_step = 1;
+    }
+    
+    for (iy=0; iy<ptr_task->ny; iy++) {
+      y0 = (iy-h < 0) ? 0 : (iy-h);
+      y1 = (iy+h >= ptr_task->ny) ? (ptr_task->ny-1) : (iy+h);
+      for (ix=x_first; ix<ptr_task->nx; ix+=x_step) {
+	x0 = (ix-h < 0) ? 0 : (ix-h);
+	x1 = (ix+h >= ptr_task->nx) ? (ptr_task->nx-1) : (ix+h);
+	
+	/* Windows are clipped at the edges of the array */
+	n_window = 0;
+	for (jz=z0; jz<=z1; jz++) {
+	  for (jy=y0; jy<=y1; jy++) {
+	    for (jx=x0; jx<=x1; jx++) {
+	      *(window+n_window) = *(ptr_task->padded_array+
+				     (size_t)jz*slab_npix+
+				     (size_t)jy*ptr_task->nx+jx);
+	      n_window++;
+	    }
+	  }
+	}
+	if (n_window == 9) {
+	  median = dm_array_median9(window);
+	} else {
+	  median = dm_array_select(window,n_window,n_window/2);
+	}
+	
+	this_value = *(ptr_slab+(size_t)iy*ptr_task->nx+ix);
+	deviation = this_value-median;
+	if (deviation < 0.) deviation = -deviation;
+	if ((ptr_task->threshold <= 0.) ||
+	    (deviation > ptr_task->threshold*fabs(median))) {
+	  if (this_value != median) n_replaced++;
+	  this_value = median;
+	}
+	*(ptr_out+(size_t)iy*ptr_task->nx+ix) = this_value;
+      }
+    }
+  }
+  
+  ptr_task->n_replaced = n_replaced;
+  return(NULL);
+}
+
+/*------------------------------------------------------------*/
+/* Position of the lowest set bit of a 64 bit word, looked up
+ * from its de Bruijn product.
+ */
+static const int dm_array_lowest_bit[64] = {
+  0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4,
+  62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+  63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+  46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+};
+
+/* Adds (change=1) or removes (change=-1) the column of the window
+ * at x to or from the ranks in the window. Counts of blocks below
+ * the one the median was last found in are kept in n_below.
+ */
+#define DM_ARRAY_MEDIAN_COLUMN(x,change) {				\
+    for (jz=z0; jz<=z1; jz++) {						\
+      ptr_ranks = ranks+(size_t)(jz-band_start)*slab_npix+(x);	\
+      for (jy=y0; jy<=y1; jy++) {					\
+	rank = *(ptr_ranks+(size_t)jy*nx);				\
+	*(rank_bits+(rank >> 6)) ^= (u_int64_t)1 << (rank & 63);	\
+	*(word_counts+(rank >> 6)) += (change);				\
+	*(block_counts+(rank >> 12)) += (change);			\
+	if ((int)(rank >> 12) < i_block) n_below += (change);		\
+      }									\
+    }									\
+  }
+
+/* Huang's sliding window over the ranks of the values: the values
+ * of a band of slabs are sorted once, and each window along x then
+ * only adds and removes one column of ranks. The median is found by
+ * walking from the block of 4096 ranks it was last in through the
+ * words of 64 ranks to the bit.
+ */
+dm_array_index_t dm_array_median_ranked(dm_array_median_task_struct *ptr_task)
+{
+  dm_array_median_rank_struct *sorted;
+  dm_array_index_t *ranks, *ptr_ranks;
+  dm_array_index_t slab_npix, n_band, i_band, rank, n_replaced;
+  dm_array_real *ptr_out, *ptr_in;
+  dm_array_real this_value, median, deviation;
+  u_int64_t *rank_bits;
+  u_int64_t word;
+  int *word_counts, *block_counts;
+  int h, nx, chunk_slabs, chunk_start, chunk_stop, slab_stop;
+  int band_start, band_stop, ix, iy, iz, jy, jz, y0, y1, z0, z1;
+  int x0, x1, n_column, k, n_below, n_word_below, i_block, i_word;
+
+  h = ptr_task->half_width;
+  nx = ptr_task->nx;
+  slab_npix = (dm_array_index_t)nx*ptr_task->ny;
+  sorted = ptr_task->sorted;
+  ranks = ptr_task->ranks;
+  rank_bits = ptr_task->rank_bits;
+  word_counts = ptr_task->word_counts;
+  block_counts = ptr_task->block_counts;
+  chunk_slabs = ptr_task->band_slabs-2*h;
+  if (chunk_slabs < 1) chunk_slabs = 1;
+  slab_stop = ptr_task->slab_stop+ptr_task->halo_lo;
+  n_replaced = 0;
+
+  for (chunk_start=ptr_task->slab_start+ptr_task->halo_lo;
+       chunk_start<slab_stop; chunk_start+=chunk_slabs) {
+    chunk_stop = (chunk_start+chunk_slabs < slab_stop) ? 
+      (chunk_start+chunk_slabs) : slab_stop;
+    band_start = (chunk_start-h < 0) ? 0 : (chunk_start-h);
+    band_stop = (chunk_stop+h > ptr_task->n_padded_slabs) ?
+      ptr_task->n_padded_slabs : (chunk_stop+h);
+
+    /* Ties are ranked by position so that every rank is used once */
+    n_band = (dm_array_index_t)(band_stop-band_start)*slab_npix;
+    ptr_in = ptr_task->padded_array+(size_t)band_start*slab_npix;
+    for (i_band=0; i_band<n_band; i_band++) {
+      (sorted+i_band)->value = *(ptr_in+i_band);
+      (sorted+i_band)->index = i_band;
+    }
+    qsort(sorted,n_band,sizeof(dm_array_median_rank_struct),
+	  dm_array_median_compare);
+    for (i_band=0; i_band<n_band; i_band++) {
+      *(ranks+(sorted+i_band)->index) = i_band;
+    }
+
+    for (iz=chunk_start; iz<chunk_stop; iz++) {
+      z0 = (iz-h < band_start) ? band_start : (iz-h);
+      z1 = (iz+h >= band_stop) ? (band_stop-1) : (iz+h);
+      for (iy=0; iy<ptr_task->ny; iy++) {
+	y0 = (iy-h < 0) ? 0 : (iy-h);
+	y1 = (iy+h >= ptr_task->ny) ? (ptr_task->ny-1) : (iy+h);
+	n_column = (z1-z0+1)*(y1-y0+1);
+	ptr_in = ptr_task->padded_array+(size_t)iz*slab_npix+
+	  (size_t)iy*nx;
+	ptr_out = ptr_task->real_array+
+	  (size_t)(iz-ptr_task->halo_lo)*slab_npix+(size_t)iy*nx;
+
+	/* The window starts empty at the beginning of each row */
+	i_block = 0;
+	n_below = 0;
+	for (ix=0; (ix<=h) && (ix<nx); ix++) {
+	  DM_ARRAY_MEDIAN_COLUMN(ix,1);
+	}
+	
+	for (ix=0; ix<nx; ix++) {
+	  x0 = (ix-h < 0) ? 0 : (ix-h);
+	  x1 = (ix+h >= nx) ? (nx-1) : (ix+h);
+	  k = n_column*(x1-x0+1)/2;
+
+	  /* The rank with k ranks of the window below it */
+	  while (n_below > k) {
+	    i_block--;
+	    n_below -= *(block_counts+i_block);
+	  }
+	  while (n_below+*(block_counts+i_block) <= k) {
+	    n_below += *(block_counts+i_block);
+	    i_block++;
+	  }
+	  i_word = i_block*64;
+	  n_word_below = n_below;
+	  while (n_word_below+*(word_counts+i_word) <= k) {
+	    n_word_below += *(word_counts+i_word);
+	    i_word++;
+	  }
+	  word = *(rank_bits+i_word);
+	  for (; n_word_below<k; n_word_below++) word &= word-1;
+	  rank = (dm_array_index_t)i_word*64+
+	    dm_array_lowest_bit[((word & (~word+1))*
+				 (u_int64_t)0x03f79d71b4cb0a89ULL) >> 58];
+	  median = (sorted+rank)->value;
+	  
+	  this_value = *(ptr_in+ix);
+	  deviation = this_value-median;
+	  if (deviation < 0.) deviation = -deviation;
+	  if ((ptr_task->threshold <= 0.) ||
+	      (deviation > ptr_task->threshold*fabs(median))) {
+	    if (this_value != median) n_replaced++;
+	    this_value = median;
+	  }
+	  *(ptr_out+ix) = this_value;
+
+	  if (ix-h >= 0) DM_ARRAY_MEDIAN_COLUMN(ix-h,-1);
+	  if (ix+h+1 < nx) DM_ARRAY_MEDIAN_COLUMN(ix+h+1,1);
+	}
+
+	/* Empty the window for the next row */
+	for (ix=((nx-h < 0) ? 0 : (nx-h)); ix<nx; ix++) {
+	  DM_ARRAY_MEDIAN_COLUMN(ix,-1);
+	}
+      }
+    }
+  }
+
+  return(n_replaced);
+}
+
+/*------------------------------------------------------------*/
+/* Orders values for qsort(), and equal values by where they came
+ * from.
+ */
+int dm_array_median_compare(const void *ptr_a,
+			    const void *ptr_b)
+{
+  const dm_array_median_rank_struct *a, *b;
+
+  a = (const dm_array_median_rank_struct *)ptr_a;
+  b = (const dm_array_median_rank_struct *)ptr_b;
+  if (a->value < b->value) return(-1);
+  if (a->value > b->value) return(1);
+  if (a->index < b->index) return(-1);
+  if (a->index > b->index) return(1);
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+/* Sorting network for 9 values (as in a 3x3 window) that leaves
+ * the median in p[4].
+ */
+dm_array_real dm_array_median9(dm_array_real *p)
+{
+  DM_ARRAY_SORT2(p[1],p[2]); DM_ARRAY_SORT2(p[4],p[5]); 
+  DM_ARRAY_SORT2(p[7],p[8]); DM_ARRAY_SORT2(p[0],p[1]);
+  DM_ARRAY_SORT2(p[3],p[4]); DM_ARRAY_SORT2(p[6],p[7]);
+  DM_ARRAY_SORT2(p[1],p[2]); DM_ARRAY_SORT2(p[4],p[5]);
+  DM_ARRAY_SORT2(p[7],p[8]); DM_ARRAY_SORT2(p[0],p[3]);
+  DM_ARRAY_SORT2(p[5],p[8]); DM_ARRAY_SORT2(p[4],p[7]);
+  DM_ARRAY_SORT2(p[3],p[6]); DM_ARRAY_SORT2(p[1],p[4]);
+  DM_ARRAY_SORT2(p[2],p[5]); DM_ARRAY_SORT2(p[4],p[7]);
+  DM_ARRAY_SORT2(p[4],p[2]); DM_ARRAY_SORT2(p[6],p[4]);
+  DM_ARRAY_SORT2(p[4],p[2]);
+  return(p[4]);
+}
+
+/*------------------------------------------------------------*/
+/* Wirth's selection algorithm: returns the k-th smallest of the
+ * n values, partially reordering them.
+ */
+dm_array_real dm_array_select(dm_array_real *values,
+			      int n,
+			      int k)
+{
+  int i, j, left, right;
+  dm_array_real pivot, temp;
+
+  left = 0;
+  right = n-1;
+  while (left < right) {
+    pivot = *(values+k);
+    i = left;
+    j = right;
+    do {
+      while (*(values+i) < pivot) i++;
+      while (pivot < *(values+j)) j--;
+      if (i <= j) {
+	temp = *(values+i);
+	*(values+i) = *(values+j);
+	*(values+j) = temp;
+	i++;
+	j--;
+      }
+    } while (i <= j);
+    if (j < k) left = i;
+    if (k < i) right = j;
+  }
+  return(*(values+k));
+}
+
+
+/*------------------------------------------------------------*/
+void dm_array_saturation_mask(dm_array_byte_struct *ptr_bas,
+			      dm_array_real_struct *ptr_ras,
+			      dm_adi_struct *ptr_adi_struct)
+{
+  dm_array_index_t ipix, local_npix;
+  dm_array_real saturation_min, saturation_max, this_value;
+  u_int8_t *byte_array;
+  dm_array_real *real_array;
+
+  if (ptr_bas->npix != ptr_ras->npix) return;
+
+  saturation_min = (dm_array_real)ptr_adi_struct->saturation_min;
+  saturation_max = (dm_array_real)ptr_adi_struct->saturation_max;
+  if (saturation_max <= saturation_min) {
+    saturation_max = (dm_array_real)HUGE_VAL;
+  }
+  
+  /* Plain loop without branches so that the compiler can vectorize it */
+  byte_array = ptr_bas->byte_array;
+  real_array = ptr_ras->real_array;
+  local_npix = ptr_ras->local_npix;
+  for (ipix=0; ipix<local_npix; ipix++) {
+    this_value = *(real_array+ipix);
+    *(byte_array+ipix) = (u_int8_t)((this_value >= saturation_min) &
+				    (this_value <= saturation_max));
+  }
+}
+
+/*------------------------------------------------------------*/
+int dm_array_halo_init(dm_array_halo_struct *ptr_halo,
+		       int array_type,
+		       int nx, int ny, int nz,
+		       dm_array_index_t local_npix,
+		       int halo_width,
+		       int my_rank,
+		       int p)
+{
+  int n_slabs;
+  size_t element_size;
+
+  if (nz > 1) {
+    n_slabs = nz;
+  } else if (ny > 1) {
+    n_slabs = ny;
+  } else {
+    n_slabs = nx;
+  }
+  ptr_halo->array_type = array_type;
+  ptr_halo->halo_width = halo_width;
+  ptr_halo->slab_npix = ((dm_array_index_t)nx*ny*nz)/n_slabs;
+  ptr_halo->local_slabs = local_npix/ptr_halo->slab_npix;
+  ptr_halo->my_rank = my_rank;
+  ptr_halo->n_requests = 0;
+  
+  if (USE_MPI) {
+    ptr_halo->halo_lo = (my_rank > 0) ? halo_width : 0;
+    ptr_halo->halo_hi = (my_rank < (p-1)) ? halo_width : 0;
+  } else {
+    ptr_halo->halo_lo = 0;
+    ptr_halo->halo_hi = 0;
+  }
+  if (ptr_halo->halo_lo > ptr_halo->local_slabs) {
+    ptr_halo->halo_lo = ptr_halo->local_slabs;
+  }
+  if (ptr_halo->halo_hi > ptr_halo->local_slabs) {
+    ptr_halo->halo_hi = ptr_halo->local_slabs;
+  }
+
+  if (array_type == DM_ARRAY_HALO_BYTE) {
+    element_size = sizeof(u_int8_t);
+  } else if (array_type == DM_ARRAY_HALO_COMPLEX) {
+    element_size = 2*sizeof(dm_array_real);
+  } else {
+    element_size = sizeof(dm_array_real);
+  }
+  /* Always allocate something so that the halo arrays can be freed */
+  ptr_halo->lo_array = 
+    malloc(((size_t)ptr_halo->halo_lo*ptr_halo->slab_npix+1)*element_size);
+  ptr_halo->hi_array = 
+    malloc(((size_t)ptr_halo->halo_hi*ptr_halo->slab_npix+1)*element_size);
+  if ((ptr_halo->lo_array == NULL) || (ptr_halo->hi_array == NULL)) {
+    dm_array_halo_free(ptr_halo);
+    return(-1);
+  }
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_halo_exchange_real(dm_array_real_struct *ptr_ras,
+				 dm_array_halo_struct *ptr_halo)
+{
+  dm_array_halo_post(ptr_halo,ptr_ras->real_array,
+		     ptr_halo->lo_array,ptr_halo->hi_array,
+		     ptr_halo->slab_npix,0,90);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_halo_exchange_byte(dm_array_byte_struct *ptr_bas,
+				 dm_array_halo_struct *ptr_halo)
+{
+  dm_array_halo_post(ptr_halo,ptr_bas->byte_array,
+		     ptr_halo->lo_array,ptr_halo->hi_array,
+		     ptr_halo->slab_npix,1,90);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_halo_exchange_complex(dm_array_complex_struct *ptr_cas,
+				    dm_array_halo_struct *ptr_halo)
+{
+  dm_array_real *lo_array, *hi_array;
+
+  lo_array = (dm_array_real *)ptr_halo->lo_array;
+  hi_array = (dm_array_real *)ptr_halo->hi_array;
+#if DM_ARRAY_SPLIT
+  /* Real and imaginary parts travel separately */
+  dm_array_halo_post(ptr_halo,&c_re(ptr_cas->complex_array,0),
+		     lo_array,hi_array,ptr_halo->slab_npix,0,90);
+  dm_array_halo_post(ptr_halo,&c_im(ptr_cas->complex_array,0),
+		     lo_array+(size_t)ptr_halo->halo_lo*ptr_halo->slab_npix,
+		     hi_array+(size_t)ptr_halo->halo_hi*ptr_halo->slab_npix,
+		     ptr_halo->slab_npix,0,92);
+#else
+  dm_array_halo_post(ptr_halo,&c_re(ptr_cas->complex_array,0),
+		     lo_array,hi_array,2*ptr_halo->slab_npix,0,90);
+#endif /* DM_ARRAY_SPLIT */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_halo_post(dm_array_halo_struct *ptr_halo,
+			void *ptr_data,
+			void *ptr_lo,
+			void *ptr_hi,
+			int count_per_slab,
+			int is_byte,
+			int tag)
+{
+#if USE_MPI
+  MPI_Datatype datatype;
+  size_t element_size;
+  int my_rank;
+
+  my_rank = ptr_halo->my_rank;
+  if (is_byte) {
+    datatype = MPI_BYTE;
+    element_size = sizeof(u_int8_t);
+  } else {
+    datatype = MPI_ARRAY_REAL;
+    element_size = sizeof(dm_array_real);
+  }
+
+  /* Receives are posted first so that the messages can go straight
+   * into the halo arrays. Tag is used for what goes up, tag+1 for
+   * what goes down.
+   */
+  if (ptr_halo->halo_lo > 0) {
+    MPI_Irecv(ptr_lo,ptr_halo->halo_lo*count_per_slab,datatype,
+	      my_rank-1,tag,MPI_COMM_WORLD,
+	      ptr_halo->requests+ptr_halo->n_requests);
+    ptr_halo->n_requests++;
+  }
+  if (ptr_halo->halo_hi > 0) {
+    MPI_Irecv(ptr_hi,ptr_halo->halo_hi*count_per_slab,datatype,
+	      my_rank+1,tag+1,MPI_COMM_WORLD,
+	      ptr_halo->requests+ptr_halo->n_requests);
+    ptr_halo->n_requests++;
+  }
+  if (ptr_halo->halo_hi > 0) {
+    MPI_Isend((char *)ptr_data+(size_t)(ptr_halo->local_slabs-
+					 ptr_halo->halo_hi)*
+	      count_per_slab*element_size,
+	      ptr_halo->halo_hi*count_per_slab,datatype,
+	      my_rank+1,tag,MPI_COMM_WORLD,
+	      ptr_halo->requests+ptr_halo->n_requests);
+    ptr_halo->n_requests++;
+  }
+  if (ptr_halo->halo_lo > 0) {
+    MPI_Isend(ptr_data,ptr_halo->halo_lo*count_per_slab,datatype,
+	      my_rank-1,tag+1,MPI_COMM_WORLD,
+	      ptr_halo->requests+ptr_halo->n_requests);
+    ptr_halo->n_requests++;
+  }
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_halo_wait(dm_array_halo_struct *ptr_halo)
+{
+#if USE_MPI
+  if (ptr_halo->n_requests > 0) {
+    MPI_Waitall(ptr_halo->n_requests,ptr_halo->requests,
+		MPI_STATUSES_IGNORE);
+  }
+#endif /* USE_MPI */
+  ptr_halo->n_requests = 0;
+}
+
+/*------------------------------------------------------------*/
+void dm_array_halo_free(dm_array_halo_struct *ptr_halo)
+{
+  if (ptr_halo->lo_array != NULL) free(ptr_halo->lo_array);
+  if (ptr_halo->hi_array != NULL) free(ptr_halo->hi_array);
+  ptr_halo->lo_array = NULL;
+  ptr_halo->hi_array = NULL;
+}
+
+/*------------------------------------------------------------*/
+void dm_array_blur_real(dm_array_real_struct *ptr_ras,
+			dm_array_real sigma,
+			int n_threads,
+			int my_rank,
+			int p)
+{
+  dm_array_blur_task_struct *tasks;
+  dm_array_real_struct source_ras;
+  dm_array_halo_struct halo;
+  dm_array_real *kernel, *temp_array, *padded_array, *source_array;
+  dm_array_index_t slab_npix, local_npix;
+  double sum, w_ideal, variance;
+  int n_dims, n_slabs, local_slabs, radius, box_radius[3], n_passes;
+  int i_pass, i, w_lo, n_lo_boxes, this_radius, n_tasks;
+
+  if (sigma <= 0.) return;
+  
+  if (ptr_ras->nz > 1) {
+    n_dims = 3;
+    n_slabs = ptr_ras->nz;
+  } else if (ptr_ras->ny > 1) {
+    n_dims = 2;
+    n_slabs = ptr_ras->ny;
+  } else {
+    n_dims = 1;
+    n_slabs = ptr_ras->nx;
+  }
+  slab_npix = ptr_ras->npix/n_slabs;
+  local_npix = ptr_ras->local_npix;
+  local_slabs = local_npix/slab_npix;
+  if (n_threads < 1) n_threads = 1;
+
+  /* Small kernels are applied directly. For larger ones the cost of
+   * three box filters of about the same variance does not depend on
+   * sigma, as each of them is done with a running sum.
+   */
+  radius = (int)ceil(3.*sigma);
+  kernel = NULL;
+  if (radius <= DM_ARRAY_BLUR_MAX_DIRECT_RADIUS) {
+    kernel = (dm_array_real *)malloc((2*radius+1)*sizeof(dm_array_real));
+    sum = 0.;
+    for (i=-radius; i<=radius; i++) {
+      *(kernel+i+radius) = (dm_array_real)exp(-0.5*(double)(i*i)/
+					      ((double)sigma*sigma));
+      sum += *(kernel+i+radius);
+    }
+    for (i=0; i<(2*radius+1); i++) {
+      *(kernel+i) = (dm_array_real)(*(kernel+i)/sum);
+    }
+    n_passes = 1;
+    box_radius[0] = radius;
+  } else {
+    variance = (double)sigma*sigma;
+    w_ideal = sqrt(12.*variance/3.+1.);
+    w_lo = (int)floor(w_ideal);
+    if ((w_lo%2) == 0) w_lo--;
+    n_lo_boxes = (int)floor((12.*variance-3.*w_lo*w_lo-12.*w_lo-9.)/
+			    (-4.*w_lo-4.)+0.5);
+    for (i=0; i<3; i++) {
+      box_radius[i] = (i < n_lo_boxes) ? (w_lo-1)/2 : (w_lo+1)/2;
+    }
+    n_passes = 3;
+  }
+  
+  temp_array = (dm_array_real *)malloc(local_npix*sizeof(dm_array_real));
+  n_tasks = n_threads;
+  tasks = (dm_array_blur_task_struct *)
+    malloc(n_tasks*sizeof(dm_array_blur_task_struct));
+  source_ras = *ptr_ras;
+
+  for (i_pass=0; i_pass<n_passes; i_pass++) {
+    this_radius = box_radius[i_pass];
+    
+    /* Along x for 2D and 3D arrays, from real_array to temp_array */
+    source_array = ptr_ras->real_array;
+    if (n_dims > 1) {
+      dm_array_blur_axis(tasks,n_tasks,source_array,temp_array,
+			 kernel,this_radius,0,0,ptr_ras->nx,1,
+			 local_npix/ptr_ras->nx,ptr_ras->nx);
+      source_array = temp_array;
+    }
+    /* Along y for 3D arrays, back into real_array */
+    if (n_dims > 2) {
+      dm_array_blur_axis(tasks,n_tasks,source_array,ptr_ras->real_array,
+			 kernel,this_radius,0,0,ptr_ras->ny,ptr_ras->nx,
+			 local_slabs,slab_npix);
+      source_array = ptr_ras->real_array;
+    }
+    
+    /* Along the slowest axis, which needs the slabs of the 
+     * neighbouring processes. 
+     */
+    source_ras.real_array = source_array;
+    if (dm_array_halo_init(&halo,DM_ARRAY_HALO_REAL,ptr_ras->nx,ptr_ras->ny,
+			   ptr_ras->nz,local_npix,this_radius,
+			   my_rank,p) != 0) {
+      break;
+    }
+    dm_array_halo_exchange_real(&source_ras,&halo);
+    padded_array = (dm_array_real *)
+      malloc((size_t)(halo.halo_lo+local_slabs+halo.halo_hi)*slab_npix*
+	     sizeof(dm_array_real));
+    memcpy(padded_array+(size_t)halo.halo_lo*slab_npix,source_array,
+	   (size_t)local_npix*sizeof(dm_array_real));
+    dm_array_halo_wait(&halo);
+    memcpy(padded_array,halo.lo_array,
+	   (size_t)halo.halo_lo*slab_npix*sizeof(dm_array_real));
+    memcpy(padded_array+(size_t)(halo.halo_lo+local_slabs)*slab_npix,
+	   halo.hi_array,(size_t)halo.halo_hi*slab_npix*sizeof(dm_array_real));
+    
+    dm_array_blur_axis(tasks,n_tasks,
+		       padded_array+(size_t)halo.halo_lo*slab_npix,
+		       ptr_ras->real_array,kernel,this_radius,
+		       halo.halo_lo,halo.halo_hi,local_slabs,slab_npix,1,0);
+    free(padded_array);
+    dm_array_halo_free(&halo);
+  }
+
+  free(tasks);
+  free(temp_array);
+  if (kernel != NULL) free(kernel);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_blur_axis(dm_array_blur_task_struct *tasks,
+			int n_tasks,
+			dm_array_real *in_array,
+			dm_array_real *out_array,
+			dm_array_real *kernel,
+			int radius,
+			int n_lo,
+			int n_hi,
+			int n_out,
+			dm_array_index_t slab_npix,
+			int n_blocks,
+			dm_array_index_t block_npix)
+{
+  int i_task, per_task, first, last;
+
+  /* Independent blocks (rows or planes) are shared out between the 
+   * threads. A single block is split up along the axis itself, and
+   * each piece can then use the slabs of its neighbours as halo.
+   */
+  if (n_blocks > 1) {
+    per_task = (n_blocks+n_tasks-1)/n_tasks;
+  } else {
+    per_task = (n_out+n_tasks-1)/n_tasks;
+  }
+  for (i_task=0; i_task<n_tasks; i_task++) {
+    first = i_task*per_task;
+    last = (i_task+1)*per_task;
+    (tasks+i_task)->kernel = kernel;
+    (tasks+i_task)->radius = radius;
+    (tasks+i_task)->slab_npix = slab_npix;
+    (tasks+i_task)->block_npix = block_npix;
+    if (n_blocks > 1) {
+      if (last > n_blocks) last = n_blocks;
+      if (first > last) first = last;
+      (tasks+i_task)->in_array = in_array+(size_t)first*block_npix;
+      (tasks+i_task)->out_array = out_array+(size_t)first*block_npix;
+      (tasks+i_task)->n_blocks = last-first;
+      (tasks+i_task)->n_out = n_out;
+      (tasks+i_task)->n_lo = n_lo;
+      (tasks+i_task)->n_hi = n_hi;
+    } else {
+      if (last > n_out) last = n_out;
+      if (first > last) first = last;
+      (tasks+i_task)->in_array = in_array+(size_t)first*slab_npix;
+      (tasks+i_task)->out_array = out_array+(size_t)first*slab_npix;
+      (tasks+i_task)->n_blocks = (last > first) ? 1 : 0;
+      (tasks+i_task)->n_out = last-first;
+      (tasks+i_task)->n_lo = n_lo+first;
+      (tasks+i_task)->n_hi = n_hi+(n_out-last);
+    }
+  }
+
+  dm_array_run_tasks(dm_array_blur_worker,tasks,sizeof(*tasks),n_tasks);
+}
+
+/*------------------------------------------------------------*/
+void *dm_array_blur_worker(void *ptr_arg)
+{
+  dm_array_blur_task_struct *ptr_task;
+  dm_array_real *ptr_in, *ptr_out, *ptr_slab, *ptr_dest, weight, norm;
+  double *running_sum;
+  dm_array_index_t ipix, slab_npix;
+  int i_block, iz, jz, radius, n_out, n_lo, n_hi;
+
+  ptr_task = (dm_array_blur_task_struct *)ptr_arg;
+  slab_npix = ptr_task->slab_npix;
+  radius = ptr_task->radius;
+  n_out = ptr_task->n_out;
+  n_lo = ptr_task->n_lo;
+  n_hi = ptr_task->n_hi;
+  running_sum = NULL;
+  if (ptr_task->kernel == NULL) {
+    running_sum = (double *)malloc(slab_npix*sizeof(double));
+  }
+  norm = (dm_array_real)(1./(2.*radius+1.));
+
+  /* Slab iz of the output is the weighted sum of input slabs
+   * iz-radius to iz+radius, where input slabs -n_lo to n_out+n_hi-1
+   * exist and the rest count as zero. Working a whole slab at a
+   * time keeps the inner loops contiguous.
+   */
+  for (i_block=0; i_block<ptr_task->n_blocks; i_block++) {
+    ptr_in = ptr_task->in_array+(size_t)i_block*ptr_task->block_npix;
+    ptr_out = ptr_task->out_array+(size_t)i_block*ptr_task->block_npix;
+    
+    if (ptr_task->kernel != NULL) {
+      for (iz=0; iz<n_out; iz++) {
+	ptr_dest = ptr_out+(size_t)iz*slab_npix;
+	for (ipix=0; ipix<slab_npix; ipix++) {
+	  *(ptr_dest+ipix) = 0.;
+	}
+	for (jz=iz-radius; jz<=iz+radius; jz++) {
+	  if ((jz < -n_lo) || (jz >= (n_out+n_hi))) continue;
+	  weight = *(ptr_task->kernel+jz-iz+radius);
+	  ptr_slab = ptr_in+(long)jz*(long)slab_npix;
+	  for (ipix=0; ipix<slab_npix; ipix++) {
+	    *(ptr_dest+ipix) += weight*(*(ptr_slab+ipix));
+	  }
+	}
+      }
+    } else {
+      /* Box filter: keep a running sum of 2*radius+1 slabs */
+      for (ipix=0; ipix<slab_npix; ipix++) {
+	*(running_sum+ipix) = 0.;
+      }
+      for (jz=-radius; jz<radius; jz++) {
+	if ((jz < -n_lo) || (jz >= (n_out+n_hi))) continue;
+	ptr_slab = ptr_in+(long)jz*(long)slab_npix;
+	for (ipix=0; ipix<slab_npix; ipix++) {
+	  *(running_sum+ipix) += *(ptr_slab+ipix);
+	}
+      }
+      for (iz=0; iz<n_out; iz++) {
+	jz = iz+radius;
+	if (jz < (n_out+n_hi)) {
+	  ptr_slab = ptr_in+(long)jz*(long)slab_npix;
+	  for (ipix=0; ipix<slab_npix; ipix++) {
+	    *(running_sum+ipix) += *(ptr_slab+ipix);
+	  }
+	}
+	ptr_dest = ptr_out+(size_t)iz*slab_npix;
+	for (ipix=0; ipix<slab_npix; ipix++) {
+	  *(ptr_dest+ipix) = norm*(dm_array_real)*(running_sum+ipix);
+	}
+	jz = iz-radius;
+	if (jz >= -n_lo) {
+	  ptr_slab = ptr_in+(long)jz*(long)slab_npix;
+	  for (ipix=0; ipix<slab_npix; ipix++) {
+	    *(running_sum+ipix) -= *(ptr_slab+ipix);
+	  }
+	}
+      }
+    }
+  }
+
+  if (running_sum != NULL) free(running_sum);
+  return(NULL);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_threshold_byte(dm_array_byte_struct *ptr_bas,
+			     dm_array_real_struct *ptr_ras,
+			     dm_array_real threshold)
+{
+  dm_array_index_t ipix, local_npix;
+  u_int8_t *byte_array;
+  dm_array_real *real_array;
+
+  if (ptr_bas->npix != ptr_ras->npix) return;
+
+  byte_array = ptr_bas->byte_array;
+  real_array = ptr_ras->real_array;
+  local_npix = ptr_ras->local_npix;
+  for (ipix=0; ipix<local_npix; ipix++) {
+    *(byte_array+ipix) = (u_int8_t)(*(real_array+ipix) >= threshold);
+  }
+}
+
+/*------------------------------------------------------------*/
+void dm_array_dilate_byte(dm_array_byte_struct *ptr_bas,
+			  int radius,
+			  int n_threads,
+			  int my_rank,
+			  int p)
+{
+  dm_array_morph_byte(ptr_bas,radius,0,n_threads,my_rank,p);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_erode_byte(dm_array_byte_struct *ptr_bas,
+			 int radius,
+			 int n_threads,
+			 int my_rank,
+			 int p)
+{
+  dm_array_morph_byte(ptr_bas,radius,1,n_threads,my_rank,p);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_morph_byte(dm_array_byte_struct *ptr_bas,
+			 int radius,
+			 int is_erode,
+			 int n_threads,
+			 int my_rank,
+			 int p)
+{
+  dm_array_morph_task_struct *tasks;
+  dm_array_halo_struct halo;
+  u_int64_t *packed, *result, *ptr_swap;
+  dm_array_index_t slab_npix, local_npix;
+  int n_slabs, local_slabs, n_padded, row_length, n_words, rows_per_slab;
+  int i_thread, i_pass, n_items, per_thread;
+  size_t slab_words;
+
+  if (radius < 1) return;
+
+  if (ptr_bas->nz > 1) {
+    n_slabs = ptr_bas->nz;
+    row_length = ptr_bas->nx;
+  } else if (ptr_bas->ny > 1) {
+    n_slabs = ptr_bas->ny;
+    row_length = ptr_bas->nx;
+  } else {
+    n_slabs = ptr_bas->nx;
+    row_length = 1;
+  }
+  slab_npix = ptr_bas->npix/n_slabs;
+  local_npix = ptr_bas->local_npix;
+  local_slabs = local_npix/slab_npix;
+  rows_per_slab = slab_npix/row_length;
+  n_words = (row_length+63)/64;
+  slab_words = (size_t)rows_per_slab*n_words;
+  if (n_threads < 1) n_threads = 1;
+
+  if (dm_array_halo_init(&halo,DM_ARRAY_HALO_BYTE,ptr_bas->nx,ptr_bas->ny,
+			 ptr_bas->nz,local_npix,radius,my_rank,p) != 0) {
+    return;
+  }
+  dm_array_halo_exchange_byte(ptr_bas,&halo);
+  n_padded = halo.halo_lo+local_slabs+halo.halo_hi;
+  packed = (u_int64_t *)calloc((size_t)n_padded*slab_words,sizeof(u_int64_t));
+  result = (u_int64_t *)calloc((size_t)n_padded*slab_words,sizeof(u_int64_t));
+  tasks = (dm_array_morph_task_struct *)
+    malloc(n_threads*sizeof(dm_array_morph_task_struct));
+  dm_array_halo_wait(&halo);
+  if ((packed == NULL) || (result == NULL) || (tasks == NULL)) {
+    if (packed != NULL) free(packed);
+    if (result != NULL) free(result);
+    if (tasks != NULL) free(tasks);
+    dm_array_halo_free(&halo);
+    return;
+  }
+
+  for (i_thread=0; i_thread<n_threads; i_thread++) {
+    (tasks+i_thread)->ptr_bas = ptr_bas;
+    (tasks+i_thread)->ptr_halo = &halo;
+    (tasks+i_thread)->radius = radius;
+    (tasks+i_thread)->is_erode = is_erode;
+    (tasks+i_thread)->row_length = row_length;
+    (tasks+i_thread)->n_words = n_words;
+    (tasks+i_thread)->rows_per_slab = rows_per_slab;
+    (tasks+i_thread)->local_slabs = local_slabs;
+    (tasks+i_thread)->slab_npix = slab_npix;
+    (tasks+i_thread)->slab_words = slab_words;
+  }
+
+  /* Rows are packed and dilated along x, then each padded slab is
+   * dilated along y, then each local slab along the slowest axis.
+   * Within a pass the pieces are independent, so they are shared out
+   * between the threads the way dm_array_blur_axis() does.
+   */
+  for (i_pass=0; i_pass<3; i_pass++) {
+    if ((i_pass == 1) && (rows_per_slab < 2)) continue;
+    if (i_pass == 0) {
+      n_items = n_padded*rows_per_slab;
+    } else if (i_pass == 1) {
+      n_items = n_padded;
+    } else {
+      n_items = local_slabs;
+    }
+    per_thread = (n_items+n_threads-1)/n_threads;
+    for (i_thread=0; i_thread<n_threads; i_thread++) {
+      (tasks+i_thread)->pass = i_pass;
+      (tasks+i_thread)->packed = packed;
+      (tasks+i_thread)->result = result;
+      (tasks+i_thread)->start = i_thread*per_thread;
+      (tasks+i_thread)->stop = (i_thread+1)*per_thread;
+      if ((tasks+i_thread)->stop > n_items) {
+	(tasks+i_thread)->stop = n_items;
+      }
+      if ((tasks+i_thread)->start > (tasks+i_thread)->stop) {
+	(tasks+i_thread)->start = (tasks+i_thread)->stop;
+      }
+    }
+    dm_array_run_tasks(dm_array_morph_worker,tasks,
+		       sizeof(*tasks),n_threads);
+    /* The y pass leaves its output in result */
+    if (i_pass == 1) {
+      ptr_swap = packed;
+      packed = result;
+      result = ptr_swap;
+    }
+  }
+  
+  free(tasks);
+  free(result);
+  free(packed);
+  dm_array_halo_free(&halo);
+}
+
+/*------------------------------------------------------------*/
+void *dm_array_morph_worker(void *ptr_arg)
+{
+  dm_array_morph_task_struct *ptr_task;
+  dm_array_halo_struct *ptr_halo;
+  u_int64_t *packed, *result, *ptr_row, *ptr_src, *ptr_dest, last_mask;
+  u_int64_t word, carry, next_carry;
+  u_int8_t *ptr_bytes;
+  dm_array_index_t slab_npix;
+  int radius, is_erode, row_length, n_words, rows_per_slab, local_slabs;
+  int i_row, i_slab, i_word, ix, iy, jy, iz, jz, i_step;
+  size_t slab_words;
+
+  ptr_task = (dm_array_morph_task_struct *)ptr_arg;
+  ptr_halo = ptr_task->ptr_halo;
+  packed = ptr_task->packed;
+  result = ptr_task->result;
+  radius = ptr_task->radius;
+  is_erode = ptr_task->is_erode;
+  row_length = ptr_task->row_length;
+  n_words = ptr_task->n_words;
+  rows_per_slab = ptr_task->rows_per_slab;
+  local_slabs = ptr_task->local_slabs;
+  slab_npix = ptr_task->slab_npix;
+  slab_words = ptr_task->slab_words;
+  last_mask = ((row_length%64) == 0) ? ~(u_int64_t)0 :
+    (((u_int64_t)1 << (row_length%64))-1);
+
+  if (ptr_task->pass == 0) {
+    for (i_row=ptr_task->start; i_row<ptr_task->stop; i_row++) {
+      /* Pack the row into bits. Erosion is done as a dilation of the
+       * complement, so that pixels outside of the array count as 0 for
+       * dilation and as 1 for erosion and never change the result.
+       */
+      i_slab = i_row/rows_per_slab;
+      if (i_slab < ptr_halo->halo_lo) {
+	ptr_bytes = (u_int8_t *)ptr_halo->lo_array+(size_t)i_row*row_length;
+      } else if (i_slab < (ptr_halo->halo_lo+local_slabs)) {
+	ptr_bytes = ptr_task->ptr_bas->byte_array+
+	  (size_t)(i_row-ptr_halo->halo_lo*rows_per_slab)*row_length;
+      } else {
+	ptr_bytes = (u_int8_t *)ptr_halo->hi_array+
+	  (size_t)(i_row-(ptr_halo->halo_lo+local_slabs)*rows_per_slab)*
+	  row_length;
+      }
+      ptr_row = packed+(size_t)i_row*n_words;
+      for (ix=0; ix<row_length; ix++) {
+	if ((*(ptr_bytes+ix) != 0) != is_erode) {
+	  *(ptr_row+ix/64) |= ((u_int64_t)1 << (ix%64));
+	}
+      }
+      if (row_length < 2) continue;
+
+      /* Along x: radius steps of OR-ing in the neighbours on both sides */
+      ptr_dest = result+(size_t)i_row*n_words;
+      for (i_step=0; i_step<radius; i_step++) {
+	/* Pixel ix is bit ix%64 of word ix/64: shift up by one... */
+	carry = 0;
+	for (i_word=0; i_word<n_words; i_word++) {
+	  word = *(ptr_row+i_word);
+	  *(ptr_dest+i_word) = word | (word << 1) | carry;
+	  carry = word >> 63;
+	}
+	/* ...and down by one */
+	carry = 0;
+	for (i_word=n_words-1; i_word>=0; i_word--) {
+	  word = *(ptr_row+i_word);
+	  next_carry = word << 63;
+	  *(ptr_dest+i_word) |= (word >> 1) | carry;
+	  carry = next_carry;
+	}
+	*(ptr_dest+n_words-1) &= last_mask;
+	memcpy(ptr_row,ptr_dest,n_words*sizeof(u_int64_t));
+      }
+    }
+  } else if (ptr_task->pass == 1) {
+    /* Along y within each plane of a 3D array */
+    for (i_slab=ptr_task->start; i_slab<ptr_task->stop; i_slab++) {
+      ptr_src = packed+(size_t)i_slab*slab_words;
+      ptr_dest = result+(size_t)i_slab*slab_words;
+      for (iy=0; iy<rows_per_slab; iy++) {
+	for (i_word=0; i_word<n_words; i_word++) {
+	  word = 0;
+	  for (jy=iy-radius; jy<=iy+radius; jy++) {
+	    if ((jy < 0) || (jy >= rows_per_slab)) continue;
+	    word |= *(ptr_src+(size_t)jy*n_words+i_word);
+	  }
+	  *(ptr_dest+(size_t)iy*n_words+i_word) = word;
+	}
+      }
+    }
+  } else {
+    /* Along the slowest axis, for the local slabs only, then unpack */
+    for (iz=ptr_task->start; iz<ptr_task->stop; iz++) {
+      ptr_dest = result+(size_t)iz*slab_words;
+      for (i_word=0; i_word<(int)slab_words; i_word++) {
+	*(ptr_dest+i_word) = 0;
+      }
+      for (jz=iz-radius; jz<=iz+radius; jz++) {
+	if ((jz < -ptr_halo->halo_lo) || 
+	    (jz >= (local_slabs+ptr_halo->halo_hi))) {
+	  continue;
+	}
+	ptr_src = packed+(size_t)(jz+ptr_halo->halo_lo)*slab_words;
+	for (i_word=0; i_word<(int)slab_words; i_word++) {
+	  *(ptr_dest+i_word) |= *(ptr_src+i_word);
+	}
+      }
+      for (iy=0; iy<rows_per_slab; iy++) {
+	ptr_row = ptr_dest+(size_t)iy*n_words;
+	ptr_bytes = ptr_task->ptr_bas->byte_array+(size_t)iz*slab_npix+
+	  (size_t)iy*row_length;
+	for (ix=0; ix<row_length; ix++) {
+	  *(ptr_bytes+ix) = 
+	    (u_int8_t)(((*(ptr_row+ix/64) >> (ix%64)) & 1) != 
+		       (u_int64_t)is_erode);
+	}
+      }
+    }
+  }
+
+  return(NULL);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_shrinkwrap(dm_array_byte_struct *ptr_spt,
+			 dm_array_complex_struct *ptr_cas,
+			 dm_array_real_struct *ptr_ras_scratch,
+			 dm_array_real sigma,
+			 dm_array_real threshold,
+			 int dilate_radius,
+			 int erode_radius,
+			 int n_threads,
+			 int my_rank,
+			 int p)
+{
+  dm_array_real max_value;
+
+  dm_array_magnitude_complex(ptr_ras_scratch,ptr_cas);
+  dm_array_blur_real(ptr_ras_scratch,sigma,n_threads,my_rank,p);
+  max_value = dm_array_max_real(ptr_ras_scratch,p);
+  dm_array_threshold_byte(ptr_spt,ptr_ras_scratch,threshold*max_value);
+  dm_array_dilate_byte(ptr_spt,dilate_radius,n_threads,my_rank,p);
+  dm_array_erode_byte(ptr_spt,erode_radius,n_threads,my_rank,p);
+}
+
+/*------------------------------------------------------------*/
+int dm_array_ensemble_init(dm_array_ensemble_struct *ptr_ensemble,
+			   dm_array_real_struct *ptr_ras_mags,
+			   dm_array_byte_struct *ptr_bas_support,
+			   int n_starts,
+			   int fft_options,
+			   int p,
+			   int my_rank)
+{
+  dm_array_complex_struct *ptr_cas;
+  int i_start, n_allocated, status;
+
+  if ((n_starts < 1) ||
+      ((ptr_bas_support->npix) != (ptr_ras_mags->npix))) return(-1);
+
+  ptr_ensemble->n_starts = n_starts;
+  ptr_ensemble->ptr_ras_mags = ptr_ras_mags;
+  ptr_ensemble->ptr_bas_support = ptr_bas_support;
+  ptr_ensemble->p = p;
+  ptr_ensemble->my_rank = my_rank;
+  ptr_ensemble->iterates = (dm_array_complex_struct *)
+    malloc(n_starts*sizeof(dm_array_complex_struct));
+  ptr_ensemble->errors = (dm_array_real *)
+    malloc(n_starts*sizeof(dm_array_real));
+
+  status = 0;
+  n_allocated = 0;
+  if ((ptr_ensemble->iterates == NULL) || (ptr_ensemble->errors == NULL)) {
+    status = -1;
+  }
+  for (i_start=0; (status == 0) && (i_start<n_starts); i_start++) {
+    ptr_cas = ptr_ensemble->iterates+i_start;
+    ptr_cas->nx = ptr_ras_mags->nx;
+    ptr_cas->ny = ptr_ras_mags->ny;
+    ptr_cas->nz = ptr_ras_mags->nz;
+    ptr_cas->npix = ptr_ras_mags->npix;
+    DM_ARRAY_COMPLEX_STRUCT_INIT(ptr_cas,ptr_cas->npix,p);
+    if (ptr_cas->complex_array == NULL) {
+      status = -1;
+      break;
+    }
+    n_allocated++;
+    ptr_cas->local_offset = (dm_array_index_t)my_rank*ptr_cas->local_npix;
+    dm_array_zero_complex(ptr_cas);
+    *(ptr_ensemble->errors+i_start) = 0.;
+  }
+
+  /* The plans are made by all processes together, so they all give
+   * up if any of them is short of memory.
+   */
+#if USE_MPI
+  MPI_Allreduce(MPI_IN_PLACE,&status,1,MPI_INT,MPI_MIN,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+  if (status != 0) {
+    for (i_start=0; i_start<n_allocated; i_start++) {
+      DM_ARRAY_COMPLEX_FREE((ptr_ensemble->iterates+i_start)->complex_array);
+    }
+    if (ptr_ensemble->iterates != NULL) free(ptr_ensemble->iterates);
+    if (ptr_ensemble->errors != NULL) free(ptr_ensemble->errors);
+    ptr_ensemble->iterates = NULL;
+    ptr_ensemble->errors = NULL;
+    ptr_ensemble->n_starts = 0;
+    return(-1);
+  }
+
+  /* The plans are made once, and since every iterate has the same
+   * size and alignment the others can execute them on their own 
+   * arrays.
+   */
+  dm_array_fft(ptr_ensemble->iterates,p,
+	       DM_ARRAY_CREATE_FFT_PLAN | fft_options,my_rank);
+  for (i_start=1; i_start<n_starts; i_start++) {
+    (ptr_ensemble->iterates+i_start)->ptr_forward_plan = 
+      ptr_ensemble->iterates->ptr_forward_plan;
+    (ptr_ensemble->iterates+i_start)->ptr_inverse_plan = 
+      ptr_ensemble->iterates->ptr_inverse_plan;
+  }
+
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_ensemble_start(dm_array_ensemble_struct *ptr_ensemble,
+			     u_int64_t seed,
+			     int n_threads)
+{
+  int i_start;
+
+  for (i_start=0; i_start<ptr_ensemble->n_starts; i_start++) {
+    dm_array_rand_seeded(ptr_ensemble->iterates+i_start,1,
+			 seed+(u_int64_t)i_start,n_threads);
+    dm_array_multiply_complex_byte(ptr_ensemble->iterates+i_start,
+				   ptr_ensemble->ptr_bas_support);
+    *(ptr_ensemble->errors+i_start) = 0.;
+  }
+}
+
+/*------------------------------------------------------------*/
+void dm_array_ensemble_run(dm_array_ensemble_struct *ptr_ensemble,
+			   int n_iterations,
+			   dm_array_real beta,
+			   int n_threads)
+{
+  dm_array_ensemble_task_struct *tasks;
+  dm_array_complex_struct *ptr_scratch;
+  int i_thread;
+
+  /* The FFTs and the error sums of a distributed array need all 
+   * processes at the same time, so they go through the starts in
+   * step.
+   */
+#if USE_MPI
+  n_threads = 1;
+#endif /* USE_MPI */
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > ptr_ensemble->n_starts) n_threads = ptr_ensemble->n_starts;
+  tasks = (dm_array_ensemble_task_struct *)
+    malloc(n_threads*sizeof(dm_array_ensemble_task_struct));
+
+  for (i_thread=0; i_thread<n_threads; i_thread++) {
+    (tasks+i_thread)->ptr_ensemble = ptr_ensemble;
+    (tasks+i_thread)->first_start = i_thread;
+    (tasks+i_thread)->start_step = n_threads;
+    (tasks+i_thread)->n_iterations = n_iterations;
+    (tasks+i_thread)->beta = beta;
+    ptr_scratch = &((tasks+i_thread)->scratch);
+    ptr_scratch->npix = ptr_ensemble->iterates->npix;
+    ptr_scratch->complex_array = NULL;
+    if (beta != 0.) {
+      DM_ARRAY_COMPLEX_STRUCT_INIT(ptr_scratch,ptr_scratch->npix,
+				   ptr_ensemble->p);
+    }
+  }
+
+  dm_array_run_tasks(dm_array_ensemble_worker,tasks,
+		     sizeof(*tasks),n_threads);
+
+  for (i_thread=0; i_thread<n_threads; i_thread++) {
+    if ((tasks+i_thread)->scratch.complex_array != NULL) {
+      DM_ARRAY_COMPLEX_FREE((tasks+i_thread)->scratch.complex_array);
+    }
+  }
+  free(tasks);
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void *dm_array_ensemble_worker(void *ptr_arg)
+{
+  dm_array_ensemble_task_struct *ptr_task;
+  dm_array_ensemble_struct *ptr_ensemble;
+  dm_array_complex_struct *ptr_cas, *ptr_scratch;
+  u_int8_t *support;
+  dm_array_real beta, error;
+  dm_array_index_t ipix;
+  int i_start, i_iteration, p, my_rank;
+
+  ptr_task = (dm_array_ensemble_task_struct *)ptr_arg;
+  ptr_ensemble = ptr_task->ptr_ensemble;
+  ptr_scratch = &(ptr_task->scratch);
+  support = ptr_ensemble->ptr_bas_support->byte_array;
+  beta = ptr_task->beta;
+  p = ptr_ensemble->p;
+  my_rank = ptr_ensemble->my_rank;
+
+  for (i_start=ptr_task->first_start; i_start<ptr_ensemble->n_starts;
+       i_start+=ptr_task->start_step) {
+    ptr_cas = ptr_ensemble->iterates+i_start;
+    error = *(ptr_ensemble->errors+i_start);
+    for (i_iteration=0; i_iteration<ptr_task->n_iterations; i_iteration++) {
+      if (beta != 0.) dm_array_copy_complex(ptr_scratch,ptr_cas);
+
+      /* Fourier space projection */
+      dm_array_fft(ptr_cas,p,DM_ARRAY_FORWARD_FFT,my_rank);
+      error = dm_array_transfer_magnitudes_error(ptr_cas,
+						 ptr_ensemble->ptr_ras_mags,
+						 NULL,0);
+      dm_array_fft(ptr_cas,p,DM_ARRAY_INVERSE_FFT,my_rank);
+
+      /* Real space: keep the projection inside the support, and 
+       * outside either zero it (error reduction) or push the previous
+       * iterate away from it (HIO).
+       */
+      if (beta == 0.) {
+	dm_array_multiply_complex_byte(ptr_cas,
+				       ptr_ensemble->ptr_bas_support);
+      } else {
+	for (ipix=0; ipix<ptr_cas->local_npix; ipix++) {
+	  if (*(support+ipix) == 0) {
+	    c_re(ptr_cas->complex_array,ipix) = 
+	      c_re(ptr_scratch->complex_array,ipix)-
+	      beta*c_re(ptr_cas->complex_array,ipix);
+	    c_im(ptr_cas->complex_array,ipix) = 
+	      c_im(ptr_scratch->complex_array,ipix)-
+	      beta*c_im(ptr_cas->complex_array,ipix);
+	  }
+	}
+      }
+    }
+    *(ptr_ensemble->errors+i_start) = error;
+  }
+
+  return(NULL);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_ensemble_free(dm_array_ensemble_struct *ptr_ensemble)
+{
+  int i_start;
+
+  dm_array_fft(ptr_ensemble->iterates,ptr_ensemble->p,
+	       DM_ARRAY_DESTROY_FFT_PLAN,ptr_ensemble->my_rank);
+  for (i_start=0; i_start<ptr_ensemble->n_starts; i_start++) {
+    DM_ARRAY_COMPLEX_FREE((ptr_ensemble->iterates+i_start)->complex_array);
+  }
+  free(ptr_ensemble->iterates);
+  free(ptr_ensemble->errors);
+  ptr_ensemble->iterates = NULL;
+  ptr_ensemble->errors = NULL;
+  ptr_ensemble->n_starts = 0;
+}
+
+/*------------------------------------------------------------*/
+void dm_array_fft_frequency(dm_array_complex_struct *ptr_cas,
+			    dm_array_index_t global_index,
+			    int *frequency)
+{
+  int ix, iy, iz;
+
+  ix = (int)(global_index % ptr_cas->nx);
+  iy = (int)((global_index/ptr_cas->nx) % ptr_cas->ny);
+  iz = (int)(global_index/(ptr_cas->nx*ptr_cas->ny));
+  *(frequency+0) = (ix < (ptr_cas->nx+1)/2) ? ix : ix-(int)ptr_cas->nx;
+  *(frequency+1) = (iy < (ptr_cas->ny+1)/2) ? iy : iy-(int)ptr_cas->ny;
+  *(frequency+2) = (iz < (ptr_cas->nz+1)/2) ? iz : iz-(int)ptr_cas->nz;
+}
+
+/*------------------------------------------------------------*/
+int dm_array_phase_ramp(dm_array_complex_struct *ptr_cas,
+			double *shift,
+			dm_array_real scale)
+{
+  dm_array_real *ramps[3], *row_ramp;
+  dm_array_real f_re, f_im, r_re, r_im, x_re, x_im;
+  double two_pi, phase;
+  dm_array_index_t ipix, jpix, global_offset, global_index, n_row;
+  int n[3], frequency[3], i_axis, i, ix0, iy, iz;
+  int my_rank;
+
+#if USE_MPI
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+#else
+  my_rank = 0;
+#endif /* USE_MPI */
+  global_offset = (dm_array_index_t)my_rank*ptr_cas->local_npix;
+  two_pi = 8.*atan(1.);
+  n[0] = (int)ptr_cas->nx;
+  n[1] = (int)ptr_cas->ny;
+  n[2] = (int)ptr_cas->nz;
+
+  /* ramps[i_axis] holds exp(-2 pi i k shift/n) as (re,im) pairs for
+   * each pixel along the axis.
+   */
+  for (i_axis=0; i_axis<3; i_axis++) {
+    ramps[i_axis] = (dm_array_real *)malloc(2*n[i_axis]*
+					    sizeof(dm_array_real));
+    if (ramps[i_axis] == NULL) {
+      for (i=0; i<i_axis; i++) free(ramps[i]);
+      return(-1);
+    }
+    for (i=0; i<n[i_axis]; i++) {
+      frequency[i_axis] = (i < (n[i_axis]+1)/2) ? i : i-n[i_axis];
+      phase = -two_pi*(double)frequency[i_axis]*(*(shift+i_axis))/
+	(double)n[i_axis];
+      *(ramps[i_axis]+2*i) = (dm_array_real)cos(phase);
+      *(ramps[i_axis]+2*i+1) = (dm_array_real)sin(phase);
+    }
+  }
+
+  /* Go a row (or the part of one on this process) at a time, with 
+   * the y and z factors and the scale folded into one row ramp.
+   */
+  for (ipix=0; ipix<ptr_cas->local_npix; ipix+=n_row) {
+    global_index = global_offset+ipix;
+    ix0 = (int)(global_index % n[0]);
+    iy = (int)((global_index/n[0]) % n[1]);
+    iz = (int)(global_index/((dm_array_index_t)n[0]*n[1]));
+    n_row = n[0]-ix0;
+    if (n_row > (ptr_cas->local_npix-ipix)) n_row = ptr_cas->local_npix-ipix;
+
+    f_re = *(ramps[1]+2*iy)*(*(ramps[2]+2*iz))-
+      *(ramps[1]+2*iy+1)*(*(ramps[2]+2*iz+1));
+    f_im = *(ramps[1]+2*iy)*(*(ramps[2]+2*iz+1))+
+      *(ramps[1]+2*iy+1)*(*(ramps[2]+2*iz));
+    f_re *= scale;
+    f_im *= scale;
+    row_ramp = ramps[0]+2*ix0;
+    for (jpix=ipix; jpix<ipix+n_row; jpix++) {
+      r_re = *(row_ramp)*f_re-*(row_ramp+1)*f_im;
+      r_im = *(row_ramp)*f_im+*(row_ramp+1)*f_re;
+      row_ramp += 2;
+      x_re = c_re(ptr_cas->complex_array,jpix);
+      x_im = c_im(ptr_cas->complex_array,jpix);
+      c_re(ptr_cas->complex_array,jpix) = x_re*r_re-x_im*r_im;
+      c_im(ptr_cas->complex_array,jpix) = x_re*r_im+x_im*r_re;
+    }
+  }
+
+  for (i_axis=0; i_axis<3; i_axis++) free(ramps[i_axis]);
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+int dm_array_shift_complex(dm_array_complex_struct *ptr_cas,
+			   double *shift,
+			   int p,
+			   int my_rank)
+{
+  dm_array_real scale;
+  int status;
+
+  scale = (dm_array_real)(1./((double)ptr_cas->nx*(double)ptr_cas->ny*
+			      (double)ptr_cas->nz));
+  dm_array_fft(ptr_cas,p,DM_ARRAY_FORWARD_FFT | DM_ARRAY_FFT_UNNORMALIZED,
+	       my_rank);
+  status = dm_array_phase_ramp(ptr_cas,shift,scale);
+  /* Without a ramp the array still has to go back, unshifted */
+  if (status != 0) dm_array_multiply_real_scalar(ptr_cas,scale);
+  dm_array_fft(ptr_cas,p,DM_ARRAY_INVERSE_FFT | DM_ARRAY_FFT_UNNORMALIZED,
+	       my_rank);
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  return(status);
+}
+
+/*------------------------------------------------------------*/
+int dm_array_rotate_complex(dm_array_complex_struct *ptr_cas,
+			    int axis,
+			    double theta)
+{
+#if defined(DIST_FFT)
+  fprintf(stderr,"dm_array_rotate_complex() needs FFTW\n");
+  return(-1);
+#else
+  dm_array_complex *line;
+  dm_fft_plan forward_plan, inverse_plan;
+  double half_pi;
+  int n[3], a_axis, b_axis, n_line, status;
+
+  n[0] = (int)ptr_cas->nx;
+  n[1] = (int)ptr_cas->ny;
+  n[2] = (int)ptr_cas->nz;
+  if ((axis < 0) || (axis > 2)) return(-1);
+  a_axis = (axis+1) % 3;
+  b_axis = (axis+2) % 3;
+  if ((ptr_cas->local_npix != ptr_cas->npix) ||
+      (n[a_axis] < 2) || (n[b_axis] < 2)) return(-1);
+
+  /* Bring the angle within 90 degrees, where the shears stay small */
+  half_pi = 2.*atan(1.);
+  while (theta > 2.*half_pi) theta -= 4.*half_pi;
+  while (theta < -2.*half_pi) theta += 4.*half_pi;
+  if (fabs(theta) > half_pi) {
+    dm_array_half_turn(ptr_cas,axis);
+    theta += (theta > 0.) ? -2.*half_pi : 2.*half_pi;
+  }
+  if (theta == 0.) return(0);
+
+  /* One line buffer and plan pair that fits both axes */
+  n_line = (n[a_axis] > n[b_axis]) ? n[a_axis] : n[b_axis];
+  DM_ARRAY_COMPLEX_MALLOC(line,n_line);
+  if (line == NULL) return(-1);
+
+  /* Rotating (a,b) by theta is a shear along a by -tan(theta/2) b,
+   * one along b by sin(theta) a and the first one again.
+   */
+#if defined(DM_ARRAY_DOUBLE)
+  forward_plan = fftw_plan_dft_1d(n[a_axis],line,line,FFTW_FORWARD,
+				  FFTW_ESTIMATE);
+  inverse_plan = fftw_plan_dft_1d(n[a_axis],line,line,FFTW_BACKWARD,
+				  FFTW_ESTIMATE);
+#else
+  forward_plan = fftwf_plan_dft_1d(n[a_axis],line,line,FFTW_FORWARD,
+				   FFTW_ESTIMATE);
+  inverse_plan = fftwf_plan_dft_1d(n[a_axis],line,line,FFTW_BACKWARD,
+				   FFTW_ESTIMATE);
+#endif /* DM_ARRAY_DOUBLE */
+  status = dm_array_shear_complex(ptr_cas,a_axis,b_axis,-tan(0.5*theta),
+				  line,forward_plan,inverse_plan);
+  if ((status == 0) && (n[b_axis] != n[a_axis])) {
+#if defined(DM_ARRAY_DOUBLE)
+    fftw_destroy_plan(forward_plan);
+    fftw_destroy_plan(inverse_plan);
+    forward_plan = fftw_plan_dft_1d(n[b_axis],line,line,FFTW_FORWARD,
+				    FFTW_ESTIMATE);
+    inverse_plan = fftw_plan_dft_1d(n[b_axis],line,line,FFTW_BACKWARD,
+				    FFTW_ESTIMATE);
+#else
+    fftwf_destroy_plan(forward_plan);
+    fftwf_destroy_plan(inverse_plan);
+    forward_plan = fftwf_plan_dft_1d(n[b_axis],line,line,FFTW_FORWARD,
+				     FFTW_ESTIMATE);
+    inverse_plan = fftwf_plan_dft_1d(n[b_axis],line,line,FFTW_BACKWARD,
+				     FFTW_ESTIMATE);
+#endif /* DM_ARRAY_DOUBLE */
+  }
+  if (status == 0) {
+    status = dm_array_shear_complex(ptr_cas,b_axis,a_axis,sin(theta),line,
+				    forward_plan,inverse_plan);
+  }
+  if ((status == 0) && (n[b_axis] != n[a_axis])) {
+#if defined(DM_ARRAY_DOUBLE)
+    fftw_destroy_plan(forward_plan);
+    fftw_destroy_plan(inverse_plan);
+    forward_plan = fftw_plan_dft_1d(n[a_axis],line,line,FFTW_FORWARD,
+				    FFTW_ESTIMATE);
+    inverse_plan = fftw_plan_dft_1d(n[a_axis],line,line,FFTW_BACKWARD,
+				    FFTW_ESTIMATE);
+#else
+    fftwf_destroy_plan(forward_plan);
+    fftwf_destroy_plan(inverse_plan);
+    forward_plan = fftwf_plan_dft_1d(n[a_axis],line,line,FFTW_FORWARD,
+				     FFTW_ESTIMATE);
+    inverse_plan = fftwf_plan_dft_1d(n[a_axis],line,line,FFTW_BACKWARD,
+				     FFTW_ESTIMATE);
+#endif /* DM_ARRAY_DOUBLE */
+  }
+  if (status == 0) {
+    status = dm_array_shear_complex(ptr_cas,a_axis,b_axis,-tan(0.5*theta),
+				    line,forward_plan,inverse_plan);
+  }
+
+#if defined(DM_ARRAY_DOUBLE)
+  fftw_destroy_plan(forward_plan);
+  fftw_destroy_plan(inverse_plan);
+#else
+  fftwf_destroy_plan(forward_plan);
+  fftwf_destroy_plan(inverse_plan);
+#endif /* DM_ARRAY_DOUBLE */
+  DM_ARRAY_COMPLEX_FREE(line);
+
+  return(status);
+#endif /* DIST_FFT */
+}
+
+#if !defined(DIST_FFT)
+/*------------------------------------------------------------*/
+int dm_array_shear_complex(dm_array_complex_struct *ptr_cas,
+			   int axis,
+			   int along_axis,
+			   double factor,
+			   dm_array_complex *line,
+			   dm_fft_plan forward_plan,
+			   dm_fft_plan inverse_plan)
+{
+  dm_array_real *ramp;
+  dm_array_real r_re, r_im, x_re, x_im;
+  double *ramp_now, *ramp_step;
+  double two_pi, phase, now_re, now_im;
+  dm_array_index_t stride[3], base;
+  int n[3], other_axis, i, i_along, i_other, frequency;
+
+  two_pi = 8.*atan(1.);
+  n[0] = (int)ptr_cas->nx;
+  n[1] = (int)ptr_cas->ny;
+  n[2] = (int)ptr_cas->nz;
+  stride[0] = 1;
+  stride[1] = (dm_array_index_t)n[0];
+  stride[2] = (dm_array_index_t)n[0]*n[1];
+  other_axis = 3-axis-along_axis;
+
+  /* The ramp for the line at i_along is exp(-2 pi i k factor 
+   * (i_along-n/2)/n), so going from one i_along to the next 
+   * multiplies it by the same step. It is kept in double so that 
+   * the steps do not add up to anything, and the 1/n of the two 
+   * unnormalized transforms goes in when it is applied.
+   */
+  ramp = (dm_array_real *)malloc(2*n[axis]*sizeof(dm_array_real));
+  ramp_now = (double *)malloc(2*n[axis]*sizeof(double));
+  ramp_step = (double *)malloc(2*n[axis]*sizeof(double));
+  if ((ramp == NULL) || (ramp_now == NULL) || (ramp_step == NULL)) {
+    if (ramp != NULL) free(ramp);
+    if (ramp_now != NULL) free(ramp_now);
+    if (ramp_step != NULL) free(ramp_step);
+    return(-1);
+  }
+  for (i=0; i<n[axis]; i++) {
+    frequency = (i < (n[axis]+1)/2) ? i : i-n[axis];
+    phase = -two_pi*(double)frequency*factor/(double)n[axis];
+    *(ramp_step+2*i) = cos(phase);
+    *(ramp_step+2*i+1) = sin(phase);
+    phase *= -(double)(n[along_axis]/2);
+    *(ramp_now+2*i) = cos(phase);
+    *(ramp_now+2*i+1) = sin(phase);
+  }
+
+  for (i_along=0; i_along<n[along_axis]; i_along++) {
+    for (i=0; i<n[axis]; i++) {
+      *(ramp+2*i) = (dm_array_real)(*(ramp_now+2*i)/(double)n[axis]);
+      *(ramp+2*i+1) = (dm_array_real)(*(ramp_now+2*i+1)/(double)n[axis]);
+      now_re = *(ramp_now+2*i);
+      now_im = *(ramp_now+2*i+1);
+      *(ramp_now+2*i) = now_re*(*(ramp_step+2*i))-
+	now_im*(*(ramp_step+2*i+1));
+      *(ramp_now+2*i+1) = now_re*(*(ramp_step+2*i+1))+
+	now_im*(*(ramp_step+2*i));
+    }
+
+    for (i_other=0; i_other<n[other_axis]; i_other++) {
+      base = (dm_array_index_t)i_along*stride[along_axis]+
+	(dm_array_index_t)i_other*stride[other_axis];
+      for (i=0; i<n[axis]; i++) {
+	c_re(line,i) = c_re(ptr_cas->complex_array,base+i*stride[axis]);
+	c_im(line,i) = c_im(ptr_cas->complex_array,base+i*stride[axis]);
+      }
+#if defined(DM_ARRAY_DOUBLE)
+      fftw_execute_dft(forward_plan,line,line);
+#else
+      fftwf_execute_dft(forward_plan,line,line);
+#endif /* DM_ARRAY_DOUBLE */
+      for (i=0; i<n[axis]; i++) {
+	r_re = *(ramp+2*i);
+	r_im = *(ramp+2*i+1);
+	x_re = c_re(line,i);
+	x_im = c_im(line,i);
+	c_re(line,i) = x_re*r_re-x_im*r_im;
+	c_im(line,i) = x_re*r_im+x_im*r_re;
+      }
+#if defined(DM_ARRAY_DOUBLE)
+      fftw_execute_dft(inverse_plan,line,line);
+#else
+      fftwf_execute_dft(inverse_plan,line,line);
+#endif /* DM_ARRAY_DOUBLE */
+      for (i=0; i<n[axis]; i++) {
+	c_re(ptr_cas->complex_array,base+i*stride[axis]) = c_re(line,i);
+	c_im(ptr_cas->complex_array,base+i*stride[axis]) = c_im(line,i);
+      }
+    }
+  }
+
+  free(ramp);
+  free(ramp_now);
+  free(ramp_step);
+  return(0);
+}
+#endif /* DIST_FFT */
+
+/*------------------------------------------------------------*/
+void dm_array_half_turn(dm_array_complex_struct *ptr_cas,
+			int axis)
+{
+  dm_array_real swap_re, swap_im;
+  dm_array_index_t stride[3], this_index, that_index;
+  int n[3], a_axis, b_axis, ia, ib, i_axis, ja, jb;
+
+  n[0] = (int)ptr_cas->nx;
+  n[1] = (int)ptr_cas->ny;
+  n[2] = (int)ptr_cas->nz;
+  stride[0] = 1;
+  stride[1] = (dm_array_index_t)n[0];
+  stride[2] = (dm_array_index_t)n[0]*n[1];
+  a_axis = (axis+1) % 3;
+  b_axis = (axis+2) % 3;
+
+  /* Pixel i goes to 2*(n/2)-i (modulo n) along both axes, which 
+   * turns the array about n/2. Each pair is swapped once, from the 
+   * pixel with the lower index.
+   */
+  for (i_axis=0; i_axis<n[axis]; i_axis++) {
+    for (ib=0; ib<n[b_axis]; ib++) {
+      jb = (2*(n[b_axis]/2)-ib+n[b_axis]) % n[b_axis];
+      for (ia=0; ia<n[a_axis]; ia++) {
+	ja = (2*(n[a_axis]/2)-ia+n[a_axis]) % n[a_axis];
+	this_index = (dm_array_index_t)i_axis*stride[axis]+
+	  (dm_array_index_t)ib*stride[b_axis]+
+	  (dm_array_index_t)ia*stride[a_axis];
+	that_index = (dm_array_index_t)i_axis*stride[axis]+
+	  (dm_array_index_t)jb*stride[b_axis]+
+	  (dm_array_index_t)ja*stride[a_axis];
+	if (that_index <= this_index) continue;
+	swap_re = c_re(ptr_cas->complex_array,this_index);
+	swap_im = c_im(ptr_cas->complex_array,this_index);
+	c_re(ptr_cas->complex_array,this_index) = 
+	  c_re(ptr_cas->complex_array,that_index);
+	c_im(ptr_cas->complex_array,this_index) = 
+	  c_im(ptr_cas->complex_array,that_index);
+	c_re(ptr_cas->complex_array,that_index) = swap_re;
+	c_im(ptr_cas->complex_array,that_index) = swap_im;
+      }
+    }
+  }
+}
+
+/* dm_array_register() refines the peak by this factor at a time */
+#define DM_ARRAY_REGISTER_STEP 10
+
+/*------------------------------------------------------------*/
+dm_array_real dm_array_register(dm_array_complex_struct *ptr_cas_ref_ft,
+				dm_array_complex_struct *ptr_cas_ft,
+				dm_array_complex_struct *ptr_cas_scratch,
+				int upsample,
+				double *shift)
+{
+  dm_array_complex_struct *ptr_corr;
+  dm_array_real ref_re, ref_im, ft_re, ft_im;
+  double local_sums[3], global_sums[3], norm, peak, error;
+  dm_array_index_t ipix, ipix_max, global_offset;
+  int peak_index[3];
+  int p, my_rank, i_axis, up_done, up_level;
+#if USE_MPI
+  struct {
+    double value;
+    int rank;
+  } local_max, global_max;
+#else
+  struct {
+    double value;
+  } local_max;
+#endif /* USE_MPI */
+
+  ptr_corr = ptr_cas_scratch;
+#if USE_MPI
+  MPI_Comm_size(MPI_COMM_WORLD,&p);
+  MPI_Comm_rank(MPI_COMM_WORLD,&my_rank);
+#else
+  p = 1;
+  my_rank = 0;
+#endif /* USE_MPI */
+  global_offset = (dm_array_index_t)my_rank*ptr_corr->local_npix;
+
+  /* Cross-power spectrum, and the powers for the error */
+  local_sums[0] = 0.;
+  local_sums[1] = 0.;
+  for (ipix=0; ipix<ptr_corr->local_npix; ipix++) {
+    ref_re = c_re(ptr_cas_ref_ft->complex_array,ipix);
+    ref_im = c_im(ptr_cas_ref_ft->complex_array,ipix);
+    ft_re = c_re(ptr_cas_ft->complex_array,ipix);
+    ft_im = c_im(ptr_cas_ft->complex_array,ipix);
+    c_re(ptr_corr->complex_array,ipix) = ref_re*ft_re+ref_im*ft_im;
+    c_im(ptr_corr->complex_array,ipix) = ref_im*ft_re-ref_re*ft_im;
+    local_sums[0] += (double)ref_re*ref_re+(double)ref_im*ref_im;
+    local_sums[1] += (double)ft_re*ft_re+(double)ft_im*ft_im;
+  }
+  dm_array_fft(ptr_corr,p,DM_ARRAY_INVERSE_FFT,my_rank);
+
+  /* Whole pixel peak */
+  local_max.value = -1.;
+  ipix_max = 0;
+  for (ipix=0; ipix<ptr_corr->local_npix; ipix++) {
+    norm = (double)c_re(ptr_corr->complex_array,ipix)*
+      c_re(ptr_corr->complex_array,ipix)+
+      (double)c_im(ptr_corr->complex_array,ipix)*
+      c_im(ptr_corr->complex_array,ipix);
+    if (norm > local_max.value) {
+      local_max.value = norm;
+      ipix_max = ipix;
+    }
+  }
+  dm_array_fft_frequency(ptr_corr,global_offset+ipix_max,peak_index);
+  /* dm_array_fft() scales by 1/sqrt(npix) */
+  local_sums[2] = local_max.value*(double)ptr_corr->npix;
+#if USE_MPI
+  local_max.rank = my_rank;
+  MPI_Allreduce(&local_max,&global_max,1,MPI_DOUBLE_INT,MPI_MAXLOC,
+		MPI_COMM_WORLD);
+  MPI_Bcast(peak_index,3,MPI_INT,global_max.rank,MPI_COMM_WORLD);
+  MPI_Bcast(local_sums+2,1,MPI_DOUBLE,global_max.rank,MPI_COMM_WORLD);
+  MPI_Allreduce(local_sums,global_sums,2,MPI_DOUBLE,MPI_SUM,
+		MPI_COMM_WORLD);
+#else
+  global_sums[0] = local_sums[0];
+  global_sums[1] = local_sums[1];
+#endif /* USE_MPI */
+  peak = local_sums[2];
+  for (i_axis=0; i_axis<3; i_axis++) {
+    *(shift+i_axis) = (double)peak_index[i_axis];
+  }
+
+  /* Refine DM_ARRAY_REGISTER_STEP times at a time, each time over 
+   * 1.5 steps of the grid before around the best point so far. That
+   * keeps every grid small: with upsample 100 two grids of 17 points
+   * per axis, instead of one of 151.
+   */
+  up_done = 1;
+  while (up_done < upsample) {
+    up_level = up_done*DM_ARRAY_REGISTER_STEP;
+    if (up_level > upsample) up_level = upsample;
+    dm_array_register_dft(ptr_cas_ref_ft,ptr_cas_ft,global_offset,
+			  shift,(int)ceil(0.75*up_level/up_done),
+			  1./(double)up_level,&peak);
+    up_done = up_level;
+  }
+
+  /* Keep the shifts within half the array either way */
+  for (i_axis=0; i_axis<3; i_axis++) {
+    norm = (i_axis == 0) ? (double)ptr_corr->nx :
+      ((i_axis == 1) ? (double)ptr_corr->ny : (double)ptr_corr->nz);
+    if (*(shift+i_axis) > 0.5*norm) *(shift+i_axis) -= norm;
+    if (*(shift+i_axis) < -0.5*norm) *(shift+i_axis) += norm;
+  }
+
+  error = ((global_sums[0] > 0.) && (global_sums[1] > 0.)) ?
+    1.-peak/(global_sums[0]*global_sums[1]) : 0.;
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  return((dm_array_real)((error > 0.) ? sqrt(error) : 0.));
+}
+
+/*------------------------------------------------------------*/
+void dm_array_register_dft(dm_array_complex_struct *ptr_cas_ref_ft,
+			   dm_array_complex_struct *ptr_cas_ft,
+			   dm_array_index_t global_offset,
+			   double *center,
+			   int half_width,
+			   double step,
+			   double *ptr_peak)
+{
+  dm_array_real ref_re, ref_im, ft_re, ft_im;
+  double *kernels[3], *row, *plane, *local_dft, *global_dft;
+  double two_pi, norm, position, x_re, x_im, k_re, k_im;
+  dm_array_index_t ipix, global_index, n_dft, i_dft, i_max;
+  int n[3], n_up[3], index[3], last_index[3];
+  int i_axis, i, u, v, w;
+
+  two_pi = 8.*atan(1.);
+  n[0] = (int)ptr_cas_ft->nx;
+  n[1] = (int)ptr_cas_ft->ny;
+  n[2] = (int)ptr_cas_ft->nz;
+
+  /* kernels[i_axis] holds exp(2 pi i k x/n) for each frequency k 
+   * along the axis (the slow index) and grid point x (the fast one).
+   */
+  n_dft = 1;
+  for (i_axis=0; i_axis<3; i_axis++) {
+    n_up[i_axis] = (n[i_axis] > 1) ? 2*half_width+1 : 1;
+    n_dft *= n_up[i_axis];
+    kernels[i_axis] = (double *)malloc(2*n[i_axis]*n_up[i_axis]*
+				       sizeof(double));
+    for (i=0; i<n[i_axis]; i++) {
+      index[i_axis] = (i < (n[i_axis]+1)/2) ? i : i-n[i_axis];
+      for (u=0; u<n_up[i_axis]; u++) {
+	position = (n[i_axis] > 1) ? 
+	  *(center+i_axis)+(double)(u-half_width)*step : 0.;
+	*(kernels[i_axis]+2*(i*n_up[i_axis]+u)) = 
+	  cos(two_pi*index[i_axis]*position/(double)n[i_axis]);
+	*(kernels[i_axis]+2*(i*n_up[i_axis]+u)+1) = 
+	  sin(two_pi*index[i_axis]*position/(double)n[i_axis]);
+      }
+    }
+  }
+  row = (double *)calloc(2*n_up[0],sizeof(double));
+  plane = (double *)calloc(2*n_up[0]*n_up[1],sizeof(double));
+  local_dft = (double *)calloc(2*n_dft,sizeof(double));
+  global_dft = (double *)malloc(2*n_dft*sizeof(double));
+
+  for (ipix=0; ipix<ptr_cas_ft->local_npix; ipix++) {
+    ref_re = c_re(ptr_cas_ref_ft->complex_array,ipix);
+    ref_im = c_im(ptr_cas_ref_ft->complex_array,ipix);
+    ft_re = c_re(ptr_cas_ft->complex_array,ipix);
+    ft_im = c_im(ptr_cas_ft->complex_array,ipix);
+    x_re = (double)ref_re*ft_re+(double)ref_im*ft_im;
+    x_im = (double)ref_im*ft_re-(double)ref_re*ft_im;
+
+    global_index = global_offset+ipix;
+    index[0] = (int)(global_index % n[0]);
+    index[1] = (int)((global_index/n[0]) % n[1]);
+    index[2] = (int)(global_index/((dm_array_index_t)n[0]*n[1]));
+    for (u=0; u<n_up[0]; u++) {
+      k_re = *(kernels[0]+2*(index[0]*n_up[0]+u));
+      k_im = *(kernels[0]+2*(index[0]*n_up[0]+u)+1);
+      *(row+2*u) += k_re*x_re-k_im*x_im;
+      *(row+2*u+1) += k_re*x_im+k_im*x_re;
+    }
+
+    /* Fold the row into the plane at the end of each row, and the
+     * plane into the result at the end of each plane.
+     */
+    last_index[1] = index[1];
+    last_index[2] = index[2];
+    global_index++;
+    if ((ipix+1 < ptr_cas_ft->local_npix) && 
+	((global_index % n[0]) != 0)) continue;
+    for (v=0; v<n_up[1]; v++) {
+      k_re = *(kernels[1]+2*(last_index[1]*n_up[1]+v));
+      k_im = *(kernels[1]+2*(last_index[1]*n_up[1]+v)+1);
+      for (u=0; u<n_up[0]; u++) {
+	*(plane+2*(v*n_up[0]+u)) += 
+	  k_re*(*(row+2*u))-k_im*(*(row+2*u+1));
+	*(plane+2*(v*n_up[0]+u)+1) += 
+	  k_re*(*(row+2*u+1))+k_im*(*(row+2*u));
+      }
+    }
+    memset(row,0,2*n_up[0]*sizeof(double));
+    if ((ipix+1 < ptr_cas_ft->local_npix) && 
+	((global_index % ((dm_array_index_t)n[0]*n[1])) != 0)) continue;
+    for (w=0; w<n_up[2]; w++) {
+      k_re = *(kernels[2]+2*(last_index[2]*n_up[2]+w));
+      k_im = *(kernels[2]+2*(last_index[2]*n_up[2]+w)+1);
+      for (i=0; i<n_up[0]*n_up[1]; i++) {
+	*(local_dft+2*(w*n_up[0]*n_up[1]+i)) += 
+	  k_re*(*(plane+2*i))-k_im*(*(plane+2*i+1));
+	*(local_dft+2*(w*n_up[0]*n_up[1]+i)+1) += 
+	  k_re*(*(plane+2*i+1))+k_im*(*(plane+2*i));
+      }
+    }
+    memset(plane,0,2*n_up[0]*n_up[1]*sizeof(double));
+  }
+
+#if USE_MPI
+  MPI_Allreduce(local_dft,global_dft,2*n_dft,MPI_DOUBLE,MPI_SUM,
+		MPI_COMM_WORLD);
+#else
+  memcpy(global_dft,local_dft,2*n_dft*sizeof(double));
+#endif /* USE_MPI */
+
+  i_max = 0;
+  *ptr_peak = -1.;
+  for (i_dft=0; i_dft<n_dft; i_dft++) {
+    norm = (*(global_dft+2*i_dft))*(*(global_dft+2*i_dft))+
+      (*(global_dft+2*i_dft+1))*(*(global_dft+2*i_dft+1));
+    if (norm > *ptr_peak) {
+      *ptr_peak = norm;
+      i_max = i_dft;
+    }
+  }
+  index[0] = (int)(i_max % n_up[0]);
+  index[1] = (int)((i_max/n_up[0]) % n_up[1]);
+  index[2] = (int)(i_max/(n_up[0]*n_up[1]));
+  for (i_axis=0; i_axis<3; i_axis++) {
+    if (n[i_axis] > 1) {
+      *(center+i_axis) += (double)(index[i_axis]-half_width)*step;
+    }
+  }
+
+  for (i_axis=0; i_axis<3; i_axis++) free(kernels[i_axis]);
+  free(row);
+  free(plane);
+  free(local_dft);
+  free(global_dft);
+}
+
+/*------------------------------------------------------------*/
+int dm_array_average_init(dm_array_average_struct *ptr_average,
+			  dm_array_complex_struct *ptr_cas_template,
+			  int fft_options,
+			  int p,
+			  int my_rank)
+{
+  dm_array_complex_struct *ptr_cas;
+  dm_array_real_struct *ptr_ras;
+  int i_array;
+
+  ptr_average->n_added = 0;
+  ptr_average->p = p;
+  ptr_average->my_rank = my_rank;
+
+  for (i_array=0; i_array<3; i_array++) {
+    ptr_cas = (i_array == 0) ? &(ptr_average->fourier_sum) :
+      ((i_array == 1) ? &(ptr_average->scratch) : 
+       &(ptr_average->correlation));
+    ptr_cas->nx = ptr_cas_template->nx;
+    ptr_cas->ny = ptr_cas_template->ny;
+    ptr_cas->nz = ptr_cas_template->nz;
+    ptr_cas->npix = ptr_cas_template->npix;
+    DM_ARRAY_COMPLEX_STRUCT_INIT(ptr_cas,ptr_cas->npix,p);
+    ptr_cas->local_offset = (dm_array_index_t)my_rank*ptr_cas->local_npix;
+  }
+  for (i_array=0; i_array<2; i_array++) {
+    ptr_ras = (i_array == 0) ? &(ptr_average->magnitude_sum) :
+      &(ptr_average->intensity_sum);
+    ptr_ras->nx = ptr_cas_template->nx;
+    ptr_ras->ny = ptr_cas_template->ny;
+    ptr_ras->nz = ptr_cas_template->nz;
+    ptr_ras->npix = ptr_cas_template->npix;
+    DM_ARRAY_REAL_STRUCT_INIT(ptr_ras,ptr_ras->npix,p);
+  }
+  if ((ptr_average->fourier_sum.complex_array == NULL) ||
+      (ptr_average->scratch.complex_array == NULL) ||
+      (ptr_average->correlation.complex_array == NULL) ||
+      (ptr_average->magnitude_sum.real_array == NULL) ||
+      (ptr_average->intensity_sum.real_array == NULL)) return(-1);
+
+  dm_array_zero_complex(&(ptr_average->fourier_sum));
+  dm_array_zero_complex(&(ptr_average->scratch));
+  dm_array_zero_real(&(ptr_average->magnitude_sum));
+  dm_array_zero_real(&(ptr_average->intensity_sum));
+
+  /* One pair of plans does for both work arrays */
+  dm_array_fft(&(ptr_average->scratch),p,
+	       DM_ARRAY_CREATE_FFT_PLAN | fft_options,my_rank);
+  ptr_average->correlation.ptr_forward_plan = 
+    ptr_average->scratch.ptr_forward_plan;
+  ptr_average->correlation.ptr_inverse_plan = 
+    ptr_average->scratch.ptr_inverse_plan;
+
+  return(0);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_average_add(dm_array_average_struct *ptr_average,
+			  dm_array_complex_struct *ptr_cas,
+			  int upsample,
+			  double *shift)
+{
+  dm_array_complex_struct *ptr_sum, *ptr_new;
+  dm_array_real sum_re, sum_im, new_re, new_im, rot_re, rot_im;
+  dm_array_real magnitude;
+  double local_sums[3], global_sums[3], phase;
+  double this_shift[3];
+  dm_array_index_t ipix;
+  int p, my_rank;
+
+  ptr_sum = &(ptr_average->fourier_sum);
+  ptr_new = &(ptr_average->scratch);
+  p = ptr_average->p;
+  my_rank = ptr_average->my_rank;
+
+  dm_array_copy_complex(ptr_new,ptr_cas);
+  dm_array_fft(ptr_new,p,DM_ARRAY_FORWARD_FFT,my_rank);
+  this_shift[0] = 0.;
+  this_shift[1] = 0.;
+  this_shift[2] = 0.;
+
+  if (ptr_average->n_added > 0) {
+    dm_array_register(ptr_sum,ptr_new,&(ptr_average->correlation),
+		      upsample,this_shift);
+
+    /* Shift, then take the global phase off relative to the sum.
+     * A process that could not make its ramp says so in the third
+     * sum, so that none of them add the iterate.
+     */
+    local_sums[2] = (dm_array_phase_ramp(ptr_new,this_shift,1.) != 0);
+    local_sums[0] = 0.;
+    local_sums[1] = 0.;
+    for (ipix=0; ipix<ptr_new->local_npix; ipix++) {
+      sum_re = c_re(ptr_sum->complex_array,ipix);
+      sum_im = c_im(ptr_sum->complex_array,ipix);
+      new_re = c_re(ptr_new->complex_array,ipix);
+      new_im = c_im(ptr_new->complex_array,ipix);
+      local_sums[0] += (double)sum_re*new_re+(double)sum_im*new_im;
+      local_sums[1] += (double)sum_re*new_im-(double)sum_im*new_re;
+    }
+#if USE_MPI
+    MPI_Allreduce(local_sums,global_sums,3,MPI_DOUBLE,MPI_SUM,
+		  MPI_COMM_WORLD);
+#else
+    global_sums[0] = local_sums[0];
+    global_sums[1] = local_sums[1];
+    global_sums[2] = local_sums[2];
+#endif /* USE_MPI */
+    if (global_sums[2] != 0.) return;
+    if ((global_sums[0] != 0.) || (global_sums[1] != 0.)) {
+      phase = atan2(global_sums[1],global_sums[0]);
+      rot_re = (dm_array_real)cos(phase);
+      rot_im = (dm_array_real)(-sin(phase));
+      for (ipix=0; ipix<ptr_new->local_npix; ipix++) {
+	new_re = c_re(ptr_new->complex_array,ipix);
+	new_im = c_im(ptr_new->complex_array,ipix);
+	c_re(ptr_new->complex_array,ipix) = new_re*rot_re-new_im*rot_im;
+	c_im(ptr_new->complex_array,ipix) = new_re*rot_im+new_im*rot_re;
+      }
+    }
+  }
+
+  for (ipix=0; ipix<ptr_new->local_npix; ipix++) {
+    new_re = c_re(ptr_new->complex_array,ipix);
+    new_im = c_im(ptr_new->complex_array,ipix);
+    c_re(ptr_sum->complex_array,ipix) += new_re;
+    c_im(ptr_sum->complex_array,ipix) += new_im;
+    magnitude = (dm_array_real)sqrt(new_re*new_re+new_im*new_im);
+    *(ptr_average->magnitude_sum.real_array+ipix) += magnitude;
+    *(ptr_average->intensity_sum.real_array+ipix) += magnitude*magnitude;
+  }
+  ptr_average->n_added++;
+
+  if (shift != NULL) {
+    *(shift+0) = this_shift[0];
+    *(shift+1) = this_shift[1];
+    *(shift+2) = this_shift[2];
+  }
+
+#if USE_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif /* USE_MPI */
+}
+
+/*------------------------------------------------------------*/
+void dm_array_average_get(dm_array_average_struct *ptr_average,
+			  dm_array_complex_struct *ptr_cas_average,
+			  dm_array_real_struct *ptr_ras_mag_mean,
+			  dm_array_real_struct *ptr_ras_mag_sigma)
+{
+  dm_array_real norm, mean, variance;
+  dm_array_index_t ipix;
+
+  if (ptr_average->n_added < 1) return;
+  norm = 1./(dm_array_real)ptr_average->n_added;
+
+  if (ptr_cas_average != NULL) {
+    dm_array_copy_complex(&(ptr_average->scratch),
+			  &(ptr_average->fourier_sum));
+    dm_array_multiply_real_scalar(&(ptr_average->scratch),norm);
+    dm_array_fft(&(ptr_average->scratch),ptr_average->p,
+		 DM_ARRAY_INVERSE_FFT,ptr_average->my_rank);
+    dm_array_copy_complex(ptr_cas_average,&(ptr_average->scratch));
+  }
+
+  for (ipix=0; ipix<ptr_average->magnitude_sum.local_npix; ipix++) {
+    mean = norm*(*(ptr_average->magnitude_sum.real_array+ipix));
+    if (ptr_ras_mag_mean != NULL) {
+      *(ptr_ras_mag_mean->real_array+ipix) = mean;
+    }
+    if (ptr_ras_mag_sigma != NULL) {
+      variance = norm*(*(ptr_average->intensity_sum.real_array+ipix))-
+	mean*mean;
+      *(ptr_ras_mag_sigma->real_array+ipix) = 
+	(variance > 0.) ? (dm_array_real)sqrt(variance) : 0.;
+    }
+  }
+}
+
+/*------------------------------------------------------------*/
+void dm_array_average_prtf(dm_array_average_struct *ptr_average,
+			   dm_array_real_struct *ptr_ras_mags,
+			   int n_bins,
+			   dm_array_real *prtf,
+			   double *counts)
+{
+  dm_array_complex_struct *ptr_sum;
+  double *local_sums, *global_sums;
+  double q, ratio, denominator;
+  dm_array_index_t ipix;
+  int frequency[3], i_bin;
+
+  if (n_bins < 1) return;
+  ptr_sum = &(ptr_average->fourier_sum);
+
+  /* Sums of the ratio in the first n_bins entries, counts after */
+  local_sums = (double *)calloc(2*n_bins,sizeof(double));
+  global_sums = (double *)malloc(2*n_bins*sizeof(double));
+
+  if (ptr_average->n_added > 0) {
+    for (ipix=0; ipix<ptr_sum->local_npix; ipix++) {
+      if (ptr_ras_mags != NULL) {
+	denominator = (double)ptr_average->n_added*
+	  (*(ptr_ras_mags->real_array+ipix));
+      } else {
+	denominator = *(ptr_average->magnitude_sum.real_array+ipix);
+      }
+      if (denominator <= 0.) continue;
+
+      dm_array_fft_frequency(ptr_sum,ptr_sum->local_offset+ipix,frequency);
+      q = sqrt(((double)frequency[0]*frequency[0])/
+	       ((double)ptr_sum->nx*ptr_sum->nx)+
+	       ((double)frequency[1]*frequency[1])/
+	       ((double)ptr_sum->ny*ptr_sum->ny)+
+	       ((double)frequency[2]*frequency[2])/
+	       ((double)ptr_sum->nz*ptr_sum->nz));
+      i_bin = (int)(2.*q*(double)n_bins);
+      if (i_bin >= n_bins) continue;
+
+      ratio = sqrt((double)c_re(ptr_sum->complex_array,ipix)*
+		   c_re(ptr_sum->complex_array,ipix)+
+		   (double)c_im(ptr_sum->complex_array,ipix)*
+		   c_im(ptr_sum->complex_array,ipix))/denominator;
+      *(local_sums+i_bin) += ratio;
+      *(local_sums+n_bins+i_bin) += 1.;
+    }
+  }
+
+#if USE_MPI
+  MPI_Allreduce(local_sums,global_sums,2*n_bins,MPI_DOUBLE,MPI_SUM,
+		MPI_COMM_WORLD);
+#else
+  memcpy(global_sums,local_sums,2*n_bins*sizeof(double));
+#endif /* USE_MPI */
+
+  for (i_bin=0; i_bin<n_bins; i_bin++) {
+    *(prtf+i_bin) = (*(global_sums+n_bins+i_bin) > 0.) ?
+      (dm_array_real)(*(global_sums+i_bin)/(*(global_sums+n_bins+i_bin))) :
+      0.;
+    if (counts != NULL) *(counts+i_bin) = *(global_sums+n_bins+i_bin);
+  }
+
+  free(local_sums);
+  free(global_sums);
+}
+
+/*------------------------------------------------------------*/
+void dm_array_average_free(dm_array_average_struct *ptr_average)
+{
+  dm_array_fft(&(ptr_average->scratch),ptr_average->p,
+	       DM_ARRAY_DESTROY_FFT_PLAN,ptr_average->my_rank);
+  DM_ARRAY_COMPLEX_FREE(ptr_average->fourier_sum.complex_array);
+  DM_ARRAY_COMPLEX_FREE(ptr_average->scratch.complex_array);
+  DM_ARRAY_COMPLEX_FREE(ptr_average->correlation.complex_array);
+  free(ptr_average->magnitude_sum.real_array);
+  free(ptr_average->intensity_sum.real_array);
+  ptr_average->n_added = 0;
+}
@@ -25,7 +25,246 @@ extern "C"
 #define DM_ARRAY_FFT_PATIENT (0) /* Default */
 #define DM_ARRAY_FFT_MEASURE (1<<3)
 #define DM_ARRAY_FFT_ESTIMATE (1<<4) 
+#define DM_ARRAY_FFT_UNNORMALIZED (1<<7)
 #define DM_ARRAY_STRLEN 80
+
+#define DM_ARRAY_HALO_REAL 0
+#define DM_ARRAY_HALO_BYTE 1
+#define DM_ARRAY_HALO_COMPLEX 2
+
+/* Gaussian blurs with a kernel radius (3*sigma) above this are done
+ * with three box filters instead of the kernel itself.
+ */
+#define DM_ARRAY_BLUR_MAX_DIRECT_RADIUS 8
+
+/* Median filter windows of more than this many pixels are done
+ * with a sliding window over the ranks of the values instead of a
+ * selection in each window.
+ */
+#define DM_ARRAY_MEDIAN_MAX_SELECT 27
+
+/* Accuracy levels of dm_array_phase_fast() and 
+ * dm_array_magnitude_complex_fast(). DM_ARRAY_MATH_LIBM is what 
+ * dm_array_phase() and dm_array_magnitude_complex() do.
+ */
+#define DM_ARRAY_MATH_LIBM 0
+#define DM_ARRAY_MATH_FAST 1
+#define DM_ARRAY_MATH_FASTEST 2
+
+  /* Ghost slabs (z-planes of a 3D array, rows of a 2D array or pixels
+   * of a 1D array) from the processes below and above in the slab
+   * distribution along the slowest axis. lo_array holds the last 
+   * halo_lo slabs of process my_rank-1 and hi_array the first
+   * halo_hi slabs of process my_rank+1, in the same layout as the 
+   * array itself: u_int8_t for byte arrays, dm_array_real for real
+   * arrays and two dm_array_real per pixel for complex arrays, either
+   * interleaved or (with DM_ARRAY_SPLIT) all real parts followed by
+   * all imaginary parts. halo_lo is 0 on the first process and 
+   * halo_hi on the last one, and both are 0 without MPI.
+   */
+  typedef struct {
+    void *lo_array;
+    void *hi_array;
+    int array_type;
+    int halo_width;
+    int halo_lo;
+    int halo_hi;
+    int local_slabs;
+    dm_array_index_t slab_npix;
+    int my_rank;
+    int n_requests;
+#if USE_MPI
+    MPI_Request requests[8];
+#endif /* USE_MPI */
+  } dm_array_halo_struct;
+
+  /* A value of a band of dm_array_median_ranked() and where it 
+   * came from.
+   */
+  typedef struct {
+    dm_array_real value;
+    dm_array_index_t index;
+  } dm_array_median_rank_struct;
+
+  /* One tile of dm_array_median_filter(): the slabs (z-planes, rows
+   * or pixels along the slowest axis) from slab_start to slab_stop of
+   * real_array, read from padded_array which has halo_lo extra slabs
+   * from the process below in front. The buffers are allocated by
+   * the caller: window for the selection, columns for 3x3 windows
+   * in 2D, and for ranked windows the sorted values and the ranks of
+   * bands of at most band_slabs slabs, with a bit and a count per
+   * rank in the window, counts per 64 and per 4096 ranks.
+   */
+  typedef struct {
+    dm_array_real *padded_array;
+    dm_array_real *real_array;
+    dm_array_real *window;
+    dm_array_real *columns;
+    dm_array_median_rank_struct *sorted;
+    dm_array_index_t *ranks;
+    u_int64_t *rank_bits;
+    int *word_counts;
+    int *block_counts;
+    int band_slabs;
+    int nx;
+    int ny;
+    int n_padded_slabs;
+    int halo_lo;
+    int half_width;
+    int slab_start;
+    int slab_stop;
+    dm_array_real threshold;
+    dm_array_index_t n_replaced;
+  } dm_array_median_task_struct;
+
+  /* One piece of a separable blur pass: n_blocks independent blocks
+   * block_npix apart, each of which gets n_out slabs of slab_npix
+   * pixels along the blurred axis. in_array may be read from n_lo
+   * slabs before to n_hi slabs after those, anything further out
+   * counts as zero. kernel holds 2*radius+1 weights, or is NULL for
+   * a box filter of the same width.
+   */
+  typedef struct {
+    dm_array_real *in_array;
+    dm_array_real *out_array;
+    dm_array_real *kernel;
+    int radius;
+    int n_lo;
+    int n_hi;
+    int n_out;
+    dm_array_index_t slab_npix;
+    int n_blocks;
+    dm_array_index_t block_npix;
+  } dm_array_blur_task_struct;
+
+  /* One piece of a pass of dm_array_morph_byte(): rows start to stop
+   * of the padded array are packed and done along x in pass 0, padded
+   * slabs are done along y in pass 1, and local slabs along the
+   * slowest axis in pass 2.
+   */
+  typedef struct {
+    dm_array_byte_struct *ptr_bas;
+    dm_array_halo_struct *ptr_halo;
+    u_int64_t *packed;
+    u_int64_t *result;
+    int radius;
+    int is_erode;
+    int row_length;
+    int n_words;
+    int rows_per_slab;
+    int local_slabs;
+    dm_array_index_t slab_npix;
+    size_t slab_words;
+    int pass;
+    int start;
+    int stop;
+  } dm_array_morph_task_struct;
+
+  /* A support as row-wise runs of set pixels: span i covers the
+   * span_lengths[i] local pixels from span_starts[i] on, no span 
+   * crosses the end of a row (x for 2D and 3D arrays), and n_inside
+   * is the total number of local pixels in the spans.
+   */
+  typedef struct {
+    dm_array_index_t *span_starts;
+    dm_array_index_t *span_lengths;
+    dm_array_index_t n_spans;
+    dm_array_index_t n_inside;
+    dm_array_index_t npix;
+    dm_array_index_t local_npix;
+  } dm_array_span_struct;
+
+  /* A piece of dm_array_remove_global_phase(): local pixels from
+   * pix_start to pix_stop. The first pass adds them up (only where
+   * byte_array is set if it is not NULL) into sum_re and sum_im, the
+   * second one multiplies them by (rot_re,rot_im).
+   */
+  typedef struct {
+    dm_array_complex_struct *ptr_cas;
+    u_int8_t *byte_array;
+    dm_array_index_t pix_start;
+    dm_array_index_t pix_stop;
+    int is_rotation;
+    dm_array_real rot_re;
+    dm_array_real rot_im;
+    double sum_re;
+    double sum_im;
+  } dm_array_phase_task_struct;
+
+  /* A piece of dm_array_load_separable(): local pixels from pix_start
+   * to pix_stop of an array whose first local pixel is global pixel
+   * global_offset.
+   */
+  typedef struct {
+    dm_array_complex_struct *ptr_cas;
+    dm_array_real *x_profile;
+    dm_array_real *y_profile;
+    dm_array_real *z_profile;
+    int inverse;
+    dm_array_index_t global_offset;
+    dm_array_index_t pix_start;
+    dm_array_index_t pix_stop;
+  } dm_array_separable_task_struct;
+
+  /* A piece of dm_array_rand_seeded(): local pixels from pix_start
+   * to pix_stop of an array whose first local pixel is global pixel
+   * global_offset.
+   */
+  typedef struct {
+    dm_array_complex_struct *ptr_cas;
+    int imaginary_too;
+    u_int64_t seed;
+    dm_array_index_t global_offset;
+    dm_array_index_t pix_start;
+    dm_array_index_t pix_stop;
+  } dm_array_rand_task_struct;
+
+  /* A set of n_starts reconstructions from different random starts
+   * that share the measured magnitudes, the support and one pair of
+   * FFT plans (those of iterates[0]). iterates holds the current
+   * iterate of each start and errors the Fourier space error of each
+   * in the last iteration.
+   */
+  typedef struct {
+    int n_starts;
+    dm_array_complex_struct *iterates;
+    dm_array_real *errors;
+    dm_array_real_struct *ptr_ras_mags;
+    dm_array_byte_struct *ptr_bas_support;
+    int p;
+    int my_rank;
+  } dm_array_ensemble_struct;
+
+  /* One thread of dm_array_ensemble_run(): starts first_start, 
+   * first_start+start_step and so on, with scratch as the copy of the
+   * previous iterate that the HIO update needs.
+   */
+  typedef struct {
+    dm_array_ensemble_struct *ptr_ensemble;
+    dm_array_complex_struct scratch;
+    int first_start;
+    int start_step;
+    int n_iterations;
+    dm_array_real beta;
+  } dm_array_ensemble_task_struct;
+
+  /* Running sums of iterates that have been brought into line with
+   * the first one, all kept in Fourier space (the layout that
+   * dm_array_fft() gives): fourier_sum holds the sum of the aligned
+   * transforms, magnitude_sum and intensity_sum the sums of their
+   * magnitudes and intensities, over n_added iterates. scratch and
+   * correlation are work arrays that own the FFT plans.
+   */
+  typedef struct {
+    dm_array_complex_struct fourier_sum;
+    dm_array_complex_struct scratch;
+    dm_array_complex_struct correlation;
+    dm_array_real_struct magnitude_sum;
+    dm_array_real_struct intensity_sum;
+    int n_added;
+    int p;
+    int my_rank;
+  } dm_array_average_struct;
   
   
   
@@ -73,6 +312,28 @@ extern "C"
                                       dm_array_real_struct *ptr_ras_mags,
                                       dm_array_real_struct *ptr_ras_errors,
 				      int zero_if_not_known);
+
+    /** This routine does the same as dm_array_transfer_magnitudes()
+     * and in the same pass adds up the Fourier space error of the
+     * array before the magnitudes were transferred. It returns the 
+     * sum over the known pixels of (old magnitude - new magnitude)^2
+     * divided by the sum of the squared known magnitudes, for all
+     * processes.
+     */
+    dm_array_real dm_array_transfer_magnitudes_error(dm_array_complex_struct *ptr_cas_dest, 
+						     dm_array_real_struct *ptr_ras_mags,
+						     dm_array_real_struct *ptr_ras_errors,
+						     int zero_if_not_known);
+
+    /* This internal routine does the work for both of the above. It
+     * has no branches in the pixel loop, and if ptr_sums is not NULL
+     * it returns the two sums of the error in ptr_sums[0] and [1].
+     */
+    void dm_array_transfer_magnitudes_kernel(dm_array_complex_struct *ptr_cas_dest, 
+					     dm_array_real_struct *ptr_ras_mags,
+					     dm_array_real_struct *ptr_ras_errors,
+					     int zero_if_not_known,
+					     double *ptr_sums);
     
     /** This routine subtracts the second real array from
         the first real array
@@ -147,13 +408,72 @@ extern "C"
     void dm_array_phase(dm_array_real_struct *real_array,
                         dm_array_complex_struct *complex_array);
 
+    /** These routines do the same as dm_array_phase() and
+     * dm_array_magnitude_complex() without calling libm per pixel,
+     * so that the loops can be vectorized. The phase comes from a 
+     * polynomial for atan() and the magnitude from sqrt() in 
+     * dm_array_real precision. Maximum errors against the exact
+     * result, as measured by test/dm_bench_math.c without 
+     * -ffast-math (which lets the compiler add to them):
+     *   DM_ARRAY_MATH_FAST     phase 2.3 ULP (float), 3.3 ULP (double)
+     *                          magnitude 1.2 ULP, but |z|^2 must not
+     *                          overflow since there is no scaling
+     *   DM_ARRAY_MATH_FASTEST  phase 2.4e-5 radians
+     *                          magnitude as for DM_ARRAY_MATH_FAST
+     *   DM_ARRAY_MATH_LIBM     calls dm_array_phase() or 
+     *                          dm_array_magnitude_complex()
+     * Infinities and NaNs are not handled, and the phase of (-0,0)
+     * is 0 instead of pi.
+     */
+    void dm_array_phase_fast(dm_array_real_struct *real_array,
+                             dm_array_complex_struct *complex_array,
+                             int accuracy);
+
+    void dm_array_magnitude_complex_fast(dm_array_real_struct *real_array,
+                                         dm_array_complex_struct *complex_array,
+                                         int accuracy);
+
+    /** This routine puts the magnitude of complex_array into 
+     * magnitude_array and its phase into phase_array, reading 
+     * complex_array only once. Either output can be NULL, and the
+     * results are the same as from dm_array_magnitude_complex() and
+     * dm_array_phase().
+     */
+    void dm_array_polar(dm_array_real_struct *magnitude_array,
+                        dm_array_real_struct *phase_array,
+                        dm_array_complex_struct *complex_array);
+
     /** This routine returns the global phase of complex_array */
     dm_array_real dm_array_global_phase(dm_array_complex_struct *complex_array);
 
+    /** This routine removes the global phase of complex_array in 
+     * place and returns the phase it removed. The global phase is 
+     * that of the sum of all pixels, or of the pixels inside the
+     * support if support_array is not NULL, which weights each phase 
+     * by its magnitude and does not suffer from phase wrapping the way
+     * the mean of dm_array_global_phase() does. The sum is made in one
+     * pass over the array and the rotation in a second one, both on
+     * n_threads threads. If the sum is zero nothing is changed.
+     */
+    dm_array_real dm_array_remove_global_phase(dm_array_complex_struct *complex_array,
+                                               dm_array_byte_struct *support_array,
+                                               int n_threads);
+
     /** This routine puts the intensity (square) of complex_array 
         into real_array */
     void dm_array_intensity(dm_array_real_struct *real_array,
                             dm_array_complex_struct *complex_array);
+
+    /** This routine puts the intensity of complex_array into 
+     * intensity_array and the magnitude into magnitude_array, 
+     * computing re*re+im*im once per pixel. Either output can be NULL.
+     * The magnitudes are the same as from dm_array_magnitude_complex(),
+     * while the intensities are summed in double precision and can 
+     * differ in the last bit from those of dm_array_intensity().
+     */
+    void dm_array_intensity_magnitude(dm_array_real_struct *intensity_array,
+                                      dm_array_real_struct *magnitude_array,
+                                      dm_array_complex_struct *complex_array);
   
     /** This routine zeroes a complex array */
     void dm_array_zero_complex(dm_array_complex_struct *ptr_cas);
@@ -190,10 +510,23 @@ extern "C"
 
 
     /* This routine will fill the real part of a
-       complex array with random numbers.
+       complex array (and the imaginary part if imaginary_too is set)
+       with random numbers in [0,1), seeded from the time on the
+       first process.
     **/
   void dm_array_rand(dm_array_complex_struct *ptr_cas, 
 		     int imaginary_too);
+
+    /** This routine does the same as dm_array_rand() with an explicit
+        seed and on n_threads threads. The numbers come from 
+        DM_PHILOX4X32_10() with the seed as key and the global pixel 
+        index (from local_offset) as counter, so the same seed gives
+        the same array for any number of processes and threads.
+    **/
+  void dm_array_rand_seeded(dm_array_complex_struct *ptr_cas, 
+			    int imaginary_too,
+			    u_int64_t seed,
+			    int n_threads);
     
     /** This routine fills in the array with a pure real gaussian
         function with a center at [(nx/2),(ny/2),(nz/2)].  If the 
@@ -208,6 +541,29 @@ extern "C"
 				int fft_centered,
                                 int p,
                                 int my_rank);
+
+    /** This routine fills in profile with the n values of a 1D 
+        gaussian of width sigma, centered as for 
+        dm_array_load_gaussian(). A sigma of 0 gives all ones.
+    */
+    void dm_array_gaussian_profile(dm_array_real *profile,
+                                   int n,
+                                   dm_array_real sigma,
+                                   int fft_centered);
+
+    /** This routine fills in the array with the real product
+        x_profile[ix]*y_profile[iy]*z_profile[iz], or 1 minus that if
+        inverse is set. The profiles have nx, ny and nz values for the
+        whole array and a NULL profile counts as all ones. The global
+        position of each local pixel comes from local_offset, and the
+        rows are shared out between n_threads threads.
+    */
+    void dm_array_load_separable(dm_array_complex_struct *ptr_cas,
+                                 dm_array_real *x_profile,
+                                 dm_array_real *y_profile,
+                                 dm_array_real *z_profile,
+                                 int inverse,
+                                 int n_threads);
   
     /** This routine multiplies two complex arrays element by element. 
         The first array will hold the result of the computation
@@ -222,6 +578,482 @@ extern "C"
     void dm_array_multiply_complex_byte(dm_array_complex_struct *ptr_cas,
                                         dm_array_byte_struct *ptr_bas);
 
+  /** These routines convert a byte mask (taken as 0 or non-zero) to
+      a bit mask with one bit per pixel and back again (as 0 or 1).
+  */
+  void dm_array_byte_to_bit(dm_array_bit_struct *ptr_bits,
+			    dm_array_byte_struct *ptr_bas);
+  void dm_array_bit_to_byte(dm_array_byte_struct *ptr_bas,
+			    dm_array_bit_struct *ptr_bits);
+
+  /** This routine works like dm_array_multiply_complex_byte() with a
+      bit mask: pixels outside of the mask are set to zero. Words of
+      64 pixels that are all inside or all outside are handled 
+      without looking at the bits.
+  */
+  void dm_array_multiply_complex_bit(dm_array_complex_struct *ptr_cas,
+				     dm_array_bit_struct *ptr_bits);
+
+  /** This routine works like dm_array_total_power_complex() with a 
+      bit mask instead of ptr_indices: it sums the power inside of the
+      mask, or outside of it if inverse is set, over all processes.
+  */
+  dm_array_real dm_array_total_power_complex_bit(dm_array_complex_struct *ptr_cas,
+						 dm_array_bit_struct *ptr_bits,
+						 int inverse);
+
+  /** This routine copies the pixels of the source array that lie 
+      inside of the bit mask into the destination array, and leaves
+      the other pixels of the destination alone.
+  */
+  void dm_array_copy_complex_bit(dm_array_complex_struct *ptr_cas_dest, 
+				 dm_array_complex_struct *ptr_cas_src,
+				 dm_array_bit_struct *ptr_bits);
+
+  /** This routine builds the span index of the non-zero pixels of
+      the local part of a byte mask. Free it with dm_array_span_free().
+      Returns 0, or -1 if the spans could not be allocated. 
+  */
+  int dm_array_span_init(dm_array_span_struct *ptr_spans,
+			 dm_array_byte_struct *ptr_bas);
+
+  /** This routine frees the arrays of a span index. */
+  void dm_array_span_free(dm_array_span_struct *ptr_spans);
+
+  /** These routines work like dm_array_multiply_complex_bit(), 
+      dm_array_total_power_complex_bit() and dm_array_copy_complex_bit()
+      with a span index, so that the work goes with the size of the
+      support rather than of the array. The pixels outside of the 
+      spans are cleared with memset().
+  */
+  void dm_array_multiply_complex_span(dm_array_complex_struct *ptr_cas,
+				      dm_array_span_struct *ptr_spans);
+  dm_array_real dm_array_total_power_complex_span(dm_array_complex_struct *ptr_cas,
+						  dm_array_span_struct *ptr_spans,
+						  int inverse);
+  void dm_array_copy_complex_span(dm_array_complex_struct *ptr_cas_dest, 
+				  dm_array_complex_struct *ptr_cas_src,
+				  dm_array_span_struct *ptr_spans);
+
+  /** This routine sets up halo_struct to exchange halo_width ghost
+      slabs of an array_type (DM_ARRAY_HALO_REAL, _BYTE or _COMPLEX)
+      array of size nx*ny*nz that is split up between p processes
+      with local_npix pixels each. The halo is limited to the slabs
+      held by one process. Returns 0, or -1 if the halo arrays could
+      not be allocated.
+  */
+  int dm_array_halo_init(dm_array_halo_struct *ptr_halo,
+			 int array_type,
+			 int nx, int ny, int nz,
+			 dm_array_index_t local_npix,
+			 int halo_width,
+			 int my_rank,
+			 int p);
+
+  /** These routines start the exchange of ghost slabs with 
+      non-blocking sends and receives and return straight away, so 
+      that the interior of the array can be worked on in the 
+      meantime. The array must not be changed, nor the halo arrays
+      read, until dm_array_halo_wait() has returned. Without MPI
+      they do nothing.
+  */
+  void dm_array_halo_exchange_real(dm_array_real_struct *ptr_ras,
+				   dm_array_halo_struct *ptr_halo);
+  void dm_array_halo_exchange_byte(dm_array_byte_struct *ptr_bas,
+				   dm_array_halo_struct *ptr_halo);
+  void dm_array_halo_exchange_complex(dm_array_complex_struct *ptr_cas,
+				      dm_array_halo_struct *ptr_halo);
+
+  /** This routine waits until a halo exchange has finished. */
+  void dm_array_halo_wait(dm_array_halo_struct *ptr_halo);
+
+  /** This routine frees the halo arrays of halo_struct. */
+  void dm_array_halo_free(dm_array_halo_struct *ptr_halo);
+
+  /* This internal routine posts the sends and receives of a halo
+     exchange for count_per_slab u_int8_t (if is_byte=1) or
+     dm_array_real elements per slab, from the local data starting at
+     ptr_data into the halo arrays starting at ptr_lo and ptr_hi.
+  */
+  void dm_array_halo_post(dm_array_halo_struct *ptr_halo,
+			  void *ptr_data,
+			  void *ptr_lo,
+			  void *ptr_hi,
+			  int count_per_slab,
+			  int is_byte,
+			  int tag);
+
+  /** This routine median filters a 1D, 2D or 3D real array in place
+      using the median_filter_width and median_filter_threshold of
+      adi_struct. The window is 2*(width/2)+1 pixels along each axis,
+      so an even width gives the next odd one. A pixel is replaced by
+      the median of the window around it if it differs from that
+      median by more than threshold times the median, or always if
+      the threshold is zero. Windows are clipped at the edges of the
+      array, the median of an even number of pixels is the upper
+      one, and a width below 2 does nothing. Windows of up to
+      DM_ARRAY_MEDIAN_MAX_SELECT pixels are searched for their
+      median, larger ones slide along x over the ranks of the values
+      so that the cost grows with the width rather than the size of
+      the window. The local array is split into
+      n_threads tiles, and with MPI the rows (or planes) next to
+      the local array are fetched from the neighbouring processes
+      with dm_array_halo_exchange_real(), which must each hold at
+      least width/2 of them. The number of pixels that were changed,
+      summed over all processes, goes into ptr_n_replaced if it is
+      not NULL. Returns 0, or -1 with the array unchanged if memory
+      ran out on any process.
+  */
+  int dm_array_median_filter(dm_array_real_struct *ptr_ras,
+			     dm_adi_struct *ptr_adi_struct,
+			     int n_threads,
+			     dm_array_index_t *ptr_n_replaced,
+			     int my_rank,
+			     int p);
+
+  /** This routine sets the byte array to 1 where the real array lies
+      within [saturation_min,saturation_max] of adi_struct and to 0
+      elsewhere. If saturation_max is not above saturation_min only 
+      the lower limit is applied.
+  */
+  void dm_array_saturation_mask(dm_array_byte_struct *ptr_bas,
+				dm_array_real_struct *ptr_ras,
+				dm_adi_struct *ptr_adi_struct);
+
+  /* These internal routines are used by dm_array_median_filter():
+     the tile worker, the sliding window over the ranks of a tile,
+     the ordering of values for it, a sorting network for the median
+     of 9 values, and Wirth's selection of the k-th smallest of n 
+     values.
+  */
+  void *dm_array_median_worker(void *ptr_arg);
+  dm_array_index_t dm_array_median_ranked(dm_array_median_task_struct *ptr_task);
+  int dm_array_median_compare(const void *ptr_a,
+			      const void *ptr_b);
+  dm_array_real dm_array_median9(dm_array_real *p);
+  dm_array_real dm_array_select(dm_array_real *values,
+				int n,
+				int k);
+
+  /** This routine blurs a 1D, 2D or 3D real array in place with a
+      Gaussian of the given sigma in pixels, one axis at a time. 
+      Values outside of the array count as zero. Up to a kernel radius
+      of DM_ARRAY_BLUR_MAX_DIRECT_RADIUS the kernel is applied 
+      directly; wider blurs are approximated by three box filters 
+      of the same total variance, whose cost does not grow with 
+      sigma. Each pass is shared out between n_threads threads, and 
+      with MPI the slabs needed from the neighbouring processes are 
+      fetched with dm_array_halo_exchange_real(), so each process 
+      must hold at least as many slabs as the kernel radius.
+  */
+  void dm_array_blur_real(dm_array_real_struct *ptr_ras,
+			  dm_array_real sigma,
+			  int n_threads,
+			  int my_rank,
+			  int p);
+
+  /** This routine sets the byte array to 1 where the real array is
+      at least threshold and to 0 elsewhere.
+  */
+  void dm_array_threshold_byte(dm_array_byte_struct *ptr_bas,
+			       dm_array_real_struct *ptr_ras,
+			       dm_array_real threshold);
+
+  /** These routines dilate or erode a byte array (taken as 0 or
+      non-zero, and left as 0 or 1) with a square or cube of 
+      2*radius+1 pixels on a side. Pixels outside of the array never
+      change the result. The rows are packed into 64 bit words so 
+      that each step works on 64 pixels at a time, and with MPI the 
+      neighbouring slabs come from dm_array_halo_exchange_byte(), so
+      each process must hold at least radius of them. Each pass is
+      split between n_threads threads.
+  */
+  void dm_array_dilate_byte(dm_array_byte_struct *ptr_bas,
+			    int radius,
+			    int n_threads,
+			    int my_rank,
+			    int p);
+  void dm_array_erode_byte(dm_array_byte_struct *ptr_bas,
+			   int radius,
+			   int n_threads,
+			   int my_rank,
+			   int p);
+
+  /** This routine does one shrink-wrap update of the support: the
+      magnitude of the complex iterate is put into the real scratch
+      array and blurred with sigma, after which the support is set 
+      to 1 where it reaches threshold times its maximum. The support
+      is then dilated by dilate_radius and eroded by erode_radius
+      pixels, either of which may be 0.
+  */
+  void dm_array_shrinkwrap(dm_array_byte_struct *ptr_spt,
+			   dm_array_complex_struct *ptr_cas,
+			   dm_array_real_struct *ptr_ras_scratch,
+			   dm_array_real sigma,
+			   dm_array_real threshold,
+			   int dilate_radius,
+			   int erode_radius,
+			   int n_threads,
+			   int my_rank,
+			   int p);
+
+  /** These routines run several reconstructions from random starts 
+      in one process. dm_array_ensemble_init() allocates n_starts 
+      iterates the size of the magnitudes, which must be in the layout
+      that dm_array_fft() gives, and makes one pair of FFT plans with
+      fft_options (DM_ARRAY_FFT_ESTIMATE etc.) for all of them. The
+      magnitudes and the support are only pointed to, so they are 
+      held once whatever the number of starts. It returns 0, or -1
+      if the sizes do not match or memory runs out on any process,
+      in which case nothing is left to free.
+
+      dm_array_ensemble_start() fills iterate k with random values 
+      from dm_array_rand_seeded() with seed+k inside the support, so
+      a run can be repeated exactly.
+
+      dm_array_ensemble_run() continues every iterate with 
+      n_iterations of Fienup's hybrid input-output algorithm with 
+      feedback beta, or of error reduction if beta is 0, so that for 
+      example HIO can be followed by some error reduction. The starts
+      are shared out between n_threads threads, each of which only
+      needs one extra array for HIO. With MPI the processes work 
+      through the starts together on one thread. Afterwards the 
+      iterates can be written together with their errors with 
+      dm_h5_append_itn_ensemble().
+
+      dm_array_ensemble_free() destroys the plans and the iterates.
+  */
+  int dm_array_ensemble_init(dm_array_ensemble_struct *ptr_ensemble,
+			     dm_array_real_struct *ptr_ras_mags,
+			     dm_array_byte_struct *ptr_bas_support,
+			     int n_starts,
+			     int fft_options,
+			     int p,
+			     int my_rank);
+  void dm_array_ensemble_start(dm_array_ensemble_struct *ptr_ensemble,
+			       u_int64_t seed,
+			       int n_threads);
+  void dm_array_ensemble_run(dm_array_ensemble_struct *ptr_ensemble,
+			     int n_iterations,
+			     dm_array_real beta,
+			     int n_threads);
+  void dm_array_ensemble_free(dm_array_ensemble_struct *ptr_ensemble);
+
+  /** This routine finds the shift that brings an array into line
+      with a reference from their transforms (the output of a
+      forward dm_array_fft()) ptr_cas_ref_ft and ptr_cas_ft. The 
+      shift is first found to the nearest pixel from the peak of the
+      cross-correlation, which takes one inverse FFT in 
+      ptr_cas_scratch, an array of the same size with FFT plans 
+      whose contents are overwritten. If upsample is above 1 the 
+      peak is then refined to 1/upsample pixels by evaluating the 
+      cross-correlation on finer and finer small grids around it 
+      with a matrix-multiply DFT, each pass going through the arrays 
+      once.
+
+      Shifting the array by shift (x, y and z, in pixels, between 
+      -n/2 and n/2, 0 along axes of size 1), that is taking 
+      array(r-shift), lines it up with the reference, so the values 
+      can go into xcenter_offset_pixels and ycenter_offset_pixels.
+      The routine returns the normalized root mean square error 
+      between the two after the shift and a global phase factor, 
+      between 0 and 1.
+  */
+  dm_array_real dm_array_register(dm_array_complex_struct *ptr_cas_ref_ft,
+				  dm_array_complex_struct *ptr_cas_ft,
+				  dm_array_complex_struct *ptr_cas_scratch,
+				  int upsample,
+				  double *shift);
+
+  /** These routines move and turn complex arrays by way of the 
+      Fourier transform, so that nothing is lost to interpolation.
+
+      dm_array_phase_ramp() multiplies an array in Fourier space (in
+      the layout of dm_array_fft()) by scale times the phase ramp 
+      that shifts it by shift (x, y and z, in pixels, which need not
+      be whole) in real space, that is array(r-shift). The ramp is 
+      worked out once per axis and put together a row at a time. It
+      returns 0, or -1 if there is not enough memory for the ramps,
+      in which case the array is left as it was.
+
+      dm_array_shift_complex() does the same to an array in real 
+      space, with the FFT plans it already has. The normalizations of
+      both transforms go into the ramp. It returns 0, or -1 if the
+      ramp could not be made, in which case the array comes back 
+      unshifted.
+
+      dm_array_rotate_complex() turns an array by theta radians about
+      axis 0, 1 or 2 (x, y or z; about z takes x towards y) around 
+      pixel (nx/2,ny/2,nz/2), with three shears along the other two
+      axes, each done with 1D FFTs along the lines being sheared. 
+      Turns of more than 90 degrees start with an exact half turn.
+      It returns 0, or -1 if the array is not all on this process,
+      is flat in the plane of the turn, (with DIST_FFT) there are
+      no 1D transforms to use, or there is not enough memory; in the
+      last case the array may have been turned part of the way.
+  */
+  int dm_array_phase_ramp(dm_array_complex_struct *ptr_cas,
+			  double *shift,
+			  dm_array_real scale);
+  int dm_array_shift_complex(dm_array_complex_struct *ptr_cas,
+			     double *shift,
+			     int p,
+			     int my_rank);
+  int dm_array_rotate_complex(dm_array_complex_struct *ptr_cas,
+			      int axis,
+			      double theta);
+
+  /** These routines average iterates as they come, for example 
+      those of a dm_array_ensemble_struct, without keeping them.
+      dm_array_average_init() sets up empty sums for arrays the size 
+      of ptr_cas_template and makes FFT plans with fft_options; it 
+      returns 0, or -1 if there is not enough memory.
+
+      dm_array_average_add() transforms an iterate, shifts it to line
+      up with the sum so far as found by dm_array_register() with 
+      upsample (1 for whole pixels), removes the global phase 
+      difference to the sum and adds it in. The first iterate is 
+      taken as it is. The iterate itself is not changed, and the 
+      shift found is returned in shift (x, y and z) if that is not 
+      NULL. If the shift cannot be applied for lack of memory the 
+      iterate is left out, which shows in n_added.
+
+      dm_array_average_get() puts the average of the aligned iterates
+      into ptr_cas_average, and the mean and standard deviation of 
+      their Fourier magnitudes into ptr_ras_mag_mean and 
+      ptr_ras_mag_sigma; any of them may be NULL.
+
+      dm_array_average_prtf() bins the phase retrieval transfer 
+      function |sum of F|/(n_added*|F measured|) over spatial 
+      frequency into n_bins shells of equal width from 0 to 0.5 
+      cycles per pixel (frequencies beyond that, in the corners, are 
+      left out) and returns it in prtf, which must hold n_bins 
+      values, on every process. Pixels where the measured magnitude
+      is not positive do not count. If ptr_ras_mags is NULL the 
+      average of |F| over the iterates is used instead. If counts is
+      not NULL it gets the number of pixels in each shell.
+
+      dm_array_average_free() frees the sums and destroys the plans.
+  */
+  int dm_array_average_init(dm_array_average_struct *ptr_average,
+			    dm_array_complex_struct *ptr_cas_template,
+			    int fft_options,
+			    int p,
+			    int my_rank);
+  void dm_array_average_add(dm_array_average_struct *ptr_average,
+			    dm_array_complex_struct *ptr_cas,
+			    int upsample,
+			    double *shift);
+  void dm_array_average_get(dm_array_average_struct *ptr_average,
+			    dm_array_complex_struct *ptr_cas_average,
+			    dm_array_real_struct *ptr_ras_mag_mean,
+			    dm_array_real_struct *ptr_ras_mag_sigma);
+  void dm_array_average_prtf(dm_array_average_struct *ptr_average,
+			     dm_array_real_struct *ptr_ras_mags,
+			     int n_bins,
+			     dm_array_real *prtf,
+			     double *counts);
+  void dm_array_average_free(dm_array_average_struct *ptr_average);
+
+  /* These internal routines are used by dm_array_blur_real() to 
+     run one pass along an axis on n_tasks threads, and by 
+     dm_array_dilate_byte() and dm_array_erode_byte(), which run 
+     dm_array_morph_worker() on each piece of a pass. 
+  */
+  void dm_array_blur_axis(dm_array_blur_task_struct *tasks,
+			  int n_tasks,
+			  dm_array_real *in_array,
+			  dm_array_real *out_array,
+			  dm_array_real *kernel,
+			  int radius,
+			  int n_lo,
+			  int n_hi,
+			  int n_out,
+			  dm_array_index_t slab_npix,
+			  int n_blocks,
+			  dm_array_index_t block_npix);
+  void *dm_array_blur_worker(void *ptr_arg);
+  void dm_array_morph_byte(dm_array_byte_struct *ptr_bas,
+			   int radius,
+			   int is_erode,
+			   int n_threads,
+			   int my_rank,
+			   int p);
+  void *dm_array_morph_worker(void *ptr_arg);
+
+  /* This internal routine does one pass of 
+     dm_array_remove_global_phase() over a piece of the array.
+  */
+  void *dm_array_global_phase_worker(void *ptr_arg);
+
+  /* These internal routines are used by dm_array_load_separable() and
+     dm_array_load_gaussian(), which give the global index of the 
+     first local pixel in different ways.
+  */
+  void dm_array_load_separable_offset(dm_array_complex_struct *ptr_cas,
+				      dm_array_real *x_profile,
+				      dm_array_real *y_profile,
+				      dm_array_real *z_profile,
+				      int inverse,
+				      dm_array_index_t global_offset,
+				      int n_threads);
+  void *dm_array_load_separable_worker(void *ptr_arg);
+
+  /* These internal routines are used by dm_array_rand() and
+     dm_array_rand_seeded().
+  */
+  void dm_array_rand_offset(dm_array_complex_struct *ptr_cas,
+			    int imaginary_too,
+			    u_int64_t seed,
+			    dm_array_index_t global_offset,
+			    int n_threads);
+  void *dm_array_rand_worker(void *ptr_arg);
+
+  /* This internal routine runs the starts of one thread of 
+     dm_array_ensemble_run().
+  */
+  void *dm_array_ensemble_worker(void *ptr_arg);
+
+  /* This internal routine gives the signed spatial frequencies 
+     (from -n/2 to (n-1)/2 along each axis) of global pixel 
+     global_index of an array in the layout of dm_array_fft().
+  */
+  void dm_array_fft_frequency(dm_array_complex_struct *ptr_cas,
+			      dm_array_index_t global_index,
+			      int *frequency);
+
+  /* These internal routines are used by dm_array_rotate_complex():
+     dm_array_shear_complex() shifts each line along axis by factor
+     times its distance from the middle along along_axis, with line
+     as a work array and 1D plans for it (returning -1 if its ramps
+     cannot be allocated), and dm_array_half_turn() turns the array
+     by 180 degrees about axis.
+  */
+#if !defined(DIST_FFT)
+  int dm_array_shear_complex(dm_array_complex_struct *ptr_cas,
+			     int axis,
+			     int along_axis,
+			     double factor,
+			     dm_array_complex *line,
+			     dm_fft_plan forward_plan,
+			     dm_fft_plan inverse_plan);
+#endif /* DIST_FFT */
+  void dm_array_half_turn(dm_array_complex_struct *ptr_cas,
+			  int axis);
+
+  /* This internal routine of dm_array_register() evaluates the
+     cross-correlation on a grid of 2*half_width+1 points step pixels
+     apart along each axis around center, and moves center to the 
+     highest point, whose squared magnitude goes in ptr_peak.
+  */
+  void dm_array_register_dft(dm_array_complex_struct *ptr_cas_ref_ft,
+			     dm_array_complex_struct *ptr_cas_ft,
+			     dm_array_index_t global_offset,
+			     double *center,
+			     int half_width,
+			     double step,
+			     double *ptr_peak);
+
     /** This routine does an FFT on a complex array.  It uses the
         FFTW routines by default unless you specified -DDIST_FFT at
         compile time, in which case it uses the Apple dist_fft routines.
@@ -256,7 +1088,10 @@ extern "C"
         bit-combined with creating a plan: DM_ARRAY_FFT_PATIENT (the
         default), DM_ARRAY_FFT_MEASURE, or DM_ARRAY_FFT_ESTIMATE.
         ESTIMATE is fastest to plan and slowest to execute,
-        followed by MEASURE and then PATIENT.
+        followed by MEASURE and then PATIENT. DM_ARRAY_FFT_UNNORMALIZED
+        can be bit-combined with a forward or inverse transform to 
+        leave out the 1/sqrt(nx*ny*nz) normalization, for callers that
+        fold it into a pass over the array of their own.
     */
     void dm_array_fft(dm_array_complex_struct *ptr_cas,
                       int p,
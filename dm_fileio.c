@@ -1,5 +1,8 @@
 /* This is the file dm_fileio.c */
 
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "dm.h"
 #include "dm_fileio.h"
 
@@ -83,11 +86,9 @@ int dm_h5_create_comments(hid_t h5_file_id,
   hid_t datatype, dataspace, dataset;
   hsize_t int_dims[1], comstr_dims[1];
   hsize_t max_dims[1] = {H5S_UNLIMITED};
-  hsize_t chunk_dims[1] = {ptr_comment_struct->n_strings};
+  hsize_t chunk_dims[1];
   herr_t status; 
-  hvl_t vl_comment_array[ptr_comment_struct->n_strings];
-  int i, this_strlen;
-  int offset = ptr_comment_struct->string_length;
+  hvl_t *vl_comment_array;
 
   if (my_rank == 0) {
       /*--- We'll use the int datatype and dataspace several times ---*/
@@ -180,6 +181,12 @@ int dm_h5_create_comments(hid_t h5_file_id,
           return(DM_FILEIO_FAILURE);
       }
       
+      /* Leave room in each chunk for strings appended later with
+       * dm_h5_append_comments(), so that one line at a time does not
+       * make one chunk per line.
+       */
+      chunk_dims[0] = (ptr_comment_struct->n_strings > DM_H5_COMMENT_CHUNK) ?
+          ptr_comment_struct->n_strings : DM_H5_COMMENT_CHUNK;
       if ((status = H5Pset_chunk(cre_pid,1,chunk_dims)) < 0) {
           strcpy(error_string,"H5Pset_chunk(comment_strings) error");
           H5Tclose(datatype);
@@ -201,19 +208,12 @@ int dm_h5_create_comments(hid_t h5_file_id,
           return(DM_FILEIO_FAILURE);
       }
       
-      /* Now allocate and initialize the vl_comment_array */
-      for (i=0;i<ptr_comment_struct->n_strings;i++) {
-          this_strlen = strlen(&ptr_comment_struct->string_array[i*offset]);
-          vl_comment_array[i].p = (char *)malloc(this_strlen*sizeof(char));
-          vl_comment_array[i].len = this_strlen;
-          strcpy((char *)vl_comment_array[i].p,
-                 &ptr_comment_struct->string_array[i*offset]);
-      }
-      
-      if ((status = H5Dwrite(dataset,datatype,
-                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                             vl_comment_array)) < 0) {
-          strcpy(error_string,"H5Dwrite(comment_strings) error");
+      /* The vl_comment_array entries point straight into string_array,
+       * so the comments are handed to HDF5 without copying them.
+       */
+      if ((vl_comment_array = 
+           dm_h5_comments_to_vlen(ptr_comment_struct)) == NULL) {
+          strcpy(error_string,"malloc(vl_comment_array) error");
           H5Dclose(dataset);
           H5Sclose(dataspace);
           H5Pclose(cre_pid);
@@ -222,17 +222,19 @@ int dm_h5_create_comments(hid_t h5_file_id,
           return(DM_FILEIO_FAILURE);
       }
       
-      if ((status = 
-           H5Dvlen_reclaim(datatype,dataspace,
-                           H5P_DEFAULT,vl_comment_array)) < 0) {
-          strcpy(error_string,"H5Dvlen_reclaim(comment_strings) error");
+      if ((status = H5Dwrite(dataset,datatype,
+                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                             vl_comment_array)) < 0) {
+          strcpy(error_string,"H5Dwrite(comment_strings) error");
+          free(vl_comment_array);
           H5Dclose(dataset);
           H5Sclose(dataspace);
-          H5Tclose(datatype);
           H5Pclose(cre_pid);
+          H5Tclose(datatype);
           H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
+      free(vl_comment_array);
       H5Dclose(dataset);
       H5Sclose(dataspace);
       H5Tclose(datatype);
@@ -310,12 +312,21 @@ int dm_h5_add_comments(hid_t h5_file_id,
   hid_t dataset, datatype, dataspace, memspace,xfer_pid;
   hid_t local_datatype;
   herr_t status;
-  int string_length, n_strings, i, this_strlen;
+  int string_length, n_strings;
   int new_strlen = ptr_comment_struct->string_length;
   hsize_t offset[1],newsize[1],comstr_dims[1];
-  hvl_t vl_comment_array[ptr_comment_struct->n_strings];
+  hvl_t *vl_comment_array;
   H5T_order_t local_order,file_order;
 
+  /* Get info of existing comments first. All processes have to
+   * call dm_h5_read_comments_info() because it broadcasts the result.
+   */
+  if (dm_h5_read_comments_info(h5_file_id,&n_strings,&string_length,
+                               error_string,my_rank) !=
+      DM_FILEIO_SUCCESS) {
+      return(DM_FILEIO_FAILURE);
+  }
+
   if (my_rank == 0) {
       strcpy(error_string,"");
       
@@ -328,12 +339,6 @@ int dm_h5_add_comments(hid_t h5_file_id,
       }
       H5Tclose(local_datatype);
       
-      /* Get info of existing comments first */
-      if (dm_h5_read_comments_info(h5_file_id,&n_strings,&string_length,
-                                   error_string,my_rank) !=
-          DM_FILEIO_SUCCESS) {
-          return(DM_FILEIO_FAILURE);
-      }
       offset[0] = n_strings;
       
       /* Update the stringlength if we need to */
@@ -359,7 +364,6 @@ int dm_h5_add_comments(hid_t h5_file_id,
       /* Update the string counter */
       n_strings += ptr_comment_struct->n_strings;
       newsize[0] = n_strings;
-      printf("new_strings: %d\n",n_strings);
       if ((dataset = 
            H5Dopen(h5_file_id,"/comments/n_comment_strings")) < 0) {
           strcpy(error_string,"H5Dopen(n_comment_strings) error");
@@ -375,15 +379,6 @@ int dm_h5_add_comments(hid_t h5_file_id,
       }
       H5Dclose(dataset);
       
-      /* Now allocate and initialize the vl_comment_array */
-      for (i=0;i<ptr_comment_struct->n_strings;i++) {
-          this_strlen = strlen(&ptr_comment_struct->string_array[i*new_strlen]);
-          vl_comment_array[i].p = (char *)malloc(this_strlen*sizeof(char));
-          vl_comment_array[i].len = this_strlen;
-          strcpy((char *)vl_comment_array[i].p,
-                 &(ptr_comment_struct->string_array[i*new_strlen]));
-      }
-      
       if ((dataset = 
            H5Dopen(h5_file_id,"/comments/comment_strings")) < 0) {
           strcpy(error_string,"H5Dopen(comment_strings) error");
@@ -428,20 +423,27 @@ int dm_h5_add_comments(hid_t h5_file_id,
           return(DM_FILEIO_FAILURE);
       }
 
+      if ((vl_comment_array = 
+           dm_h5_comments_to_vlen(ptr_comment_struct)) == NULL) {
+          strcpy(error_string,"malloc(vl_comment_array) error");
+          H5Dclose(dataset);
+          H5Sclose(memspace);
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+
       if ((status = H5Dwrite(dataset,datatype,memspace,dataspace,H5P_DEFAULT,
                              vl_comment_array)) < 0) {
           strcpy(error_string,"H5Dwrite(comment_strings) error");
+          free(vl_comment_array);
           H5Dclose(dataset);
           H5Sclose(memspace);
           H5Sclose(dataspace);
           H5Tclose(datatype);
           return(DM_FILEIO_FAILURE);
       }
-  
-      /* free the memory from our vl structure */
-      for (i=0;i<ptr_comment_struct->n_strings;i++) {
-          free(vl_comment_array[i].p);
-      }
+      free(vl_comment_array);
       H5Dclose(dataset);
       H5Sclose(memspace);
       H5Sclose(dataspace);
@@ -450,35 +452,270 @@ int dm_h5_add_comments(hid_t h5_file_id,
   
   return(DM_FILEIO_SUCCESS);
 }
+/*-------------------------------------------------------------------------*/
+int dm_h5_append_comment(hid_t h5_file_id,
+			 char *comment_string,
+			 char *error_string,
+			 int my_rank)
+{
+  return(dm_h5_append_comments(h5_file_id,&comment_string,1,
+			       error_string,my_rank));
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_append_comments(hid_t h5_file_id,
+			  char **comment_strings,
+			  int n_strings,
+			  char *error_string,
+			  int my_rank)
+{
+  hid_t dataset, datatype, dataspace, memspace;
+  hsize_t offset[1], count[1], newsize[1];
+  herr_t status;
+  hvl_t *vl_comment_array;
+  dm_comment_struct empty_comment_struct;
+  int i, new_string_length;
+
+  strcpy(error_string,"");
+
+  if ((my_rank == 0) && (n_strings > 0)) {
+      /* Like dm_add_string_to_comments(), keep only the first line of
+       * each string. The strings are handed to HDF5 in place.
+       */
+      if ((vl_comment_array = (hvl_t *)malloc(sizeof(hvl_t)*n_strings)) 
+          == NULL) {
+          strcpy(error_string,"malloc(vl_comment_array) error");
+          return(DM_FILEIO_FAILURE);
+      }
+      new_string_length = 1;
+      for (i=0; i<n_strings; i++) {
+          vl_comment_array[i].p = comment_strings[i];
+          vl_comment_array[i].len = strcspn(comment_strings[i],"\n\r");
+          if ((int)vl_comment_array[i].len >= new_string_length) {
+              new_string_length = vl_comment_array[i].len+1;
+          }
+      }
+
+      /* Start an empty comments group if there is none yet */
+      if ((dataset = H5Dopen(h5_file_id,"/comments/comment_strings")) < 0) {
+          empty_comment_struct.string_array = NULL;
+          empty_comment_struct.n_strings = 0;
+          empty_comment_struct.n_strings_max = 0;
+          empty_comment_struct.string_length = new_string_length;
+          empty_comment_struct.specimen_name = 
+              (char *)calloc(new_string_length,1);
+          empty_comment_struct.collection_date = 
+              (char *)calloc(new_string_length,1);
+          status = dm_h5_create_comments(h5_file_id,&empty_comment_struct,
+                                         error_string,my_rank);
+          free(empty_comment_struct.specimen_name);
+          free(empty_comment_struct.collection_date);
+          if ((status != DM_FILEIO_SUCCESS) ||
+              ((dataset = 
+                H5Dopen(h5_file_id,"/comments/comment_strings")) < 0)) {
+              if (status == DM_FILEIO_SUCCESS) {
+                  strcpy(error_string,"H5Dopen(comment_strings) error");
+              }
+              free(vl_comment_array);
+              return(DM_FILEIO_FAILURE);
+          }
+      }
+
+      /* n_comment_strings is left alone: the readers go by the size of
+       * comment_strings. comment_string_length only changes if one of
+       * the new strings is longer.
+       */
+      if (dm_h5_update_comment_string_length(h5_file_id,new_string_length,
+                                             error_string) 
+          != DM_FILEIO_SUCCESS) {
+          free(vl_comment_array);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(comment_strings) error");
+          free(vl_comment_array);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Sget_simple_extent_dims(dataspace,offset,NULL);
+      H5Sclose(dataspace);
+      
+      count[0] = n_strings;
+      newsize[0] = offset[0]+count[0];
+      if ((status = H5Dset_extent(dataset,newsize)) < 0) {
+          strcpy(error_string,"H5Dset_extent(comment_strings) error");
+          free(vl_comment_array);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(comment_strings) error");
+          free(vl_comment_array);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Sselect_hyperslab(dataspace,H5S_SELECT_SET,offset,NULL,
+                                        count,NULL)) < 0) {
+          strcpy(error_string,"H5Sselect_hyperslab(comment_strings) error");
+          free(vl_comment_array);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((memspace = H5Screate_simple(1,count,NULL)) < 0) {
+          strcpy(error_string,"H5Screate_simple(comment_strings) error");
+          free(vl_comment_array);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((datatype = H5Tvlen_create(H5T_C_S1)) < 0) {
+          strcpy(error_string,"H5Tvlen_create(comment_strings) error");
+          free(vl_comment_array);
+          H5Sclose(memspace);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      status = H5Dwrite(dataset,datatype,memspace,dataspace,H5P_DEFAULT,
+                        vl_comment_array);
+      free(vl_comment_array);
+      H5Tclose(datatype);
+      H5Sclose(memspace);
+      H5Sclose(dataspace);
+      H5Dclose(dataset);
+      if (status < 0) {
+          strcpy(error_string,"H5Dwrite(comment_strings) error");
+          return(DM_FILEIO_FAILURE);
+      }
+  } /* endif(my_rank == 0) */
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_update_comment_string_length(hid_t h5_file_id,
+				       int new_string_length,
+				       char *error_string)
+{
+  hid_t dataset;
+  herr_t status;
+  int string_length;
+
+  if ((dataset = H5Dopen(h5_file_id,"/comments/comment_string_length")) < 0) {
+    strcpy(error_string,"H5Dopen(comment_string_length) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  if ((status = H5Dread(dataset,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,
+			H5P_DEFAULT,&string_length)) < 0) {
+    strcpy(error_string,"H5Dread(comment_string_length) error");
+    H5Dclose(dataset);
+    return(DM_FILEIO_FAILURE);
+  }
+  if ((string_length < new_string_length) &&
+      ((status = H5Dwrite(dataset,H5T_NATIVE_INT,H5S_ALL,H5S_ALL,
+			  H5P_DEFAULT,&new_string_length)) < 0)) {
+    strcpy(error_string,"H5Dwrite(comment_string_length) error");
+    H5Dclose(dataset);
+    return(DM_FILEIO_FAILURE);
+  }
+  H5Dclose(dataset);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+hvl_t *dm_h5_comments_to_vlen(dm_comment_struct *ptr_comment_struct)
+{
+  hvl_t *vl_comment_array;
+  char *this_string;
+  int i;
+
+  /* Keep malloc() from returning NULL when there are no strings */
+  if ((vl_comment_array = (hvl_t *)
+       malloc(sizeof(hvl_t)*(ptr_comment_struct->n_strings+1))) == NULL) {
+    return(NULL);
+  }
+  for (i=0; i<ptr_comment_struct->n_strings; i++) {
+    this_string = ptr_comment_struct->string_array+
+      (size_t)i*ptr_comment_struct->string_length;
+    vl_comment_array[i].p = this_string;
+    vl_comment_array[i].len = strlen(this_string);
+  }
+  return(vl_comment_array);
+}
+
 /*-------------------------------------------------------------------------*/
 int dm_h5_write_ainfo(hid_t h5_file_id,
 		      dm_ainfo_struct *ptr_ainfo_struct,
 		      char *error_string,
                       int my_rank)
+{
+  return(dm_h5_write_ainfo_encoding(h5_file_id,ptr_ainfo_struct,
+                                    DM_H5_STRINGS_FIXED,
+                                    error_string,my_rank));
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_write_ainfo_packed(hid_t h5_file_id,
+			     dm_ainfo_struct *ptr_ainfo_struct,
+			     char *error_string,
+			     int my_rank)
+{
+  return(dm_h5_write_ainfo_encoding(h5_file_id,ptr_ainfo_struct,
+                                    DM_H5_STRINGS_PACKED,
+                                    error_string,my_rank));
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_write_ainfo_encoding(hid_t h5_file_id,
+			       dm_ainfo_struct *ptr_ainfo_struct,
+			       int string_encoding,
+			       char *error_string,
+			       int my_rank)
 {  
   hid_t int_datatype, int_dataspace;
   hid_t ainfo_group, attr;
-  hid_t str_datatype, str_dataspace, strarr_dataspace, dataset;
+  hid_t str_datatype, str_dataspace, dataset;
   hid_t dbl_datatype, dblarr_dataspace;
   hsize_t int_dims[1], names_dims[1], double_dims[1];
   herr_t status;                             
-  int dm_ainfo_version;
+  int dm_ainfo_version, file_string_length, i_frame, this_strlen;
+  char *this_string;
 
   if (my_rank == 0) {
-      /* Check if n_frames_max is greater than n_frames */
-      if (ptr_ainfo_struct->n_frames > ptr_ainfo_struct->n_frames_max) {
-          strcpy(error_string,
-                 "dm_h5_write_ainfo: n_frames greater than n_frames_max!");
-          return(DM_FILEIO_FAILURE);
-      }
-
-      /* Then check array sizes of ainfo_struct. Add default values 
-       * if necessary.
+      /* Check array sizes of ainfo_struct, growing them if n_frames
+       * is greater than n_frames_max. Add default values if necessary.
        */
       if (dm_check_ainfo(ptr_ainfo_struct, error_string,my_rank) !=
           DM_FILEIO_SUCCESS) {
           return(DM_FILEIO_FAILURE);
       }
+
+      /* Packed strings only take the room they need, so the
+       * string_length we store is that of the longest string.
+       */
+      file_string_length = ptr_ainfo_struct->string_length;
+      if (string_encoding == DM_H5_STRINGS_PACKED) {
+          file_string_length = strlen(ptr_ainfo_struct->file_directory)+1;
+          for (i_frame=0; i_frame<ptr_ainfo_struct->n_frames; i_frame++) {
+              this_string = ptr_ainfo_struct->filename_array+
+                  (size_t)i_frame*ptr_ainfo_struct->string_length;
+              this_strlen = strlen(this_string)+1;
+              if (this_strlen > file_string_length) {
+                  file_string_length = this_strlen;
+              }
+              this_string = ptr_ainfo_struct->systime_array+
+                  (size_t)i_frame*ptr_ainfo_struct->string_length;
+              this_strlen = strlen(this_string)+1;
+              if (this_strlen > file_string_length) {
+                  file_string_length = this_strlen;
+              }
+          }
+      }
   
       /*--- We'll use the int datatype and dataspace several times ---*/
       int_dims[0] = 1;
@@ -524,6 +761,31 @@ int dm_h5_write_ainfo(hid_t h5_file_id,
       }
       H5Aclose(attr);
 
+      /* Files with fixed-width strings carry no string_encoding, so
+       * that they stay the same as before.
+       */
+      if (string_encoding != DM_H5_STRINGS_FIXED) {
+          if ((attr = H5Acreate(ainfo_group,"string_encoding",
+                                int_datatype,int_dataspace,
+                                H5P_DEFAULT)) < 0) {
+              strcpy(error_string,"H5Acreate(string_encoding) error");
+              H5Gclose(ainfo_group);
+              H5Sclose(int_dataspace);
+              H5Tclose(int_datatype);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((status = H5Awrite(attr,int_datatype,
+                                 &string_encoding)) < 0) {
+              strcpy(error_string,"H5Awrite(string_encoding) error");
+              H5Aclose(attr);
+              H5Sclose(int_dataspace);
+              H5Tclose(int_datatype);
+              H5Gclose(ainfo_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          H5Aclose(attr);
+      }
+
       if ((dataset = H5Dcreate(ainfo_group,"string_length",
                                int_datatype,int_dataspace,
                                H5P_DEFAULT)) < 0) {
@@ -536,7 +798,7 @@ int dm_h5_write_ainfo(hid_t h5_file_id,
       }
       if ((status = H5Dwrite(dataset,int_datatype,
                              H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                             &ptr_ainfo_struct->string_length)) < 0) {
+                             &file_string_length)) < 0) {
           strcpy(error_string,"H5Dwrite(string_length) error");
           H5Dclose(dataset);
           H5Gclose(ainfo_group);
@@ -643,7 +905,7 @@ int dm_h5_write_ainfo(hid_t h5_file_id,
           return(DM_FILEIO_FAILURE);
       }
 
-      H5Tset_size(str_datatype,ptr_ainfo_struct->string_length);
+      H5Tset_size(str_datatype,file_string_length);
 
       names_dims[0] = 1;
       if ((str_dataspace = H5Screate_simple(1,names_dims,NULL)) < 0) {
@@ -676,64 +938,29 @@ int dm_h5_write_ainfo(hid_t h5_file_id,
       H5Dclose(dataset);
       H5Sclose(str_dataspace);
 
-      /* Start here with the string arrays (same datatype as file_directory)*/
-      names_dims[0] = ptr_ainfo_struct->n_frames;
-      if ((strarr_dataspace = H5Screate_simple(1,names_dims,NULL)) < 0) {
-          strcpy(error_string,"H5Screate_simple(filename_array) error");
-          H5Sclose(strarr_dataspace);
-          H5Tclose(str_datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }  
+      H5Tclose(str_datatype);
 
-      if ((dataset = H5Dcreate(ainfo_group,"filename_array",
-                               str_datatype,strarr_dataspace,
-                               H5P_DEFAULT)) < 0) {
-          strcpy(error_string,"H5Dcreate(filename_array) error");
-          H5Dclose(dataset);
-          H5Sclose(strarr_dataspace);
-          H5Tclose(str_datatype);
+      /* Start here with the string arrays */
+      if (dm_h5_write_string_array(ainfo_group,"filename_array",
+                                   ptr_ainfo_struct->filename_array,
+                                   ptr_ainfo_struct->n_frames,
+                                   ptr_ainfo_struct->string_length,
+                                   string_encoding,
+                                   error_string) != DM_FILEIO_SUCCESS) {
           H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dwrite(dataset,str_datatype,
-                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                             ptr_ainfo_struct->filename_array)) < 0) {
-          strcpy(error_string,"H5Dwrite(filename_array) error");
-          H5Dclose(dataset);
-          H5Sclose(strarr_dataspace);
-          H5Tclose(str_datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      } 
-      H5Dclose(dataset);
-  
-      /* Same datatype and dataspace for the systime array */
-      if ((dataset = H5Dcreate(ainfo_group,"systime_array",
-                               str_datatype,strarr_dataspace,
-                               H5P_DEFAULT)) < 0) {
-          strcpy(error_string,"H5Dcreate(systime_array) error");
-          H5Dclose(dataset);
-          H5Sclose(strarr_dataspace);
-          H5Tclose(str_datatype);
+      if (dm_h5_write_string_array(ainfo_group,"systime_array",
+                                   ptr_ainfo_struct->systime_array,
+                                   ptr_ainfo_struct->n_frames,
+                                   ptr_ainfo_struct->string_length,
+                                   string_encoding,
+                                   error_string) != DM_FILEIO_SUCCESS) {
           H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dwrite(dataset,str_datatype,
-                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                             ptr_ainfo_struct->systime_array)) < 0) {
-          strcpy(error_string,"H5Dwrite(systime_array) error");
-          H5Dclose(dataset);
-          H5Sclose(strarr_dataspace);
-          H5Tclose(str_datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      } 
-      H5Dclose(dataset);
-      H5Tclose(str_datatype);
-      H5Sclose(strarr_dataspace);
 
-      /* Start here with the double arrays (same dataspace as string arrays)*/
+      /* Start here with the double arrays */
       if ((dbl_datatype = H5Tcopy(H5T_NATIVE_DOUBLE)) < 0) {
           strcpy(error_string,"H5Tcopy() error");
           H5Tclose(dbl_datatype);
@@ -874,58 +1101,330 @@ int dm_h5_write_ainfo(hid_t h5_file_id,
   return(DM_FILEIO_SUCCESS);
 }
 /*-------------------------------------------------------------------------*/
-int dm_h5_write_adi(hid_t h5_file_id,
-		    dm_adi_struct *ptr_adi_struct,
-		    dm_array_real_struct *ptr_adi_array_struct,
-		    dm_array_real_struct *ptr_adi_error_array_struct,
-		    char *error_string,
-                    int my_rank,
-                    int p)
+int dm_h5_write_string_array(hid_t group_id,
+			     char *dataset_name,
+			     char *string_array,
+			     int n_strings,
+			     int string_length,
+			     int string_encoding,
+			     char *error_string)
 {
-  hid_t adi_group;
-  hid_t datatype, dataspace, dataset,local_datatype;
-  hid_t attr, cre_pid;
-  hsize_t int_dims[1], adi_struct_dims[1];
-  hsize_t *array_dims;
-  hsize_t *array_maxdims;
-  hsize_t *chunk_dims;
-  herr_t status;                             
-  int n_dims, dm_adi_version,i,exists;
-  int nx, ny, nz, error_is_present;
-  dm_adi_struct local_adi_struct;
-  htri_t equal;
-  H5T_order_t local_order, file_order;
-#if USE_MPI
-  MPI_Status mpi_status;
-  hsize_t mem_dataspace;
-  hsize_t *file_offsets,*file_counts;
-  dm_array_real *slice_array;
-#endif
-  
-  /*--- determine local order, if we update make sure we convert
-   * to file_order ---*/
-  
-  local_datatype = H5Tcopy(H5T_NATIVE_INT);
-  if ((local_order = H5Tget_order(local_datatype)) < 0) {
-      strcpy(error_string,"H5Tget_order(dm_h5_write_adi) error");
+  hid_t datatype, dataspace, dataset;
+  hsize_t dims[1], *string_offsets;
+  herr_t status;
+  size_t n_chars, this_strlen;
+  char *packed_chars, *this_string, packed_name[80];
+  int i_string;
+
+  if (string_encoding == DM_H5_STRINGS_FIXED) {
+    if ((datatype = H5Tcopy(H5T_C_S1)) < 0) {
+      sprintf(error_string,"H5Tcopy(%s) error",dataset_name);
+      return(DM_FILEIO_FAILURE);
+    }
+    H5Tset_size(datatype,string_length);
+    dims[0] = n_strings;
+    if ((dataspace = H5Screate_simple(1,dims,NULL)) < 0) {
+      sprintf(error_string,"H5Screate_simple(%s) error",dataset_name);
+      H5Tclose(datatype);
+      return(DM_FILEIO_FAILURE);
+    }
+    if ((dataset = H5Dcreate(group_id,dataset_name,datatype,dataspace,
+			     H5P_DEFAULT)) < 0) {
+      sprintf(error_string,"H5Dcreate(%s) error",dataset_name);
+      H5Sclose(dataspace);
+      H5Tclose(datatype);
+      return(DM_FILEIO_FAILURE);
+    }
+    status = H5Dwrite(dataset,datatype,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		      string_array);
+    H5Dclose(dataset);
+    H5Sclose(dataspace);
+    H5Tclose(datatype);
+    if (status < 0) {
+      sprintf(error_string,"H5Dwrite(%s) error",dataset_name);
       return(DM_FILEIO_FAILURE);
+    }
+    return(DM_FILEIO_SUCCESS);
   }
-  H5Tclose(local_datatype);
-  
-  strcpy(error_string,"");
-  
-  /* Check if file has an existing adi group.
+
+  /* Packed: all strings back to back, each with its terminating
+   * '\000', in "<dataset_name>_chars", and where each one starts
+   * in "<dataset_name>_offsets".
    */
-  exists = dm_h5_adi_group_exists(h5_file_id,my_rank);
-          
-  if (exists == 0) {
-      if (my_rank == 0) {
-          /* in this case we need to create the adi-group */
-          if (ptr_adi_array_struct->ny == 1) {
-              n_dims = 1;
-          
-              array_dims = (hsize_t *)malloc(n_dims*sizeof(hsize_t));
-              *(array_dims + 0) = ptr_adi_array_struct->nx;
+  if ((string_offsets = (hsize_t *)
+       malloc(sizeof(hsize_t)*(n_strings+1))) == NULL) {
+    sprintf(error_string,"malloc(%s offsets) error",dataset_name);
+    return(DM_FILEIO_FAILURE);
+  }
+  n_chars = 0;
+  for (i_string=0; i_string<n_strings; i_string++) {
+    string_offsets[i_string] = n_chars;
+    n_chars += strlen(string_array+(size_t)i_string*string_length)+1;
+  }
+  if ((packed_chars = (char *)malloc(n_chars+1)) == NULL) {
+    sprintf(error_string,"malloc(%s chars) error",dataset_name);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+  for (i_string=0; i_string<n_strings; i_string++) {
+    this_string = string_array+(size_t)i_string*string_length;
+    this_strlen = strlen(this_string)+1;
+    memcpy(packed_chars+string_offsets[i_string],this_string,this_strlen);
+  }
+
+  dims[0] = n_strings;
+  sprintf(packed_name,"%s_offsets",dataset_name);
+  if ((dataspace = H5Screate_simple(1,dims,NULL)) < 0) {
+    sprintf(error_string,"H5Screate_simple(%s) error",packed_name);
+    free(packed_chars);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+  if ((dataset = H5Dcreate(group_id,packed_name,H5T_NATIVE_HSIZE,dataspace,
+			   H5P_DEFAULT)) < 0) {
+    sprintf(error_string,"H5Dcreate(%s) error",packed_name);
+    H5Sclose(dataspace);
+    free(packed_chars);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+  status = H5Dwrite(dataset,H5T_NATIVE_HSIZE,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		    string_offsets);
+  H5Dclose(dataset);
+  H5Sclose(dataspace);
+  free(string_offsets);
+  if (status < 0) {
+    sprintf(error_string,"H5Dwrite(%s) error",packed_name);
+    free(packed_chars);
+    return(DM_FILEIO_FAILURE);
+  }
+
+  dims[0] = n_chars;
+  sprintf(packed_name,"%s_chars",dataset_name);
+  if ((dataspace = H5Screate_simple(1,dims,NULL)) < 0) {
+    sprintf(error_string,"H5Screate_simple(%s) error",packed_name);
+    free(packed_chars);
+    return(DM_FILEIO_FAILURE);
+  }
+  if ((dataset = H5Dcreate(group_id,packed_name,H5T_NATIVE_CHAR,dataspace,
+			   H5P_DEFAULT)) < 0) {
+    sprintf(error_string,"H5Dcreate(%s) error",packed_name);
+    H5Sclose(dataspace);
+    free(packed_chars);
+    return(DM_FILEIO_FAILURE);
+  }
+  status = H5Dwrite(dataset,H5T_NATIVE_CHAR,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		    packed_chars);
+  H5Dclose(dataset);
+  H5Sclose(dataspace);
+  free(packed_chars);
+  if (status < 0) {
+    sprintf(error_string,"H5Dwrite(%s) error",packed_name);
+    return(DM_FILEIO_FAILURE);
+  }
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_string_array(hid_t group_id,
+			    char *dataset_name,
+			    char *string_array,
+			    int n_strings,
+			    int string_length,
+			    int string_encoding,
+			    char *error_string)
+{
+  hid_t datatype, dataspace, dataset;
+  hsize_t *string_offsets;
+  hssize_t n_points;
+  herr_t status;
+  size_t n_chars, this_strlen;
+  char *packed_chars, *this_string, packed_name[80];
+  int i_string;
+
+  if (string_encoding == DM_H5_STRINGS_FIXED) {
+    if ((datatype = H5Tcopy(H5T_C_S1)) < 0) {
+      sprintf(error_string,"H5Tcopy(%s) error",dataset_name);
+      return(DM_FILEIO_FAILURE);
+    }
+    H5Tset_size(datatype,string_length);
+    if ((dataset = H5Dopen(group_id,dataset_name)) < 0) {
+      sprintf(error_string,"H5Dopen(%s) error",dataset_name);
+      H5Tclose(datatype);
+      return(DM_FILEIO_FAILURE);
+    }
+    status = H5Dread(dataset,datatype,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		     string_array);
+    H5Dclose(dataset);
+    H5Tclose(datatype);
+    if (status < 0) {
+      sprintf(error_string,"H5Dread(%s) error",dataset_name);
+      return(DM_FILEIO_FAILURE);
+    }
+    return(DM_FILEIO_SUCCESS);
+  }
+
+  /* Packed: read the offsets and the characters, then lay the
+   * strings out string_length apart.
+   */
+  sprintf(packed_name,"%s_offsets",dataset_name);
+  if ((dataset = H5Dopen(group_id,packed_name)) < 0) {
+    sprintf(error_string,"H5Dopen(%s) error",packed_name);
+    return(DM_FILEIO_FAILURE);
+  }
+  dataspace = H5Dget_space(dataset);
+  n_points = H5Sget_simple_extent_npoints(dataspace);
+  H5Sclose(dataspace);
+  if (n_points != n_strings) {
+    sprintf(error_string,"%s has %d entries instead of %d",
+	    packed_name,(int)n_points,n_strings);
+    H5Dclose(dataset);
+    return(DM_FILEIO_FAILURE);
+  }
+  if ((string_offsets = (hsize_t *)
+       malloc(sizeof(hsize_t)*(n_strings+1))) == NULL) {
+    sprintf(error_string,"malloc(%s) error",packed_name);
+    H5Dclose(dataset);
+    return(DM_FILEIO_FAILURE);
+  }
+  status = H5Dread(dataset,H5T_NATIVE_HSIZE,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		   string_offsets);
+  H5Dclose(dataset);
+  if (status < 0) {
+    sprintf(error_string,"H5Dread(%s) error",packed_name);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+
+  sprintf(packed_name,"%s_chars",dataset_name);
+  if ((dataset = H5Dopen(group_id,packed_name)) < 0) {
+    sprintf(error_string,"H5Dopen(%s) error",packed_name);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+  dataspace = H5Dget_space(dataset);
+  n_points = H5Sget_simple_extent_npoints(dataspace);
+  H5Sclose(dataspace);
+  if ((n_points < 0) ||
+      ((packed_chars = (char *)malloc(n_points+1)) == NULL)) {
+    sprintf(error_string,"malloc(%s) error",packed_name);
+    H5Dclose(dataset);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+  n_chars = n_points;
+  status = H5Dread(dataset,H5T_NATIVE_CHAR,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		   packed_chars);
+  H5Dclose(dataset);
+  if (status < 0) {
+    sprintf(error_string,"H5Dread(%s) error",packed_name);
+    free(packed_chars);
+    free(string_offsets);
+    return(DM_FILEIO_FAILURE);
+  }
+  /* Guard against a missing terminator on the last string */
+  packed_chars[n_chars] = '\000';
+
+  for (i_string=0; i_string<n_strings; i_string++) {
+    this_string = string_array+(size_t)i_string*string_length;
+    memset(this_string,0,string_length);
+    if (string_offsets[i_string] < n_chars) {
+      this_strlen = strlen(packed_chars+string_offsets[i_string]);
+      if (this_strlen > (size_t)(string_length-1)) {
+	this_strlen = string_length-1;
+      }
+      memcpy(this_string,packed_chars+string_offsets[i_string],this_strlen);
+    }
+  }
+  free(packed_chars);
+  free(string_offsets);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_write_adi(hid_t h5_file_id,
+		    dm_adi_struct *ptr_adi_struct,
+		    dm_array_real_struct *ptr_adi_array_struct,
+		    dm_array_real_struct *ptr_adi_error_array_struct,
+		    char *error_string,
+                    int my_rank,
+                    int p)
+{
+  return(dm_h5_write_adi_layout(h5_file_id,ptr_adi_struct,
+                                ptr_adi_array_struct,
+                                ptr_adi_error_array_struct,0,
+                                error_string,my_rank,p));
+}
+
+/*--------------------------------------------------------------------*/
+int dm_h5_write_adi_contiguous(hid_t h5_file_id,
+                               dm_adi_struct *ptr_adi_struct,
+                               dm_array_real_struct *ptr_adi_array_struct,
+                               dm_array_real_struct *ptr_adi_error_array_struct,
+                               char *error_string,
+                               int my_rank,
+                               int p)
+{
+  return(dm_h5_write_adi_layout(h5_file_id,ptr_adi_struct,
+                                ptr_adi_array_struct,
+                                ptr_adi_error_array_struct,1,
+                                error_string,my_rank,p));
+}
+
+/*--------------------------------------------------------------------*/
+int dm_h5_write_adi_layout(hid_t h5_file_id,
+                           dm_adi_struct *ptr_adi_struct,
+                           dm_array_real_struct *ptr_adi_array_struct,
+                           dm_array_real_struct *ptr_adi_error_array_struct,
+                           int contiguous,
+                           char *error_string,
+                           int my_rank,
+                           int p)
+{
+  hid_t adi_group;
+  hid_t datatype, dataspace, dataset,local_datatype;
+  hid_t attr, cre_pid;
+  hsize_t int_dims[1], adi_struct_dims[1];
+  hsize_t *array_dims;
+  hsize_t *array_maxdims;
+  hsize_t *chunk_dims;
+  herr_t status;                             
+  int n_dims, dm_adi_version,i,exists;
+  int nx, ny, nz, error_is_present;
+  dm_adi_struct local_adi_struct;
+  htri_t equal;
+  H5T_order_t local_order, file_order;
+#if USE_MPI
+  MPI_Status mpi_status;
+  hsize_t mem_dataspace;
+  hsize_t *file_offsets,*file_counts;
+  dm_array_real *slice_array;
+#endif
+  
+  /*--- determine local order, if we update make sure we convert
+   * to file_order ---*/
+  
+  local_datatype = H5Tcopy(H5T_NATIVE_INT);
+  if ((local_order = H5Tget_order(local_datatype)) < 0) {
+      strcpy(error_string,"H5Tget_order(dm_h5_write_adi) error");
+      return(DM_FILEIO_FAILURE);
+  }
+  H5Tclose(local_datatype);
+  
+  strcpy(error_string,"");
+  
+  /* Check if file has an existing adi group.
+   */
+  exists = dm_h5_adi_group_exists(h5_file_id,my_rank);
+          
+  if (exists == 0) {
+      if (my_rank == 0) {
+          /* in this case we need to create the adi-group */
+          if (ptr_adi_array_struct->ny == 1) {
+              n_dims = 1;
+          
+              array_dims = (hsize_t *)malloc(n_dims*sizeof(hsize_t));
+              *(array_dims + 0) = ptr_adi_array_struct->nx;
           
               array_maxdims = (hsize_t *)malloc(n_dims*sizeof(hsize_t));
               *(array_maxdims + 0) = H5S_UNLIMITED;
@@ -1008,6 +1507,13 @@ int dm_h5_write_adi(hid_t h5_file_id,
 #endif
           }
       
+          /* A contiguous dataset can not be extended later */
+          if (contiguous == 1) {
+              for (i = 0; i < n_dims; i++) {
+                  *(array_maxdims + i) = *(array_dims + i);
+              }
+          }
+      
           /* Data will go into a group "/adi" in the file */
           if ((adi_group = H5Gcreate(h5_file_id,"/adi",0)) < 0) {
               strcpy(error_string,"H5Gcreate(\"/adi\") error");
@@ -1227,8 +1733,17 @@ int dm_h5_write_adi(hid_t h5_file_id,
               return(DM_FILEIO_FAILURE);
           }
       
-          if ((status = H5Pset_chunk(cre_pid,n_dims,chunk_dims)) < 0) {
-              strcpy(error_string,"H5Pset_chunk(adi_array) error");
+          if (contiguous == 1) {
+              status = H5Pset_layout(cre_pid,H5D_CONTIGUOUS);
+          } else {
+              status = H5Pset_chunk(cre_pid,n_dims,chunk_dims);
+          }
+          if (status < 0) {
+              if (contiguous == 1) {
+                  strcpy(error_string,"H5Pset_layout(adi_array) error");
+              } else {
+                  strcpy(error_string,"H5Pset_chunk(adi_array) error");
+              }
               H5Pclose(cre_pid);
               H5Sclose(dataspace);
               H5Tclose(datatype);
@@ -1581,6 +2096,16 @@ int dm_h5_write_adi(hid_t h5_file_id,
       
   } else if (exists == 1) {
 
+      /* in this case we just want to update an existing adi array.
+       * dm_h5_read_adi_info() broadcasts the array size, so all
+       * processes have to call it.
+       */
+      if (dm_h5_read_adi_info(h5_file_id,&nx,&ny,&nz,&error_is_present,
+                              &local_adi_struct,
+                              error_string,my_rank) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+
       if (my_rank == 0) {
           
           /* first update the adi_struct */
@@ -1609,12 +2134,6 @@ int dm_h5_write_adi(hid_t h5_file_id,
           H5Dclose(dataset);
           H5Tclose(datatype);
           
-          /* in this case we just want to update an existing adi array */
-          if (dm_h5_read_adi_info(h5_file_id,&nx,&ny,&nz,&error_is_present,
-                                  &local_adi_struct,
-                                  error_string,my_rank) == DM_FILEIO_FAILURE) {
-              return(DM_FILEIO_FAILURE);
-          }
       
           if ((dataset = H5Dopen(h5_file_id,"/adi/adi_array")) < 0) {
               strcpy(error_string,"H5Dopen(adi_array) error");
@@ -1794,7 +2313,7 @@ int dm_h5_write_adi(hid_t h5_file_id,
           } 
       
           /* Now see if we have to extend the dataset. */
-          if ((status = H5Dset_extent(dataset,array_dims)) < 0) {
+          if ((status = dm_h5_set_array_extent(dataset,array_dims)) < 0) {
               strcpy(error_string, "H5Dset_extent(adi_array) error");
               H5Dclose(dataset);
               H5Tclose(datatype);
@@ -2043,7 +2562,7 @@ int dm_h5_write_adi(hid_t h5_file_id,
               } 
           
               /* Now see if we have to extend the dataset. */
-              if ((status = H5Dset_extent(dataset,array_dims)) < 0) {
+              if ((status = dm_h5_set_array_extent(dataset,array_dims)) < 0) {
                   strcpy(error_string, "H5Dset_extent(adi_error_array) error");
                   H5Dclose(dataset);
                   H5Tclose(datatype);
@@ -2697,6 +3216,16 @@ int dm_h5_write_spt(hid_t h5_file_id,
       
   } else if (exists == 1) {
 
+      /* in this case we just want to update an existing spt array.
+       * dm_h5_read_spt_info() broadcasts the array size, so all
+       * processes have to call it.
+       */
+      if (dm_h5_read_spt_info(h5_file_id,&nx,&ny,&nz,
+                              &local_spt_struct,
+                              error_string,my_rank) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+
       if (my_rank == 0) {
           
           /* first update the spt_struct */
@@ -2725,12 +3254,6 @@ int dm_h5_write_spt(hid_t h5_file_id,
           H5Dclose(dataset);
           H5Tclose(datatype);
 
-          /* in this case we just want to update an existing spt array */
-          if (dm_h5_read_spt_info(h5_file_id,&nx,&ny,&nz,
-                                  &local_spt_struct,
-                                  error_string,my_rank) == DM_FILEIO_FAILURE) {
-              return(DM_FILEIO_FAILURE);
-          }
 
           if ((dataset = H5Dopen(h5_file_id,"/spt/spt_array")) < 0) {
               strcpy(error_string,"H5Dopen(spt_array) error");
@@ -3023,6 +3546,42 @@ int dm_h5_write_spt(hid_t h5_file_id,
   } /* endif(dm_h5_spt_group_exists(h5_file_id) */
 }
 
+/*-------------------------------------------------------------------------*/
+int dm_h5_write_spt_bit(hid_t h5_file_id,
+			dm_spt_struct *ptr_spt_struct,
+			dm_array_bit_struct *ptr_spt_bit_struct,
+			char *error_string,
+			int my_rank,
+			int p)
+{
+  dm_array_byte_struct spt_array_struct;
+  dm_array_index_t ipix;
+  int status;
+
+  /* The file keeps one byte per pixel, so that spt_array reads the
+   * same whichever way it was written. Only the local part of the
+   * mask is unpacked at a time.
+   */
+  spt_array_struct.nx = ptr_spt_bit_struct->nx;
+  spt_array_struct.ny = ptr_spt_bit_struct->ny;
+  spt_array_struct.nz = ptr_spt_bit_struct->nz;
+  spt_array_struct.npix = ptr_spt_bit_struct->npix;
+  spt_array_struct.local_offset = ptr_spt_bit_struct->local_offset;
+  DM_ARRAY_BYTE_STRUCT_INIT((&spt_array_struct),spt_array_struct.npix,p);
+  
+  for (ipix=0; ipix<spt_array_struct.local_npix; ipix++) {
+    *(spt_array_struct.byte_array+ipix) = 
+      (u_int8_t)((*(ptr_spt_bit_struct->bit_array+ipix/64) >> 
+		  (ipix%64)) & 1);
+  }
+
+  status = dm_h5_write_spt(h5_file_id,ptr_spt_struct,&spt_array_struct,
+			   error_string,my_rank,p);
+  free(spt_array_struct.byte_array);
+  
+  return(status);
+}
+
 /*-------------------------------------------------------------------------*/
 int dm_h5_write_itn(hid_t h5_file_id,
 		    dm_itn_struct *ptr_itn_struct,
@@ -3286,7 +3845,8 @@ int dm_h5_write_itn(hid_t h5_file_id,
               return(DM_FILEIO_FAILURE);
 	    }
 	    
-	    recon_errors_chunkdim[0] = ptr_recon_errors->npix/2;
+	    recon_errors_chunkdim[0] = (ptr_recon_errors->npix/2 > 0) ?
+	        ptr_recon_errors->npix/2 : 1;
 	    if ((status = H5Pset_chunk(cre_pid,1,recon_errors_chunkdim)) < 0) {
               strcpy(error_string,"H5Pset_chunk(recon_errors) error");
               H5Pclose(cre_pid);
@@ -3570,6 +4130,18 @@ int dm_h5_write_itn(hid_t h5_file_id,
       
   } else if ((exists = dm_h5_itn_group_exists(h5_file_id,my_rank)) == 1) {
 
+      /* Check on sizes of itn_array and recon_errors. 
+       * dm_h5_read_itn_info() broadcasts the array size, so all
+       * processes have to call it.
+       */
+      if (dm_h5_read_itn_info(h5_file_id,&nx,&ny,&nz,
+                              &recon_errors_npix,
+                              &local_itn_struct,
+                              error_string,
+                              my_rank) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+
       if (my_rank == 0) {
 	
 	/* first update the itn_struct */
@@ -3597,14 +4169,6 @@ int dm_h5_write_itn(hid_t h5_file_id,
           H5Dclose(dataset);
           H5Tclose(datatype);
 
-	  /* Check on sizes of itn_array and recon_errors */
-          if (dm_h5_read_itn_info(h5_file_id,&nx,&ny,&nz,
-				  &recon_errors_npix,
-                                  &local_itn_struct,
-                                  error_string,
-                                  my_rank) == DM_FILEIO_FAILURE) {
-              return(DM_FILEIO_FAILURE);
-          }
 
 	  /* See if we have an existing recon_errors dataset */
 	  if (recon_errors_npix == -1) {
@@ -3634,7 +4198,8 @@ int dm_h5_write_itn(hid_t h5_file_id,
 		return(DM_FILEIO_FAILURE);
 	      }
 	      
-	      recon_errors_chunkdim[0] = ptr_recon_errors->npix/2;
+	      recon_errors_chunkdim[0] = (ptr_recon_errors->npix/2 > 0) ?
+	          ptr_recon_errors->npix/2 : 1;
 	      if ((status = H5Pset_chunk(cre_pid,1,recon_errors_chunkdim)) < 0) {
 		strcpy(error_string,"H5Pset_chunk(recon_errors) error");
 		H5Pclose(cre_pid);
@@ -4194,3168 +4759,5529 @@ int dm_h5_write_itn(hid_t h5_file_id,
 }
 
 /*-------------------------------------------------------------------------*/
-int dm_h5_adi_group_exists(hid_t h5_file_id,int my_rank)
+int dm_h5_append_itn_history(hid_t h5_file_id,
+			     dm_itn_struct *ptr_itn_struct,
+			     dm_array_complex_struct *ptr_itn_array_struct,
+			     dm_array_real recon_error,
+			     char *error_string,
+			     int my_rank,
+			     int p)
 {
-  hid_t adi_group;
-  int exists;
-  
-  if (my_rank == 0) {
-      adi_group = H5Gopen(h5_file_id,"/adi");
-      H5Gclose(adi_group);
-      if (adi_group < 0) {
-          exists = 0;
-      } else {
-          exists = 1;
-      }
-  } /* endif(my_rank == 0) */
-
+  hid_t history_group;
+  hid_t datatype, dataspace, dataset, cre_pid;
+  hid_t file_dataspace, memory_dataspace;
+  hid_t attr;
+  hsize_t int_dims[1], itn_struct_dims[1];
+  hsize_t file_dims[5], array_maxdims[5], chunk_dims[5];
+  hsize_t memory_dims[5], file_offsets[5], file_counts[5];
+  hsize_t old_dims[5], i_iterate;
+  herr_t status;
+  int i, exists, n_dims, old_n_dims, islab, n_slabs;
+  int dm_itn_history_version;
+  dm_array_index_t ipix, slab_npix, slab_offset;
+  dm_array_real *slice_array;
 #if USE_MPI
-   MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Status mpi_status;
+#if DM_ARRAY_SPLIT
+  dm_array_real *temp_re,*temp_im;
+#endif
 #endif
-      
-  if (exists == 0) {
-    return(0);
-  } else {
-    return(1);
-  }
-}
-
-/*-------------------------------------------------------------------------*/
-int dm_h5_ads_group_exists(hid_t h5_file_id,int my_rank)
-{
-  hid_t ads_group;
-  int exists;
-
-  if (my_rank == 0) {
-      ads_group = H5Gopen(h5_file_id,"/ads");
-      H5Gclose(ads_group);
 
-      if (ads_group < 0) {
-          exists = 0;
-      } else {
-          exists = 1;
-      }
-  } /* endif(my_rank == 0) */
+  strcpy(error_string,"");
 
-#if USE_MPI
-   MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif
-   
-  if (exists == 0) {
-    return(0);
+  /* The history array has the same layout as "/itn/itn_array" with
+   * an additional leading dimension that counts the iterates. The
+   * leading dimension starts out at zero and is extended by one
+   * for every call.
+   */
+  if (ptr_itn_array_struct->ny == 1) {
+      n_dims = 3;
+      file_dims[1] = ptr_itn_array_struct->nx;
+      file_dims[2] = 2;
+  } else if (ptr_itn_array_struct->nz == 1) {
+      n_dims = 4;
+      file_dims[1] = ptr_itn_array_struct->ny;
+      file_dims[2] = ptr_itn_array_struct->nx;
+      file_dims[3] = 2;
   } else {
-    return(1);
+      n_dims = 5;
+      file_dims[1] = ptr_itn_array_struct->nz;
+      file_dims[2] = ptr_itn_array_struct->ny;
+      file_dims[3] = ptr_itn_array_struct->nx;
+      file_dims[4] = 2;
+  }
+  file_dims[0] = 0;
+  array_maxdims[0] = H5S_UNLIMITED;
+  chunk_dims[0] = 1;
+  memory_dims[0] = 1;
+  file_counts[0] = 1;
+  for (i=1; i<n_dims; i++) {
+      array_maxdims[i] = file_dims[i];
+      chunk_dims[i] = file_dims[i];
+      memory_dims[i] = file_dims[i];
+      file_counts[i] = file_dims[i];
+      file_offsets[i] = 0;
+  }
+  /* One chunk per z-slice keeps the chunks small for 3D arrays */
+  if (n_dims == 5) {
+      chunk_dims[1] = 1;
   }
-}
-
-/*-------------------------------------------------------------------------*/
-int dm_h5_spt_group_exists(hid_t h5_file_id,int my_rank)
-{
-  hid_t spt_group;
-  int exists;
 
-  if (my_rank == 0) {
-      spt_group = H5Gopen(h5_file_id,"/spt");
-      H5Gclose(spt_group);
-      
-      if (spt_group < 0) {
-          exists = 0;
-      } else {
-          exists = 1;
-      }
-  } /* endif(my_rank == 0) */
-  
+  /* Prepare for hyperslabs of the data.  "slab_npix" does not
+   * reflect the factor of 2 for complex numbers; this is deliberate.
+   */
 #if USE_MPI
-  MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif
-  
-  if (exists == 0) {
-      return(0);
+  n_slabs = p;
+  slab_npix = ptr_itn_array_struct->npix/p;
+  memory_dims[1] = file_dims[1]/p;
+#else /* no USE_MPI */
+  if (n_dims == 5) {
+      n_slabs = ptr_itn_array_struct->nz;
+      slab_npix = (dm_array_index_t)(ptr_itn_array_struct->nx) *
+          (dm_array_index_t)(ptr_itn_array_struct->ny);
+      memory_dims[1] = 1;
   } else {
-      return(1);
+      n_slabs = 1;
+      slab_npix = ptr_itn_array_struct->npix;
   }
-}
+#endif /* USE_MPI */
+  file_counts[1] = memory_dims[1];
 
-/*-------------------------------------------------------------------------*/
-int dm_h5_itn_group_exists(hid_t h5_file_id,int my_rank)
-{
-    hid_t itn_group;
-    int exists;
-
-    if (my_rank == 0) {
-        itn_group = H5Gopen(h5_file_id,"/itn");
-        H5Gclose(itn_group);
-        
-        if (itn_group < 0) {
-            exists = 0;
-        } else {
-            exists = 1;
-        }
-    } /* endif(my_rank == 0) */
-    
-#if USE_MPI
-    MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif
-    
-    if (exists == 0) {
-        return(0);
-    } else {
-        return(1);
-    }
-}
-
-/*-------------------------------------------------------------------------*/
-int dm_h5_comments_group_exists(hid_t h5_file_id,int my_rank)
-{
-    hid_t comments_group;
-    int exists;
+  exists = dm_h5_itn_history_group_exists(h5_file_id,my_rank);
+  if (my_rank == 0) {
+      if (exists == 0) {
+          /* Data will go into a group "/itn_history" in the file */
+          if ((history_group = H5Gcreate(h5_file_id,"/itn_history",0)) < 0) {
+              strcpy(error_string,"H5Gcreate(\"/itn_history\") error");
+              return(DM_FILEIO_FAILURE);
+          }
 
-    if (my_rank == 0) {
-        comments_group = H5Gopen(h5_file_id,"/comments");
-        
-        if (comments_group < 0) {
-            exists = 0;
-        } else {
-            exists = 1;
-	    H5Gclose(comments_group);
-        }
-    } /* endif(my_rank == 0) */
-    
-#if USE_MPI
-    MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif
-    
-    if (exists == 0) {
-        return(0);
-    } else {
-        return(1);
-    }
-}
+          int_dims[0] = 1;
+          if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+              strcpy(error_string,"H5Tcopy(datatype) error");
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((dataspace = H5Screate_simple(1,int_dims,NULL)) < 0) {
+              strcpy(error_string,"H5Screate_simple(dataspace) error");
+              H5Tclose(datatype);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((attr = H5Acreate(history_group,"itn_history_version",
+                                datatype,dataspace,
+                                H5P_DEFAULT)) < 0) {
+              strcpy(error_string,"H5Acreate(itn_history_version) error");
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          dm_itn_history_version = DM_ITN_HISTORY_VERSION;
+          if ((status = H5Awrite(attr,datatype,
+                                 &dm_itn_history_version)) < 0) {
+              strcpy(error_string,"H5Awrite(itn_history_version) error");
+              H5Aclose(attr);
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          H5Aclose(attr);
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
 
-/*-------------------------------------------------------------------------*/
-int dm_h5_read_comments_info(hid_t h5_file_id,
-			     int *ptr_n_strings, int *ptr_string_length,
-			     char *error_string,
-                             int my_rank)
-{
-  hid_t comments_group;
-  hid_t dataset;
-  herr_t status;                             
+          /* The itn_struct holds the pixel sizes, which do not change
+           * between iterates. It is rewritten with every append.
+           */
+          itn_struct_dims[0] = 1;
+          if ((datatype = H5Tcreate(H5T_COMPOUND,
+                                    sizeof(dm_itn_struct))) < 0) {
+              strcpy(error_string,"H5Tcreate(itn_struct) error");
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          dm_h5_insert_itn_struct_members(datatype);
 
-  strcpy(error_string,"");
+          if ((dataspace =
+               H5Screate_simple(1,itn_struct_dims,NULL)) < 0) {
+              strcpy(error_string,"H5Screate_simple(itn_struct)");
+              H5Tclose(datatype);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((dataset = H5Dcreate(history_group,"itn_struct",
+                                   datatype,dataspace,
+                                   H5P_DEFAULT)) < 0) {
+              strcpy(error_string,"H5Dcreate(itn_struct)");
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          H5Dclose(dataset);
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
 
-  if (my_rank == 0) {
+          /* The per-iterate values go into 1D datasets that run in
+           * parallel to the leading dimension of itn_history_array.
+           */
+          if ((dm_h5_create_itn_history_value(history_group,
+                                              "iterate_count",
+                                              H5T_NATIVE_UINT32,
+                                              error_string)
+               == DM_FILEIO_FAILURE) ||
+              (dm_h5_create_itn_history_value(history_group,
+                                              "photon_scaling",
+                                              H5T_NATIVE_DOUBLE,
+                                              error_string)
+               == DM_FILEIO_FAILURE) ||
+              (dm_h5_create_itn_history_value(history_group,
+                                              "recon_error",
+                                              DM_H5_ARRAY_REAL,
+                                              error_string)
+               == DM_FILEIO_FAILURE)) {
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
 
-      if ((comments_group = H5Gopen(h5_file_id,"/comments")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/comments\") error");
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((dataset = H5Dopen(comments_group,"comment_string_length")) < 0) {
-          strcpy(error_string,"H5Dopen(comment_string_length) error");
+          if ((file_dataspace =
+               H5Screate_simple(n_dims,file_dims,array_maxdims)) < 0) {
+              strcpy(error_string,
+                     "H5Screate_simple(itn_history_array,file) error");
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((cre_pid = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
+              strcpy(error_string,"H5Pcreate(itn_history_array) error");
+              H5Sclose(file_dataspace);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((status = H5Pset_chunk(cre_pid,n_dims,chunk_dims)) < 0) {
+              strcpy(error_string,"H5Pset_chunk(itn_history_array) error");
+              H5Pclose(cre_pid);
+              H5Sclose(file_dataspace);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((dataset = H5Dcreate(history_group,"itn_history_array",
+                                   DM_H5_ARRAY_REAL,
+                                   file_dataspace,cre_pid)) < 0) {
+              strcpy(error_string,"H5Dcreate(itn_history_array) error");
+              H5Pclose(cre_pid);
+              H5Sclose(file_dataspace);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          H5Pclose(cre_pid);
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Sclose(file_dataspace);
+          H5Gclose(history_group);
+      } /* endif(exists == 0) */
+
+      if ((history_group = H5Gopen(h5_file_id,"/itn_history")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/itn_history\") error");
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_string_length)) < 0) {
-          sprintf(error_string,"H5Dread(comment_string_length) error");
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
+
+      /* Rewrite itn_struct so that the pixel sizes stay current */
+      if ((dataset = H5Dopen(history_group,"itn_struct")) < 0) {
+          strcpy(error_string,"H5Dopen(itn_struct) error");
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Dclose(dataset);
-      
-      if ((dataset = H5Dopen(comments_group,"n_comment_strings")) < 0) {
-          strcpy(error_string,"H5Dopen(n_comment_strings) error");
+      if ((datatype = H5Tcreate(H5T_COMPOUND,
+                                sizeof(dm_itn_struct))) < 0) {
+          strcpy(error_string,"H5Tcreate(itn_struct) error");
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_n_strings)) < 0) {
-          sprintf(error_string,"H5Dread(n_comment_strings) error");
+      dm_h5_insert_itn_struct_members(datatype);
+      if ((status = H5Dwrite(dataset,datatype,
+                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                             ptr_itn_struct)) < 0) {
+          strcpy(error_string,"Error in H5Dwrite(itn_struct)");
+          H5Tclose(datatype);
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
+      H5Tclose(datatype);
       H5Dclose(dataset);
-      H5Gclose(comments_group);
-  } /* endif(my_rank == 0) */
-  
-    /* Send info on strlen and number of comments to other processes
-     * if necesary
-     */
-#if USE_MPI
-  MPI_Bcast(ptr_string_length,1,MPI_INT,0,MPI_COMM_WORLD);
-  MPI_Bcast(ptr_n_strings,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif /* USE_MPI */
-
-      
-  return(DM_FILEIO_SUCCESS);
-}
-
-/*-------------------------------------------------------------------------*/
-int dm_h5_read_comments(hid_t h5_file_id,
-			dm_comment_struct *ptr_comment_struct,
-			char *error_string,
-                        int my_rank)
-{
-  hid_t comments_group, xfer_pid;
-  hid_t dataset, datatype, dataspace;
-  herr_t status;                             
-  int i_string, local_string_length, local_n_strings, check;
-  char *local_string;
-
-  strcpy(error_string,"");
-
-  if (my_rank == 0) {
-      hvl_t local_string_array[ptr_comment_struct->n_strings_max];
 
-      if ((comments_group = H5Gopen(h5_file_id,"/comments")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/comments\") error");
+      /* Check the existing array and make room for one more iterate */
+      if ((dataset = H5Dopen(history_group,"itn_history_array")) < 0) {
+          strcpy(error_string,"H5Dopen(itn_history_array) error");
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-
-      if ((dataset = H5Dopen(comments_group,"comment_string_length")) < 0) {
-          strcpy(error_string,"H5Dopen(comment_string_length) error");
+      if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(itn_history_array) error");
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &local_string_length)) < 0) {
-          sprintf(error_string,"H5Dread(comment_string_length) error");
+      old_n_dims = H5Sget_simple_extent_ndims(file_dataspace);
+      if ((old_n_dims != n_dims) ||
+          (H5Sget_simple_extent_dims(file_dataspace,old_dims,NULL) < 0)) {
+          sprintf(error_string,
+                  "Error: itn_history_array n_dims=%d rather than %d",
+                  old_n_dims,n_dims);
+          H5Sclose(file_dataspace);
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Dclose(dataset);
-      
-      if ((dataset = H5Dopen(comments_group,"n_comment_strings")) < 0) {
-          strcpy(error_string,"H5Dopen(n_comment_strings) error");
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
+      H5Sclose(file_dataspace);
+      for (i=1; i<n_dims; i++) {
+          if (old_dims[i] != file_dims[i]) {
+              sprintf(error_string,
+                      "Error: itn_history_array dimension %d is %d not %d",
+                      i,(int)old_dims[i],(int)file_dims[i]);
+              H5Dclose(dataset);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &local_n_strings)) < 0) {
-          sprintf(error_string,"H5Dread(n_comment_strings) error");
+
+      i_iterate = old_dims[0];
+      file_dims[0] = i_iterate+1;
+      file_offsets[0] = i_iterate;
+      if ((status = H5Dextend(dataset,file_dims)) < 0) {
+          strcpy(error_string,"H5Dextend(itn_history_array) error");
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Dclose(dataset);
-      
-      if (local_string_length > (ptr_comment_struct->string_length)) {
-          sprintf(error_string,"Comment string length is %d but your max is %d",
-                  local_string_length,(ptr_comment_struct->string_length));
-          H5Gclose(comments_group);
+
+      if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(itn_history_array) error");
+          H5Dclose(dataset);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      
-      if (local_n_strings > (ptr_comment_struct->n_strings_max)) {
-          sprintf(error_string,"Number of comment strings is %d but your max is %d",
-                  local_n_strings,(ptr_comment_struct->n_strings_max));
-          H5Gclose(comments_group);
+      if ((memory_dataspace =
+           H5Screate_simple(n_dims,memory_dims,NULL)) < 0) {
+          strcpy(error_string,
+                 "H5Screate_simple(itn_history_array,memory) error");
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      
-      dm_clear_comments(ptr_comment_struct);
-      
-      if ((dataset = H5Dopen(comments_group,"comment_strings")) < 0) {
-          strcpy(error_string,"H5Dopen(comment_strings) error");
+
+      slice_array = (dm_array_real *)malloc(2*sizeof(dm_array_real)*
+                                            slab_npix);
+      if (slice_array == NULL) {
+          strcpy(error_string,"slice malloc() error");
+          H5Sclose(memory_dataspace);
+          H5Sclose(file_dataspace);
           H5Dclose(dataset);
-          H5Gclose(comments_group);
+          H5Gclose(history_group);
           return(DM_FILEIO_FAILURE);
       }
-      
-      if ((datatype = H5Dget_type(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_type(comment_strings) error");
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((xfer_pid = H5Pcreate(H5P_DATASET_XFER)) < 0) {
-          strcpy(error_string,"H5Pcreate(comment_strings) error");
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_space(comment_strings) error");
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          H5Pclose(xfer_pid);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((status = H5Dread(dataset,datatype,
-                            H5S_ALL,H5S_ALL,xfer_pid,
-                            local_string_array)) < 0) {
-          strcpy(error_string,"H5Dread(comment_strings) error");
-          H5Dclose(dataset);
-          H5Tclose(datatype);
-          H5Gclose(comments_group);
-          H5Sclose(dataspace);
-          H5Pclose(xfer_pid);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Dclose(dataset);
-      
-      /* Now that we have a copy of the string array, copy it into the
-       * comment_struct.  We do it this way in case there's a mismatch
-       * between string length in the file, and string length in comment_struct.
-       */
-      for (i_string=0; i_string<local_n_strings; i_string++) {
-          if (local_string_array[i_string].len != 0) {
-              dm_add_string_to_comments((char *)local_string_array[i_string].p,
-                                        ptr_comment_struct);
+  } /* endif(my_rank == 0) */
+
+  /* As in dm_h5_write_itn() we always write an interleaved array.
+   * Without MPI a slab is one z-slice (or the whole array for 1D and
+   * 2D), with MPI a slab is the part of the array held by one process.
+   */
+  for (islab=0; islab<n_slabs; islab++) {
+#if USE_MPI
+      if ((islab > 0) && (my_rank == islab)) {
+#if DM_ARRAY_SPLIT
+          MPI_Send((ptr_itn_array_struct->complex_array)->re,
+                   slab_npix, MPI_ARRAY_REAL, 0, 99,
+                   MPI_COMM_WORLD);
+          MPI_Send((ptr_itn_array_struct->complex_array)->im,
+                   slab_npix, MPI_ARRAY_REAL, 0, 98,
+                   MPI_COMM_WORLD);
+#else
+          MPI_Send(ptr_itn_array_struct->complex_array,
+                   2*slab_npix, MPI_ARRAY_REAL, 0, 99,
+                   MPI_COMM_WORLD);
+#endif /* DM_ARRAY_SPLIT */
+      } /* endif(my_rank == islab) */
+#endif /* USE_MPI */
+
+      if (my_rank == 0) {
+#if USE_MPI
+          slab_offset = 0;
+          if (islab > 0) {
+#if DM_ARRAY_SPLIT
+              temp_re = (dm_array_real *)malloc(sizeof(dm_array_real)*
+                                                slab_npix);
+              temp_im = (dm_array_real *)malloc(sizeof(dm_array_real)*
+                                                slab_npix);
+              MPI_Recv(temp_re,slab_npix,MPI_ARRAY_REAL,
+                       islab,99,MPI_COMM_WORLD,&mpi_status);
+              MPI_Recv(temp_im,slab_npix,MPI_ARRAY_REAL,
+                       islab,98,MPI_COMM_WORLD,&mpi_status);
+              for (ipix=0; ipix<slab_npix; ipix++) {
+                  *(slice_array+2*ipix) = *(temp_re+ipix);
+                  *(slice_array+2*ipix+1) = *(temp_im+ipix);
+              }
+              free(temp_re);
+              free(temp_im);
+#else
+              MPI_Recv(slice_array,2*slab_npix,MPI_ARRAY_REAL,
+                       islab,99,MPI_COMM_WORLD,&mpi_status);
+#endif /* DM_ARRAY_SPLIT */
           }
-      }
-      
-      if ((status = 
-           H5Dvlen_reclaim(datatype,dataspace,
-                           xfer_pid,local_string_array)) < 0) {
-          strcpy(error_string,"H5Dvlen_reclaim(comment_strings) error");
-          H5Tclose(datatype);
-          H5Sclose(dataspace);
-          H5Gclose(comments_group);
-          H5Pclose(xfer_pid);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Pclose(xfer_pid);
-      H5Tclose(datatype);
-      H5Sclose(dataspace);
-      
-      /* 
-       * Now read the single strings. Allocate memory in local_string
-       */
-      local_string = (char *)malloc(local_string_length*sizeof(char));
-      
-      if ((dataset = H5Dopen(comments_group,"specimen_name")) < 0) {
-          strcpy(error_string,"H5Dopen(specimen_name) error");
-          free(local_string);
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((datatype = H5Dget_type(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_type(specimen_name) error");
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((status = H5Dread(dataset,datatype,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_string)) < 0) {
-          strcpy(error_string,"H5Dread(specimen_name) error");
-          H5Dclose(dataset);
-          H5Tclose(datatype);
-          free(local_string);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Dclose(dataset);
-      H5Tclose(datatype);
-      dm_add_specimen_name_to_comments(local_string, ptr_comment_struct);
-      free(local_string);
-      
-      local_string = (char *)malloc(local_string_length*sizeof(char));
-      if ((dataset = H5Dopen(comments_group,"collection_date")) < 0) {
-          strcpy(error_string,"H5Aopen(collection_date) error");
-          free(local_string);
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((datatype = H5Dget_type(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_type(collection_date) error");
-          H5Dclose(dataset);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      
-      if ((status = H5Dread(dataset,datatype,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_string)) < 0) {
-          strcpy(error_string,"H5Aread(collection_date) error");
-          H5Dclose(dataset);
-          H5Tclose(datatype);
-          free(local_string);
-          H5Gclose(comments_group);
-          return(DM_FILEIO_FAILURE);
-      }
+#else /* no USE_MPI */
+          slab_offset = islab*slab_npix;
+#endif /* USE_MPI */
+          if ((islab == 0) || (USE_MPI == 0)) {
+              for (ipix=0; ipix<slab_npix; ipix++) {
+                  *(slice_array+2*ipix) =
+                      c_re(ptr_itn_array_struct->complex_array,
+                           (ipix+slab_offset));
+                  *(slice_array+2*ipix+1) =
+                      c_im(ptr_itn_array_struct->complex_array,
+                           (ipix+slab_offset));
+              }
+          }
+
+          file_offsets[1] = islab*memory_dims[1];
+          if ((status = H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                                            file_offsets,NULL,
+                                            file_counts,NULL)) < 0) {
+              strcpy(error_string,
+                     "Error in H5Sselect_hyperslab(itn_history_array)");
+              free(slice_array);
+              H5Sclose(memory_dataspace);
+              H5Sclose(file_dataspace);
+              H5Dclose(dataset);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((status = H5Dwrite(dataset,DM_H5_ARRAY_REAL,memory_dataspace,
+                                 file_dataspace,H5P_DEFAULT,
+                                 slice_array)) < 0) {
+              strcpy(error_string,"Error in H5Dwrite(itn_history_array)");
+              free(slice_array);
+              H5Sclose(memory_dataspace);
+              H5Sclose(file_dataspace);
+              H5Dclose(dataset);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+      } /* endif(my_rank == 0) */
+  } /* endfor(islab) */
+
+  if (my_rank == 0) {
+      free(slice_array);
+      H5Sclose(memory_dataspace);
+      H5Sclose(file_dataspace);
       H5Dclose(dataset);
-      H5Tclose(datatype);
-      H5Gclose(comments_group);
-      dm_add_collection_date_to_comments(local_string,ptr_comment_struct);
-      
-      free(local_string);
 
+      if ((dm_h5_append_itn_history_value(history_group,"iterate_count",
+                                          H5T_NATIVE_UINT32,i_iterate,
+                                          &(ptr_itn_struct->iterate_count),
+                                          error_string)
+           == DM_FILEIO_FAILURE) ||
+          (dm_h5_append_itn_history_value(history_group,"photon_scaling",
+                                          H5T_NATIVE_DOUBLE,i_iterate,
+                                          &(ptr_itn_struct->photon_scaling),
+                                          error_string)
+           == DM_FILEIO_FAILURE) ||
+          (dm_h5_append_itn_history_value(history_group,"recon_error",
+                                          DM_H5_ARRAY_REAL,i_iterate,
+                                          &recon_error,
+                                          error_string)
+           == DM_FILEIO_FAILURE)) {
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Gclose(history_group);
   } /* endif(my_rank == 0) */
+
   return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-int dm_h5_read_ainfo_info(hid_t h5_file_id,
-			  int *ptr_n_frames, int *ptr_string_length,
-			  char *error_string,
-                          int my_rank)
+int dm_h5_append_itn_ensemble(hid_t h5_file_id,
+			      dm_itn_struct *ptr_itn_struct,
+			      int n_iterates,
+			      dm_array_complex_struct *itn_array_structs,
+			      dm_array_real *recon_errors,
+			      char *error_string,
+			      int my_rank,
+			      int p)
 {
-  hid_t ainfo_group, attr;
-  hid_t dataset,datatype;
-  herr_t status;  
-  int dm_ainfo_version;
+  int i_iterate;
 
   strcpy(error_string,"");
-
-  if (my_rank == 0) {
-
-      if ((ainfo_group = H5Gopen(h5_file_id,"/ainfo")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/ainfo\") error");
-          return(DM_FILEIO_FAILURE);
-      }
-  
-      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-          strcpy(error_string,"H5Tcopy(datatype) error");
-          H5Tclose(datatype);
-          return(DM_FILEIO_FAILURE);
-      }
-  
-      H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(ainfo_group,"ainfo_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(ainfo_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((status = H5Aread(attr,datatype,
-                            &dm_ainfo_version)) < 0) {
-          strcpy(error_string,"H5Aread(ainfo_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Aclose(attr);
-      H5Tclose(datatype);
-  
-      if (dm_ainfo_version > DM_AINFO_VERSION) {
-          sprintf(error_string,
-                  "Can only handle AINFO version up to %d, not %d",
-                  DM_AINFO_VERSION,dm_ainfo_version);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-   
-      if ((dataset = H5Dopen(ainfo_group,"string_length")) < 0) {
-          strcpy(error_string,"H5Dopen(string_length) error");
-          H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_string_length)) < 0) {
-          sprintf(error_string,"H5Dread(string_length) error");
-          H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Dclose(dataset);
-
-      if ((dataset = H5Dopen(ainfo_group,"n_frames")) < 0) {
-          strcpy(error_string,"H5Dopen(n_frames) error");
-          H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_n_frames)) < 0) {
-          sprintf(error_string,"H5Dread(n_frames) error");
-          H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
+  for (i_iterate=0; i_iterate<n_iterates; i_iterate++) {
+      if (dm_h5_append_itn_history(h5_file_id,ptr_itn_struct,
+				   itn_array_structs+i_iterate,
+				   *(recon_errors+i_iterate),
+				   error_string,my_rank,p) 
+	  == DM_FILEIO_FAILURE) {
+	  return(DM_FILEIO_FAILURE);
       }
-      H5Dclose(dataset);
-      H5Gclose(ainfo_group);
-
-  } /* endif(my_rank = 0) */
+  }
 
   return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-int dm_h5_read_ainfo(hid_t h5_file_id,
-		     dm_ainfo_struct *ptr_ainfo_struct,
-		     char *error_string,
-                     int my_rank)
+int dm_h5_adi_group_exists(hid_t h5_file_id,int my_rank)
 {
-  hid_t ainfo_group, attr;
-  hid_t dataset, datatype;
-  herr_t status;                             
-  int i_string, dm_ainfo_version, this_value;
-  size_t local_string_length, local_n_frames;
-  char *local_string_array;
-  double *local_double_array;
+  hid_t adi_group;
+  int exists;
+  
+  if (my_rank == 0) {
+      adi_group = H5Gopen(h5_file_id,"/adi");
+      H5Gclose(adi_group);
+      if (adi_group < 0) {
+          exists = 0;
+      } else {
+          exists = 1;
+      }
+  } /* endif(my_rank == 0) */
 
-  strcpy(error_string,"");
+#if USE_MPI
+   MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
+      
+  if (exists == 0) {
+    return(0);
+  } else {
+    return(1);
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_ads_group_exists(hid_t h5_file_id,int my_rank)
+{
+  hid_t ads_group;
+  int exists;
 
   if (my_rank == 0) {
+      ads_group = H5Gopen(h5_file_id,"/ads");
+      H5Gclose(ads_group);
 
-      if ((ainfo_group = H5Gopen(h5_file_id,"/ainfo")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/ainfo\") error");
-          return(DM_FILEIO_FAILURE);
+      if (ads_group < 0) {
+          exists = 0;
+      } else {
+          exists = 1;
       }
+  } /* endif(my_rank == 0) */
+
+#if USE_MPI
+   MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
    
-      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-          strcpy(error_string,"H5Tcopy(datatype) error");
-          H5Tclose(datatype);
-          return(DM_FILEIO_FAILURE);
+  if (exists == 0) {
+    return(0);
+  } else {
+    return(1);
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_spt_group_exists(hid_t h5_file_id,int my_rank)
+{
+  hid_t spt_group;
+  int exists;
+
+  if (my_rank == 0) {
+      spt_group = H5Gopen(h5_file_id,"/spt");
+      H5Gclose(spt_group);
+      
+      if (spt_group < 0) {
+          exists = 0;
+      } else {
+          exists = 1;
       }
+  } /* endif(my_rank == 0) */
   
-      H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(ainfo_group,"ainfo_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(ainfo_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((status = H5Aread(attr,datatype,
-                            &dm_ainfo_version)) < 0) {
-          strcpy(error_string,"H5Aread(ainfo_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Aclose(attr);
-      H5Tclose(datatype);
+#if USE_MPI
+  MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
   
-      if (dm_ainfo_version > DM_AINFO_VERSION) {
-          sprintf(error_string,
-                  "Can only handle AINFO version up to %d, not %d",
-                  DM_AINFO_VERSION,dm_ainfo_version);
-          H5Gclose(ainfo_group);
+  if (exists == 0) {
+      return(0);
+  } else {
+      return(1);
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_itn_group_exists(hid_t h5_file_id,int my_rank)
+{
+    hid_t itn_group;
+    int exists;
+
+    if (my_rank == 0) {
+        itn_group = H5Gopen(h5_file_id,"/itn");
+        H5Gclose(itn_group);
+        
+        if (itn_group < 0) {
+            exists = 0;
+        } else {
+            exists = 1;
+        }
+    } /* endif(my_rank == 0) */
+    
+#if USE_MPI
+    MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
+    
+    if (exists == 0) {
+        return(0);
+    } else {
+        return(1);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_comments_group_exists(hid_t h5_file_id,int my_rank)
+{
+    hid_t comments_group;
+    int exists;
+
+    if (my_rank == 0) {
+        comments_group = H5Gopen(h5_file_id,"/comments");
+        
+        if (comments_group < 0) {
+            exists = 0;
+        } else {
+            exists = 1;
+	    H5Gclose(comments_group);
+        }
+    } /* endif(my_rank == 0) */
+    
+#if USE_MPI
+    MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
+    
+    if (exists == 0) {
+        return(0);
+    } else {
+        return(1);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_itn_history_group_exists(hid_t h5_file_id,int my_rank)
+{
+    hid_t history_group;
+    int exists = 0;
+
+    if (my_rank == 0) {
+        history_group = H5Gopen(h5_file_id,"/itn_history");
+
+        if (history_group < 0) {
+            exists = 0;
+        } else {
+            exists = 1;
+            H5Gclose(history_group);
+        }
+    } /* endif(my_rank == 0) */
+
+#if USE_MPI
+    MPI_Bcast(&exists,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
+
+    if (exists == 0) {
+        return(0);
+    } else {
+        return(1);
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_comments_info(hid_t h5_file_id,
+			     int *ptr_n_strings, int *ptr_string_length,
+			     char *error_string,
+                             int my_rank)
+{
+  hid_t comments_group;
+  hid_t dataset, dataspace;
+  hssize_t n_points;
+  herr_t status;                             
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+
+      if ((comments_group = H5Gopen(h5_file_id,"/comments")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/comments\") error");
           return(DM_FILEIO_FAILURE);
       }
-
-      if ((dataset = H5Dopen(ainfo_group,"string_length")) < 0) {
-          strcpy(error_string,"H5Dopen(string_length) error");
+      
+      if ((dataset = H5Dopen(comments_group,"comment_string_length")) < 0) {
+          strcpy(error_string,"H5Dopen(comment_string_length) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &local_string_length)) < 0) {
-          sprintf(error_string,"H5Dread(string_length) error");
+                            ptr_string_length)) < 0) {
+          sprintf(error_string,"H5Dread(comment_string_length) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-  
-      if ((dataset = H5Dopen(ainfo_group,"n_frames")) < 0) {
-          strcpy(error_string,"H5Dopen(n_frames) error");
+      
+      if ((dataset = H5Dopen(comments_group,"n_comment_strings")) < 0) {
+          strcpy(error_string,"H5Dopen(n_comment_strings) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
+      
       if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &local_n_frames)) < 0) {
-          sprintf(error_string,"H5Dread(n_frames) error");
+                            ptr_n_strings)) < 0) {
+          sprintf(error_string,"H5Dread(n_comment_strings) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
 
-      if (local_string_length > (ptr_ainfo_struct->string_length)) {
-          sprintf(error_string,"Ainfo string length is %d but your max is %d",
-                  local_string_length,(ptr_ainfo_struct->string_length));
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
+      /* dm_h5_append_comments() does not update n_comment_strings,
+       * so the size of comment_strings has the final say.
+       */
+      if ((dataset = H5Dopen(comments_group,"comment_strings")) >= 0) {
+          dataspace = H5Dget_space(dataset);
+          n_points = H5Sget_simple_extent_npoints(dataspace);
+          if (n_points > *ptr_n_strings) {
+              *ptr_n_strings = n_points;
+          }
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
       }
+      H5Gclose(comments_group);
+  } /* endif(my_rank == 0) */
+  
+    /* Send info on strlen and number of comments to other processes
+     * if necesary
+     */
+#if USE_MPI
+  MPI_Bcast(ptr_string_length,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_n_strings,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
 
-      if (local_n_frames > (ptr_ainfo_struct->n_frames_max)) {
-          sprintf(error_string,"Number of filenames is %d but your max is %d",
-                  local_n_frames,(ptr_ainfo_struct->n_frames_max));
-          H5Gclose(ainfo_group);
-          return(DM_FILEIO_FAILURE);
-      }
+      
+  return(DM_FILEIO_SUCCESS);
+}
 
-      dm_clear_ainfo(ptr_ainfo_struct);
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_comments(hid_t h5_file_id,
+			dm_comment_struct *ptr_comment_struct,
+			char *error_string,
+                        int my_rank)
+{
+  hid_t comments_group, xfer_pid;
+  hid_t dataset, datatype, dataspace;
+  herr_t status;                             
+  int i_string, local_string_length, local_n_strings, check;
+  hssize_t n_vlen_strings;
+  hvl_t *local_string_array;
+  size_t this_strlen;
+  char *local_string;
 
-      /* Now we can copy the local_n_frames to the ainfo_struct */
-      ptr_ainfo_struct->n_frames = local_n_frames;
+  strcpy(error_string,"");
 
-      /* Now read in the other integers*/
-      if ((dataset = H5Dopen(ainfo_group,"no_background")) < 0) {
-          strcpy(error_string,"H5Dopen(no_background) error");
+  if (my_rank == 0) {
+      if ((comments_group = H5Gopen(h5_file_id,"/comments")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/comments\") error");
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((dataset = H5Dopen(comments_group,"comment_string_length")) < 0) {
+          strcpy(error_string,"H5Dopen(comment_string_length) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &this_value)) < 0) {
-          sprintf(error_string,"H5Dread(no_background) error");
+                            &local_string_length)) < 0) {
+          sprintf(error_string,"H5Dread(comment_string_length) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-      ptr_ainfo_struct->no_background = this_value;
-
-      if ((dataset = H5Dopen(ainfo_group,"dk_by_pix")) < 0) {
-          strcpy(error_string,"H5Dopen(dk_by_pix) error");
+      
+      if ((dataset = H5Dopen(comments_group,"n_comment_strings")) < 0) {
+          strcpy(error_string,"H5Dopen(n_comment_strings) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &this_value)) < 0) {
-          sprintf(error_string,"H5Dread(dk_by_pix) error");
+                            &local_n_strings)) < 0) {
+          sprintf(error_string,"H5Dread(n_comment_strings) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-      ptr_ainfo_struct->dk_by_pix = this_value;
-
-      if ((dataset = H5Dopen(ainfo_group,"merge_first")) < 0) {
-          strcpy(error_string,"H5Dopen(merge_first) error");
+      
+      if (local_string_length > (ptr_comment_struct->string_length)) {
+          sprintf(error_string,"Comment string length is %d but your max is %d",
+                  local_string_length,(ptr_comment_struct->string_length));
+          H5Gclose(comments_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      /* Make room if there are more strings than n_strings_max */
+      if (dm_grow_comments(ptr_comment_struct,local_n_strings,
+                           error_string) != DM_FILEIO_SUCCESS) {
+          H5Gclose(comments_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      dm_clear_comments(ptr_comment_struct);
+      
+      if ((dataset = H5Dopen(comments_group,"comment_strings")) < 0) {
+          strcpy(error_string,"H5Dopen(comment_strings) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            &this_value)) < 0) {
-          sprintf(error_string,"H5Dread(merge_first) error");
+      
+      if ((datatype = H5Dget_type(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_type(comment_strings) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Dclose(dataset);
-      ptr_ainfo_struct->merge_first = this_value;
-
-      if ((datatype = H5Tcopy(H5T_C_S1)) < 0) {
-          strcpy(error_string,"H5Tcopy(filename_array) error");
+      
+      if ((xfer_pid = H5Pcreate(H5P_DATASET_XFER)) < 0) {
+          strcpy(error_string,"H5Pcreate(comment_strings) error");
           H5Tclose(datatype);
-          H5Gclose(ainfo_group);
+          H5Dclose(dataset);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Tset_size(datatype,local_string_length);
-      local_string_array = 
-          (char *)malloc(local_string_length*local_n_frames);
-      if ((dataset = H5Dopen(ainfo_group,"filename_array")) < 0) {
-          strcpy(error_string,"H5Aopen(filename_array) error");
-          free(local_string_array);
+      
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(comment_strings) error");
           H5Tclose(datatype);
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
+          H5Pclose(xfer_pid);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      /* Strings appended by dm_h5_append_comments() are not counted
+       * in n_comment_strings, so go by the size of the dataspace.
+       */
+      n_vlen_strings = H5Sget_simple_extent_npoints(dataspace);
+      if ((n_vlen_strings < 0) || 
+          ((local_string_array = (hvl_t *)
+            malloc(sizeof(hvl_t)*(n_vlen_strings+1))) == NULL)) {
+          strcpy(error_string,"malloc(local_string_array) error");
+          H5Dclose(dataset);
+          H5Tclose(datatype);
+          H5Gclose(comments_group);
+          H5Sclose(dataspace);
+          H5Pclose(xfer_pid);
           return(DM_FILEIO_FAILURE);
       }
+      local_n_strings = n_vlen_strings;
+      
       if ((status = H5Dread(dataset,datatype,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            H5S_ALL,H5S_ALL,xfer_pid,
                             local_string_array)) < 0) {
-          strcpy(error_string,"H5Aread(filename_array) error");
+          strcpy(error_string,"H5Dread(comment_strings) error");
+          free(local_string_array);
           H5Dclose(dataset);
           H5Tclose(datatype);
-          free(local_string_array);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
+          H5Sclose(dataspace);
+          H5Pclose(xfer_pid);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-      /* Now that we have a copy of the filename array, copy it into the
-       * ainfo_struct.  We do it this way in case there's a mismatch
-       * between string length in the file, and string length in ainfo_struct.
+      
+      /* Now that we have a copy of the string array, copy it into the
+       * comment_struct.  We do it this way in case there's a mismatch
+       * between string length in the file, and string length in comment_struct.
+       * The vlen strings are not null-terminated, so they go through
+       * local_string first.
        */
-      for (i_string=0; i_string<local_n_frames; i_string++) {
-          dm_add_filename_to_ainfo((local_string_array+
-                                    i_string*local_string_length),
-                                   ptr_ainfo_struct);
+      local_string = (char *)malloc(ptr_comment_struct->string_length);
+      for (i_string=0; i_string<local_n_strings; i_string++) {
+          if (local_string_array[i_string].len != 0) {
+              this_strlen = local_string_array[i_string].len;
+              if (this_strlen > (ptr_comment_struct->string_length-1)) {
+                  this_strlen = ptr_comment_struct->string_length-1;
+              }
+              memcpy(local_string,local_string_array[i_string].p,this_strlen);
+              local_string[this_strlen] = '\000';
+              if (dm_add_string_to_comments(local_string,ptr_comment_struct)
+                  != DM_FILEIO_SUCCESS) {
+                  strcpy(error_string,"dm_add_string_to_comments() error");
+                  break;
+              }
+          }
       }
-      /* Clear the local_string_array for the systime array to be read */
-      dm_clear_local_string_array(local_string_array, local_string_length,
-                                  local_n_frames);
-  
-      if ((dataset = H5Dopen(ainfo_group,"systime_array")) < 0) {
-          strcpy(error_string,"H5Aopen(systime_array) error");
+      free(local_string);
+      if (i_string < local_n_strings) {
+          H5Dvlen_reclaim(datatype,dataspace,xfer_pid,local_string_array);
           free(local_string_array);
           H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Sclose(dataspace);
+          H5Gclose(comments_group);
+          H5Pclose(xfer_pid);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,datatype,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_string_array)) < 0) {
-          strcpy(error_string,"H5Aread(systime_array) error");
-          H5Dclose(dataset);
+      
+      status = H5Dvlen_reclaim(datatype,dataspace,
+                               xfer_pid,local_string_array);
+      free(local_string_array);
+      if (status < 0) {
+          strcpy(error_string,"H5Dvlen_reclaim(comment_strings) error");
           H5Tclose(datatype);
-          free(local_string_array);
-          H5Gclose(ainfo_group);
+          H5Sclose(dataspace);
+          H5Gclose(comments_group);
+          H5Pclose(xfer_pid);
           return(DM_FILEIO_FAILURE);
       }
-      H5Dclose(dataset);
-      /* Now that we have a copy of the systime array, copy it into the
-       * ainfo_struct.  We do it this way in case there's a mismatch
-       * between string length in the file, and string length in ainfo_struct.
+      H5Pclose(xfer_pid);
+      H5Tclose(datatype);
+      H5Sclose(dataspace);
+      
+      /* 
+       * Now read the single strings. Allocate memory in local_string
        */
-      for (i_string=0; i_string<local_n_frames; i_string++) {
-          dm_add_systime_to_ainfo((local_string_array+
-                                   i_string*local_string_length),
-                                  ptr_ainfo_struct);
-      }
-      /* Clear the local_systime_array for the file_directory to be read in */
-      dm_clear_local_string_array(local_string_array, local_string_length,
-                                  local_n_frames);
-
-      if ((dataset = H5Dopen(ainfo_group,"file_directory")) < 0) {
-          strcpy(error_string,"H5Aopen(file_directory) error");
-          free(local_string_array);
+      local_string = (char *)malloc(local_string_length*sizeof(char));
+      
+      if ((dataset = H5Dopen(comments_group,"specimen_name")) < 0) {
+          strcpy(error_string,"H5Dopen(specimen_name) error");
+          free(local_string);
           H5Tclose(datatype);
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
+          H5Gclose(comments_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      if ((datatype = H5Dget_type(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_type(specimen_name) error");
+          H5Dclose(dataset);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
+      
       if ((status = H5Dread(dataset,datatype,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_string_array)) < 0) {
-          strcpy(error_string,"H5Aread(file_directory) error");
+                            local_string)) < 0) {
+          strcpy(error_string,"H5Dread(specimen_name) error");
           H5Dclose(dataset);
           H5Tclose(datatype);
-          free(local_string_array);
-          H5Gclose(ainfo_group);
+          free(local_string);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-      dm_add_file_directory_to_ainfo(local_string_array,
-                                     ptr_ainfo_struct);
       H5Tclose(datatype);
-      free(local_string_array);
-  
-      /* Now we start reading the double arrays */
-      local_double_array = (double *)malloc(local_n_frames*sizeof(double));
-  
-      if ((dataset = H5Dopen(ainfo_group,"theta_x_radians_array")) < 0) {
-          strcpy(error_string,"H5Aopen(theta_x_radians_array) error");
+      dm_add_specimen_name_to_comments(local_string, ptr_comment_struct);
+      free(local_string);
+      
+      local_string = (char *)malloc(local_string_length*sizeof(char));
+      if ((dataset = H5Dopen(comments_group,"collection_date")) < 0) {
+          strcpy(error_string,"H5Aopen(collection_date) error");
+          free(local_string);
+          H5Tclose(datatype);
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          free(local_double_array);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+      
+      if ((datatype = H5Dget_type(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_type(collection_date) error");
+          H5Dclose(dataset);
+          H5Gclose(comments_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      if ((status = H5Dread(dataset,datatype,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_double_array)) < 0) {
-          strcpy(error_string,"H5Aread(theta_x_radians_array) error");
+                            local_string)) < 0) {
+          strcpy(error_string,"H5Aread(collection_date) error");
           H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          free(local_double_array);
+          H5Tclose(datatype);
+          free(local_string);
+          H5Gclose(comments_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
+      H5Tclose(datatype);
+      H5Gclose(comments_group);
+      dm_add_collection_date_to_comments(local_string,ptr_comment_struct);
+      
+      free(local_string);
 
-      /* Now copy the values to ainfo_struct */
-      for (i_string=0; i_string<local_n_frames; i_string++) {
-          *(ptr_ainfo_struct->theta_x_radians_array +i_string) = 
-              *(local_double_array + i_string);
-      }
+  } /* endif(my_rank == 0) */
+  return(DM_FILEIO_SUCCESS);
+}
 
-      if (DM_AINFO_VERSION > 1) {
-	if ((dataset = H5Dopen(ainfo_group,"theta_y_radians_array")) < 0) {
-          strcpy(error_string,"H5Aopen(theta_y_radians_array) error");
-          H5Dclose(dataset);
-          H5Gclose(ainfo_group);
-          free(local_double_array);
-          return(DM_FILEIO_FAILURE);
-	}
-	if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
-			      H5S_ALL,H5S_ALL,H5P_DEFAULT,
-			      local_double_array)) < 0) {
-          strcpy(error_string,"H5Aread(theta_y_radians_array) error");
-          H5Dclose(dataset);
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_ainfo_info(hid_t h5_file_id,
+			  int *ptr_n_frames, int *ptr_string_length,
+			  char *error_string,
+                          int my_rank)
+{
+  hid_t ainfo_group, attr;
+  hid_t dataset,datatype;
+  herr_t status;  
+  int dm_ainfo_version;
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+
+      if ((ainfo_group = H5Gopen(h5_file_id,"/ainfo")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/ainfo\") error");
+          return(DM_FILEIO_FAILURE);
+      }
+  
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
+          H5Tclose(datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+  
+      H5Tset_size(datatype,H5_SIZEOF_INT);
+      if ((attr = H5Aopen_name(ainfo_group,"ainfo_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(ainfo_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-	}
-	H5Dclose(dataset);
-	
-	/* Now copy the values to ainfo_struct */
-	for (i_string=0; i_string<local_n_frames; i_string++) {
-          *(ptr_ainfo_struct->theta_y_radians_array +i_string) = 
-	    *(local_double_array + i_string);
-	}
-	
-	if ((dataset = H5Dopen(ainfo_group,"theta_z_radians_array")) < 0) {
-          strcpy(error_string,"H5Aopen(theta_z_radians_array) error");
-          H5Dclose(dataset);
+      }
+      if ((status = H5Aread(attr,datatype,
+                            &dm_ainfo_version)) < 0) {
+          strcpy(error_string,"H5Aread(ainfo_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-	}
-	if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
-			      H5S_ALL,H5S_ALL,H5P_DEFAULT,
-			      local_double_array)) < 0) {
-          strcpy(error_string,"H5Aread(theta_z_radians_array) error");
-          H5Dclose(dataset);
+      }
+      H5Aclose(attr);
+      H5Tclose(datatype);
+  
+      if (dm_ainfo_version > DM_AINFO_VERSION) {
+          sprintf(error_string,
+                  "Can only handle AINFO version up to %d, not %d",
+                  DM_AINFO_VERSION,dm_ainfo_version);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-	}
-	H5Dclose(dataset);
-	
-	/* Now copy the values to ainfo_struct */
-	for (i_string=0; i_string<local_n_frames; i_string++) {
-          *(ptr_ainfo_struct->theta_z_radians_array +i_string) = 
-	    *(local_double_array + i_string);
-	}
-      } /* endif(DM_AINFO_VERSION > 1) */
-
-      if ((dataset = H5Dopen(ainfo_group,"xcenter_offset_pixels_array")) < 0) {
-          strcpy(error_string,"H5Aopen(xcenter_offset_pixels_array) error");
+      }
+   
+      if ((dataset = H5Dopen(ainfo_group,"string_length")) < 0) {
+          strcpy(error_string,"H5Dopen(string_length) error");
           H5Dclose(dataset);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_double_array)) < 0) {
-          strcpy(error_string,"H5Aread(xcenter_offset_pixels_array) error");
+                            ptr_string_length)) < 0) {
+          sprintf(error_string,"H5Dread(string_length) error");
           H5Dclose(dataset);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-      /* Now copy the values to ainfo_struct */
-      for (i_string=0; i_string<local_n_frames; i_string++) {
-          *(ptr_ainfo_struct->xcenter_offset_pixels_array +i_string) = 
-              *(local_double_array + i_string);
-      }
 
-      if ((dataset = H5Dopen(ainfo_group,"ycenter_offset_pixels_array")) < 0) {
-          strcpy(error_string,"H5Aopen(ycenter_offset_pixels_array) error");
+      if ((dataset = H5Dopen(ainfo_group,"n_frames")) < 0) {
+          strcpy(error_string,"H5Dopen(n_frames) error");
           H5Dclose(dataset);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            local_double_array)) < 0) {
-          strcpy(error_string,"H5Aread(ycenter_offset_pixels_array) error");
+                            ptr_n_frames)) < 0) {
+          sprintf(error_string,"H5Dread(n_frames) error");
           H5Dclose(dataset);
           H5Gclose(ainfo_group);
-          free(local_double_array);
           return(DM_FILEIO_FAILURE);
       }
       H5Dclose(dataset);
-      /* Now copy the values to ainfo_struct */
+      H5Gclose(ainfo_group);
 
-      for (i_string=0; i_string<local_n_frames; i_string++) {
-          *(ptr_ainfo_struct->ycenter_offset_pixels_array +i_string) = 
-              *(local_double_array + i_string);
-      }  
+  } /* endif(my_rank = 0) */
 
-      free(local_double_array);
-      H5Gclose(ainfo_group);
-  } /* endif(my_rank == 0) */
-  
   return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-int dm_h5_read_adi_info(hid_t h5_file_id,
-			int *ptr_nx, int *ptr_ny, int *ptr_nz,
-			int *ptr_error_is_present,
-			dm_adi_struct *ptr_adi_struct,
-			char *error_string,
-                        int my_rank)
+int dm_h5_read_ainfo(hid_t h5_file_id,
+		     dm_ainfo_struct *ptr_ainfo_struct,
+		     char *error_string,
+                     int my_rank)
 {
-  hid_t adi_group;
-  hid_t datatype, dataspace, dataset;
-  hid_t attr;
-  hsize_t *arr_dims;
+  hid_t ainfo_group, attr;
+  hid_t dataset, datatype;
   herr_t status;                             
-  int arr_n_dims, dm_adi_version;
-  int error_nx, error_ny, error_nz;
+  int i_string, dm_ainfo_version, this_value, string_encoding;
+  int local_string_length, local_n_frames;
+  char *local_string_array;
+  double *local_double_array;
 
   strcpy(error_string,"");
 
   if (my_rank == 0) {
 
-    if ((adi_group = H5Gopen(h5_file_id,"/adi")) < 0) {
-      strcpy(error_string,"H5Gopen(\"/adi\") error");
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
-    }
-    
-    if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-      strcpy(error_string,"H5Tcopy(datatype) error");
-      H5Tclose(datatype);
-      return(DM_FILEIO_FAILURE);
-    }
-    H5Tset_size(datatype,H5_SIZEOF_INT);
-    if ((attr = H5Aopen_name(adi_group,"adi_version")) < 0) {
-      strcpy(error_string,"H5Aopen_name(adi_version) error");
-      H5Aclose(attr);
-      H5Tclose(datatype);
-      H5Gclose(adi_group);
+      if ((ainfo_group = H5Gopen(h5_file_id,"/ainfo")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/ainfo\") error");
           return(DM_FILEIO_FAILURE);
-    }
-    if ((status = H5Aread(attr,datatype,
-			  &dm_adi_version)) < 0) {
-      strcpy(error_string,"H5Aread(adi_version) error");
+      }
+   
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
+          H5Tclose(datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+  
+      H5Tset_size(datatype,H5_SIZEOF_INT);
+      if ((attr = H5Aopen_name(ainfo_group,"ainfo_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(ainfo_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Aread(attr,datatype,
+                            &dm_ainfo_version)) < 0) {
+          strcpy(error_string,"H5Aread(ainfo_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
       H5Aclose(attr);
+
+      /* Only files with packed strings have a string_encoding */
+      string_encoding = DM_H5_STRINGS_FIXED;
+      if ((attr = H5Aopen_name(ainfo_group,"string_encoding")) >= 0) {
+          if ((status = H5Aread(attr,datatype,&string_encoding)) < 0) {
+              strcpy(error_string,"H5Aread(string_encoding) error");
+              H5Aclose(attr);
+              H5Tclose(datatype);
+              H5Gclose(ainfo_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          H5Aclose(attr);
+      }
       H5Tclose(datatype);
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
+  
+      if (dm_ainfo_version > DM_AINFO_VERSION) {
+          sprintf(error_string,
+                  "Can only handle AINFO version up to %d, not %d",
+                  DM_AINFO_VERSION,dm_ainfo_version);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
       }
-    H5Aclose(attr);
-    H5Tclose(datatype);
-    
-    if (dm_adi_version > DM_ADI_VERSION) {
-      sprintf(error_string,
-	      "Can only handle ADI version up to %d, not %d",
-	      DM_ADI_VERSION,dm_adi_version);
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
-    } 
+
+      if ((dataset = H5Dopen(ainfo_group,"string_length")) < 0) {
+          strcpy(error_string,"H5Dopen(string_length) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            &local_string_length)) < 0) {
+          sprintf(error_string,"H5Dread(string_length) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Dclose(dataset);
   
-    /*--- check on dimensions of adi_array --- */
-    if ((dataset = H5Dopen(adi_group,"adi_array")) < 0) {
-      strcpy(error_string,"H5Dopen(\"adi_array\") error");
+      if ((dataset = H5Dopen(ainfo_group,"n_frames")) < 0) {
+          strcpy(error_string,"H5Dopen(n_frames) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            &local_n_frames)) < 0) {
+          sprintf(error_string,"H5Dread(n_frames) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
       H5Dclose(dataset);
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
-    }
 
-    if ((dataspace = H5Dget_space(dataset)) < 0) {
-      strcpy(error_string,"H5Dget_space(adi_array) error");
-      H5Sclose(dataspace);
-      H5Dclose(dataset);
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
-    }
-    arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
-    
-    arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
-    if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
-      strcpy(error_string,"H5Dget_simple_extent_dims(adi_array) error");
-      free(arr_dims);
-      H5Sclose(dataspace);
-      H5Dclose(dataset);
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
-    }
-    
-    if (arr_n_dims == 1) {
-      *ptr_nx = (*(arr_dims+0));
-      *ptr_ny = 1;
-      *ptr_nz = 1;
-    } else if (arr_n_dims == 2) {
-      *ptr_ny = (*(arr_dims+0));
-      *ptr_nx = (*(arr_dims+1));
-      *ptr_nz = 1;
-    } else if (arr_n_dims == 3) {
-      *ptr_nz = (*(arr_dims+0));
-      *ptr_ny = (*(arr_dims+1));
-      *ptr_nx = (*(arr_dims+2));
-    } else {
-      sprintf(error_string,"Error: ADI array n_dims=%d rather than 1, 2, or 3",
-	      (int)arr_n_dims);
-      free(arr_dims);
-      H5Sclose(dataspace);
-      H5Dclose(dataset);
-      H5Gclose(adi_group);
-      return(DM_FILEIO_FAILURE);
-    }    
-    free(arr_dims); 
-    H5Sclose(dataspace);
-    H5Dclose(dataset);
-
-  } /* endif(my_rank == 0) */
-  
-  /* Send info on array size to other processes if necesary */
-#if USE_MPI
-  MPI_Bcast(ptr_nx,1,MPI_INT,0,MPI_COMM_WORLD);
-  MPI_Bcast(ptr_ny,1,MPI_INT,0,MPI_COMM_WORLD);
-  MPI_Bcast(ptr_nz,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif /* USE_MPI */
-  
-  /*--- check on dimensions of adi_error_array ---*/
-  *ptr_error_is_present = 0;
-
-  if (my_rank == 0) {
-      if ((dataset = H5Dopen(adi_group,"adi_error_array")) < 0) {
-          H5Dclose(dataset);
-      } else {
-          if ((datatype = H5Dget_type(dataset)) < 0) {
-              strcpy(error_string,"H5Dget_type(adi_error_array) error");
-              H5Tclose(datatype);
-              H5Dclose(dataset);
-              H5Gclose(adi_group);
-              return(DM_FILEIO_FAILURE);
-          }
-          if ((dataspace = H5Dget_space(dataset)) < 0) {
-              strcpy(error_string,"H5Dget_space(adi_error_array) error");
-              H5Sclose(dataspace);
-              H5Tclose(datatype);
-              H5Dclose(dataset);
-              H5Gclose(adi_group);
-              return(DM_FILEIO_FAILURE);
-          }
-          arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
-          arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
-          if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,
-                                                  NULL)) < 0) {
-              strcpy(error_string,"H5Dget_simple_extent_dims(adi_error_array) error");
-              free(arr_dims);
-              H5Sclose(dataspace);
-              H5Tclose(datatype);
-              H5Dclose(dataset);
-              H5Gclose(adi_group);
-              return(DM_FILEIO_FAILURE);
-          }
-    
-          if (arr_n_dims == 1) {
-              error_nx = (*(arr_dims+0));
-              error_ny = 1;
-              error_nz = 1;
-          } else if (arr_n_dims == 2) {
-              error_ny = (*(arr_dims+0));
-              error_nx = (*(arr_dims+1));
-              error_nz = 1;
-          } else if (arr_n_dims == 3) {
-              error_nz = (*(arr_dims+0));
-              error_ny = (*(arr_dims+1));
-              error_nx = (*(arr_dims+2));
-          } else {
-              sprintf(error_string,
-                      "Error: adi_error_array n_dims=%d rather than 1, 2, or 3",
-                      (int)arr_n_dims);
-              free(arr_dims);
-              H5Sclose(dataspace);
-              H5Tclose(datatype);
-              H5Dclose(dataset);
-              H5Gclose(adi_group);
-              return(DM_FILEIO_FAILURE);
-          }
-          free(arr_dims);
-
-          if ((error_nx != (*ptr_nx)) || (error_ny != (*ptr_ny)) ||
-              (error_nz != (*ptr_nz))) {
-              sprintf(error_string,
-                      "Error: adi_array[%d,%d,%d] but adi_error_array[%d,%d,%d]",
-                      (int)(*ptr_nx),(int)(*ptr_ny),(int)(*ptr_nz),
-                      error_nx,error_ny,error_nz);
-              H5Sclose(dataspace);
-              H5Tclose(datatype);
-              H5Dclose(dataset);
-              return(DM_FILEIO_FAILURE);
-          }
-  
-          /* If we got to this end point, then all is OK with adi_error_array */
-          *ptr_error_is_present = 1;
+      if (local_string_length > (ptr_ainfo_struct->string_length)) {
+          sprintf(error_string,"Ainfo string length is %d but your max is %d",
+                  local_string_length,(ptr_ainfo_struct->string_length));
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
 
-      } /* endif(H5Dopen(adi_group,"adi_error_array") == 0) */
-  } /* endif(my_rank == 0) */
+      /* Make room if there are more frames than n_frames_max */
+      if (dm_grow_ainfo(ptr_ainfo_struct,local_n_frames,
+                        error_string) != DM_FILEIO_SUCCESS) {
+          H5Gclose(ainfo_group);
+          return(DM_FILEIO_FAILURE);
+      }
 
-  /* Let other processes know if we have error array or not. */
-#if USE_MPI
-  MPI_Bcast(ptr_error_is_present,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif
+      dm_clear_ainfo(ptr_ainfo_struct);
 
-  if (my_rank == 0) {
-      H5Sclose(dataspace);
-      H5Tclose(datatype);
-      H5Dclose(dataset);
-  } /* endif(my_rank == 0) */
-  
-  /*----------------------------------------------------------------*/
-  /* Now get adi_struct, for now only read-out to root process */
+      /* Now we can copy the local_n_frames to the ainfo_struct */
+      ptr_ainfo_struct->n_frames = local_n_frames;
 
-  if (my_rank == 0) {
-      if ((dataset = H5Dopen(adi_group,"adi_struct")) < 0) {
-          strcpy(error_string,"H5Dopen(adi_struct) error");
+      /* Now read in the other integers*/
+      if ((dataset = H5Dopen(ainfo_group,"no_background")) < 0) {
+          strcpy(error_string,"H5Dopen(no_background) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Gget_space(adi_struct) error");
-          H5Sclose(dataspace);
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            &this_value)) < 0) {
+          sprintf(error_string,"H5Dread(no_background) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((datatype = H5Tcreate(H5T_COMPOUND,
-                                sizeof(dm_adi_struct))) < 0) {
-          strcpy(error_string,"H5Tcreate(adi_struct) error");
-          H5Tclose(datatype);
-          H5Sclose(dataspace);
+      H5Dclose(dataset);
+      ptr_ainfo_struct->no_background = this_value;
+
+      if ((dataset = H5Dopen(ainfo_group,"dk_by_pix")) < 0) {
+          strcpy(error_string,"H5Dopen(dk_by_pix) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      dm_h5_insert_adi_struct_members(datatype);
-      
-      if ((status = H5Dread(dataset,datatype,
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_adi_struct)) < 0) {
-          strcpy(error_string,"H5Dread(adi_struct) error");
-          H5Tclose(datatype);
-          H5Sclose(dataspace);
+                            &this_value)) < 0) {
+          sprintf(error_string,"H5Dread(dk_by_pix) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Tclose(datatype);
-      H5Sclose(dataspace);
       H5Dclose(dataset);
-      H5Gclose(adi_group);
-
-      } /* endif(my_rank == 0) */
-  
-  return(DM_FILEIO_SUCCESS);
-}
-
-/*-------------------------------------------------------------------------*/
-int dm_h5_read_adi(hid_t h5_file_id,
-		   dm_array_real_struct *ptr_adi_array_struct,
-		   dm_array_real_struct *ptr_adi_error_array_struct,
-		   char *error_string,
-                   int my_rank,
-                   int p)
-{
-  hid_t adi_group;
-  hid_t datatype, memspace, dataset, dataspace;
-  hid_t mem_type_id;
-  hid_t attr, local_datatype, read_datatype;
-  hsize_t *arr_dims;
-  herr_t status;                             
-  int arr_n_dims, dm_adi_version;
-  int local_nx, local_ny, local_nz;
-  int error_exists, no_error;
-  H5T_order_t order,local_order;
-#if USE_MPI
-  hsize_t *file_offsets, *file_counts;
-  int i;
-  dm_array_real *slice_array;
-  MPI_Status mpi_status;
-#endif
+      ptr_ainfo_struct->dk_by_pix = this_value;
 
-  if (my_rank == 0) {
-      strcpy(error_string,"");
-      
-      if ((adi_group = H5Gopen(h5_file_id,"/adi")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/adi\") error");
-          H5Gclose(adi_group);
+      if ((dataset = H5Dopen(ainfo_group,"merge_first")) < 0) {
+          strcpy(error_string,"H5Dopen(merge_first) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      
-      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-          strcpy(error_string,"H5Tcopy(datatype) error");
-          H5Tclose(datatype);
+      if ((status = H5Dread(dataset,H5T_NATIVE_INT,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            &this_value)) < 0) {
+          sprintf(error_string,"H5Dread(merge_first) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(adi_group,"adi_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(adi_version) error");
-          H5Aclose(attr);
+      H5Dclose(dataset);
+      ptr_ainfo_struct->merge_first = this_value;
+
+      if ((datatype = H5Tcopy(H5T_C_S1)) < 0) {
+          strcpy(error_string,"H5Tcopy(filename_array) error");
           H5Tclose(datatype);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((status = H5Aread(attr,datatype,
-                            &dm_adi_version)) < 0) {
-          strcpy(error_string,"H5Aread(comment_string_length) error");
-          H5Aclose(attr);
+      H5Tset_size(datatype,local_string_length);
+      /* One extra string so that file_directory fits if n_frames=0 */
+      local_string_array = 
+          (char *)malloc((size_t)local_string_length*(local_n_frames+1));
+      if (dm_h5_read_string_array(ainfo_group,"filename_array",
+                                  local_string_array,local_n_frames,
+                                  local_string_length,string_encoding,
+                                  error_string) != DM_FILEIO_SUCCESS) {
+          free(local_string_array);
           H5Tclose(datatype);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      H5Aclose(attr);
-      H5Tclose(datatype);
-      
-      if (dm_adi_version > DM_ADI_VERSION) {
-          sprintf(error_string,
-                  "Can only handle ADI version up to %d, not %d",
-                  DM_ADI_VERSION,dm_adi_version);
-          H5Gclose(adi_group);
-          return(DM_FILEIO_FAILURE);
+      /* Now that we have a copy of the filename array, copy it into the
+       * ainfo_struct.  We do it this way in case there's a mismatch
+       * between string length in the file, and string length in ainfo_struct.
+       */
+      for (i_string=0; i_string<local_n_frames; i_string++) {
+          if (dm_add_filename_to_ainfo(local_string_array+
+                                       (size_t)i_string*local_string_length,
+                                       ptr_ainfo_struct) 
+              != DM_FILEIO_SUCCESS) {
+              strcpy(error_string,"dm_add_filename_to_ainfo() error");
+              free(local_string_array);
+              H5Tclose(datatype);
+              H5Gclose(ainfo_group);
+              return(DM_FILEIO_FAILURE);
+          }
       }
-
-
+      /* Clear the local_string_array for the systime array to be read */
+      dm_clear_local_string_array(local_string_array, local_string_length,
+                                  local_n_frames);
   
-      /*--- adi_array ---*/
-      if ((dataset = H5Dopen(adi_group,"adi_array")) < 0) {
-          strcpy(error_string,"H5Dopen(\"adi_array\") error");
-          H5Gclose(adi_group);
+      if (dm_h5_read_string_array(ainfo_group,"systime_array",
+                                  local_string_array,local_n_frames,
+                                  local_string_length,string_encoding,
+                                  error_string) != DM_FILEIO_SUCCESS) {
+          free(local_string_array);
+          H5Tclose(datatype);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-      if ((datatype = H5Dget_type(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_type(adi_array) error");
+      /* Now that we have a copy of the systime array, copy it into the
+       * ainfo_struct.  We do it this way in case there's a mismatch
+       * between string length in the file, and string length in ainfo_struct.
+       */
+      for (i_string=0; i_string<local_n_frames; i_string++) {
+          if (dm_add_systime_to_ainfo(local_string_array+
+                                      (size_t)i_string*local_string_length,
+                                      ptr_ainfo_struct) 
+              != DM_FILEIO_SUCCESS) {
+              strcpy(error_string,"dm_add_systime_to_ainfo() error");
+              free(local_string_array);
+              H5Tclose(datatype);
+              H5Gclose(ainfo_group);
+              return(DM_FILEIO_FAILURE);
+          }
+      }
+      /* Clear the local_systime_array for the file_directory to be read in */
+      dm_clear_local_string_array(local_string_array, local_string_length,
+                                  local_n_frames);
+
+      if ((dataset = H5Dopen(ainfo_group,"file_directory")) < 0) {
+          strcpy(error_string,"H5Aopen(file_directory) error");
+          free(local_string_array);
+          H5Tclose(datatype);
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-
-      /*--- get order of type ---*/
-      if ((order = H5Tget_order(datatype)) < 0) {
-          strcpy(error_string,"H5Tget_order(adi_array) error");
+      if ((status = H5Dread(dataset,datatype,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            local_string_array)) < 0) {
+          strcpy(error_string,"H5Aread(file_directory) error");
           H5Dclose(dataset);
           H5Tclose(datatype);
-          H5Gclose(adi_group);
+          free(local_string_array);
+          H5Gclose(ainfo_group);
           return(DM_FILEIO_FAILURE);
       }
-
-      /*--- create local datatype to compare the orders ---*/
-      if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
-          strcpy(error_string,"H5Tcopy(adi_array) error");
+      H5Dclose(dataset);
+      dm_add_file_directory_to_ainfo(local_string_array,
+                                     ptr_ainfo_struct);
+      H5Tclose(datatype);
+      free(local_string_array);
+  
+      /* Now we start reading the double arrays */
+      local_double_array = (double *)malloc(local_n_frames*sizeof(double));
+  
+      if ((dataset = H5Dopen(ainfo_group,"theta_x_radians_array")) < 0) {
+          strcpy(error_string,"H5Aopen(theta_x_radians_array) error");
           H5Dclose(dataset);
-          H5Tclose(datatype);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
           return(DM_FILEIO_FAILURE);
       }
-
-      /*--- get order of local type ---*/
-      if ((local_order = H5Tget_order(local_datatype)) < 0) {
-          strcpy(error_string,"H5Tget_order(adi_array) error");
+      if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            local_double_array)) < 0) {
+          strcpy(error_string,"H5Aread(theta_x_radians_array) error");
           H5Dclose(dataset);
-          H5Tclose(datatype);
-          H5Gclose(adi_group);
-          H5Tclose(local_datatype);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
           return(DM_FILEIO_FAILURE);
       }
- 
-      /*--- Convert to local order if necessary ---*/
-      read_datatype = H5Tcopy(datatype);
-      if (local_order != order) {
-          if ((status = H5Tset_order(read_datatype,local_order)) < 0) {
-              strcpy(error_string,"H5Tset_order(adi_array) error");
-              H5Dclose(dataset);
-              H5Tclose(datatype);
-              H5Tclose(local_datatype);
-              H5Gclose(adi_group);
-              return(DM_FILEIO_FAILURE);
-          } 
+      H5Dclose(dataset);
+
+      /* Now copy the values to ainfo_struct */
+      for (i_string=0; i_string<local_n_frames; i_string++) {
+          *(ptr_ainfo_struct->theta_x_radians_array +i_string) = 
+              *(local_double_array + i_string);
       }
-      H5Tclose(local_datatype);
-      H5Tclose(datatype);
 
-      if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_space(adi_array) error");
-          H5Sclose(dataspace);
-          H5Tclose(read_datatype);
+      if (DM_AINFO_VERSION > 1) {
+	if ((dataset = H5Dopen(ainfo_group,"theta_y_radians_array")) < 0) {
+          strcpy(error_string,"H5Aopen(theta_y_radians_array) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-      }
-
-      arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
-      arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
-      if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
-          strcpy(error_string,"H5Dget_simple_extent_dims(adi_array) error");
-          free(arr_dims);
-          H5Sclose(dataspace);
-          H5Tclose(read_datatype);
+	}
+	if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+			      H5S_ALL,H5S_ALL,H5P_DEFAULT,
+			      local_double_array)) < 0) {
+          strcpy(error_string,"H5Aread(theta_y_radians_array) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-      }
-    
-      if (arr_n_dims == 1) {
-          local_nx = (*(arr_dims+0));
-          local_ny = 1;
-          local_nz = 1;
-#if USE_MPI
-          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_offsets + 0) = 0; /* Will be adjusted for each slice */
-          
-          /* Note that we have to divide by the number of processes here.
-           */
-          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_counts + 0) = (*(arr_dims+0))/p;
-#endif
-      } else if (arr_n_dims == 2) {
-          local_ny = (*(arr_dims+0));
-          local_nx = (*(arr_dims+1));
-          local_nz = 1;
-#if USE_MPI
-          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_offsets + 0) = 0;
-          *(file_offsets + 1) = 0; /* Will be adjusted for each slice */
-          
-          /* Note that we have to divide by the number of processes here.
-           */
-          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_counts + 0) = (*(arr_dims+0))/p;
-          *(file_counts + 1) = (*(arr_dims+1));
-#endif
-      } else if (arr_n_dims == 3) {
-          local_nz = (*(arr_dims+0));
-          local_ny = (*(arr_dims+1));
-          local_nx = (*(arr_dims+2));
-#if USE_MPI
-          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_offsets + 0) = 0;
-          *(file_offsets + 1) = 0;
-          *(file_offsets + 2) = 0; /* Will be adjusted for each slice */
-           
-          /* Note that we have to divide by the number of processes here.
-           */
-          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_counts + 0) = (*(arr_dims+0))/p;
-          *(file_counts + 1) = (*(arr_dims+1));
-          *(file_counts + 2) = (*(arr_dims+2));
-#endif
-      } else {
-          sprintf(error_string,"ADI array n_dims=%d rather than 1, 2, or 3",
-                  (int)arr_n_dims);
-          free(arr_dims);
-          H5Sclose(dataspace);
-          H5Tclose(read_datatype);
+	}
+	H5Dclose(dataset);
+	
+	/* Now copy the values to ainfo_struct */
+	for (i_string=0; i_string<local_n_frames; i_string++) {
+          *(ptr_ainfo_struct->theta_y_radians_array +i_string) = 
+	    *(local_double_array + i_string);
+	}
+	
+	if ((dataset = H5Dopen(ainfo_group,"theta_z_radians_array")) < 0) {
+          strcpy(error_string,"H5Aopen(theta_z_radians_array) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-      }    
-  
-      if ((local_nx != ptr_adi_array_struct->nx) ||
-          (local_ny != ptr_adi_array_struct->ny) ||
-          (local_nz != ptr_adi_array_struct->nz)) {
-          sprintf(error_string,"ADI array dimensions are [%d,%d,%d] not [%d,%d,%d]",
-                  local_nx,local_ny,local_nz,
-                  ptr_adi_array_struct->nx,ptr_adi_array_struct->ny,
-                  ptr_adi_array_struct->nz);
-          H5Tclose(read_datatype);
-          H5Sclose(dataspace);
+	}
+	if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+			      H5S_ALL,H5S_ALL,H5P_DEFAULT,
+			      local_double_array)) < 0) {
+          strcpy(error_string,"H5Aread(theta_z_radians_array) error");
           H5Dclose(dataset);
-          H5Gclose(adi_group);
-          free(arr_dims);
-#if USE_MPI
-          free(file_offsets);
-          free(file_counts);
-#endif
+          H5Gclose(ainfo_group);
+          free(local_double_array);
           return(DM_FILEIO_FAILURE);
-      }
-  } /* endif(my_rank == 0) */
+	}
+	H5Dclose(dataset);
+	
+	/* Now copy the values to ainfo_struct */
+	for (i_string=0; i_string<local_n_frames; i_string++) {
+          *(ptr_ainfo_struct->theta_z_radians_array +i_string) = 
+	    *(local_double_array + i_string);
+	}
+      } /* endif(DM_AINFO_VERSION > 1) */
 
-#if USE_MPI
-  /* Distribute data onto nodes. npix will tell us the total number of
-   * elements so we need to divide by the number of processes..
-   */
-  for (i = 0; i < p; i++) {
-      if (my_rank == 0) {
-          
-          /* Determine the file_offsets here. Note that we have to
-           * divide by number of processes.
-           */
-          if (arr_n_dims == 1) {
-              file_offsets[0] = i*ptr_adi_array_struct->nx/p;
-          } else if (arr_n_dims == 2) {
-              file_offsets[0] = i*ptr_adi_array_struct->ny/p;
-          } else if (arr_n_dims == 3) {
-              file_offsets[0] = i*ptr_adi_array_struct->nz/p;
-          }
+      if ((dataset = H5Dopen(ainfo_group,"xcenter_offset_pixels_array")) < 0) {
+          strcpy(error_string,"H5Aopen(xcenter_offset_pixels_array) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            local_double_array)) < 0) {
+          strcpy(error_string,"H5Aread(xcenter_offset_pixels_array) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Dclose(dataset);
+      /* Now copy the values to ainfo_struct */
+      for (i_string=0; i_string<local_n_frames; i_string++) {
+          *(ptr_ainfo_struct->xcenter_offset_pixels_array +i_string) = 
+              *(local_double_array + i_string);
+      }
 
-          if ((memspace =
-               H5Screate_simple(arr_n_dims,file_counts,NULL)) < 0) {
-              sprintf(error_string,"H5Screate_simple(adi_array) error");
-              H5Sclose(dataspace);
-              H5Tclose(read_datatype);
-              H5Dclose(dataset);
-              H5Gclose(adi_group);
-              free(file_offsets);
-              free(file_counts);
-              return(DM_FILEIO_FAILURE);
-          }
+      if ((dataset = H5Dopen(ainfo_group,"ycenter_offset_pixels_array")) < 0) {
+          strcpy(error_string,"H5Aopen(ycenter_offset_pixels_array) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Dread(dataset,H5T_NATIVE_DOUBLE,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            local_double_array)) < 0) {
+          strcpy(error_string,"H5Aread(ycenter_offset_pixels_array) error");
+          H5Dclose(dataset);
+          H5Gclose(ainfo_group);
+          free(local_double_array);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Dclose(dataset);
+      /* Now copy the values to ainfo_struct */
 
-          if ((status = H5Sselect_hyperslab(dataspace, H5S_SELECT_SET,
-                                            file_offsets, NULL,
-                                            file_counts, NULL)) < 0) {
-              strcpy(error_string,
-                     "Error in H5Sselect_hyperslab(adi_array)");
-              H5Sclose(dataspace);
-              H5Sclose(memspace);
-              H5Tclose(read_datatype);
-              H5Gclose(adi_group);
-              free(file_offsets);
-              free(file_counts);
-              return(DM_FILEIO_FAILURE);
-          }
+      for (i_string=0; i_string<local_n_frames; i_string++) {
+          *(ptr_ainfo_struct->ycenter_offset_pixels_array +i_string) = 
+              *(local_double_array + i_string);
+      }  
 
-          if (i == 0) {
-              /* read directly into the adi_array_struct */
-              if ((status = H5Dread(dataset,read_datatype,
-                                    memspace,dataspace,H5P_DEFAULT,
-                                    ptr_adi_array_struct->real_array)) < 0) {
-                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
-                  H5Sclose(dataspace);
-                  H5Sclose(memspace);
-                  H5Tclose(datatype);
-                  H5Gclose(adi_group);
-                  free(file_offsets);
-                  free(file_counts);
-                  return(DM_FILEIO_FAILURE);
-              }              
-          } else {
-              /* Read into slice array to send it */
-              slice_array =
-                  (dm_array_real *)malloc(sizeof(dm_array_real)*
-                                          ptr_adi_array_struct->npix/p);
-              
-              if ((status = H5Dread(dataset,read_datatype,
-                                    memspace,dataspace,H5P_DEFAULT,
-                                    slice_array)) < 0) {
-                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
-                  H5Sclose(dataspace);
-                  H5Sclose(memspace);
-                  H5Tclose(datatype);
-                  H5Gclose(adi_group);
-                  free(file_offsets);
-                  free(file_counts);
-                  free(slice_array);
-                  return(DM_FILEIO_FAILURE);
-              }
-              
-              MPI_Send(slice_array,ptr_adi_array_struct->npix/p,
-                       MPI_ARRAY_REAL,i,99,MPI_COMM_WORLD);
-              
-              free(slice_array);
-          } /* endif(i == 0) */
-      }  /* endif(my_rank == 0) */
+      free(local_double_array);
+      H5Gclose(ainfo_group);
+  } /* endif(my_rank == 0) */
+  
+  return(DM_FILEIO_SUCCESS);
+}
 
-      if (i > 0) {
-          if (my_rank == i) {
-              
-              MPI_Recv(ptr_adi_array_struct->real_array,
-                       ptr_adi_array_struct->npix/p,
-                       MPI_ARRAY_REAL, 0, 99,MPI_COMM_WORLD,&mpi_status);
-          
-          } /* endif(my_rank == i) */
-      } /* endif(i > 0) */
-  } /* endfor */
-          
-#else /* no USE_MPI */
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_adi_info(hid_t h5_file_id,
+			int *ptr_nx, int *ptr_ny, int *ptr_nz,
+			int *ptr_error_is_present,
+			dm_adi_struct *ptr_adi_struct,
+			char *error_string,
+                        int my_rank)
+{
+  hid_t adi_group;
+  hid_t datatype, dataspace, dataset;
+  hid_t attr;
+  hsize_t *arr_dims;
+  herr_t status;                             
+  int arr_n_dims, dm_adi_version;
+  int error_nx, error_ny, error_nz;
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+
+    if ((adi_group = H5Gopen(h5_file_id,"/adi")) < 0) {
+      strcpy(error_string,"H5Gopen(\"/adi\") error");
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+    }
+    
+    if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+      strcpy(error_string,"H5Tcopy(datatype) error");
+      H5Tclose(datatype);
+      return(DM_FILEIO_FAILURE);
+    }
+    H5Tset_size(datatype,H5_SIZEOF_INT);
+    if ((attr = H5Aopen_name(adi_group,"adi_version")) < 0) {
+      strcpy(error_string,"H5Aopen_name(adi_version) error");
+      H5Aclose(attr);
+      H5Tclose(datatype);
+      H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+    }
+    if ((status = H5Aread(attr,datatype,
+			  &dm_adi_version)) < 0) {
+      strcpy(error_string,"H5Aread(adi_version) error");
+      H5Aclose(attr);
+      H5Tclose(datatype);
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+      }
+    H5Aclose(attr);
+    H5Tclose(datatype);
+    
+    if (dm_adi_version > DM_ADI_VERSION) {
+      sprintf(error_string,
+	      "Can only handle ADI version up to %d, not %d",
+	      DM_ADI_VERSION,dm_adi_version);
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+    } 
   
-  if ((memspace = H5Screate_simple(arr_n_dims,arr_dims,NULL)) < 0) {
-      sprintf(error_string,"H5Screate_simple(adi_array) error");
-      H5Sclose(dataspace);
-      H5Tclose(read_datatype);
+    /*--- check on dimensions of adi_array --- */
+    if ((dataset = H5Dopen(adi_group,"adi_array")) < 0) {
+      strcpy(error_string,"H5Dopen(\"adi_array\") error");
       H5Dclose(dataset);
       H5Gclose(adi_group);
       return(DM_FILEIO_FAILURE);
-  }
-  
-  if ((status = H5Dread(dataset,read_datatype,
-			memspace,dataspace,H5P_DEFAULT,
-			ptr_adi_array_struct->real_array)) < 0) {
-      sprintf(error_string,"H5Dread(adi_array) error");
+    }
+
+    if ((dataspace = H5Dget_space(dataset)) < 0) {
+      strcpy(error_string,"H5Dget_space(adi_array) error");
       H5Sclose(dataspace);
-      H5Sclose(memspace);
-      H5Tclose(read_datatype);
       H5Dclose(dataset);
       H5Gclose(adi_group);
       return(DM_FILEIO_FAILURE);
-  }
-
-#endif /* USE_MPI */
-  if (my_rank == 0) {
+    }
+    arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
+    
+    arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
+    if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
+      strcpy(error_string,"H5Dget_simple_extent_dims(adi_array) error");
+      free(arr_dims);
       H5Sclose(dataspace);
-      H5Tclose(read_datatype);
       H5Dclose(dataset);
-      H5Sclose(memspace);
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+    }
+    
+    if (arr_n_dims == 1) {
+      *ptr_nx = (*(arr_dims+0));
+      *ptr_ny = 1;
+      *ptr_nz = 1;
+    } else if (arr_n_dims == 2) {
+      *ptr_ny = (*(arr_dims+0));
+      *ptr_nx = (*(arr_dims+1));
+      *ptr_nz = 1;
+    } else if (arr_n_dims == 3) {
+      *ptr_nz = (*(arr_dims+0));
+      *ptr_ny = (*(arr_dims+1));
+      *ptr_nx = (*(arr_dims+2));
+    } else {
+      sprintf(error_string,"Error: ADI array n_dims=%d rather than 1, 2, or 3",
+	      (int)arr_n_dims);
       free(arr_dims);
+      H5Sclose(dataspace);
+      H5Dclose(dataset);
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+    }    
+    free(arr_dims); 
+    H5Sclose(dataspace);
+    H5Dclose(dataset);
+
+  } /* endif(my_rank == 0) */
+  
+  /* Send info on array size to other processes if necesary */
 #if USE_MPI
-      free(file_offsets);
-      free(file_counts);
-#endif
-  } /* endif(my_rank == 0) */
+  MPI_Bcast(ptr_nx,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_ny,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_nz,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+  
+  /*--- check on dimensions of adi_error_array ---*/
+  *ptr_error_is_present = 0;
 
-  /* Check if the user wants to read out an error array.
-   * In case there is no error array we'll set the npix to zero quietly.
-   */
   if (my_rank == 0) {
-      if (ptr_adi_error_array_struct->npix == 0) {
-          error_exists = 0;
+      if ((dataset = H5Dopen(adi_group,"adi_error_array")) < 0) {
+          H5Dclose(dataset);
       } else {
-          error_exists = 1;
-      }
+          if ((datatype = H5Dget_type(dataset)) < 0) {
+              strcpy(error_string,"H5Dget_type(adi_error_array) error");
+              H5Tclose(datatype);
+              H5Dclose(dataset);
+              H5Gclose(adi_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((dataspace = H5Dget_space(dataset)) < 0) {
+              strcpy(error_string,"H5Dget_space(adi_error_array) error");
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Dclose(dataset);
+              H5Gclose(adi_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
+          arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
+          if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,
+                                                  NULL)) < 0) {
+              strcpy(error_string,"H5Dget_simple_extent_dims(adi_error_array) error");
+              free(arr_dims);
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Dclose(dataset);
+              H5Gclose(adi_group);
+              return(DM_FILEIO_FAILURE);
+          }
+    
+          if (arr_n_dims == 1) {
+              error_nx = (*(arr_dims+0));
+              error_ny = 1;
+              error_nz = 1;
+          } else if (arr_n_dims == 2) {
+              error_ny = (*(arr_dims+0));
+              error_nx = (*(arr_dims+1));
+              error_nz = 1;
+          } else if (arr_n_dims == 3) {
+              error_nz = (*(arr_dims+0));
+              error_ny = (*(arr_dims+1));
+              error_nx = (*(arr_dims+2));
+          } else {
+              sprintf(error_string,
+                      "Error: adi_error_array n_dims=%d rather than 1, 2, or 3",
+                      (int)arr_n_dims);
+              free(arr_dims);
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Dclose(dataset);
+              H5Gclose(adi_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          free(arr_dims);
+
+          if ((error_nx != (*ptr_nx)) || (error_ny != (*ptr_ny)) ||
+              (error_nz != (*ptr_nz))) {
+              sprintf(error_string,
+                      "Error: adi_array[%d,%d,%d] but adi_error_array[%d,%d,%d]",
+                      (int)(*ptr_nx),(int)(*ptr_ny),(int)(*ptr_nz),
+                      error_nx,error_ny,error_nz);
+              H5Sclose(dataspace);
+              H5Tclose(datatype);
+              H5Dclose(dataset);
+              return(DM_FILEIO_FAILURE);
+          }
+  
+          /* If we got to this end point, then all is OK with adi_error_array */
+          *ptr_error_is_present = 1;
+
+      } /* endif(H5Dopen(adi_group,"adi_error_array") == 0) */
   } /* endif(my_rank == 0) */
 
-  /* See if error array exists and let the other nodes know if we are
-   * using MPI.
-   */
+  /* Let other processes know if we have error array or not. */
 #if USE_MPI
-  MPI_Bcast(&error_exists,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif /* USE_MPI */
+  MPI_Bcast(ptr_error_is_present,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif
+
+  if (my_rank == 0) {
+      H5Sclose(dataspace);
+      H5Tclose(datatype);
+      H5Dclose(dataset);
+  } /* endif(my_rank == 0) */
+  
+  /*----------------------------------------------------------------*/
+  /* Now get adi_struct, for now only read-out to root process */
+
+  if (my_rank == 0) {
+      if ((dataset = H5Dopen(adi_group,"adi_struct")) < 0) {
+          strcpy(error_string,"H5Dopen(adi_struct) error");
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Gget_space(adi_struct) error");
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((datatype = H5Tcreate(H5T_COMPOUND,
+                                sizeof(dm_adi_struct))) < 0) {
+          strcpy(error_string,"H5Tcreate(adi_struct) error");
+          H5Tclose(datatype);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      dm_h5_insert_adi_struct_members(datatype);
+      
+      if ((status = H5Dread(dataset,datatype,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            ptr_adi_struct)) < 0) {
+          strcpy(error_string,"H5Dread(adi_struct) error");
+          H5Tclose(datatype);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tclose(datatype);
+      H5Sclose(dataspace);
+      H5Dclose(dataset);
+      H5Gclose(adi_group);
 
-  /*--- adi_error_array ---*/
-  if (error_exists == 0) {
-      /* There's no need to even attempt reading an error array */
-  } else if (error_exists == 1) {
-      if (my_rank == 0) {
-          if ((dataset = H5Dopen(adi_group,"adi_error_array")) < 0) {
-              /* If there was no adi_error array, don't report an error; just
-               * set the array size to zero. */
-              ptr_adi_error_array_struct->nx = 0;
-              ptr_adi_error_array_struct->ny = 0;
-              ptr_adi_error_array_struct->nz = 0;
-              ptr_adi_error_array_struct->npix = 0;
-              H5Dclose(dataset);
-              no_error = 1;
-          } else {
-              no_error = 0;
-          }
       } /* endif(my_rank == 0) */
+  
+  return(DM_FILEIO_SUCCESS);
+}
 
-      /* Now broadcast this if we use MPI */
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_adi(hid_t h5_file_id,
+		   dm_array_real_struct *ptr_adi_array_struct,
+		   dm_array_real_struct *ptr_adi_error_array_struct,
+		   char *error_string,
+                   int my_rank,
+                   int p)
+{
+  hid_t adi_group;
+  hid_t datatype, memspace, dataset, dataspace;
+  hid_t mem_type_id;
+  hid_t attr, local_datatype, read_datatype;
+  hsize_t *arr_dims;
+  herr_t status;                             
+  int arr_n_dims, dm_adi_version;
+  int local_nx, local_ny, local_nz;
+  int error_exists, no_error;
+  H5T_order_t order,local_order;
 #if USE_MPI
-      MPI_Bcast(&no_error,1,MPI_INT,0,MPI_COMM_WORLD);
-#endif /* USE_MPI */
+  hsize_t *file_offsets, *file_counts;
+  int i;
+  dm_array_real *slice_array;
+  MPI_Status mpi_status;
+#endif
 
-      /* Now if there is no error then we jump to the end. We have to do it
-       * in this clumsy way to make sure that all other processes
-       * besides root will also exit quietly if we use MPI.
-       */
-      if (no_error == 0) {
-      
-          if (my_rank == 0) {
-              /* There is an adi_error_array, and we should read it */
-              if ((datatype = H5Dget_type(dataset)) < 0) {
-                  strcpy(error_string,"H5Dget_type(adi_error_array) error");
-                  H5Dclose(dataset);
-                  H5Gclose(adi_group);
-                  return(DM_FILEIO_FAILURE);
-              }
+  if (my_rank == 0) {
+      strcpy(error_string,"");
       
-              /*--- get order of type ---*/
-              if ((order = H5Tget_order(datatype)) < 0) {
-                  strcpy(error_string,"H5Tget_order(adi_array) error");
-                  H5Dclose(dataset);
-                  H5Tclose(datatype);
-                  H5Gclose(adi_group);
-                  return(DM_FILEIO_FAILURE);
-              }
+      if ((adi_group = H5Gopen(h5_file_id,"/adi")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/adi\") error");
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
       
-              /*--- create local datatype to compare the orders ---*/
-              if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
-                  strcpy(error_string,"H5Tcopy(adi_array) error");
-                  H5Dclose(dataset);
-                  H5Tclose(datatype);
-                  H5Gclose(adi_group);
-                  return(DM_FILEIO_FAILURE);
-              }
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
+          H5Tclose(datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tset_size(datatype,H5_SIZEOF_INT);
+      if ((attr = H5Aopen_name(adi_group,"adi_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(adi_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Aread(attr,datatype,
+                            &dm_adi_version)) < 0) {
+          strcpy(error_string,"H5Aread(comment_string_length) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Aclose(attr);
+      H5Tclose(datatype);
       
-              /*--- get order of local type ---*/
-              if ((local_order = H5Tget_order(local_datatype)) < 0) {
-                  strcpy(error_string,"H5Tget_order(adi_array) error");
-                  H5Dclose(dataset);
-                  H5Tclose(datatype);
-                  H5Gclose(adi_group);
-                  H5Tclose(local_datatype);
-                  return(DM_FILEIO_FAILURE);
-              }
-      
-              /*--- Convert to local order if necessary ---*/
-              read_datatype = H5Tcopy(datatype);
-              if (local_order != order) {
-                  if ((status =
-                       H5Tset_order(read_datatype,local_order)) < 0) {
-                      strcpy(error_string,"H5Tset_order(adi_array) error");
-                      H5Dclose(dataset);
-                      H5Tclose(datatype);
-                      H5Tclose(local_datatype);
-                      H5Gclose(adi_group);
-                      return(DM_FILEIO_FAILURE);
-                  } 
-              }
-              H5Tclose(local_datatype);
+      if (dm_adi_version > DM_ADI_VERSION) {
+          sprintf(error_string,
+                  "Can only handle ADI version up to %d, not %d",
+                  DM_ADI_VERSION,dm_adi_version);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+
+  
+      /*--- adi_array ---*/
+      if ((dataset = H5Dopen(adi_group,"adi_array")) < 0) {
+          strcpy(error_string,"H5Dopen(\"adi_array\") error");
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((datatype = H5Dget_type(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_type(adi_array) error");
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /*--- get order of type ---*/
+      if ((order = H5Tget_order(datatype)) < 0) {
+          strcpy(error_string,"H5Tget_order(adi_array) error");
+          H5Dclose(dataset);
+          H5Tclose(datatype);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /*--- create local datatype to compare the orders ---*/
+      if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
+          strcpy(error_string,"H5Tcopy(adi_array) error");
+          H5Dclose(dataset);
+          H5Tclose(datatype);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /*--- get order of local type ---*/
+      if ((local_order = H5Tget_order(local_datatype)) < 0) {
+          strcpy(error_string,"H5Tget_order(adi_array) error");
+          H5Dclose(dataset);
+          H5Tclose(datatype);
+          H5Gclose(adi_group);
+          H5Tclose(local_datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+ 
+      /*--- Convert to local order if necessary ---*/
+      read_datatype = H5Tcopy(datatype);
+      if (local_order != order) {
+          if ((status = H5Tset_order(read_datatype,local_order)) < 0) {
+              strcpy(error_string,"H5Tset_order(adi_array) error");
+              H5Dclose(dataset);
               H5Tclose(datatype);
-      
-              if ((dataspace = H5Dget_space(dataset)) < 0) {
-                  strcpy(error_string,"H5Dget_space(adi_error_array) error");
-                  H5Sclose(dataspace);
-                  H5Tclose(read_datatype);
-                  H5Dclose(dataset);
-                  H5Gclose(adi_group);
-                  return(DM_FILEIO_FAILURE);
-              }
-              arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
-              arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
-              if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,
-                                                      NULL)) < 0) {
-                  strcpy(error_string,
-                         "H5Dget_simple_extent_dims(adi_error_array) error");
-                  free(arr_dims);
-                  H5Sclose(dataspace);
-                  H5Tclose(read_datatype);
-                  H5Dclose(dataset);
-                  H5Gclose(adi_group);
-                  return(DM_FILEIO_FAILURE);
-              }
-      
-              if (arr_n_dims == 1) {
-                  local_nx = (*(arr_dims+0));
-                  local_ny = 1;
-                  local_nz = 1;
+              H5Tclose(local_datatype);
+              H5Gclose(adi_group);
+              return(DM_FILEIO_FAILURE);
+          } 
+      }
+      H5Tclose(local_datatype);
+      H5Tclose(datatype);
+
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(adi_array) error");
+          H5Sclose(dataspace);
+          H5Tclose(read_datatype);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
+      arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
+      if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
+          strcpy(error_string,"H5Dget_simple_extent_dims(adi_array) error");
+          free(arr_dims);
+          H5Sclose(dataspace);
+          H5Tclose(read_datatype);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }
+    
+      if (arr_n_dims == 1) {
+          local_nx = (*(arr_dims+0));
+          local_ny = 1;
+          local_nz = 1;
 #if USE_MPI
-                  file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-                  *(file_offsets + 0) = 0; /* Will be adjusted for each
-                                              slice */
-                  
-                  /* Note that we have to divide by the number of
-                   * processes here.
-                   */
-                  file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-                  *(file_counts + 0) = (*(arr_dims+0))/p;
+          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_offsets + 0) = 0; /* Will be adjusted for each slice */
+          
+          /* Note that we have to divide by the number of processes here.
+           */
+          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_counts + 0) = (*(arr_dims+0))/p;
 #endif
-              } else if (arr_n_dims == 2) {
-                  local_ny = (*(arr_dims+0));
-                  local_nx = (*(arr_dims+1));
-                  local_nz = 1;
+      } else if (arr_n_dims == 2) {
+          local_ny = (*(arr_dims+0));
+          local_nx = (*(arr_dims+1));
+          local_nz = 1;
 #if USE_MPI
-                  file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-                  *(file_offsets + 0) = 0;
-                  *(file_offsets + 1) = 0; /* Will be adjusted for each
-                                              slice */
-                  
-                  /* Note that we have to divide by the number of
-                   * processes here.
-                   */
-                  file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-                  *(file_counts + 0) = (*(arr_dims+0))/p;
-                  *(file_counts + 1) = (*(arr_dims+1));
+          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_offsets + 0) = 0;
+          *(file_offsets + 1) = 0; /* Will be adjusted for each slice */
+          
+          /* Note that we have to divide by the number of processes here.
+           */
+          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_counts + 0) = (*(arr_dims+0))/p;
+          *(file_counts + 1) = (*(arr_dims+1));
 #endif
-              } else if (arr_n_dims == 3) {
-                  local_nz = (*(arr_dims+0));
-                  local_ny = (*(arr_dims+1));
-                  local_nx = (*(arr_dims+2));
+      } else if (arr_n_dims == 3) {
+          local_nz = (*(arr_dims+0));
+          local_ny = (*(arr_dims+1));
+          local_nx = (*(arr_dims+2));
 #if USE_MPI
-                  file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-                  *(file_offsets + 0) = 0;
-                  *(file_offsets + 1) = 0;
-                  *(file_offsets + 2) = 0; /* Will be adjusted for each
-                                              slice */
-                  
-                  /* Note that we have to divide by the number of
-                   * processes here.
-                   */
-                  file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-                  *(file_counts + 0) = (*(arr_dims+0))/p;
-                  *(file_counts + 1) = (*(arr_dims+1));
-                  *(file_counts + 2) = (*(arr_dims+2));
+          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_offsets + 0) = 0;
+          *(file_offsets + 1) = 0;
+          *(file_offsets + 2) = 0; /* Will be adjusted for each slice */
+           
+          /* Note that we have to divide by the number of processes here.
+           */
+          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_counts + 0) = (*(arr_dims+0))/p;
+          *(file_counts + 1) = (*(arr_dims+1));
+          *(file_counts + 2) = (*(arr_dims+2));
 #endif
-              } else {
-                  sprintf(error_string,"ADI array n_dims=%d rather than 2 or 3",
-                          (int)arr_n_dims);
-                  free(arr_dims);
-                  H5Tclose(read_datatype);
-                  H5Dclose(dataset);
-                  H5Gclose(adi_group);
-                  return(DM_FILEIO_FAILURE);
-              }    
-
-              if ((local_nx != ptr_adi_error_array_struct->nx) ||
-                  (local_ny != ptr_adi_error_array_struct->ny) ||
-                  (local_nz != ptr_adi_error_array_struct->nz)) {
-                  sprintf(error_string,
-                          "adi_error_array dimensions are [%d,%d,%d] not [%d,%d,%d]",
-                          local_nx,local_ny,local_nz,
-                          ptr_adi_error_array_struct->nx,
-                          ptr_adi_error_array_struct->ny,
-                          ptr_adi_error_array_struct->nz);
-                  H5Tclose(read_datatype);
-                  H5Dclose(dataset);
-                  H5Gclose(adi_group);
-                  free(arr_dims);
-#if USE_MPI
-                  free(file_offsets);
-                  free(file_counts);
-#endif
-                  return(DM_FILEIO_FAILURE);
-              }
-          } /* endif(my_rank == 0) */
+      } else {
+          sprintf(error_string,"ADI array n_dims=%d rather than 1, 2, or 3",
+                  (int)arr_n_dims);
+          free(arr_dims);
+          H5Sclose(dataspace);
+          H5Tclose(read_datatype);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          return(DM_FILEIO_FAILURE);
+      }    
+  
+      if ((local_nx != ptr_adi_array_struct->nx) ||
+          (local_ny != ptr_adi_array_struct->ny) ||
+          (local_nz != ptr_adi_array_struct->nz)) {
+          sprintf(error_string,"ADI array dimensions are [%d,%d,%d] not [%d,%d,%d]",
+                  local_nx,local_ny,local_nz,
+                  ptr_adi_array_struct->nx,ptr_adi_array_struct->ny,
+                  ptr_adi_array_struct->nz);
+          H5Tclose(read_datatype);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(adi_group);
+          free(arr_dims);
+#if USE_MPI
+          free(file_offsets);
+          free(file_counts);
+#endif
+          return(DM_FILEIO_FAILURE);
+      }
+  } /* endif(my_rank == 0) */
 
 #if USE_MPI
-          /* Distribute data onto nodes. npix will tell us the total
-           * number of elements so we need to divide by the number
-           * of processes...
+  /* Distribute data onto nodes. npix will tell us the total number of
+   * elements so we need to divide by the number of processes..
+   */
+  for (i = 0; i < p; i++) {
+      if (my_rank == 0) {
+          
+          /* Determine the file_offsets here. Note that we have to
+           * divide by number of processes.
            */
-          for (i = 0; i < p; i++) {
-              if (my_rank == 0) {
-                  /* Determine the file_offsets here. Note that we have to
-                   * divide by number of processes.
-                   */
-                  if (arr_n_dims == 1) {
-                      file_offsets[0] = i*ptr_adi_error_array_struct->nx/p;
-                  } else if (arr_n_dims == 2) {
-                      file_offsets[0] = i*ptr_adi_error_array_struct->ny/p;
-                  } else if (arr_n_dims == 3) {
-                      file_offsets[0] = i*ptr_adi_error_array_struct->nz/p;
-                  }
-                  
-                  if ((memspace =
-                       H5Screate_simple(arr_n_dims,file_counts,NULL)) < 0) {
-                      sprintf(error_string,
-                              "H5Screate_simple(adi_array) error");
-                      H5Sclose(dataspace);
-                      H5Tclose(read_datatype);
-                      H5Dclose(dataset);
-                      H5Gclose(adi_group);
-                      free(file_offsets);
-                      free(file_counts);
-                      free(slice_array);
-                      return(DM_FILEIO_FAILURE);
-                  }
-                  
-                  if ((status =
-                       H5Sselect_hyperslab(dataspace, H5S_SELECT_SET,
-                                           file_offsets, NULL,
-                                           file_counts, NULL)) < 0) {
-                      strcpy(error_string,
-                             "Error in H5Sselect_hyperslab(adi_array)");
-                      H5Sclose(dataspace);
-                      H5Sclose(memspace);
-                      H5Tclose(read_datatype);
-                      H5Gclose(adi_group);
-                      free(file_offsets);
-                      free(file_counts);
-                      free(slice_array);
-                      return(DM_FILEIO_FAILURE);
-                  }
-                  if (i == 0) {
-                      /* Read directly into adi_error_array_struct */
-                      if ((status =
-                           H5Dread(dataset,read_datatype,
-                                   memspace,dataspace,H5P_DEFAULT,
-                                   ptr_adi_error_array_struct->real_array)) < 0) {
-                          strcpy(error_string, "Error in H5Dread (adi_array)");
-                          H5Sclose(dataspace);
-                          H5Sclose(memspace);
-                          H5Tclose(datatype);
-                          H5Gclose(adi_group);
-                          free(file_offsets);
-                          free(file_counts);
-                          return(DM_FILEIO_FAILURE);
-                      }
-                  } else {
-                      /* Read into slice array to send around */
-                      slice_array =(dm_array_real *)malloc(sizeof(dm_array_real)*
-                                                           ptr_adi_error_array_struct->npix/p);
-                  
-
-                      if ((status = H5Dread(dataset,read_datatype,
-                                            memspace,dataspace,H5P_DEFAULT,
-                                            slice_array)) < 0) {
-                          strcpy(error_string, "Error in H5Dread (adi_array)");
-                          H5Sclose(dataspace);
-                          H5Sclose(memspace);
-                          H5Tclose(datatype);
-                          H5Gclose(adi_group);
-                          free(file_offsets);
-                          free(file_counts);
-                          free(slice_array);
-                          return(DM_FILEIO_FAILURE);
-                      }
-                  
-                      MPI_Send(slice_array,ptr_adi_error_array_struct->npix/p,
-                               MPI_ARRAY_REAL,i,99,MPI_COMM_WORLD);
-                      
-                      free(slice_array);
-                  } /* endif(i == 0) */
-              }  /* endif(my_rank == 0) */ 
+          if (arr_n_dims == 1) {
+              file_offsets[0] = i*ptr_adi_array_struct->nx/p;
+          } else if (arr_n_dims == 2) {
+              file_offsets[0] = i*ptr_adi_array_struct->ny/p;
+          } else if (arr_n_dims == 3) {
+              file_offsets[0] = i*ptr_adi_array_struct->nz/p;
+          }
 
-              if (i > 0) {
-                  if (my_rank == i) {                  
-                      MPI_Recv(ptr_adi_error_array_struct->real_array,
-                               ptr_adi_error_array_struct->npix/p,
-                               MPI_ARRAY_REAL, 0, 99,MPI_COMM_WORLD,&mpi_status);
-                      
-                      
-                  } /* endif(my_rank == i) */
-              } /* endif(i > 0) */
-          } /* endfor */
-          
-#else /* no USE_MPI */
-          
-          if ((memspace = H5Screate_simple(arr_n_dims,arr_dims,NULL)) < 0) {
+          if ((memspace =
+               H5Screate_simple(arr_n_dims,file_counts,NULL)) < 0) {
               sprintf(error_string,"H5Screate_simple(adi_array) error");
               H5Sclose(dataspace);
               H5Tclose(read_datatype);
               H5Dclose(dataset);
               H5Gclose(adi_group);
+              free(file_offsets);
+              free(file_counts);
               return(DM_FILEIO_FAILURE);
           }
-          
-          if ((status =
-               H5Dread(dataset,read_datatype,memspace,dataspace,
-                       H5P_DEFAULT,
-                       ptr_adi_error_array_struct->real_array)) < 0) {
-              sprintf(error_string,"H5Dread(adi_error_array) error");
+
+          if ((status = H5Sselect_hyperslab(dataspace, H5S_SELECT_SET,
+                                            file_offsets, NULL,
+                                            file_counts, NULL)) < 0) {
+              strcpy(error_string,
+                     "Error in H5Sselect_hyperslab(adi_array)");
               H5Sclose(dataspace);
               H5Sclose(memspace);
               H5Tclose(read_datatype);
-              H5Dclose(dataset);
               H5Gclose(adi_group);
+              free(file_offsets);
+              free(file_counts);
               return(DM_FILEIO_FAILURE);
           }
-#endif /* USE_MPI */
+
+          if (i == 0) {
+              /* read directly into the adi_array_struct */
+              if ((status = H5Dread(dataset,read_datatype,
+                                    memspace,dataspace,H5P_DEFAULT,
+                                    ptr_adi_array_struct->real_array)) < 0) {
+                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
+                  H5Sclose(dataspace);
+                  H5Sclose(memspace);
+                  H5Tclose(datatype);
+                  H5Gclose(adi_group);
+                  free(file_offsets);
+                  free(file_counts);
+                  return(DM_FILEIO_FAILURE);
+              }              
+          } else {
+              /* Read into slice array to send it */
+              slice_array =
+                  (dm_array_real *)malloc(sizeof(dm_array_real)*
+                                          ptr_adi_array_struct->npix/p);
+              
+              if ((status = H5Dread(dataset,read_datatype,
+                                    memspace,dataspace,H5P_DEFAULT,
+                                    slice_array)) < 0) {
+                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
+                  H5Sclose(dataspace);
+                  H5Sclose(memspace);
+                  H5Tclose(datatype);
+                  H5Gclose(adi_group);
+                  free(file_offsets);
+                  free(file_counts);
+                  free(slice_array);
+                  return(DM_FILEIO_FAILURE);
+              }
+              
+              MPI_Send(slice_array,ptr_adi_array_struct->npix/p,
+                       MPI_ARRAY_REAL,i,99,MPI_COMM_WORLD);
+              
+              free(slice_array);
+          } /* endif(i == 0) */
+      }  /* endif(my_rank == 0) */
+
+      if (i > 0) {
+          if (my_rank == i) {
+              
+              MPI_Recv(ptr_adi_array_struct->real_array,
+                       ptr_adi_array_struct->npix/p,
+                       MPI_ARRAY_REAL, 0, 99,MPI_COMM_WORLD,&mpi_status);
           
-          if (my_rank == 0) {
-              H5Sclose(dataspace);
-              H5Tclose(read_datatype);
-              H5Dclose(dataset);
-              H5Sclose(memspace);
-              free(arr_dims);
-#if USE_MPI
-              free(file_offsets);
-              free(file_counts);
-#endif
-          } /* endif(my_rank == 0) */
+          } /* endif(my_rank == i) */
+      } /* endif(i > 0) */
+  } /* endfor */
           
-      } /* endif(no_error == 0) */
-  } /* endif(error_exists == 1) */
+#else /* no USE_MPI */
+  
+  if ((memspace = H5Screate_simple(arr_n_dims,arr_dims,NULL)) < 0) {
+      sprintf(error_string,"H5Screate_simple(adi_array) error");
+      H5Sclose(dataspace);
+      H5Tclose(read_datatype);
+      H5Dclose(dataset);
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+  }
+  
+  if ((status = H5Dread(dataset,read_datatype,
+			memspace,dataspace,H5P_DEFAULT,
+			ptr_adi_array_struct->real_array)) < 0) {
+      sprintf(error_string,"H5Dread(adi_array) error");
+      H5Sclose(dataspace);
+      H5Sclose(memspace);
+      H5Tclose(read_datatype);
+      H5Dclose(dataset);
+      H5Gclose(adi_group);
+      return(DM_FILEIO_FAILURE);
+  }
 
+#endif /* USE_MPI */
   if (my_rank == 0) {
-      H5Gclose(adi_group);
+      H5Sclose(dataspace);
+      H5Tclose(read_datatype);
+      H5Dclose(dataset);
+      H5Sclose(memspace);
+      free(arr_dims);
+#if USE_MPI
+      free(file_offsets);
+      free(file_counts);
+#endif
   } /* endif(my_rank == 0) */
-  
-  return(DM_FILEIO_SUCCESS);
-}
-
-/*-------------------------------------------------------------------------*/
-int dm_h5_read_spt_info(hid_t h5_file_id,
-			int *ptr_nx, int *ptr_ny, int *ptr_nz,
-			dm_spt_struct *ptr_spt_struct,
-			char *error_string,
-                        int my_rank)
-{
-  hid_t spt_group;
-  hid_t datatype, dataspace, dataset;
-  hid_t attr;
-  hsize_t *arr_dims;
-  herr_t status;                             
-  int arr_n_dims, dm_spt_version;
-
-  strcpy(error_string,"");
 
+  /* Check if the user wants to read out an error array.
+   * In case there is no error array we'll set the npix to zero quietly.
+   */
   if (my_rank == 0) {
-
-      if ((spt_group = H5Gopen(h5_file_id,"/spt")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/spt\") error");
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-
-      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-          strcpy(error_string,"H5Tcopy(datatype) error");
-          H5Tclose(datatype);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(spt_group,"spt_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(spt_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((status = H5Aread(attr,datatype,
-                            &dm_spt_version)) < 0) {
-          strcpy(error_string,"H5Aread(spt_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Aclose(attr);
-      H5Tclose(datatype);
-  
-      if (dm_spt_version > DM_SPT_VERSION) {
-          sprintf(error_string,
-                  "Can only handle SPT version up to %d, not %d",
-                  DM_SPT_VERSION,dm_spt_version);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-  
-      /*--- check on dimensions of spt_array ---*/
-      if ((dataset = H5Dopen(spt_group,"spt_array")) < 0) {
-          strcpy(error_string,"H5Dopen(\"spt_array\") error");
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-
-      if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_space(spt_array) error");
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
-      arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
-      if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
-          strcpy(error_string,"H5Dget_simple_extent_dims(spt_array) error");
-          free(arr_dims);
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-
-      if (arr_n_dims == 1) {
-          *ptr_nx = (*(arr_dims+0));
-          *ptr_ny = 1;
-          *ptr_nz = 1;
-      } else if (arr_n_dims == 2) {
-          *ptr_ny = (*(arr_dims+0));
-          *ptr_nx = (*(arr_dims+1));
-          *ptr_nz = 1;
-      } else if (arr_n_dims == 3) {
-          *ptr_nz = (*(arr_dims+0));
-          *ptr_ny = (*(arr_dims+1));
-          *ptr_nx = (*(arr_dims+2));
+      if (ptr_adi_error_array_struct->npix == 0) {
+          error_exists = 0;
       } else {
-          sprintf(error_string,
-		  "Error: SPT array n_dims=%d rather than 1, 2, or 3",
-                  (int)arr_n_dims);
-          free(arr_dims);
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }    
-      free(arr_dims);
-      H5Sclose(dataspace);
-      H5Dclose(dataset);
-
+          error_exists = 1;
+      }
   } /* endif(my_rank == 0) */
 
-    /* Send info on array size to other processes if necesary */
+  /* See if error array exists and let the other nodes know if we are
+   * using MPI.
+   */
 #if USE_MPI
-  MPI_Bcast(ptr_nx,1,MPI_INT,0,MPI_COMM_WORLD);
-  MPI_Bcast(ptr_ny,1,MPI_INT,0,MPI_COMM_WORLD);
-  MPI_Bcast(ptr_nz,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(&error_exists,1,MPI_INT,0,MPI_COMM_WORLD);
 #endif /* USE_MPI */
 
-  /*----------------------------------------------------------------*/
-  /* Now get spt_struct */
-  if (my_rank == 0) {
-      if ((dataset = H5Dopen(spt_group,"spt_struct")) < 0) {
-          strcpy(error_string,"H5Dopen(spt_struct) error");
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Gget_space(spt_struct) error");
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((datatype = H5Tcreate(H5T_COMPOUND,
-                                sizeof(dm_spt_struct))) < 0) {
-          strcpy(error_string,"H5Tcreate(spt_struct) error");
-          H5Tclose(datatype);
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      dm_h5_insert_spt_struct_members(datatype);
-      
-      if ((status = H5Dread(dataset,datatype,
-                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_spt_struct)) < 0) {
-          strcpy(error_string,"H5Dread(spt_struct) error");
-          H5Tclose(datatype);
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Tclose(datatype);
-      H5Sclose(dataspace);
-      H5Dclose(dataset);
-      H5Gclose(spt_group);
-      
-  } /* endif(my_rank == 0) */
-  
-  return(DM_FILEIO_SUCCESS);
-}
+  /*--- adi_error_array ---*/
+  if (error_exists == 0) {
+      /* There's no need to even attempt reading an error array */
+  } else if (error_exists == 1) {
+      if (my_rank == 0) {
+          if ((dataset = H5Dopen(adi_group,"adi_error_array")) < 0) {
+              /* If there was no adi_error array, don't report an error; just
+               * set the array size to zero. */
+              ptr_adi_error_array_struct->nx = 0;
+              ptr_adi_error_array_struct->ny = 0;
+              ptr_adi_error_array_struct->nz = 0;
+              ptr_adi_error_array_struct->npix = 0;
+              H5Dclose(dataset);
+              no_error = 1;
+          } else {
+              no_error = 0;
+          }
+      } /* endif(my_rank == 0) */
 
-/*-------------------------------------------------------------------------*/
-int dm_h5_read_spt(hid_t h5_file_id,
-		   dm_array_byte_struct *ptr_spt_array_struct,
-		   char *error_string,
-                   int my_rank,
-                   int p)
-{
-  hid_t spt_group;
-  hid_t datatype, dataspace, dataset;
-  hid_t mem_type_id;
-  hid_t attr;
-  hsize_t *arr_dims;
-  herr_t status;                             
-  int arr_n_dims, dm_spt_version;
-  int local_nx, local_ny, local_nz;
+      /* Now broadcast this if we use MPI */
 #if USE_MPI
-  hsize_t *file_offsets, *file_counts;
-  hid_t memspace;
-  int i;
-  dm_array_real *slice_array;
-  MPI_Status mpi_status;
-#endif
+      MPI_Bcast(&no_error,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
 
-  if (my_rank == 0) {
-      strcpy(error_string,"");
+      /* Now if there is no error then we jump to the end. We have to do it
+       * in this clumsy way to make sure that all other processes
+       * besides root will also exit quietly if we use MPI.
+       */
+      if (no_error == 0) {
       
-      if ((spt_group = H5Gopen(h5_file_id,"/spt")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/spt\") error");
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-  
-      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-          strcpy(error_string,"H5Tcopy(datatype) error");
-          H5Tclose(datatype);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(spt_group,"spt_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(spt_version) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((status = H5Aread(attr,datatype,
-                            &dm_spt_version)) < 0) {
-          strcpy(error_string,"H5Aread(comment_string_length) error");
-          H5Aclose(attr);
-          H5Tclose(datatype);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      H5Aclose(attr);
-      H5Tclose(datatype);
-  
-      if (dm_spt_version > DM_SPT_VERSION) {
-          sprintf(error_string,
-                  "Can only handle SPT version up to %d, not %d",
-                  DM_SPT_VERSION,dm_spt_version);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-  
-      /*--- spt_array ---*/
-      if ((dataset = H5Dopen(spt_group,"spt_array")) < 0) {
-          strcpy(error_string,"H5Dopen(\"spt_array\") error");
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((datatype = H5Dget_type(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_type(spt_array) error");
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_space(spt_array) error");
-          H5Sclose(dataspace);
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-      arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
-      arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
-      if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
-          strcpy(error_string,"H5Dget_simple_extent_dims(spt_array) error");
-          free(arr_dims);
-          H5Sclose(dataspace);
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }
-    
-      if (arr_n_dims == 1) {
-          local_nx = (*(arr_dims+0));
-          local_ny = 1;
-          local_nz = 1;
+          if (my_rank == 0) {
+              /* There is an adi_error_array, and we should read it */
+              if ((datatype = H5Dget_type(dataset)) < 0) {
+                  strcpy(error_string,"H5Dget_type(adi_error_array) error");
+                  H5Dclose(dataset);
+                  H5Gclose(adi_group);
+                  return(DM_FILEIO_FAILURE);
+              }
+      
+              /*--- get order of type ---*/
+              if ((order = H5Tget_order(datatype)) < 0) {
+                  strcpy(error_string,"H5Tget_order(adi_array) error");
+                  H5Dclose(dataset);
+                  H5Tclose(datatype);
+                  H5Gclose(adi_group);
+                  return(DM_FILEIO_FAILURE);
+              }
+      
+              /*--- create local datatype to compare the orders ---*/
+              if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
+                  strcpy(error_string,"H5Tcopy(adi_array) error");
+                  H5Dclose(dataset);
+                  H5Tclose(datatype);
+                  H5Gclose(adi_group);
+                  return(DM_FILEIO_FAILURE);
+              }
+      
+              /*--- get order of local type ---*/
+              if ((local_order = H5Tget_order(local_datatype)) < 0) {
+                  strcpy(error_string,"H5Tget_order(adi_array) error");
+                  H5Dclose(dataset);
+                  H5Tclose(datatype);
+                  H5Gclose(adi_group);
+                  H5Tclose(local_datatype);
+                  return(DM_FILEIO_FAILURE);
+              }
+      
+              /*--- Convert to local order if necessary ---*/
+              read_datatype = H5Tcopy(datatype);
+              if (local_order != order) {
+                  if ((status =
+                       H5Tset_order(read_datatype,local_order)) < 0) {
+                      strcpy(error_string,"H5Tset_order(adi_array) error");
+                      H5Dclose(dataset);
+                      H5Tclose(datatype);
+                      H5Tclose(local_datatype);
+                      H5Gclose(adi_group);
+                      return(DM_FILEIO_FAILURE);
+                  } 
+              }
+              H5Tclose(local_datatype);
+              H5Tclose(datatype);
+      
+              if ((dataspace = H5Dget_space(dataset)) < 0) {
+                  strcpy(error_string,"H5Dget_space(adi_error_array) error");
+                  H5Sclose(dataspace);
+                  H5Tclose(read_datatype);
+                  H5Dclose(dataset);
+                  H5Gclose(adi_group);
+                  return(DM_FILEIO_FAILURE);
+              }
+              arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
+              arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
+              if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,
+                                                      NULL)) < 0) {
+                  strcpy(error_string,
+                         "H5Dget_simple_extent_dims(adi_error_array) error");
+                  free(arr_dims);
+                  H5Sclose(dataspace);
+                  H5Tclose(read_datatype);
+                  H5Dclose(dataset);
+                  H5Gclose(adi_group);
+                  return(DM_FILEIO_FAILURE);
+              }
+      
+              if (arr_n_dims == 1) {
+                  local_nx = (*(arr_dims+0));
+                  local_ny = 1;
+                  local_nz = 1;
 #if USE_MPI
-          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_offsets + 0) = 0; /* Will be adjusted for each slice */
-          
-          /* Note that we have to divide by the number of processes here.
-           */
-          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_counts + 0) = (*(arr_dims+0))/p;
+                  file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+                  *(file_offsets + 0) = 0; /* Will be adjusted for each
+                                              slice */
+                  
+                  /* Note that we have to divide by the number of
+                   * processes here.
+                   */
+                  file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+                  *(file_counts + 0) = (*(arr_dims+0))/p;
 #endif
-      } else if (arr_n_dims == 2) {
-          local_ny = (*(arr_dims+0));
-          local_nx = (*(arr_dims+1));
-          local_nz = 1;
+              } else if (arr_n_dims == 2) {
+                  local_ny = (*(arr_dims+0));
+                  local_nx = (*(arr_dims+1));
+                  local_nz = 1;
 #if USE_MPI
-          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_offsets + 0) = 0;
-          *(file_offsets + 1) = 0; /* Will be adjusted for each slice */
-          
-          /* Note that we have to divide by the number of processes here.
-           */
-          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_counts + 0) = (*(arr_dims+0))/p;
-          *(file_counts + 1) = (*(arr_dims+1));
+                  file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+                  *(file_offsets + 0) = 0;
+                  *(file_offsets + 1) = 0; /* Will be adjusted for each
+                                              slice */
+                  
+                  /* Note that we have to divide by the number of
+                   * processes here.
+                   */
+                  file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+                  *(file_counts + 0) = (*(arr_dims+0))/p;
+                  *(file_counts + 1) = (*(arr_dims+1));
 #endif
-      } else if (arr_n_dims == 3) {
-          local_nz = (*(arr_dims+0));
-          local_ny = (*(arr_dims+1));
-          local_nx = (*(arr_dims+2));
+              } else if (arr_n_dims == 3) {
+                  local_nz = (*(arr_dims+0));
+                  local_ny = (*(arr_dims+1));
+                  local_nx = (*(arr_dims+2));
 #if USE_MPI
-          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_offsets + 0) = 0;
-          *(file_offsets + 1) = 0;
-          *(file_offsets + 2) = 0; /* Will be adjusted for each slice */
-           
-          /* Note that we have to divide by the number of processes here.
-           */
-          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
-          *(file_counts + 0) = (*(arr_dims+0))/p;
-          *(file_counts + 1) = (*(arr_dims+1));
-          *(file_counts + 2) = (*(arr_dims+2));
+                  file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+                  *(file_offsets + 0) = 0;
+                  *(file_offsets + 1) = 0;
+                  *(file_offsets + 2) = 0; /* Will be adjusted for each
+                                              slice */
+                  
+                  /* Note that we have to divide by the number of
+                   * processes here.
+                   */
+                  file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+                  *(file_counts + 0) = (*(arr_dims+0))/p;
+                  *(file_counts + 1) = (*(arr_dims+1));
+                  *(file_counts + 2) = (*(arr_dims+2));
 #endif
-      } else {
-          sprintf(error_string,"SPT array n_dims=%d rather than 1, 2, or 3",
-                  (int)arr_n_dims);
-          free(arr_dims);
-          H5Sclose(dataspace);
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
-          return(DM_FILEIO_FAILURE);
-      }    
-      free(arr_dims);
-  
-      if ((local_nx != ptr_spt_array_struct->nx) ||
-          (local_ny != ptr_spt_array_struct->ny) ||
-          (local_nz != ptr_spt_array_struct->nz)) {
-          sprintf(error_string,"SPT array dimensions are [%d,%d,%d] not [%d,%d,%d]",
-                  local_nx,local_ny,local_nz,
-                  ptr_spt_array_struct->nx,ptr_spt_array_struct->ny,
-                  ptr_spt_array_struct->nz);
-          H5Sclose(dataspace);
-          H5Tclose(datatype);
-          H5Dclose(dataset);
-          H5Gclose(spt_group);
+              } else {
+                  sprintf(error_string,"ADI array n_dims=%d rather than 2 or 3",
+                          (int)arr_n_dims);
+                  free(arr_dims);
+                  H5Tclose(read_datatype);
+                  H5Dclose(dataset);
+                  H5Gclose(adi_group);
+                  return(DM_FILEIO_FAILURE);
+              }    
+
+              if ((local_nx != ptr_adi_error_array_struct->nx) ||
+                  (local_ny != ptr_adi_error_array_struct->ny) ||
+                  (local_nz != ptr_adi_error_array_struct->nz)) {
+                  sprintf(error_string,
+                          "adi_error_array dimensions are [%d,%d,%d] not [%d,%d,%d]",
+                          local_nx,local_ny,local_nz,
+                          ptr_adi_error_array_struct->nx,
+                          ptr_adi_error_array_struct->ny,
+                          ptr_adi_error_array_struct->nz);
+                  H5Tclose(read_datatype);
+                  H5Dclose(dataset);
+                  H5Gclose(adi_group);
+                  free(arr_dims);
 #if USE_MPI
-          free(file_offsets);
-          free(file_counts);
+                  free(file_offsets);
+                  free(file_counts);
 #endif
-          return(DM_FILEIO_FAILURE);
-      }
-  
-      mem_type_id = H5Tcopy(H5T_NATIVE_UINT8);
-
-  } /* endif(my_rank == 0) */
+                  return(DM_FILEIO_FAILURE);
+              }
+          } /* endif(my_rank == 0) */
 
-  #if USE_MPI
-  /* Distribute data onto nodes. npix will tell us the total number of
-   * elements so we need to divide by the number of processes..
-   */
-  for (i = 0; i < p; i++) {
-      if (my_rank == 0) {
-          
-          /* Determine the file_offsets here. Note that we have to
-           * divide by number of processes.
-           */
-          if (arr_n_dims == 1) {
-              file_offsets[0] = i*ptr_spt_array_struct->nx/p;
-          } else if (arr_n_dims == 2) {
-              file_offsets[0] = i*ptr_spt_array_struct->ny/p;
-          } else if (arr_n_dims == 3) {
-              file_offsets[0] = i*ptr_spt_array_struct->nz/p;
-          }
+#if USE_MPI
+          /* Distribute data onto nodes. npix will tell us the total
+           * number of elements so we need to divide by the number
+           * of processes...
+           */
+          for (i = 0; i < p; i++) {
+              if (my_rank == 0) {
+                  /* Determine the file_offsets here. Note that we have to
+                   * divide by number of processes.
+                   */
+                  if (arr_n_dims == 1) {
+                      file_offsets[0] = i*ptr_adi_error_array_struct->nx/p;
+                  } else if (arr_n_dims == 2) {
+                      file_offsets[0] = i*ptr_adi_error_array_struct->ny/p;
+                  } else if (arr_n_dims == 3) {
+                      file_offsets[0] = i*ptr_adi_error_array_struct->nz/p;
+                  }
+                  
+                  if ((memspace =
+                       H5Screate_simple(arr_n_dims,file_counts,NULL)) < 0) {
+                      sprintf(error_string,
+                              "H5Screate_simple(adi_array) error");
+                      H5Sclose(dataspace);
+                      H5Tclose(read_datatype);
+                      H5Dclose(dataset);
+                      H5Gclose(adi_group);
+                      free(file_offsets);
+                      free(file_counts);
+                      free(slice_array);
+                      return(DM_FILEIO_FAILURE);
+                  }
+                  
+                  if ((status =
+                       H5Sselect_hyperslab(dataspace, H5S_SELECT_SET,
+                                           file_offsets, NULL,
+                                           file_counts, NULL)) < 0) {
+                      strcpy(error_string,
+                             "Error in H5Sselect_hyperslab(adi_array)");
+                      H5Sclose(dataspace);
+                      H5Sclose(memspace);
+                      H5Tclose(read_datatype);
+                      H5Gclose(adi_group);
+                      free(file_offsets);
+                      free(file_counts);
+                      free(slice_array);
+                      return(DM_FILEIO_FAILURE);
+                  }
+                  if (i == 0) {
+                      /* Read directly into adi_error_array_struct */
+                      if ((status =
+                           H5Dread(dataset,read_datatype,
+                                   memspace,dataspace,H5P_DEFAULT,
+                                   ptr_adi_error_array_struct->real_array)) < 0) {
+                          strcpy(error_string, "Error in H5Dread (adi_array)");
+                          H5Sclose(dataspace);
+                          H5Sclose(memspace);
+                          H5Tclose(datatype);
+                          H5Gclose(adi_group);
+                          free(file_offsets);
+                          free(file_counts);
+                          return(DM_FILEIO_FAILURE);
+                      }
+                  } else {
+                      /* Read into slice array to send around */
+                      slice_array =(dm_array_real *)malloc(sizeof(dm_array_real)*
+                                                           ptr_adi_error_array_struct->npix/p);
+                  
 
-          if ((memspace =
-               H5Screate_simple(arr_n_dims,file_counts,NULL)) < 0) {
+                      if ((status = H5Dread(dataset,read_datatype,
+                                            memspace,dataspace,H5P_DEFAULT,
+                                            slice_array)) < 0) {
+                          strcpy(error_string, "Error in H5Dread (adi_array)");
+                          H5Sclose(dataspace);
+                          H5Sclose(memspace);
+                          H5Tclose(datatype);
+                          H5Gclose(adi_group);
+                          free(file_offsets);
+                          free(file_counts);
+                          free(slice_array);
+                          return(DM_FILEIO_FAILURE);
+                      }
+                  
+                      MPI_Send(slice_array,ptr_adi_error_array_struct->npix/p,
+                               MPI_ARRAY_REAL,i,99,MPI_COMM_WORLD);
+                      
+                      free(slice_array);
+                  } /* endif(i == 0) */
+              }  /* endif(my_rank == 0) */ 
+
+              if (i > 0) {
+                  if (my_rank == i) {                  
+                      MPI_Recv(ptr_adi_error_array_struct->real_array,
+                               ptr_adi_error_array_struct->npix/p,
+                               MPI_ARRAY_REAL, 0, 99,MPI_COMM_WORLD,&mpi_status);
+                      
+                      
+                  } /* endif(my_rank == i) */
+              } /* endif(i > 0) */
+          } /* endfor */
+          
+#else /* no USE_MPI */
+          
+          if ((memspace = H5Screate_simple(arr_n_dims,arr_dims,NULL)) < 0) {
               sprintf(error_string,"H5Screate_simple(adi_array) error");
               H5Sclose(dataspace);
-              H5Tclose(mem_type_id);
+              H5Tclose(read_datatype);
               H5Dclose(dataset);
-              H5Gclose(spt_group);
-              free(file_offsets);
-              free(file_counts);
-              free(slice_array);
+              H5Gclose(adi_group);
               return(DM_FILEIO_FAILURE);
           }
-
-          if ((status = H5Sselect_hyperslab(dataspace, H5S_SELECT_SET,
-                                            file_offsets, NULL,
-                                            file_counts, NULL)) < 0) {
-              strcpy(error_string,
-                     "Error in H5Sselect_hyperslab(adi_array)");
+          
+          if ((status =
+               H5Dread(dataset,read_datatype,memspace,dataspace,
+                       H5P_DEFAULT,
+                       ptr_adi_error_array_struct->real_array)) < 0) {
+              sprintf(error_string,"H5Dread(adi_error_array) error");
               H5Sclose(dataspace);
               H5Sclose(memspace);
-              H5Tclose(mem_type_id);
-              H5Gclose(spt_group);
-              free(file_offsets);
-              free(file_counts);
-              free(slice_array);
+              H5Tclose(read_datatype);
+              H5Dclose(dataset);
+              H5Gclose(adi_group);
               return(DM_FILEIO_FAILURE);
           }
-
-          if (i == 0) {
-              /* read directly into spt_array_struct */
-              if ((status = H5Dread(dataset,mem_type_id,
-                                    memspace,dataspace,H5P_DEFAULT,
-                                    ptr_spt_array_struct->byte_array)) < 0) {
-                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
-                  H5Sclose(dataspace);
-                  H5Sclose(memspace);
-                  H5Tclose(mem_type_id);
-                  H5Gclose(spt_group);
-                  free(file_offsets);
-                  free(file_counts);
-                  return(DM_FILEIO_FAILURE);
-              }
-
-          } else {
-              slice_array =
-                  (dm_array_real *)malloc(sizeof(dm_array_real)*
-                                          ptr_spt_array_struct->npix/p);
-
-              if ((status = H5Dread(dataset,mem_type_id,
-                                    memspace,dataspace,H5P_DEFAULT,
-                                    slice_array)) < 0) {
-                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
-                  H5Sclose(dataspace);
-                  H5Sclose(memspace);
-                  H5Tclose(mem_type_id);
-                  H5Gclose(spt_group);
-                  free(file_offsets);
-                  free(file_counts);
-                  free(slice_array);
-                  return(DM_FILEIO_FAILURE);
-              }
-              
-              MPI_Send(slice_array,ptr_spt_array_struct->npix/p,
-                       MPI_BYTE,i,99,MPI_COMM_WORLD);
-              
-              free(slice_array);
-          } /* endif(i == 0) */
-      }  /* endif(my_rank == 0) */
-            
-      if (i > 0) {
-          if (my_rank == i) {
-              
-              MPI_Recv(ptr_spt_array_struct->byte_array,
-                       ptr_spt_array_struct->npix/p,
-                       MPI_BYTE, 0, 99,MPI_COMM_WORLD,&mpi_status);
-              
-          } /* endif(my_rank == i) */
-      } /* endif(i > 0) */
-  } /* endfor */
-          
-#else /* no USE_MPI */  
-  if ((status = H5Dread(dataset,mem_type_id,
-			H5S_ALL,H5S_ALL,H5P_DEFAULT,
-			ptr_spt_array_struct->byte_array)) < 0) {
-      sprintf(error_string,"H5Dread(spt_array) error");
-      H5Sclose(dataspace);
-      H5Tclose(datatype);
-      H5Dclose(dataset);
-      H5Gclose(spt_group);
-      return(DM_FILEIO_FAILURE);
-  }
-
 #endif /* USE_MPI */
-  if (my_rank == 0) {
-      H5Sclose(dataspace);
-      H5Tclose(datatype);
-      H5Dclose(dataset);
+          
+          if (my_rank == 0) {
+              H5Sclose(dataspace);
+              H5Tclose(read_datatype);
+              H5Dclose(dataset);
+              H5Sclose(memspace);
+              free(arr_dims);
 #if USE_MPI
-      H5Sclose(memspace);
-      free(file_offsets);
-      free(file_counts);
+              free(file_offsets);
+              free(file_counts);
 #endif
-  } /* endif(my_rank == 0) */
+          } /* endif(my_rank == 0) */
+          
+      } /* endif(no_error == 0) */
+  } /* endif(error_exists == 1) */
 
   if (my_rank == 0) {
-      H5Gclose(spt_group);
+      H5Gclose(adi_group);
   } /* endif(my_rank == 0) */
-
+  
   return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-int dm_h5_read_itn_info(hid_t h5_file_id,
-			int *ptr_nx, int *ptr_ny, int *ptr_nz,
-			int *ptr_recon_errors_npix,
-			dm_itn_struct *ptr_itn_struct,
-			char *error_string,
-                        int my_rank)
+int dm_h5_map_adi(hid_t h5_file_id,
+                  dm_h5_map_struct *ptr_map,
+                  dm_array_real_struct *ptr_adi_array_struct,
+                  char *error_string,
+                  int my_rank,
+                  int p)
 {
-  hid_t itn_group;
-  hid_t datatype, dataset, dataspace;
-  hid_t attr;
-  hsize_t *file_dims;
-  herr_t status;                             
-  int file_n_dims, dm_itn_version, n_complex,i;
+  dm_array_real_struct no_error_array_struct;
+  char filename[FILENAME_MAX];
+  haddr_t offset;
+  off_t data_offset, map_offset;
+  size_t page_size, local_bytes;
+  void *map_address;
+  int fd, mappable;
+#if USE_MPI
+  int all_mapped;
+#endif
 
   strcpy(error_string,"");
+  ptr_map->map_address = NULL;
+  ptr_map->map_length = 0;
+  ptr_map->is_mapped = 0;
+  ptr_adi_array_struct->real_array = NULL;
+  ptr_adi_array_struct->local_npix = ptr_adi_array_struct->npix/p;
 
+  mappable = 0;
   if (my_rank == 0) {
-      if ((itn_group = H5Gopen(h5_file_id,"/itn")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/itn\") error");
-          H5Gclose(itn_group);
-          return(DM_FILEIO_FAILURE);
+      mappable = dm_h5_adi_is_mappable(h5_file_id,ptr_adi_array_struct,
+                                       filename,FILENAME_MAX,&offset);
+  } /* endif(my_rank == 0) */
+  
+#if USE_MPI
+  MPI_Bcast(&mappable,1,MPI_INT,0,MPI_COMM_WORLD);
+  if (mappable == 1) {
+      MPI_Bcast(filename,FILENAME_MAX,MPI_CHAR,0,MPI_COMM_WORLD);
+      MPI_Bcast(&offset,sizeof(haddr_t),MPI_BYTE,0,MPI_COMM_WORLD);
+  }
+#endif
+
+  if (mappable == 1) {
+      /* Every process maps its own slab of the array. The offset given
+       * to mmap() has to be a multiple of the page size, so we map from
+       * the page boundary below the slab and point real_array into it.
+       * The mapping is writable but MAP_PRIVATE, so pages the caller
+       * changes are copied and the file itself is never modified.
+       */
+      page_size = (size_t)sysconf(_SC_PAGESIZE);
+      local_bytes = 
+          (size_t)ptr_adi_array_struct->local_npix*sizeof(dm_array_real);
+      data_offset = (off_t)offset + (off_t)my_rank*(off_t)local_bytes;
+      map_offset = data_offset - (data_offset % (off_t)page_size);
+      
+      if ((fd = open(filename,O_RDONLY)) >= 0) {
+          map_address = mmap(NULL,(size_t)(data_offset-map_offset)+local_bytes,
+                             PROT_READ | PROT_WRITE,MAP_PRIVATE,
+                             fd,map_offset);
+          close(fd);
+          if (map_address != MAP_FAILED) {
+              ptr_map->map_address = map_address;
+              ptr_map->map_length = 
+                  (size_t)(data_offset-map_offset)+local_bytes;
+              ptr_map->is_mapped = 1;
+              ptr_adi_array_struct->real_array = (dm_array_real *)
+                  ((char *)map_address+(data_offset-map_offset));
+          }
       }
 
-      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
-          strcpy(error_string,"H5Tcopy(datatype) error");
+#if USE_MPI
+      /* dm_h5_read_adi() has to be called by everyone, so if one
+       * process could not map its slab nobody uses the mapping.
+       */
+      MPI_Allreduce(&ptr_map->is_mapped,&all_mapped,1,MPI_INT,MPI_MIN,
+                    MPI_COMM_WORLD);
+      if ((all_mapped == 0) && (ptr_map->is_mapped == 1)) {
+          dm_h5_unmap_adi(ptr_map,ptr_adi_array_struct);
+      }
+#endif
+  } /* endif(mappable == 1) */
+
+  if (ptr_map->is_mapped == 0) {
+      /* Fall back to reading the array into memory */
+      DM_ARRAY_REAL_STRUCT_INIT(ptr_adi_array_struct,
+                                ptr_adi_array_struct->npix,p);
+      no_error_array_struct.nx = 0;
+      no_error_array_struct.ny = 0;
+      no_error_array_struct.nz = 0;
+      no_error_array_struct.npix = 0;
+      if (dm_h5_read_adi(h5_file_id,ptr_adi_array_struct,
+                         &no_error_array_struct,
+                         error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+          free(ptr_adi_array_struct->real_array);
+          ptr_adi_array_struct->real_array = NULL;
+          return(DM_FILEIO_FAILURE);
+      }
+  }
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_unmap_adi(dm_h5_map_struct *ptr_map,
+                     dm_array_real_struct *ptr_adi_array_struct)
+{
+  if (ptr_map->is_mapped == 1) {
+      munmap(ptr_map->map_address,ptr_map->map_length);
+  } else if (ptr_adi_array_struct->real_array != NULL) {
+      free(ptr_adi_array_struct->real_array);
+  }
+  ptr_adi_array_struct->real_array = NULL;
+  ptr_map->map_address = NULL;
+  ptr_map->map_length = 0;
+  ptr_map->is_mapped = 0;
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_spt_info(hid_t h5_file_id,
+			int *ptr_nx, int *ptr_ny, int *ptr_nz,
+			dm_spt_struct *ptr_spt_struct,
+			char *error_string,
+                        int my_rank)
+{
+  hid_t spt_group;
+  hid_t datatype, dataspace, dataset;
+  hid_t attr;
+  hsize_t *arr_dims;
+  herr_t status;                             
+  int arr_n_dims, dm_spt_version;
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+
+      if ((spt_group = H5Gopen(h5_file_id,"/spt")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/spt\") error");
+          H5Gclose(spt_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
           H5Tclose(datatype);
           return(DM_FILEIO_FAILURE);
       }
       H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(itn_group,"itn_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(itn_version) error");
+      if ((attr = H5Aopen_name(spt_group,"spt_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(spt_version) error");
           H5Aclose(attr);
           H5Tclose(datatype);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
       if ((status = H5Aread(attr,datatype,
-                            &dm_itn_version)) < 0) {
-          strcpy(error_string,"H5Aread(itn_version) error");
+                            &dm_spt_version)) < 0) {
+          strcpy(error_string,"H5Aread(spt_version) error");
           H5Aclose(attr);
           H5Tclose(datatype);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Aclose(attr);
       H5Tclose(datatype);
   
-      if (dm_itn_version > DM_ITN_VERSION) {
+      if (dm_spt_version > DM_SPT_VERSION) {
           sprintf(error_string,
-                  "Can only handle ITN version up to %d, not %d",
-                  DM_ITN_VERSION,dm_itn_version);
-          H5Gclose(itn_group);
+                  "Can only handle SPT version up to %d, not %d",
+                  DM_SPT_VERSION,dm_spt_version);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
   
-      /*--- check on dimensions of itn_array ---*/
-      if ((dataset = H5Dopen(itn_group,"itn_array")) < 0) {
-          strcpy(error_string,"H5Dopen(\"itn_array\") error");
+      /*--- check on dimensions of spt_array ---*/
+      if ((dataset = H5Dopen(spt_group,"spt_array")) < 0) {
+          strcpy(error_string,"H5Dopen(\"spt_array\") error");
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
 
       if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_space(itn_array) error");
+          strcpy(error_string,"H5Dget_space(spt_array) error");
           H5Sclose(dataspace);
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
-      file_n_dims = H5Sget_simple_extent_ndims(dataspace);
-      file_dims = (hsize_t *)malloc(file_n_dims*sizeof(hsize_t));
-      if ((status = H5Sget_simple_extent_dims(dataspace,file_dims,NULL)) < 0) {
-          strcpy(error_string,"H5Dget_simple_extent_dims(itn_array) error");
-          free(file_dims);
+      arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
+      arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
+      if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
+          strcpy(error_string,"H5Dget_simple_extent_dims(spt_array) error");
+          free(arr_dims);
           H5Sclose(dataspace);
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
 
-      if (file_n_dims == 2) {
-          *ptr_nx = (*(file_dims+0));
-          n_complex = (*(file_dims+1));
+      if (arr_n_dims == 1) {
+          *ptr_nx = (*(arr_dims+0));
           *ptr_ny = 1;
           *ptr_nz = 1;
-      } else if (file_n_dims == 3) {
-          *ptr_ny = (*(file_dims+0));
-          *ptr_nx = (*(file_dims+1));
-          n_complex = (*(file_dims+2));
+      } else if (arr_n_dims == 2) {
+          *ptr_ny = (*(arr_dims+0));
+          *ptr_nx = (*(arr_dims+1));
           *ptr_nz = 1;
-      } else if (file_n_dims == 4) {
-          *ptr_nz = (*(file_dims+0));
-          *ptr_ny = (*(file_dims+1));
-          *ptr_nx = (*(file_dims+2));
-          n_complex = (*(file_dims+3));
+      } else if (arr_n_dims == 3) {
+          *ptr_nz = (*(arr_dims+0));
+          *ptr_ny = (*(arr_dims+1));
+          *ptr_nx = (*(arr_dims+2));
       } else {
           sprintf(error_string,
-                  "Error: ITN array n_dims=%d rather than 2, 3, or 4 for complex",
-                  (int)file_n_dims);
-          free(file_dims);
+		  "Error: SPT array n_dims=%d rather than 1, 2, or 3",
+                  (int)arr_n_dims);
+          free(arr_dims);
           H5Sclose(dataspace);
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }    
-      free(file_dims);
-
-      if (n_complex != 2) {
-          sprintf(error_string,
-                  "Error: ITN array should have fast index=2 not %d for complex",
-                  (int)n_complex);
-          H5Sclose(dataspace);
-	  H5Dclose(dataset);
-          H5Gclose(itn_group);
-          return(DM_FILEIO_FAILURE);
-      }
+      free(arr_dims);
       H5Sclose(dataspace);
       H5Dclose(dataset);
-      
 
-      /*--- check on dimensions of recon_errors ---*/
-      if ((dataset = H5Dopen(itn_group,"recon_errors")) < 0) {
-	/* It does not exist, in this case simply return 0 */
-	*ptr_recon_errors_npix = -1;
-
-      } else {
-	if ((dataspace = H5Dget_space(dataset)) < 0) {
-          strcpy(error_string,"H5Dget_space(itn_array) error");
-          H5Sclose(dataspace);
-          H5Dclose(dataset);
-          H5Gclose(itn_group);
-          return(DM_FILEIO_FAILURE);
-	}
-
-	file_n_dims = 1;
-	file_dims = (hsize_t *)malloc(file_n_dims*sizeof(hsize_t));
-	if ((status = 
-	     H5Sget_simple_extent_dims(dataspace,file_dims,NULL)) < 0) {
-          strcpy(error_string,"H5Dget_simple_extent_dims(recon_errors) error");
-          free(file_dims);
-          H5Sclose(dataspace);
-	  H5Dclose(dataset);
-          H5Gclose(itn_group);
-          return(DM_FILEIO_FAILURE);
-	}
-	*ptr_recon_errors_npix = *(file_dims + 0);
-
-	free(file_dims);
-      }
   } /* endif(my_rank == 0) */
-  
-  /* Send info on array size to other processes if necesary */
+
+    /* Send info on array size to other processes if necesary */
 #if USE_MPI
   MPI_Bcast(ptr_nx,1,MPI_INT,0,MPI_COMM_WORLD);
   MPI_Bcast(ptr_ny,1,MPI_INT,0,MPI_COMM_WORLD);
   MPI_Bcast(ptr_nz,1,MPI_INT,0,MPI_COMM_WORLD);
 #endif /* USE_MPI */
-  
+
   /*----------------------------------------------------------------*/
-  /* Now get itn_struct */
+  /* Now get spt_struct */
   if (my_rank == 0) {
-      if ((dataset = H5Dopen(itn_group,"itn_struct")) < 0) {
-          strcpy(error_string,"H5Dopen(itn_struct) error");
+      if ((dataset = H5Dopen(spt_group,"spt_struct")) < 0) {
+          strcpy(error_string,"H5Dopen(spt_struct) error");
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Gget_space(spt_struct) error");
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
-
       if ((datatype = H5Tcreate(H5T_COMPOUND,
-                                sizeof(dm_itn_struct))) < 0) {
-          strcpy(error_string,"H5Tcreate(itn_struct) error");
+                                sizeof(dm_spt_struct))) < 0) {
+          strcpy(error_string,"H5Tcreate(spt_struct) error");
           H5Tclose(datatype);
+          H5Sclose(dataspace);
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
-      dm_h5_insert_itn_struct_members(datatype);
-  
+      dm_h5_insert_spt_struct_members(datatype);
+      
       if ((status = H5Dread(dataset,datatype,
                             H5S_ALL,H5S_ALL,H5P_DEFAULT,
-                            ptr_itn_struct)) < 0) {
-          strcpy(error_string,"H5Dread(itn_struct) error");
+                            ptr_spt_struct)) < 0) {
+          strcpy(error_string,"H5Dread(spt_struct) error");
           H5Tclose(datatype);
+          H5Sclose(dataspace);
           H5Dclose(dataset);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Tclose(datatype);
+      H5Sclose(dataspace);
       H5Dclose(dataset);
-      H5Gclose(itn_group);
-
+      H5Gclose(spt_group);
+      
   } /* endif(my_rank == 0) */
+  
   return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-int dm_h5_read_itn(hid_t h5_file_id,
-		   dm_array_real_struct *ptr_recon_errors,
-		   dm_array_complex_struct *ptr_itn_array_struct,
+int dm_h5_read_spt(hid_t h5_file_id,
+		   dm_array_byte_struct *ptr_spt_array_struct,
 		   char *error_string,
                    int my_rank,
                    int p)
 {
-  hid_t itn_group;
-  hid_t datatype, dataset;
-  hid_t file_dataspace, memory_dataspace;
-  hid_t mem_type_id, local_datatype, read_datatype;
-  hsize_t memory_dims[4], file_offsets[4], file_counts[4];
+  hid_t spt_group;
+  hid_t datatype, dataspace, dataset;
+  hid_t mem_type_id;
   hid_t attr;
-  hsize_t *file_dims;
-  herr_t status;
-  int file_n_dims, dm_itn_version, n_complex;
+  hsize_t *arr_dims;
+  herr_t status;                             
+  int arr_n_dims, dm_spt_version;
   int local_nx, local_ny, local_nz;
-  dm_array_index_t iz, zoffset, ipix, slice_npix;
-  dm_array_real *slice_array;
-  H5T_order_t order, local_order;
 #if USE_MPI
+  hsize_t *file_offsets, *file_counts;
+  hid_t memspace;
   int i;
+  dm_array_real *slice_array;
   MPI_Status mpi_status;
 #endif
 
-  strcpy(error_string,"");
-  
   if (my_rank == 0) {
-      if ((itn_group = H5Gopen(h5_file_id,"/itn")) < 0) {
-          strcpy(error_string,"H5Gopen(\"/itn\") error");
-          H5Gclose(itn_group);
+      strcpy(error_string,"");
+      
+      if ((spt_group = H5Gopen(h5_file_id,"/spt")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/spt\") error");
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
-      
+  
       if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
           strcpy(error_string,"H5Tcopy(datatype) error");
           H5Tclose(datatype);
           return(DM_FILEIO_FAILURE);
       }
       H5Tset_size(datatype,H5_SIZEOF_INT);
-      if ((attr = H5Aopen_name(itn_group,"itn_version")) < 0) {
-          strcpy(error_string,"H5Aopen_name(itn_version) error");
+      if ((attr = H5Aopen_name(spt_group,"spt_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(spt_version) error");
           H5Aclose(attr);
           H5Tclose(datatype);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
       if ((status = H5Aread(attr,datatype,
-                            &dm_itn_version)) < 0) {
+                            &dm_spt_version)) < 0) {
           strcpy(error_string,"H5Aread(comment_string_length) error");
           H5Aclose(attr);
           H5Tclose(datatype);
-          H5Gclose(itn_group);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
       H5Aclose(attr);
       H5Tclose(datatype);
-      
-      if (dm_itn_version > DM_ITN_VERSION) {
+  
+      if (dm_spt_version > DM_SPT_VERSION) {
           sprintf(error_string,
-                  "Can only handle ITN version up to %d, not %d",
-                  DM_ITN_VERSION,dm_itn_version);
-          H5Gclose(itn_group);
+                  "Can only handle SPT version up to %d, not %d",
+                  DM_SPT_VERSION,dm_spt_version);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
       }
-      
-      /* recon_errors */
-      if ((dataset = H5Dopen(itn_group,"recon_errors")) < 0) {
-	/* If there was no recon_errors, don't report an error; just
-	 * set the array size to zero. */
-	ptr_recon_errors->nx = 0;
-	ptr_recon_errors->ny = 0;
-	ptr_recon_errors->nz = 0;
-	ptr_recon_errors->npix = 0;
-	H5Dclose(dataset);
-      } else {
-	if ((datatype = H5Dget_type(dataset)) < 0) {
-	  strcpy(error_string,"H5Dget_type(recon_errors) error");
-	  H5Dclose(dataset);
-	  H5Gclose(itn_group);
-	  return(DM_FILEIO_FAILURE);
-	}
-	
-	/*--- get order of type ---*/
-	if ((order = H5Tget_order(datatype)) < 0) {
-	  strcpy(error_string,"H5Tget_order(recon_errors) error");
-	  H5Dclose(dataset);
-	  H5Tclose(datatype);
-	  H5Gclose(itn_group);
-	  return(DM_FILEIO_FAILURE);
-	}
-      
-	/*--- create local datatype to compare the orders ---*/
-	if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
-	  strcpy(error_string,"H5Tcopy(recon_errors) error");
-	  H5Dclose(dataset);
-	  H5Tclose(datatype);
-	  H5Gclose(itn_group);
-	  return(DM_FILEIO_FAILURE);
-	}
-	
-	/*--- get order of local type ---*/
-	if ((local_order = H5Tget_order(local_datatype)) < 0) {
-	  strcpy(error_string,"H5Tget_order(recon_errors) error");
-	  H5Dclose(dataset);
-	  H5Tclose(datatype);
-	  H5Gclose(itn_group);
-	  H5Tclose(local_datatype);
+  
+      /*--- spt_array ---*/
+      if ((dataset = H5Dopen(spt_group,"spt_array")) < 0) {
+          strcpy(error_string,"H5Dopen(\"spt_array\") error");
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
           return(DM_FILEIO_FAILURE);
-	}
-	
-	/*--- Convert to local order if necessary ---*/
-	read_datatype = H5Tcopy(datatype);
-	if (local_order != order) {
-	  if ((status = H5Tset_order(read_datatype,local_order)) < 0) {
-	    strcpy(error_string,"H5Tset_order(recon_errors) error");
-	    H5Dclose(dataset);
-	    H5Tclose(datatype);
-	    H5Tclose(local_datatype);
-	    H5Gclose(itn_group);
-	    return(DM_FILEIO_FAILURE);
-	  } 
-	}
-	
-	if ((status =
-	     H5Dread(dataset,read_datatype,H5S_ALL,H5S_ALL,H5P_DEFAULT,
-		     ptr_recon_errors->real_array)) < 0) {
-	  strcpy(error_string, "Error in H5Dread (recon_errors)");
-	  H5Tclose(datatype);
-	  H5Gclose(itn_group);
-	  H5Tclose(local_datatype);
-	  H5Tclose(read_datatype);
-	  H5Dclose(dataset);
-	  return(DM_FILEIO_FAILURE);
-	}
-	
-	H5Tclose(local_datatype);
-	H5Tclose(datatype);
-	H5Tclose(read_datatype);
-	H5Dclose(dataset);
-      }
-      
-      /*--- itn_array ---*/
-      if ((dataset = H5Dopen(itn_group,"itn_array")) < 0) {
-	strcpy(error_string,"H5Dopen(\"itn_array\") error");
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
       }
       if ((datatype = H5Dget_type(dataset)) < 0) {
-	strcpy(error_string,"H5Dget_type(itn_array) error");
-	H5Tclose(datatype);
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
-      }
-      
-      /*--- get order of type ---*/
-      if ((order = H5Tget_order(datatype)) < 0) {
-	strcpy(error_string,"H5Tget_order(itn_array) error");
-	H5Dclose(dataset);
-	H5Tclose(datatype);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
+          strcpy(error_string,"H5Dget_type(spt_array) error");
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
+          return(DM_FILEIO_FAILURE);
       }
-      
-      /*--- create local datatype to compare the orders ---*/
-      if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
-	strcpy(error_string,"H5Tcopy(itn_array) error");
-	H5Dclose(dataset);
-	H5Tclose(datatype);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(spt_array) error");
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
+          return(DM_FILEIO_FAILURE);
       }
-      
-      /*--- get order of local type ---*/
-      if ((local_order = H5Tget_order(local_datatype)) < 0) {
-	strcpy(error_string,"H5Tget_order(itn_array) error");
-	H5Dclose(dataset);
-	H5Tclose(datatype);
-	H5Gclose(itn_group);
-	H5Tclose(local_datatype);
-	return(DM_FILEIO_FAILURE);
+      arr_n_dims = H5Sget_simple_extent_ndims(dataspace);
+      arr_dims = (hsize_t *)malloc(arr_n_dims*sizeof(hsize_t));
+      if ((status = H5Sget_simple_extent_dims(dataspace,arr_dims,NULL)) < 0) {
+          strcpy(error_string,"H5Dget_simple_extent_dims(spt_array) error");
+          free(arr_dims);
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
+          return(DM_FILEIO_FAILURE);
       }
-      
-      /*--- Convert to local order if necessary ---*/
-      read_datatype = H5Tcopy(datatype);
-      if (local_order != order) {
-	if ((status = H5Tset_order(read_datatype,local_order)) < 0) {
-	  strcpy(error_string,"H5Tset_order(itn_array) error");
-	  H5Dclose(dataset);
-	  H5Tclose(datatype);
-	  H5Tclose(local_datatype);
-	  H5Gclose(itn_group);
-	  return(DM_FILEIO_FAILURE);
-	} 
+    
+      if (arr_n_dims == 1) {
+          local_nx = (*(arr_dims+0));
+          local_ny = 1;
+          local_nz = 1;
+#if USE_MPI
+          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_offsets + 0) = 0; /* Will be adjusted for each slice */
+          
+          /* Note that we have to divide by the number of processes here.
+           */
+          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_counts + 0) = (*(arr_dims+0))/p;
+#endif
+      } else if (arr_n_dims == 2) {
+          local_ny = (*(arr_dims+0));
+          local_nx = (*(arr_dims+1));
+          local_nz = 1;
+#if USE_MPI
+          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_offsets + 0) = 0;
+          *(file_offsets + 1) = 0; /* Will be adjusted for each slice */
+          
+          /* Note that we have to divide by the number of processes here.
+           */
+          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_counts + 0) = (*(arr_dims+0))/p;
+          *(file_counts + 1) = (*(arr_dims+1));
+#endif
+      } else if (arr_n_dims == 3) {
+          local_nz = (*(arr_dims+0));
+          local_ny = (*(arr_dims+1));
+          local_nx = (*(arr_dims+2));
+#if USE_MPI
+          file_offsets = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_offsets + 0) = 0;
+          *(file_offsets + 1) = 0;
+          *(file_offsets + 2) = 0; /* Will be adjusted for each slice */
+           
+          /* Note that we have to divide by the number of processes here.
+           */
+          file_counts = malloc(arr_n_dims*sizeof(hsize_t));
+          *(file_counts + 0) = (*(arr_dims+0))/p;
+          *(file_counts + 1) = (*(arr_dims+1));
+          *(file_counts + 2) = (*(arr_dims+2));
+#endif
+      } else {
+          sprintf(error_string,"SPT array n_dims=%d rather than 1, 2, or 3",
+                  (int)arr_n_dims);
+          free(arr_dims);
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
+          return(DM_FILEIO_FAILURE);
+      }    
+      free(arr_dims);
+  
+      if ((local_nx != ptr_spt_array_struct->nx) ||
+          (local_ny != ptr_spt_array_struct->ny) ||
+          (local_nz != ptr_spt_array_struct->nz)) {
+          sprintf(error_string,"SPT array dimensions are [%d,%d,%d] not [%d,%d,%d]",
+                  local_nx,local_ny,local_nz,
+                  ptr_spt_array_struct->nx,ptr_spt_array_struct->ny,
+                  ptr_spt_array_struct->nz);
+          H5Sclose(dataspace);
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(spt_group);
+#if USE_MPI
+          free(file_offsets);
+          free(file_counts);
+#endif
+          return(DM_FILEIO_FAILURE);
       }
-      H5Tclose(local_datatype);
-      H5Tclose(datatype);
-      
-      if ((file_dataspace = H5Dget_space(dataset)) < 0) {
-	strcpy(error_string,"H5Dget_space(itn_array) error");
-	H5Sclose(file_dataspace);
-	H5Tclose(read_datatype);
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
+  
+      mem_type_id = H5Tcopy(H5T_NATIVE_UINT8);
+
+  } /* endif(my_rank == 0) */
+
+  #if USE_MPI
+  /* Distribute data onto nodes. npix will tell us the total number of
+   * elements so we need to divide by the number of processes..
+   */
+  for (i = 0; i < p; i++) {
+      if (my_rank == 0) {
+          
+          /* Determine the file_offsets here. Note that we have to
+           * divide by number of processes.
+           */
+          if (arr_n_dims == 1) {
+              file_offsets[0] = i*ptr_spt_array_struct->nx/p;
+          } else if (arr_n_dims == 2) {
+              file_offsets[0] = i*ptr_spt_array_struct->ny/p;
+          } else if (arr_n_dims == 3) {
+              file_offsets[0] = i*ptr_spt_array_struct->nz/p;
+          }
+
+          if ((memspace =
+               H5Screate_simple(arr_n_dims,file_counts,NULL)) < 0) {
+              sprintf(error_string,"H5Screate_simple(adi_array) error");
+              H5Sclose(dataspace);
+              H5Tclose(mem_type_id);
+              H5Dclose(dataset);
+              H5Gclose(spt_group);
+              free(file_offsets);
+              free(file_counts);
+              free(slice_array);
+              return(DM_FILEIO_FAILURE);
+          }
+
+          if ((status = H5Sselect_hyperslab(dataspace, H5S_SELECT_SET,
+                                            file_offsets, NULL,
+                                            file_counts, NULL)) < 0) {
+              strcpy(error_string,
+                     "Error in H5Sselect_hyperslab(adi_array)");
+              H5Sclose(dataspace);
+              H5Sclose(memspace);
+              H5Tclose(mem_type_id);
+              H5Gclose(spt_group);
+              free(file_offsets);
+              free(file_counts);
+              free(slice_array);
+              return(DM_FILEIO_FAILURE);
+          }
+
+          if (i == 0) {
+              /* read directly into spt_array_struct */
+              if ((status = H5Dread(dataset,mem_type_id,
+                                    memspace,dataspace,H5P_DEFAULT,
+                                    ptr_spt_array_struct->byte_array)) < 0) {
+                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
+                  H5Sclose(dataspace);
+                  H5Sclose(memspace);
+                  H5Tclose(mem_type_id);
+                  H5Gclose(spt_group);
+                  free(file_offsets);
+                  free(file_counts);
+                  return(DM_FILEIO_FAILURE);
+              }
+
+          } else {
+              slice_array =
+                  (dm_array_real *)malloc(sizeof(dm_array_real)*
+                                          ptr_spt_array_struct->npix/p);
+
+              if ((status = H5Dread(dataset,mem_type_id,
+                                    memspace,dataspace,H5P_DEFAULT,
+                                    slice_array)) < 0) {
+                  strcpy(error_string, "Error in H5Dwrite (adi_array)");
+                  H5Sclose(dataspace);
+                  H5Sclose(memspace);
+                  H5Tclose(mem_type_id);
+                  H5Gclose(spt_group);
+                  free(file_offsets);
+                  free(file_counts);
+                  free(slice_array);
+                  return(DM_FILEIO_FAILURE);
+              }
+              
+              MPI_Send(slice_array,ptr_spt_array_struct->npix/p,
+                       MPI_BYTE,i,99,MPI_COMM_WORLD);
+              
+              free(slice_array);
+          } /* endif(i == 0) */
+      }  /* endif(my_rank == 0) */
+            
+      if (i > 0) {
+          if (my_rank == i) {
+              
+              MPI_Recv(ptr_spt_array_struct->byte_array,
+                       ptr_spt_array_struct->npix/p,
+                       MPI_BYTE, 0, 99,MPI_COMM_WORLD,&mpi_status);
+              
+          } /* endif(my_rank == i) */
+      } /* endif(i > 0) */
+  } /* endfor */
+          
+#else /* no USE_MPI */  
+  if ((status = H5Dread(dataset,mem_type_id,
+			H5S_ALL,H5S_ALL,H5P_DEFAULT,
+			ptr_spt_array_struct->byte_array)) < 0) {
+      sprintf(error_string,"H5Dread(spt_array) error");
+      H5Sclose(dataspace);
+      H5Tclose(datatype);
+      H5Dclose(dataset);
+      H5Gclose(spt_group);
+      return(DM_FILEIO_FAILURE);
+  }
+
+#endif /* USE_MPI */
+  if (my_rank == 0) {
+      H5Sclose(dataspace);
+      H5Tclose(datatype);
+      H5Dclose(dataset);
+#if USE_MPI
+      H5Sclose(memspace);
+      free(file_offsets);
+      free(file_counts);
+#endif
+  } /* endif(my_rank == 0) */
+
+  if (my_rank == 0) {
+      H5Gclose(spt_group);
+  } /* endif(my_rank == 0) */
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_spt_bit(hid_t h5_file_id,
+		       dm_array_bit_struct *ptr_spt_bit_struct,
+		       char *error_string,
+		       int my_rank,
+		       int p)
+{
+  dm_array_byte_struct spt_array_struct;
+  dm_array_index_t ipix, n_words;
+  int status;
+
+  spt_array_struct.nx = ptr_spt_bit_struct->nx;
+  spt_array_struct.ny = ptr_spt_bit_struct->ny;
+  spt_array_struct.nz = ptr_spt_bit_struct->nz;
+  spt_array_struct.npix = ptr_spt_bit_struct->npix;
+  spt_array_struct.local_offset = ptr_spt_bit_struct->local_offset;
+  DM_ARRAY_BYTE_STRUCT_INIT((&spt_array_struct),spt_array_struct.npix,p);
+
+  status = dm_h5_read_spt(h5_file_id,&spt_array_struct,
+			  error_string,my_rank,p);
+  if (status == DM_FILEIO_SUCCESS) {
+    n_words = (spt_array_struct.local_npix+63)/64;
+    for (ipix=0; ipix<n_words; ipix++) {
+      *(ptr_spt_bit_struct->bit_array+ipix) = 0;
+    }
+    for (ipix=0; ipix<spt_array_struct.local_npix; ipix++) {
+      if (*(spt_array_struct.byte_array+ipix) != 0) {
+	*(ptr_spt_bit_struct->bit_array+ipix/64) |= 
+	  ((u_int64_t)1 << (ipix%64));
+      }
+    }
+  }
+  free(spt_array_struct.byte_array);
+
+  return(status);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_itn_info(hid_t h5_file_id,
+			int *ptr_nx, int *ptr_ny, int *ptr_nz,
+			int *ptr_recon_errors_npix,
+			dm_itn_struct *ptr_itn_struct,
+			char *error_string,
+                        int my_rank)
+{
+  hid_t itn_group;
+  hid_t datatype, dataset, dataspace;
+  hid_t attr;
+  hsize_t *file_dims;
+  herr_t status;                             
+  int file_n_dims, dm_itn_version, n_complex,i;
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+      if ((itn_group = H5Gopen(h5_file_id,"/itn")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/itn\") error");
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
+          H5Tclose(datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tset_size(datatype,H5_SIZEOF_INT);
+      if ((attr = H5Aopen_name(itn_group,"itn_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(itn_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Aread(attr,datatype,
+                            &dm_itn_version)) < 0) {
+          strcpy(error_string,"H5Aread(itn_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Aclose(attr);
+      H5Tclose(datatype);
+  
+      if (dm_itn_version > DM_ITN_VERSION) {
+          sprintf(error_string,
+                  "Can only handle ITN version up to %d, not %d",
+                  DM_ITN_VERSION,dm_itn_version);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+  
+      /*--- check on dimensions of itn_array ---*/
+      if ((dataset = H5Dopen(itn_group,"itn_array")) < 0) {
+          strcpy(error_string,"H5Dopen(\"itn_array\") error");
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(itn_array) error");
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      file_n_dims = H5Sget_simple_extent_ndims(dataspace);
+      file_dims = (hsize_t *)malloc(file_n_dims*sizeof(hsize_t));
+      if ((status = H5Sget_simple_extent_dims(dataspace,file_dims,NULL)) < 0) {
+          strcpy(error_string,"H5Dget_simple_extent_dims(itn_array) error");
+          free(file_dims);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if (file_n_dims == 2) {
+          *ptr_nx = (*(file_dims+0));
+          n_complex = (*(file_dims+1));
+          *ptr_ny = 1;
+          *ptr_nz = 1;
+      } else if (file_n_dims == 3) {
+          *ptr_ny = (*(file_dims+0));
+          *ptr_nx = (*(file_dims+1));
+          n_complex = (*(file_dims+2));
+          *ptr_nz = 1;
+      } else if (file_n_dims == 4) {
+          *ptr_nz = (*(file_dims+0));
+          *ptr_ny = (*(file_dims+1));
+          *ptr_nx = (*(file_dims+2));
+          n_complex = (*(file_dims+3));
+      } else {
+          sprintf(error_string,
+                  "Error: ITN array n_dims=%d rather than 2, 3, or 4 for complex",
+                  (int)file_n_dims);
+          free(file_dims);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }    
+      free(file_dims);
+
+      if (n_complex != 2) {
+          sprintf(error_string,
+                  "Error: ITN array should have fast index=2 not %d for complex",
+                  (int)n_complex);
+          H5Sclose(dataspace);
+	  H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Sclose(dataspace);
+      H5Dclose(dataset);
+      
+
+      /*--- check on dimensions of recon_errors ---*/
+      if ((dataset = H5Dopen(itn_group,"recon_errors")) < 0) {
+	/* It does not exist, in this case simply return 0 */
+	*ptr_recon_errors_npix = -1;
+
+      } else {
+	if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(itn_array) error");
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+	}
+
+	file_n_dims = 1;
+	file_dims = (hsize_t *)malloc(file_n_dims*sizeof(hsize_t));
+	if ((status = 
+	     H5Sget_simple_extent_dims(dataspace,file_dims,NULL)) < 0) {
+          strcpy(error_string,"H5Dget_simple_extent_dims(recon_errors) error");
+          free(file_dims);
+          H5Sclose(dataspace);
+	  H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+	}
+	*ptr_recon_errors_npix = *(file_dims + 0);
+
+	free(file_dims);
+      }
+  } /* endif(my_rank == 0) */
+  
+  /* Send info on array size to other processes if necesary */
+#if USE_MPI
+  MPI_Bcast(ptr_nx,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_ny,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_nz,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+  
+  /*----------------------------------------------------------------*/
+  /* Now get itn_struct */
+  if (my_rank == 0) {
+      if ((dataset = H5Dopen(itn_group,"itn_struct")) < 0) {
+          strcpy(error_string,"H5Dopen(itn_struct) error");
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((datatype = H5Tcreate(H5T_COMPOUND,
+                                sizeof(dm_itn_struct))) < 0) {
+          strcpy(error_string,"H5Tcreate(itn_struct) error");
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      dm_h5_insert_itn_struct_members(datatype);
+  
+      if ((status = H5Dread(dataset,datatype,
+                            H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                            ptr_itn_struct)) < 0) {
+          strcpy(error_string,"H5Dread(itn_struct) error");
+          H5Tclose(datatype);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tclose(datatype);
+      H5Dclose(dataset);
+      H5Gclose(itn_group);
+
+  } /* endif(my_rank == 0) */
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_itn(hid_t h5_file_id,
+		   dm_array_real_struct *ptr_recon_errors,
+		   dm_array_complex_struct *ptr_itn_array_struct,
+		   char *error_string,
+                   int my_rank,
+                   int p)
+{
+  hid_t itn_group;
+  hid_t datatype, dataset;
+  hid_t file_dataspace, memory_dataspace;
+  hid_t mem_type_id, local_datatype, read_datatype;
+  hsize_t memory_dims[4], file_offsets[4], file_counts[4];
+  hid_t attr;
+  hsize_t file_dims[4];
+  herr_t status;
+  int i, file_n_dims, memory_n_dims, dm_itn_version, n_complex;
+  int local_nx, local_ny, local_nz;
+  void *ptr_read;
+  H5T_order_t order, local_order;
+#if DM_ARRAY_SPLIT
+  int i_complex;
+#endif
+#if USE_MPI
+  dm_array_index_t slice_npix;
+  dm_array_real *slice_array;
+  MPI_Status mpi_status;
+#endif
+
+  strcpy(error_string,"");
+  
+  if (my_rank == 0) {
+      if ((itn_group = H5Gopen(h5_file_id,"/itn")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/itn\") error");
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
+          H5Tclose(datatype);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tset_size(datatype,H5_SIZEOF_INT);
+      if ((attr = H5Aopen_name(itn_group,"itn_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(itn_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Aread(attr,datatype,
+                            &dm_itn_version)) < 0) {
+          strcpy(error_string,"H5Aread(comment_string_length) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Aclose(attr);
+      H5Tclose(datatype);
+      
+      if (dm_itn_version > DM_ITN_VERSION) {
+          sprintf(error_string,
+                  "Can only handle ITN version up to %d, not %d",
+                  DM_ITN_VERSION,dm_itn_version);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      
+      /* recon_errors */
+      if ((dataset = H5Dopen(itn_group,"recon_errors")) < 0) {
+	/* If there was no recon_errors, don't report an error; just
+	 * set the array size to zero. */
+	ptr_recon_errors->nx = 0;
+	ptr_recon_errors->ny = 0;
+	ptr_recon_errors->nz = 0;
+	ptr_recon_errors->npix = 0;
+	H5Dclose(dataset);
+      } else {
+	if ((datatype = H5Dget_type(dataset)) < 0) {
+	  strcpy(error_string,"H5Dget_type(recon_errors) error");
+	  H5Dclose(dataset);
+	  H5Gclose(itn_group);
+	  return(DM_FILEIO_FAILURE);
+	}
+	
+	/*--- get order of type ---*/
+	if ((order = H5Tget_order(datatype)) < 0) {
+	  strcpy(error_string,"H5Tget_order(recon_errors) error");
+	  H5Dclose(dataset);
+	  H5Tclose(datatype);
+	  H5Gclose(itn_group);
+	  return(DM_FILEIO_FAILURE);
+	}
+      
+	/*--- create local datatype to compare the orders ---*/
+	if ((local_datatype = H5Tcopy(H5T_NATIVE_FLOAT)) < 0) {
+	  strcpy(error_string,"H5Tcopy(recon_errors) error");
+	  H5Dclose(dataset);
+	  H5Tclose(datatype);
+	  H5Gclose(itn_group);
+	  return(DM_FILEIO_FAILURE);
+	}
+	
+	/*--- get order of local type ---*/
+	if ((local_order = H5Tget_order(local_datatype)) < 0) {
+	  strcpy(error_string,"H5Tget_order(recon_errors) error");
+	  H5Dclose(dataset);
+	  H5Tclose(datatype);
+	  H5Gclose(itn_group);
+	  H5Tclose(local_datatype);
+          return(DM_FILEIO_FAILURE);
+	}
+	
+	/*--- Convert to local order if necessary ---*/
+	read_datatype = H5Tcopy(datatype);
+	if (local_order != order) {
+	  if ((status = H5Tset_order(read_datatype,local_order)) < 0) {
+	    strcpy(error_string,"H5Tset_order(recon_errors) error");
+	    H5Dclose(dataset);
+	    H5Tclose(datatype);
+	    H5Tclose(local_datatype);
+	    H5Gclose(itn_group);
+	    return(DM_FILEIO_FAILURE);
+	  } 
+	}
+	
+	if ((status =
+	     H5Dread(dataset,read_datatype,H5S_ALL,H5S_ALL,H5P_DEFAULT,
+		     ptr_recon_errors->real_array)) < 0) {
+	  strcpy(error_string, "Error in H5Dread (recon_errors)");
+	  H5Tclose(datatype);
+	  H5Gclose(itn_group);
+	  H5Tclose(local_datatype);
+	  H5Tclose(read_datatype);
+	  H5Dclose(dataset);
+	  return(DM_FILEIO_FAILURE);
+	}
+	
+	H5Tclose(local_datatype);
+	H5Tclose(datatype);
+	H5Tclose(read_datatype);
+	H5Dclose(dataset);
+      }
+      
+      /*--- itn_array ---*/
+      if ((dataset = H5Dopen(itn_group,"itn_array")) < 0) {
+	strcpy(error_string,"H5Dopen(\"itn_array\") error");
+	H5Gclose(itn_group);
+	return(DM_FILEIO_FAILURE);
+      }
+      
+      if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+	strcpy(error_string,"H5Dget_space(itn_array) error");
+	H5Dclose(dataset);
+	H5Gclose(itn_group);
+	return(DM_FILEIO_FAILURE);
+      }
+      file_n_dims = H5Sget_simple_extent_ndims(file_dataspace);
+      if ((file_n_dims < 2) || (file_n_dims > 4)) {
+	sprintf(error_string,
+		"Error: ITN array n_dims=%d rather than 2, 3, or 4 for complex",
+		(int)file_n_dims);
+	H5Sclose(file_dataspace);
+	H5Dclose(dataset);
+	H5Gclose(itn_group);
+	return(DM_FILEIO_FAILURE);
+      }
+      if ((status =
+           H5Sget_simple_extent_dims(file_dataspace,file_dims,NULL)) < 0) {
+	strcpy(error_string,"H5Dget_simple_extent_dims(itn_array) error");
+	H5Sclose(file_dataspace);
+	H5Dclose(dataset);
+	H5Gclose(itn_group);
+	return(DM_FILEIO_FAILURE);
+      }
+      
+      if (file_n_dims == 2) {
+	local_nx = file_dims[0];
+	local_ny = 1;
+	local_nz = 1;
+      } else if (file_n_dims == 3) {
+	local_ny = file_dims[0];
+	local_nx = file_dims[1];
+	local_nz = 1;
+      } else {
+	local_nz = file_dims[0];
+	local_ny = file_dims[1];
+	local_nx = file_dims[2];
+      }
+      n_complex = file_dims[file_n_dims-1];
+      
+      if (n_complex != 2) {
+	sprintf(error_string,
+		"Error: ITN array should have fast index=2 not %d for complex",
+		(int)n_complex);
+	H5Sclose(file_dataspace);
+	H5Dclose(dataset);
+	H5Gclose(itn_group);
+	return(DM_FILEIO_FAILURE);
+      }    
+      
+      if ((local_nx != ptr_itn_array_struct->nx) ||
+          (local_ny != ptr_itn_array_struct->ny) ||
+          (local_nz != ptr_itn_array_struct->nz)) {
+	sprintf(error_string,"ITN array dimensions are [%d,%d,%d] not [%d,%d,%d]",
+		local_nx,local_ny,local_nz,
+		ptr_itn_array_struct->nx,ptr_itn_array_struct->ny,
+		ptr_itn_array_struct->nz);
+	H5Sclose(file_dataspace);
+	H5Dclose(dataset);
+	H5Gclose(itn_group);
+	return(DM_FILEIO_FAILURE);
+      }
+      
+      /* Each process gets npix/p elements along the slowest dimension.
+       * The memory dataspace has the shape of that slab; for split 
+       * arrays it is flat because real and imaginary parts are read
+       * one at a time (see below).
+       */
+      for (i=0; i<file_n_dims; i++) {
+          file_offsets[i] = 0;
+          file_counts[i] = file_dims[i];
+          memory_dims[i] = file_dims[i];
+      }
+#if USE_MPI
+      file_counts[0] = file_dims[0]/p;
+      memory_dims[0] = file_counts[0];
+#endif /* USE_MPI */
+
+#if DM_ARRAY_SPLIT
+      file_counts[file_n_dims-1] = 1;
+#if USE_MPI
+      memory_dims[0] = ptr_itn_array_struct->npix/p;
+#else /* no USE_MPI */
+      memory_dims[0] = ptr_itn_array_struct->npix;
+#endif /* USE_MPI */
+      memory_n_dims = 1;
+#else
+      memory_n_dims = file_n_dims;
+#endif /* DM_ARRAY_SPLIT */
+      
+      if ((memory_dataspace = H5Screate_simple(memory_n_dims, memory_dims, 
+                                               NULL)) < 0) {
+          strcpy(error_string,"H5Screate_simple(itn_array,memory) error");
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+  } /* endif(my_rank == 0) */
+  
+  /* We no longer stage the data in an interleaved slice_array.  For
+   * interleaved complex arrays the memory layout is the same as the
+   * [..,2] fast dimension in the file, so H5Dread() goes straight
+   * into complex_array.  For split arrays we select every other
+   * element along the fast dimension in the file and read real and
+   * imaginary parts directly into their own arrays.  Reading with
+   * the native type lets HDF 5 take care of byte order and precision.
+   * With MPI, only the parts that go to the other processes need a
+   * buffer on the root process.
+   */
+#if USE_MPI
+  slice_npix = ptr_itn_array_struct->npix/p;
+  if (my_rank == 0) {
+      if (p > 1) {
+          slice_array = (dm_array_real *)malloc(2*sizeof(dm_array_real)*
+                                                slice_npix);
+          if (slice_array == NULL) {
+              strcpy(error_string,"slice malloc() error");
+              H5Sclose(memory_dataspace);
+              H5Sclose(file_dataspace);
+              H5Dclose(dataset);
+              H5Gclose(itn_group);
+              return(DM_FILEIO_FAILURE);
+          }
+      }
+      
+      for (i = 0; i < p; i++) {
+          file_offsets[0] = i*file_counts[0];
+#if DM_ARRAY_SPLIT
+          for (i_complex = 0; i_complex < 2; i_complex++) {
+              file_offsets[file_n_dims-1] = i_complex;
+              if (i == 0) {
+                  ptr_read = (i_complex == 0) ? 
+                      (ptr_itn_array_struct->complex_array)->re :
+                      (ptr_itn_array_struct->complex_array)->im;
+              } else {
+                  ptr_read = slice_array+i_complex*slice_npix;
+              }
+#else
+              ptr_read = (i == 0) ? 
+                  (void *)ptr_itn_array_struct->complex_array : 
+                  (void *)slice_array;
+#endif /* DM_ARRAY_SPLIT */
+              if (((status = H5Sselect_hyperslab(file_dataspace, 
+                                                 H5S_SELECT_SET,
+                                                 file_offsets, NULL,
+                                                 file_counts, NULL)) < 0) ||
+                  ((status = H5Dread(dataset, DM_H5_ARRAY_REAL, 
+                                     memory_dataspace, file_dataspace,
+                                     H5P_DEFAULT, ptr_read)) < 0)) {
+                  strcpy(error_string, "Error in H5Dread(itn_array)");
+                  if (p > 1) 
+                      free(slice_array);
+                  H5Sclose(file_dataspace);
+                  H5Sclose(memory_dataspace);
+                  H5Dclose(dataset);
+                  H5Gclose(itn_group);
+                  return(DM_FILEIO_FAILURE);
+              }
+#if DM_ARRAY_SPLIT
+          } /* endfor(i_complex) */
+          if (i > 0) {
+              MPI_Send(slice_array,slice_npix,MPI_ARRAY_REAL,
+                       i,99,MPI_COMM_WORLD);
+              MPI_Send(slice_array+slice_npix,slice_npix,MPI_ARRAY_REAL,
+                       i,98,MPI_COMM_WORLD);
+          }
+#else
+          if (i > 0) {
+              MPI_Send(slice_array,2*slice_npix,MPI_ARRAY_REAL,
+                       i,99,MPI_COMM_WORLD);
+          }
+#endif /* DM_ARRAY_SPLIT */
+      } /* endfor */
+      if (p > 1) 
+          free(slice_array);
+  } else {
+      /* Receive straight into the local part of the array */
+#if DM_ARRAY_SPLIT
+      MPI_Recv((ptr_itn_array_struct->complex_array)->re,slice_npix,
+               MPI_ARRAY_REAL,0,99,MPI_COMM_WORLD,&mpi_status);
+      MPI_Recv((ptr_itn_array_struct->complex_array)->im,slice_npix,
+               MPI_ARRAY_REAL,0,98,MPI_COMM_WORLD,&mpi_status);
+#else
+      MPI_Recv(ptr_itn_array_struct->complex_array,2*slice_npix,
+               MPI_ARRAY_REAL,0,99,MPI_COMM_WORLD,&mpi_status);
+#endif /* DM_ARRAY_SPLIT */
+  } /* endif(my_rank == 0) */
+  
+#else /* no USE_MPI */
+#if DM_ARRAY_SPLIT
+  for (i_complex = 0; i_complex < 2; i_complex++) {
+      file_offsets[file_n_dims-1] = i_complex;
+      ptr_read = (i_complex == 0) ? 
+          (ptr_itn_array_struct->complex_array)->re :
+          (ptr_itn_array_struct->complex_array)->im;
+#else
+      ptr_read = ptr_itn_array_struct->complex_array;
+#endif /* DM_ARRAY_SPLIT */
+      if (((status = H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                                         file_offsets,NULL,
+                                         file_counts,NULL)) < 0) ||
+          ((status = H5Dread(dataset,DM_H5_ARRAY_REAL,memory_dataspace,
+                             file_dataspace,H5P_DEFAULT,ptr_read)) < 0)) {
+          strcpy(error_string,"Error in H5Dread(itn_array)");
+          H5Dclose(dataset);
+          H5Sclose(file_dataspace);
+          H5Sclose(memory_dataspace);
+          H5Gclose(itn_group);
+          return(DM_FILEIO_FAILURE);
+      }
+#if DM_ARRAY_SPLIT
+  } /* endfor(i_complex) */
+#endif /* DM_ARRAY_SPLIT */
+#endif /* USE_MPI */
+
+  if (my_rank == 0) {
+      H5Dclose(dataset);
+      H5Sclose(file_dataspace);
+      H5Sclose(memory_dataspace);
+      H5Gclose(itn_group);
+  }
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_adi_region(hid_t h5_file_id,
+                          int *region_offsets,
+                          int *region_strides,
+                          dm_array_real_struct *ptr_adi_array_struct,
+                          char *error_string,
+                          int my_rank,
+                          int p)
+{
+  return(dm_h5_read_region(h5_file_id,"/adi/adi_array",DM_H5_ARRAY_REAL,0,
+                           ptr_adi_array_struct->nx,
+                           ptr_adi_array_struct->ny,
+                           ptr_adi_array_struct->nz,
+                           region_offsets,region_strides,
+                           ptr_adi_array_struct->real_array,NULL,
+                           sizeof(dm_array_real),
+                           error_string,my_rank,p));
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_spt_region(hid_t h5_file_id,
+                          int *region_offsets,
+                          int *region_strides,
+                          dm_array_byte_struct *ptr_spt_array_struct,
+                          char *error_string,
+                          int my_rank,
+                          int p)
+{
+  return(dm_h5_read_region(h5_file_id,"/spt/spt_array",H5T_NATIVE_UINT8,0,
+                           ptr_spt_array_struct->nx,
+                           ptr_spt_array_struct->ny,
+                           ptr_spt_array_struct->nz,
+                           region_offsets,region_strides,
+                           ptr_spt_array_struct->byte_array,NULL,
+                           sizeof(u_int8_t),
+                           error_string,my_rank,p));
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_itn_region(hid_t h5_file_id,
+                          int *region_offsets,
+                          int *region_strides,
+                          dm_array_complex_struct *ptr_itn_array_struct,
+                          char *error_string,
+                          int my_rank,
+                          int p)
+{
+#if DM_ARRAY_SPLIT
+  return(dm_h5_read_region(h5_file_id,"/itn/itn_array",DM_H5_ARRAY_REAL,1,
+                           ptr_itn_array_struct->nx,
+                           ptr_itn_array_struct->ny,
+                           ptr_itn_array_struct->nz,
+                           region_offsets,region_strides,
+                           (ptr_itn_array_struct->complex_array)->re,
+                           (ptr_itn_array_struct->complex_array)->im,
+                           sizeof(dm_array_real),
+                           error_string,my_rank,p));
+#else
+  return(dm_h5_read_region(h5_file_id,"/itn/itn_array",DM_H5_ARRAY_REAL,1,
+                           ptr_itn_array_struct->nx,
+                           ptr_itn_array_struct->ny,
+                           ptr_itn_array_struct->nz,
+                           region_offsets,region_strides,
+                           ptr_itn_array_struct->complex_array,NULL,
+                           sizeof(dm_array_real),
+                           error_string,my_rank,p));
+#endif /* DM_ARRAY_SPLIT */
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_itn_history_info(hid_t h5_file_id,
+				int *ptr_nx, int *ptr_ny, int *ptr_nz,
+				int *ptr_n_iterates,
+				char *error_string,
+				int my_rank)
+{
+  hid_t history_group;
+  hid_t datatype, dataset, dataspace;
+  hid_t attr;
+  hsize_t file_dims[5];
+  herr_t status;
+  int file_n_dims, dm_itn_history_version;
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+      if ((history_group = H5Gopen(h5_file_id,"/itn_history")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/itn_history\") error");
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((datatype = H5Tcopy(H5T_NATIVE_INT)) < 0) {
+          strcpy(error_string,"H5Tcopy(datatype) error");
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tset_size(datatype,H5_SIZEOF_INT);
+      if ((attr = H5Aopen_name(history_group,"itn_history_version")) < 0) {
+          strcpy(error_string,"H5Aopen_name(itn_history_version) error");
+          H5Tclose(datatype);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Aread(attr,datatype,
+                            &dm_itn_history_version)) < 0) {
+          strcpy(error_string,"H5Aread(itn_history_version) error");
+          H5Aclose(attr);
+          H5Tclose(datatype);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Aclose(attr);
+      H5Tclose(datatype);
+
+      if (dm_itn_history_version > DM_ITN_HISTORY_VERSION) {
+          sprintf(error_string,
+                  "Can only handle ITN history version up to %d, not %d",
+                  DM_ITN_HISTORY_VERSION,dm_itn_history_version);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /*--- check on dimensions of itn_history_array ---*/
+      if ((dataset = H5Dopen(history_group,"itn_history_array")) < 0) {
+          strcpy(error_string,"H5Dopen(\"itn_history_array\") error");
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(itn_history_array) error");
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      file_n_dims = H5Sget_simple_extent_ndims(dataspace);
+      if ((file_n_dims < 3) || (file_n_dims > 5)) {
+          sprintf(error_string,
+                  "Error: ITN history n_dims=%d rather than 3, 4, or 5",
+                  file_n_dims);
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((status = H5Sget_simple_extent_dims(dataspace,file_dims,NULL)) < 0) {
+          strcpy(error_string,
+                 "H5Dget_simple_extent_dims(itn_history_array) error");
+          H5Sclose(dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Sclose(dataspace);
+      H5Dclose(dataset);
+      H5Gclose(history_group);
+
+      *ptr_n_iterates = file_dims[0];
+      if (file_n_dims == 3) {
+          *ptr_nx = file_dims[1];
+          *ptr_ny = 1;
+          *ptr_nz = 1;
+      } else if (file_n_dims == 4) {
+          *ptr_ny = file_dims[1];
+          *ptr_nx = file_dims[2];
+          *ptr_nz = 1;
+      } else {
+          *ptr_nz = file_dims[1];
+          *ptr_ny = file_dims[2];
+          *ptr_nx = file_dims[3];
+      }
+  } /* endif(my_rank == 0) */
+
+#if USE_MPI
+  MPI_Bcast(ptr_nx,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_ny,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_nz,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(ptr_n_iterates,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_itn_history(hid_t h5_file_id,
+			   int i_iterate,
+			   dm_itn_struct *ptr_itn_struct,
+			   dm_array_real *ptr_recon_error,
+			   dm_array_complex_struct *ptr_itn_array_struct,
+			   char *error_string,
+			   int my_rank,
+			   int p)
+{
+  hid_t history_group = -1;
+  hid_t datatype, dataset = -1;
+  hid_t file_dataspace = -1, memory_dataspace = -1;
+  hsize_t file_dims[5], memory_dims[5], file_offsets[5], file_counts[5];
+  herr_t status;
+  int i, file_n_dims, islab, n_slabs;
+  int local_nx, local_ny, local_nz;
+  dm_array_index_t ipix, slab_npix, slab_offset;
+  dm_array_real *slice_array;
+#if USE_MPI
+  MPI_Status mpi_status;
+#endif
+
+  strcpy(error_string,"");
+
+  if (my_rank == 0) {
+      if ((history_group = H5Gopen(h5_file_id,"/itn_history")) < 0) {
+          strcpy(error_string,"H5Gopen(\"/itn_history\") error");
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /*--- itn_history_array ---*/
+      if ((dataset = H5Dopen(history_group,"itn_history_array")) < 0) {
+          strcpy(error_string,"H5Dopen(\"itn_history_array\") error");
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+          strcpy(error_string,"H5Dget_space(itn_history_array) error");
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      file_n_dims = H5Sget_simple_extent_ndims(file_dataspace);
+      if ((file_n_dims < 3) || (file_n_dims > 5) ||
+          (H5Sget_simple_extent_dims(file_dataspace,file_dims,NULL) < 0)) {
+          sprintf(error_string,
+                  "Error: ITN history n_dims=%d rather than 3, 4, or 5",
+                  file_n_dims);
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if (file_n_dims == 3) {
+          local_nx = file_dims[1];
+          local_ny = 1;
+          local_nz = 1;
+      } else if (file_n_dims == 4) {
+          local_ny = file_dims[1];
+          local_nx = file_dims[2];
+          local_nz = 1;
+      } else {
+          local_nz = file_dims[1];
+          local_ny = file_dims[2];
+          local_nx = file_dims[3];
+      }
+
+      if ((local_nx != ptr_itn_array_struct->nx) ||
+          (local_ny != ptr_itn_array_struct->ny) ||
+          (local_nz != ptr_itn_array_struct->nz)) {
+          sprintf(error_string,
+                  "ITN history dimensions are [%d,%d,%d] not [%d,%d,%d]",
+                  local_nx,local_ny,local_nz,
+                  ptr_itn_array_struct->nx,ptr_itn_array_struct->ny,
+                  ptr_itn_array_struct->nz);
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      if ((i_iterate < 0) || (i_iterate >= (int)file_dims[0])) {
+          sprintf(error_string,
+                  "ITN history has %d iterates, cannot read iterate %d",
+                  (int)file_dims[0],i_iterate);
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /*--- itn_struct and the values stored for this iterate ---*/
+      if ((datatype = H5Tcreate(H5T_COMPOUND,
+                                sizeof(dm_itn_struct))) < 0) {
+          strcpy(error_string,"H5Tcreate(itn_struct) error");
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      dm_h5_insert_itn_struct_members(datatype);
+      if ((status = dm_h5_read_itn_history_value(history_group,
+                                                 "itn_struct",datatype,
+                                                 0,ptr_itn_struct,
+                                                 error_string))
+          == DM_FILEIO_FAILURE) {
+          H5Tclose(datatype);
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+      H5Tclose(datatype);
+
+      if ((dm_h5_read_itn_history_value(history_group,"iterate_count",
+                                        H5T_NATIVE_UINT32,i_iterate,
+                                        &(ptr_itn_struct->iterate_count),
+                                        error_string)
+           == DM_FILEIO_FAILURE) ||
+          (dm_h5_read_itn_history_value(history_group,"photon_scaling",
+                                        H5T_NATIVE_DOUBLE,i_iterate,
+                                        &(ptr_itn_struct->photon_scaling),
+                                        error_string)
+           == DM_FILEIO_FAILURE) ||
+          (dm_h5_read_itn_history_value(history_group,"recon_error",
+                                        DM_H5_ARRAY_REAL,i_iterate,
+                                        ptr_recon_error,
+                                        error_string)
+           == DM_FILEIO_FAILURE)) {
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+  } /* endif(my_rank == 0) */
+
+  /* Prepare for hyperslabs of iterate i_iterate only.  "slab_npix" does
+   * not reflect the factor of 2 for complex numbers; this is deliberate.
+   */
+  if (ptr_itn_array_struct->ny == 1) {
+      file_n_dims = 3;
+      file_dims[1] = ptr_itn_array_struct->nx;
+      file_dims[2] = 2;
+  } else if (ptr_itn_array_struct->nz == 1) {
+      file_n_dims = 4;
+      file_dims[1] = ptr_itn_array_struct->ny;
+      file_dims[2] = ptr_itn_array_struct->nx;
+      file_dims[3] = 2;
+  } else {
+      file_n_dims = 5;
+      file_dims[1] = ptr_itn_array_struct->nz;
+      file_dims[2] = ptr_itn_array_struct->ny;
+      file_dims[3] = ptr_itn_array_struct->nx;
+      file_dims[4] = 2;
+  }
+  memory_dims[0] = 1;
+  file_counts[0] = 1;
+  file_offsets[0] = i_iterate;
+  for (i=1; i<file_n_dims; i++) {
+      memory_dims[i] = file_dims[i];
+      file_counts[i] = file_dims[i];
+      file_offsets[i] = 0;
+  }
+#if USE_MPI
+  n_slabs = p;
+  slab_npix = ptr_itn_array_struct->npix/p;
+  memory_dims[1] = file_dims[1]/p;
+#else /* no USE_MPI */
+  if (file_n_dims == 5) {
+      n_slabs = ptr_itn_array_struct->nz;
+      slab_npix = (dm_array_index_t)(ptr_itn_array_struct->nx) *
+          (dm_array_index_t)(ptr_itn_array_struct->ny);
+      memory_dims[1] = 1;
+  } else {
+      n_slabs = 1;
+      slab_npix = ptr_itn_array_struct->npix;
+  }
+#endif /* USE_MPI */
+  file_counts[1] = memory_dims[1];
+
+  /* the slice array will always be interleaved */
+  slice_array = (dm_array_real *)malloc(2*sizeof(dm_array_real)*slab_npix);
+
+  if (my_rank == 0) {
+      if ((memory_dataspace =
+           H5Screate_simple(file_n_dims,memory_dims,NULL)) < 0) {
+          strcpy(error_string,
+                 "H5Screate_simple(itn_history_array,memory) error");
+          free(slice_array);
+          H5Sclose(file_dataspace);
+          H5Dclose(dataset);
+          H5Gclose(history_group);
+          return(DM_FILEIO_FAILURE);
+      }
+  } /* endif(my_rank == 0) */
+
+  for (islab=0; islab<n_slabs; islab++) {
+      if (my_rank == 0) {
+          file_offsets[1] = islab*memory_dims[1];
+          if ((status = H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                                            file_offsets,NULL,
+                                            file_counts,NULL)) < 0) {
+              strcpy(error_string,
+                     "Error in H5Sselect_hyperslab(itn_history_array)");
+              free(slice_array);
+              H5Sclose(memory_dataspace);
+              H5Sclose(file_dataspace);
+              H5Dclose(dataset);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+          if ((status = H5Dread(dataset,DM_H5_ARRAY_REAL,memory_dataspace,
+                                file_dataspace,H5P_DEFAULT,
+                                slice_array)) < 0) {
+              strcpy(error_string,"Error in H5Dread(itn_history_array)");
+              free(slice_array);
+              H5Sclose(memory_dataspace);
+              H5Sclose(file_dataspace);
+              H5Dclose(dataset);
+              H5Gclose(history_group);
+              return(DM_FILEIO_FAILURE);
+          }
+#if USE_MPI
+          if (islab > 0) {
+              MPI_Send(slice_array,2*slab_npix,MPI_ARRAY_REAL,
+                       islab,99,MPI_COMM_WORLD);
+          }
+#endif /* USE_MPI */
+      } /* endif(my_rank == 0) */
+
+#if USE_MPI
+      if ((islab > 0) && (my_rank == islab)) {
+          MPI_Recv(slice_array,2*slab_npix,MPI_ARRAY_REAL,
+                   0,99,MPI_COMM_WORLD,&mpi_status);
+      }
+      slab_offset = 0;
+#else /* no USE_MPI */
+      slab_offset = islab*slab_npix;
+#endif /* USE_MPI */
+
+      /* Now map using the predefined macros */
+      if (my_rank == (USE_MPI ? islab : 0)) {
+          for (ipix=0; ipix<slab_npix; ipix++) {
+              c_re(ptr_itn_array_struct->complex_array,(ipix+slab_offset)) =
+                  (*(slice_array+2*ipix));
+              c_im(ptr_itn_array_struct->complex_array,(ipix+slab_offset)) =
+                  (*(slice_array+2*ipix+1));
+          }
+      }
+  } /* endfor(islab) */
+
+  free(slice_array);
+  /* Only rank 0 opened anything */
+  if (memory_dataspace >= 0) H5Sclose(memory_dataspace);
+  if (file_dataspace >= 0) H5Sclose(file_dataspace);
+  if (dataset >= 0) H5Dclose(dataset);
+  if (history_group >= 0) H5Gclose(history_group);
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_open(char *filename,
+		       int create,
+		       dm_h5_session_struct *ptr_session,
+		       char *error_string,
+		       int my_rank)
+{
+  strcpy(error_string,"");
+
+  ptr_session->adi_group = -1;
+  ptr_session->spt_group = -1;
+  ptr_session->itn_group = -1;
+  ptr_session->adi_struct_dataset = -1;
+  ptr_session->spt_struct_dataset = -1;
+  ptr_session->itn_struct_dataset = -1;
+  ptr_session->adi_struct_datatype = -1;
+  ptr_session->spt_struct_datatype = -1;
+  ptr_session->itn_struct_datatype = -1;
+  ptr_session->adi_array.dataset = -1;
+  ptr_session->adi_error_array.dataset = -1;
+  ptr_session->spt_array.dataset = -1;
+  ptr_session->itn_array.dataset = -1;
+  ptr_session->recon_errors.dataset = -1;
+  ptr_session->adi_struct_dirty = 0;
+  ptr_session->spt_struct_dirty = 0;
+  ptr_session->itn_struct_dirty = 0;
+
+  if (create == 1) {
+      if (dm_h5_create(filename,&(ptr_session->h5_file_id),
+                       error_string,my_rank) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+  } else {
+      if (dm_h5_openwrite(filename,&(ptr_session->h5_file_id),
+                          error_string,my_rank) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+  }
+
+  /* The compound datatypes are built only once per session */
+  if (my_rank == 0) {
+      if (((ptr_session->adi_struct_datatype = 
+            H5Tcreate(H5T_COMPOUND,sizeof(dm_adi_struct))) < 0) ||
+          ((ptr_session->spt_struct_datatype = 
+            H5Tcreate(H5T_COMPOUND,sizeof(dm_spt_struct))) < 0) ||
+          ((ptr_session->itn_struct_datatype = 
+            H5Tcreate(H5T_COMPOUND,sizeof(dm_itn_struct))) < 0)) {
+          strcpy(error_string,"H5Tcreate(session struct types) error");
+          dm_h5_session_close_handles(ptr_session);
+          dm_h5_close(ptr_session->h5_file_id,my_rank);
+          return(DM_FILEIO_FAILURE);
+      }
+      dm_h5_insert_adi_struct_members(ptr_session->adi_struct_datatype);
+      dm_h5_insert_spt_struct_members(ptr_session->spt_struct_datatype);
+      dm_h5_insert_itn_struct_members(ptr_session->itn_struct_datatype);
+  } /* endif(my_rank == 0) */
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_write_adi(dm_h5_session_struct *ptr_session,
+			    dm_adi_struct *ptr_adi_struct,
+			    dm_array_real_struct *ptr_adi_array_struct,
+			    dm_array_real_struct *ptr_adi_error_array_struct,
+			    char *error_string,
+			    int my_rank,
+			    int p)
+{
+  hsize_t array_dims[4];
+  int n_dims, use_cache = 0;
+
+  strcpy(error_string,"");
+  dm_h5_session_array_dims(ptr_adi_array_struct->nx,
+                           ptr_adi_array_struct->ny,
+                           ptr_adi_array_struct->nz,0,
+                           &n_dims,array_dims);
+
+  if (my_rank == 0) {
+      use_cache = 
+          dm_h5_session_dataset_matches(&(ptr_session->adi_array),
+                                        n_dims,array_dims) &&
+          ((ptr_adi_error_array_struct->npix == 0) ||
+           dm_h5_session_dataset_matches(&(ptr_session->adi_error_array),
+                                         n_dims,array_dims));
+  } /* endif(my_rank == 0) */
+#if USE_MPI
+  MPI_Bcast(&use_cache,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  if (use_cache == 0) {
+      /* First write or a change of array size: go through
+       * dm_h5_write_adi() and pick up the handles afterwards.
+       */
+      if (my_rank == 0) {
+          dm_h5_session_close_dataset(&(ptr_session->adi_array));
+          dm_h5_session_close_dataset(&(ptr_session->adi_error_array));
+      }
+      if (dm_h5_write_adi(ptr_session->h5_file_id,ptr_adi_struct,
+                          ptr_adi_array_struct,ptr_adi_error_array_struct,
+                          error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+      ptr_session->adi_struct_dirty = 0;
+      if (my_rank == 0) {
+          if ((dm_h5_session_open_group(ptr_session->h5_file_id,"/adi",
+                                        "adi_struct",
+                                        &(ptr_session->adi_group),
+                                        &(ptr_session->adi_struct_dataset),
+                                        error_string) == DM_FILEIO_FAILURE) ||
+              (dm_h5_session_open_dataset(ptr_session->adi_group,
+                                          "adi_array",
+                                          &(ptr_session->adi_array),
+                                          error_string) == DM_FILEIO_FAILURE) ||
+              (dm_h5_session_open_dataset(ptr_session->adi_group,
+                                          "adi_error_array",
+                                          &(ptr_session->adi_error_array),
+                                          error_string) == DM_FILEIO_FAILURE)) {
+              return(DM_FILEIO_FAILURE);
+          }
+      } /* endif(my_rank == 0) */
+      return(DM_FILEIO_SUCCESS);
+  } /* endif(use_cache == 0) */
+
+  /* The adi_struct waits for dm_h5_session_flush() */
+  if (my_rank == 0) {
+      ptr_session->adi_struct = *ptr_adi_struct;
+      ptr_session->adi_struct_dirty = 1;
+  }
+
+  if (dm_h5_write_array_slabs(ptr_session->adi_array.dataset,
+                              DM_H5_ARRAY_REAL,n_dims,array_dims,
+                              ptr_adi_array_struct->real_array,NULL,
+                              sizeof(dm_array_real),
+                              error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+      return(DM_FILEIO_FAILURE);
+  }
+  if (ptr_adi_error_array_struct->npix > 0) {
+      if (dm_h5_write_array_slabs(ptr_session->adi_error_array.dataset,
+                                  DM_H5_ARRAY_REAL,n_dims,array_dims,
+                                  ptr_adi_error_array_struct->real_array,NULL,
+                                  sizeof(dm_array_real),
+                                  error_string,my_rank,p) 
+          == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+  }
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_write_spt(dm_h5_session_struct *ptr_session,
+			    dm_spt_struct *ptr_spt_struct,
+			    dm_array_byte_struct *ptr_spt_array_struct,
+			    char *error_string,
+			    int my_rank,
+			    int p)
+{
+  hsize_t array_dims[4];
+  int n_dims, use_cache = 0;
+
+  strcpy(error_string,"");
+  dm_h5_session_array_dims(ptr_spt_array_struct->nx,
+                           ptr_spt_array_struct->ny,
+                           ptr_spt_array_struct->nz,0,
+                           &n_dims,array_dims);
+
+  if (my_rank == 0) {
+      use_cache = dm_h5_session_dataset_matches(&(ptr_session->spt_array),
+                                                n_dims,array_dims);
+  } /* endif(my_rank == 0) */
+#if USE_MPI
+  MPI_Bcast(&use_cache,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  if (use_cache == 0) {
+      if (my_rank == 0) {
+          dm_h5_session_close_dataset(&(ptr_session->spt_array));
+      }
+      if (dm_h5_write_spt(ptr_session->h5_file_id,ptr_spt_struct,
+                          ptr_spt_array_struct,
+                          error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+      ptr_session->spt_struct_dirty = 0;
+      if (my_rank == 0) {
+          if ((dm_h5_session_open_group(ptr_session->h5_file_id,"/spt",
+                                        "spt_struct",
+                                        &(ptr_session->spt_group),
+                                        &(ptr_session->spt_struct_dataset),
+                                        error_string) == DM_FILEIO_FAILURE) ||
+              (dm_h5_session_open_dataset(ptr_session->spt_group,
+                                          "spt_array",
+                                          &(ptr_session->spt_array),
+                                          error_string) == DM_FILEIO_FAILURE)) {
+              return(DM_FILEIO_FAILURE);
+          }
+      } /* endif(my_rank == 0) */
+      return(DM_FILEIO_SUCCESS);
+  } /* endif(use_cache == 0) */
+
+  if (my_rank == 0) {
+      ptr_session->spt_struct = *ptr_spt_struct;
+      ptr_session->spt_struct_dirty = 1;
+  }
+
+  return(dm_h5_write_array_slabs(ptr_session->spt_array.dataset,
+                                 H5T_NATIVE_UINT8,n_dims,array_dims,
+                                 ptr_spt_array_struct->byte_array,NULL,
+                                 sizeof(u_int8_t),
+                                 error_string,my_rank,p));
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_write_itn(dm_h5_session_struct *ptr_session,
+			    dm_itn_struct *ptr_itn_struct,
+			    dm_array_complex_struct *ptr_itn_array_struct,
+			    dm_array_real_struct *ptr_recon_errors,
+			    char *error_string,
+			    int my_rank,
+			    int p)
+{
+  hsize_t array_dims[4];
+  herr_t status;
+  int n_dims, use_cache = 0;
+
+  strcpy(error_string,"");
+  dm_h5_session_array_dims(ptr_itn_array_struct->nx,
+                           ptr_itn_array_struct->ny,
+                           ptr_itn_array_struct->nz,1,
+                           &n_dims,array_dims);
+
+  if (my_rank == 0) {
+      use_cache = 
+          dm_h5_session_dataset_matches(&(ptr_session->itn_array),
+                                        n_dims,array_dims) &&
+          ((ptr_recon_errors->npix == 0) ||
+           (ptr_session->recon_errors.dataset >= 0));
+  } /* endif(my_rank == 0) */
+#if USE_MPI
+  MPI_Bcast(&use_cache,1,MPI_INT,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  if (use_cache == 0) {
+      if (my_rank == 0) {
+          dm_h5_session_close_dataset(&(ptr_session->itn_array));
+          dm_h5_session_close_dataset(&(ptr_session->recon_errors));
+      }
+      if (dm_h5_write_itn(ptr_session->h5_file_id,ptr_itn_struct,
+                          ptr_itn_array_struct,ptr_recon_errors,
+                          error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+          return(DM_FILEIO_FAILURE);
+      }
+      ptr_session->itn_struct_dirty = 0;
+      if (my_rank == 0) {
+          if ((dm_h5_session_open_group(ptr_session->h5_file_id,"/itn",
+                                        "itn_struct",
+                                        &(ptr_session->itn_group),
+                                        &(ptr_session->itn_struct_dataset),
+                                        error_string) == DM_FILEIO_FAILURE) ||
+              (dm_h5_session_open_dataset(ptr_session->itn_group,
+                                          "itn_array",
+                                          &(ptr_session->itn_array),
+                                          error_string) == DM_FILEIO_FAILURE) ||
+              (dm_h5_session_open_dataset(ptr_session->itn_group,
+                                          "recon_errors",
+                                          &(ptr_session->recon_errors),
+                                          error_string) == DM_FILEIO_FAILURE)) {
+              return(DM_FILEIO_FAILURE);
+          }
+      } /* endif(my_rank == 0) */
+      return(DM_FILEIO_SUCCESS);
+  } /* endif(use_cache == 0) */
+
+  if (my_rank == 0) {
+      ptr_session->itn_struct = *ptr_itn_struct;
+      ptr_session->itn_struct_dirty = 1;
+
+      /* recon_errors is not distributed and usually grows by a few
+       * elements between calls.
+       */
+      if (ptr_recon_errors->npix > 0) {
+          if (ptr_session->recon_errors.dims[0] != ptr_recon_errors->npix) {
+              ptr_session->recon_errors.dims[0] = ptr_recon_errors->npix;
+              if ((status = 
+                   H5Dset_extent(ptr_session->recon_errors.dataset,
+                                 ptr_session->recon_errors.dims)) < 0) {
+                  strcpy(error_string,"H5Dset_extent(recon_errors) error");
+                  return(DM_FILEIO_FAILURE);
+              }
+          }
+          if ((status = H5Dwrite(ptr_session->recon_errors.dataset,
+                                 DM_H5_ARRAY_REAL,H5S_ALL,H5S_ALL,
+                                 H5P_DEFAULT,
+                                 ptr_recon_errors->real_array)) < 0) {
+              strcpy(error_string,"Error in H5Dwrite(recon_errors)");
+              return(DM_FILEIO_FAILURE);
+          }
+      }
+  } /* endif(my_rank == 0) */
+
+#if DM_ARRAY_SPLIT
+  return(dm_h5_write_array_slabs(ptr_session->itn_array.dataset,
+                                 DM_H5_ARRAY_REAL,n_dims,array_dims,
+                                 (ptr_itn_array_struct->complex_array)->re,
+                                 (ptr_itn_array_struct->complex_array)->im,
+                                 sizeof(dm_array_real),
+                                 error_string,my_rank,p));
+#else
+  return(dm_h5_write_array_slabs(ptr_session->itn_array.dataset,
+                                 DM_H5_ARRAY_REAL,n_dims,array_dims,
+                                 ptr_itn_array_struct->complex_array,NULL,
+                                 sizeof(dm_array_real),
+                                 error_string,my_rank,p));
+#endif /* DM_ARRAY_SPLIT */
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_flush(dm_h5_session_struct *ptr_session,
+			char *error_string,
+			int my_rank)
+{
+  herr_t status;
+
+  strcpy(error_string,"");
+
+  /* All metadata that changed since the last flush goes out in one 
+   * go, followed by a single H5Fflush().
+   */
+  if (my_rank == 0) {
+      if (ptr_session->adi_struct_dirty == 1) {
+          if ((status = H5Dwrite(ptr_session->adi_struct_dataset,
+                                 ptr_session->adi_struct_datatype,
+                                 H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                                 &(ptr_session->adi_struct))) < 0) {
+              strcpy(error_string,"Error in H5Dwrite(adi_struct)");
+              return(DM_FILEIO_FAILURE);
+          }
+          ptr_session->adi_struct_dirty = 0;
+      }
+      if (ptr_session->spt_struct_dirty == 1) {
+          if ((status = H5Dwrite(ptr_session->spt_struct_dataset,
+                                 ptr_session->spt_struct_datatype,
+                                 H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                                 &(ptr_session->spt_struct))) < 0) {
+              strcpy(error_string,"Error in H5Dwrite(spt_struct)");
+              return(DM_FILEIO_FAILURE);
+          }
+          ptr_session->spt_struct_dirty = 0;
+      }
+      if (ptr_session->itn_struct_dirty == 1) {
+          if ((status = H5Dwrite(ptr_session->itn_struct_dataset,
+                                 ptr_session->itn_struct_datatype,
+                                 H5S_ALL,H5S_ALL,H5P_DEFAULT,
+                                 &(ptr_session->itn_struct))) < 0) {
+              strcpy(error_string,"Error in H5Dwrite(itn_struct)");
+              return(DM_FILEIO_FAILURE);
+          }
+          ptr_session->itn_struct_dirty = 0;
+      }
+      if ((status = H5Fflush(ptr_session->h5_file_id,H5F_SCOPE_LOCAL)) < 0) {
+          strcpy(error_string,"H5Fflush() error");
+          return(DM_FILEIO_FAILURE);
+      }
+  } /* endif(my_rank == 0) */
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_close(dm_h5_session_struct *ptr_session,
+			char *error_string,
+			int my_rank)
+{
+  int status;
+
+  status = dm_h5_session_flush(ptr_session,error_string,my_rank);
+  if (my_rank == 0) {
+      dm_h5_session_close_handles(ptr_session);
+  }
+  dm_h5_close(ptr_session->h5_file_id,my_rank);
+
+  return(status);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_insert_adi_struct_members(hid_t datatype)
+{
+  H5Tinsert(datatype,"photon_scaling", 
+	    HOFFSET(dm_adi_struct,photon_scaling),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"error_scaling", 
+	    HOFFSET(dm_adi_struct,error_scaling),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"lambda_meters", 
+	    HOFFSET(dm_adi_struct,lambda_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"camera_z_meters", 
+	    HOFFSET(dm_adi_struct,camera_z_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"camera_x_pixelsize_meters", 
+	    HOFFSET(dm_adi_struct,camera_x_pixelsize_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"camera_y_pixelsize_meters", 
+	    HOFFSET(dm_adi_struct,camera_y_pixelsize_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"camera_alpha_radians", 
+	    HOFFSET(dm_adi_struct,camera_alpha_radians),
+	    H5T_NATIVE_DOUBLE); 
+  H5Tinsert(datatype,"camera_beta_radians", 
+	    HOFFSET(dm_adi_struct,camera_beta_radians),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"camera_gamma_radians", 
+	    HOFFSET(dm_adi_struct,camera_gamma_radians),
+	    H5T_NATIVE_DOUBLE); 
+  H5Tinsert(datatype,"median_filter_width", 
+	    HOFFSET(dm_adi_struct,median_filter_width),
+	    H5T_NATIVE_DOUBLE); 
+  H5Tinsert(datatype,"median_filter_threshold", 
+	    HOFFSET(dm_adi_struct,median_filter_threshold),
+	    H5T_NATIVE_DOUBLE); 
+  H5Tinsert(datatype,"saturation_min", 
+	    HOFFSET(dm_adi_struct,saturation_min),
+	    H5T_NATIVE_DOUBLE); 
+  H5Tinsert(datatype,"saturation_max", 
+	    HOFFSET(dm_adi_struct,saturation_max),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"theta_x_radians", 
+	    HOFFSET(dm_adi_struct,theta_x_radians),
+	    H5T_NATIVE_DOUBLE);
+  if (DM_AINFO_VERSION > 1) {
+    H5Tinsert(datatype,"theta_y_radians", 
+	      HOFFSET(dm_adi_struct,theta_y_radians),
+	      H5T_NATIVE_DOUBLE);
+    H5Tinsert(datatype,"theta_z_radians", 
+	      HOFFSET(dm_adi_struct,theta_z_radians),
+	      H5T_NATIVE_DOUBLE);
+  } /* endif(DM_AINFO_VERSION > 1) */
+  H5Tinsert(datatype,"xcenter_offset_pixels", 
+	    HOFFSET(dm_adi_struct,xcenter_offset_pixels),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"ycenter_offset_pixels", 
+	    HOFFSET(dm_adi_struct,ycenter_offset_pixels),
+	    H5T_NATIVE_DOUBLE);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_insert_spt_struct_members(hid_t datatype)
+{
+  H5Tinsert(datatype,"support_scaling", 
+	    HOFFSET(dm_spt_struct,support_scaling),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"pix_x_meters", 
+	    HOFFSET(dm_spt_struct,pix_x_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"pix_y_meters", 
+	    HOFFSET(dm_spt_struct,pix_y_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"pix_z_meters", 
+	    HOFFSET(dm_spt_struct,pix_z_meters),
+	    H5T_NATIVE_DOUBLE);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_insert_itn_struct_members(hid_t datatype)
+				     
+{
+
+  H5Tinsert(datatype,"photon_scaling", 
+	    HOFFSET(dm_itn_struct,photon_scaling),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"pix_x_meters", 
+	    HOFFSET(dm_itn_struct,pix_x_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"pix_y_meters", 
+	    HOFFSET(dm_itn_struct,pix_y_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"pix_z_meters", 
+	    HOFFSET(dm_itn_struct,pix_z_meters),
+	    H5T_NATIVE_DOUBLE);
+  H5Tinsert(datatype,"iterate_count", 
+	    HOFFSET(dm_itn_struct,iterate_count),
+	    H5T_NATIVE_UINT32);
+ 
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_create_itn_history_value(hid_t history_group,
+				   char *name,
+				   hid_t datatype,
+				   char *error_string)
+{
+  hid_t dataspace, dataset, cre_pid;
+  hsize_t dims[1] = {0}, maxdims[1] = {H5S_UNLIMITED}, chunk_dims[1] = {64};
+
+  if ((dataspace = H5Screate_simple(1,dims,maxdims)) < 0) {
+      sprintf(error_string,"H5Screate_simple(%s) error",name);
+      return(DM_FILEIO_FAILURE);
+  }
+  if ((cre_pid = H5Pcreate(H5P_DATASET_CREATE)) < 0) {
+      sprintf(error_string,"H5Pcreate(%s) error",name);
+      H5Sclose(dataspace);
+      return(DM_FILEIO_FAILURE);
+  }
+  if (H5Pset_chunk(cre_pid,1,chunk_dims) < 0) {
+      sprintf(error_string,"H5Pset_chunk(%s) error",name);
+      H5Pclose(cre_pid);
+      H5Sclose(dataspace);
+      return(DM_FILEIO_FAILURE);
+  }
+  if ((dataset = H5Dcreate(history_group,name,datatype,
+                           dataspace,cre_pid)) < 0) {
+      sprintf(error_string,"H5Dcreate(%s) error",name);
+      H5Pclose(cre_pid);
+      H5Sclose(dataspace);
+      return(DM_FILEIO_FAILURE);
+  }
+  H5Dclose(dataset);
+  H5Pclose(cre_pid);
+  H5Sclose(dataspace);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_append_itn_history_value(hid_t history_group,
+				   char *name,
+				   hid_t datatype,
+				   hsize_t i_iterate,
+				   void *ptr_value,
+				   char *error_string)
+{
+  hid_t dataset, file_dataspace, memory_dataspace;
+  hsize_t dims[1], offsets[1], counts[1] = {1};
+
+  if ((dataset = H5Dopen(history_group,name)) < 0) {
+      sprintf(error_string,"H5Dopen(%s) error",name);
+      return(DM_FILEIO_FAILURE);
+  }
+  dims[0] = i_iterate+1;
+  if (H5Dextend(dataset,dims) < 0) {
+      sprintf(error_string,"H5Dextend(%s) error",name);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+      sprintf(error_string,"H5Dget_space(%s) error",name);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  if ((memory_dataspace = H5Screate_simple(1,counts,NULL)) < 0) {
+      sprintf(error_string,"H5Screate_simple(%s) error",name);
+      H5Sclose(file_dataspace);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  offsets[0] = i_iterate;
+  if ((H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                           offsets,NULL,counts,NULL) < 0) ||
+      (H5Dwrite(dataset,datatype,memory_dataspace,file_dataspace,
+                H5P_DEFAULT,ptr_value) < 0)) {
+      sprintf(error_string,"Error in H5Dwrite(%s)",name);
+      H5Sclose(memory_dataspace);
+      H5Sclose(file_dataspace);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  H5Sclose(memory_dataspace);
+  H5Sclose(file_dataspace);
+  H5Dclose(dataset);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_itn_history_value(hid_t history_group,
+				 char *name,
+				 hid_t datatype,
+				 hsize_t i_iterate,
+				 void *ptr_value,
+				 char *error_string)
+{
+  hid_t dataset, file_dataspace, memory_dataspace;
+  hsize_t offsets[1], counts[1] = {1};
+
+  if ((dataset = H5Dopen(history_group,name)) < 0) {
+      sprintf(error_string,"H5Dopen(%s) error",name);
+      return(DM_FILEIO_FAILURE);
+  }
+  if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+      sprintf(error_string,"H5Dget_space(%s) error",name);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  if ((memory_dataspace = H5Screate_simple(1,counts,NULL)) < 0) {
+      sprintf(error_string,"H5Screate_simple(%s) error",name);
+      H5Sclose(file_dataspace);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  offsets[0] = i_iterate;
+  if ((H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                           offsets,NULL,counts,NULL) < 0) ||
+      (H5Dread(dataset,datatype,memory_dataspace,file_dataspace,
+               H5P_DEFAULT,ptr_value) < 0)) {
+      sprintf(error_string,"Error in H5Dread(%s)",name);
+      H5Sclose(memory_dataspace);
+      H5Sclose(file_dataspace);
+      H5Dclose(dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  H5Sclose(memory_dataspace);
+  H5Sclose(file_dataspace);
+  H5Dclose(dataset);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_session_array_dims(int nx, int ny, int nz,
+			      int is_complex,
+			      int *ptr_n_dims,
+			      hsize_t *array_dims)
+{
+  if (ny == 1) {
+      *ptr_n_dims = 1;
+      array_dims[0] = nx;
+  } else if (nz == 1) {
+      *ptr_n_dims = 2;
+      array_dims[0] = ny;
+      array_dims[1] = nx;
+  } else {
+      *ptr_n_dims = 3;
+      array_dims[0] = nz;
+      array_dims[1] = ny;
+      array_dims[2] = nx;
+  }
+  if (is_complex == 1) {
+      array_dims[*ptr_n_dims] = 2;
+      (*ptr_n_dims)++;
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_dataset_matches(dm_h5_session_dataset_struct *ptr_dataset,
+				  int n_dims,
+				  hsize_t *array_dims)
+{
+  int i;
+
+  if ((ptr_dataset->dataset < 0) || (ptr_dataset->n_dims != n_dims)) {
+      return(0);
+  }
+  for (i=0; i<n_dims; i++) {
+      if (ptr_dataset->dims[i] != array_dims[i]) {
+          return(0);
       }
-      file_n_dims = H5Sget_simple_extent_ndims(file_dataspace);
-      file_dims = (hsize_t *)malloc(file_n_dims*sizeof(hsize_t));
-      if ((status =
-           H5Sget_simple_extent_dims(file_dataspace,file_dims,NULL)) < 0) {
-	strcpy(error_string,"H5Dget_simple_extent_dims(itn_array) error");
-	free(file_dims);
-	H5Sclose(file_dataspace);
-	H5Tclose(read_datatype);
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
+  }
+  return(1);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_open_group(hid_t h5_file_id,
+			     char *group_name,
+			     char *struct_name,
+			     hid_t *ptr_group,
+			     hid_t *ptr_struct_dataset,
+			     char *error_string)
+{
+  if (*ptr_group < 0) {
+      if ((*ptr_group = H5Gopen(h5_file_id,group_name)) < 0) {
+          sprintf(error_string,"H5Gopen(\"%s\") error",group_name);
+          return(DM_FILEIO_FAILURE);
       }
-      
-      if (file_n_dims == 2) {
-	local_nx = (*(file_dims+0));
-	n_complex = (*(file_dims+1));
-	local_ny = 1;
-	local_nz = 1;
-      } else if (file_n_dims == 3) {
-	local_ny = (*(file_dims+0));
-	local_nx = (*(file_dims+1));
-	n_complex = (*(file_dims+2));
-	local_nz = 1;
-      } else if (file_n_dims == 4) {
-	local_nz = (*(file_dims+0));
-	local_ny = (*(file_dims+1));
-	local_nx = (*(file_dims+2));
-	n_complex = (*(file_dims+3));
-      } else {
-	sprintf(error_string,
-		"Error: ITN array n_dims=%d rather than 2, 3, or 4 for complex",
-		(int)file_n_dims);
-	free(file_dims);
-	H5Sclose(file_dataspace);
-	H5Tclose(read_datatype);
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
-      }    
-      
-      if (n_complex != 2) {
-	sprintf(error_string,
-		"Error: ITN array should have fast index=2 not %d for complex",
-		(int)file_n_dims);
-	free(file_dims);
-	H5Sclose(file_dataspace);
-	H5Tclose(read_datatype);
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	return(DM_FILEIO_FAILURE);
-      }    
-      
-      if ((local_nx != ptr_itn_array_struct->nx) ||
-          (local_ny != ptr_itn_array_struct->ny) ||
-          (local_nz != ptr_itn_array_struct->nz)) {
-	sprintf(error_string,"ITN array dimensions are [%d,%d,%d] not [%d,%d,%d]",
-		local_nx,local_ny,local_nz,
-		ptr_itn_array_struct->nx,ptr_itn_array_struct->ny,
-		ptr_itn_array_struct->nz);
-	H5Sclose(file_dataspace);
-	H5Tclose(read_datatype);
-	H5Dclose(dataset);
-	H5Gclose(itn_group);
-	free(file_dims);
-	return(DM_FILEIO_FAILURE);
+  }
+  if (*ptr_struct_dataset < 0) {
+      if ((*ptr_struct_dataset = H5Dopen(*ptr_group,struct_name)) < 0) {
+          sprintf(error_string,"H5Dopen(%s) error",struct_name);
+          return(DM_FILEIO_FAILURE);
       }
-      
-      /* Prepare for hyperslabs of the data.  "slice_npix" does not
-       * reflect the factor of 2 for complex numbers; this is deliberate.
-       */
-      if (ptr_itn_array_struct->ny == 1) {
-          file_offsets[0] = 0;
-          file_offsets[1] = 0;
-#if USE_MPI
-          memory_dims[0] = file_dims[0]/p;
-          memory_dims[1] = file_dims[1];
-          file_counts[0] = file_dims[0]/p;
-          file_counts[1] = file_dims[1];
-          slice_npix = ptr_itn_array_struct->npix/p;
-#else /* no USE_MPI */
-          memory_dims[0] = file_dims[0];
-          memory_dims[1] = file_dims[1];
-          file_counts[0] = memory_dims[0];
-          file_counts[1] = memory_dims[1];
-          slice_npix = ptr_itn_array_struct->npix;
-#endif /* USE_MPI */
-      } else if (ptr_itn_array_struct->nz == 1) {
-          file_offsets[0] = 0;
-          file_offsets[1] = 0;
-          file_offsets[2] = 0;
-#if USE_MPI
-          memory_dims[0] = file_dims[0]/p;
-          memory_dims[1] = file_dims[1];
-          memory_dims[2] = file_dims[2];
-          file_counts[0] = file_dims[0]/p;
-          file_counts[1] = file_dims[1];
-          file_counts[2] = file_dims[2];
-          slice_npix = ptr_itn_array_struct->npix/p;
-#else /* no USE_MPI */
-          memory_dims[0] = file_dims[0];
-          memory_dims[1] = file_dims[1];
-          memory_dims[2] = file_dims[2];
-          file_counts[0] = memory_dims[0];
-          file_counts[1] = memory_dims[1];
-          file_counts[2] = memory_dims[2];
-          slice_npix = ptr_itn_array_struct->npix;
-#endif /* USE_MPI */
-      } else {
-          file_offsets[0] = 0; /* Will be adjusted for each slice */
-          file_offsets[1] = 0;
-          file_offsets[2] = 0;
-          file_offsets[3] = 0;
-#if USE_MPI
-          memory_dims[0] = file_dims[0]/p;
-          memory_dims[1] = file_dims[1];
-          memory_dims[2] = file_dims[2];
-          memory_dims[3] = file_dims[3];
-          
-          file_counts[0] = file_dims[0]/p;
-          file_counts[1] = file_dims[1];
-          file_counts[2] = file_dims[2];
-          file_counts[3] = file_dims[3];
-          slice_npix = ptr_itn_array_struct->npix/p;
+  }
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_session_open_dataset(hid_t group,
+			       char *name,
+			       dm_h5_session_dataset_struct *ptr_dataset,
+			       char *error_string)
+{
+  hid_t dataspace;
+
+  /* A missing dataset is not an error; it just never matches */
+  if ((ptr_dataset->dataset = H5Dopen(group,name)) < 0) {
+      ptr_dataset->dataset = -1;
+      return(DM_FILEIO_SUCCESS);
+  }
+  if ((dataspace = H5Dget_space(ptr_dataset->dataset)) < 0) {
+      sprintf(error_string,"H5Dget_space(%s) error",name);
+      dm_h5_session_close_dataset(ptr_dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  ptr_dataset->n_dims = H5Sget_simple_extent_ndims(dataspace);
+  if ((ptr_dataset->n_dims < 1) || (ptr_dataset->n_dims > 4) ||
+      (H5Sget_simple_extent_dims(dataspace,ptr_dataset->dims,NULL) < 0)) {
+      sprintf(error_string,"H5Sget_simple_extent_dims(%s) error",name);
+      H5Sclose(dataspace);
+      dm_h5_session_close_dataset(ptr_dataset);
+      return(DM_FILEIO_FAILURE);
+  }
+  H5Sclose(dataspace);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_session_close_dataset(dm_h5_session_dataset_struct *ptr_dataset)
+{
+  if (ptr_dataset->dataset >= 0) {
+      H5Dclose(ptr_dataset->dataset);
+  }
+  ptr_dataset->dataset = -1;
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_h5_session_close_handles(dm_h5_session_struct *ptr_session)
+{
+  dm_h5_session_close_dataset(&(ptr_session->adi_array));
+  dm_h5_session_close_dataset(&(ptr_session->adi_error_array));
+  dm_h5_session_close_dataset(&(ptr_session->spt_array));
+  dm_h5_session_close_dataset(&(ptr_session->itn_array));
+  dm_h5_session_close_dataset(&(ptr_session->recon_errors));
+  if (ptr_session->adi_struct_dataset >= 0) 
+      H5Dclose(ptr_session->adi_struct_dataset);
+  if (ptr_session->spt_struct_dataset >= 0) 
+      H5Dclose(ptr_session->spt_struct_dataset);
+  if (ptr_session->itn_struct_dataset >= 0) 
+      H5Dclose(ptr_session->itn_struct_dataset);
+  if (ptr_session->adi_struct_datatype >= 0) 
+      H5Tclose(ptr_session->adi_struct_datatype);
+  if (ptr_session->spt_struct_datatype >= 0) 
+      H5Tclose(ptr_session->spt_struct_datatype);
+  if (ptr_session->itn_struct_datatype >= 0) 
+      H5Tclose(ptr_session->itn_struct_datatype);
+  if (ptr_session->adi_group >= 0) 
+      H5Gclose(ptr_session->adi_group);
+  if (ptr_session->spt_group >= 0) 
+      H5Gclose(ptr_session->spt_group);
+  if (ptr_session->itn_group >= 0) 
+      H5Gclose(ptr_session->itn_group);
+  ptr_session->adi_struct_dataset = -1;
+  ptr_session->spt_struct_dataset = -1;
+  ptr_session->itn_struct_dataset = -1;
+  ptr_session->adi_struct_datatype = -1;
+  ptr_session->spt_struct_datatype = -1;
+  ptr_session->itn_struct_datatype = -1;
+  ptr_session->adi_group = -1;
+  ptr_session->spt_group = -1;
+  ptr_session->itn_group = -1;
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_write_array_slabs(hid_t dataset,
+			    hid_t memory_datatype,
+			    int n_dims,
+			    hsize_t *array_dims,
+			    void *ptr_data,
+			    void *ptr_data_im,
+			    size_t element_size,
+			    char *error_string,
+			    int my_rank,
+			    int p)
+{
+  hid_t file_dataspace, memory_dataspace;
+  hsize_t file_offsets[4], file_counts[4], memory_dims[1];
+  herr_t status;
+  int i, islab, n_slabs, i_complex, n_complex;
+  char *slab_buffer;
+  void *ptr_write;
+#if USE_MPI
+  MPI_Status mpi_status;
+#endif
+
+  /* Split complex arrays have the real and imaginary parts in
+   * ptr_data and ptr_data_im; they go into every other element 
+   * along the fast dimension.
+   */
+  n_complex = (ptr_data_im == NULL) ? 1 : 2;
+  memory_dims[0] = 1;
+  for (i=0; i<n_dims; i++) {
+      memory_dims[0] *= array_dims[i];
+      file_offsets[i] = 0;
+      file_counts[i] = array_dims[i];
+  }
+  memory_dims[0] /= n_complex;
+  if (n_complex == 2) {
+      file_counts[n_dims-1] = 1;
+  }
+#if USE_MPI
+  n_slabs = p;
+  memory_dims[0] /= p;
+  file_counts[0] = array_dims[0]/p;
 #else /* no USE_MPI */
-          memory_dims[0] = 1;
-          memory_dims[1] = file_dims[1];
-          memory_dims[2] = file_dims[2];
-          memory_dims[3] = file_dims[3];
-          
-          file_counts[0] = 1;
-          file_counts[1] = memory_dims[1];
-          file_counts[2] = memory_dims[2];
-          file_counts[3] = memory_dims[3];
-          slice_npix = (dm_array_index_t)(ptr_itn_array_struct->nx) *
-              (dm_array_index_t)(ptr_itn_array_struct->ny);
+  n_slabs = 1;
 #endif /* USE_MPI */
+
+#if USE_MPI
+  if (my_rank > 0) {
+      for (i_complex=0; i_complex<n_complex; i_complex++) {
+          MPI_Send((i_complex == 0) ? ptr_data : ptr_data_im,
+                   memory_dims[0]*element_size,MPI_BYTE,
+                   0,99-i_complex,MPI_COMM_WORLD);
       }
-      free(file_dims);
-      
-      if ((memory_dataspace = H5Screate_simple(file_n_dims, memory_dims, 
-                                               NULL)) < 0) {
-          strcpy(error_string,"H5Screate_simple(itn_array,memory) error");
-          H5Sclose(file_dataspace);
+      return(DM_FILEIO_SUCCESS);
+  }
+#endif /* USE_MPI */
+
+  if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+      strcpy(error_string,"H5Dget_space() error");
+      return(DM_FILEIO_FAILURE);
+  }
+  /* Giving the memory dataspace the shape of the file selection lets
+   * HDF 5 copy whole rows instead of going element by element.
+   */
+  if ((memory_dataspace = H5Screate_simple(n_dims,file_counts,NULL)) < 0) {
+      strcpy(error_string,"H5Screate_simple(memory) error");
+      H5Sclose(file_dataspace);
+      return(DM_FILEIO_FAILURE);
+  }
+  slab_buffer = NULL;
+  if (n_slabs > 1) {
+      if ((slab_buffer = (char *)malloc(memory_dims[0]*element_size)) 
+          == NULL) {
+          strcpy(error_string,"slab malloc() error");
           H5Sclose(memory_dataspace);
-          H5Tclose(read_datatype);
-          H5Gclose(itn_group);
+          H5Sclose(file_dataspace);
           return(DM_FILEIO_FAILURE);
       }
-  } /* endif(my_rank == 0) */
-  
-  /* Now here is where we have to be careful for split versus
-   * interleaved complex arrays.  We take care of this by
-   * always making an interleaved array.  Remember that
-   * we should not use sizeof(dm_array_complex) because it
-   * might be an array of pointers.
-   */
+  }
+
+  for (islab=0; islab<n_slabs; islab++) {
+      file_offsets[0] = islab*file_counts[0];
+      for (i_complex=0; i_complex<n_complex; i_complex++) {
+          if (n_complex == 2) {
+              file_offsets[n_dims-1] = i_complex;
+          }
+          if (islab == 0) {
+              ptr_write = (i_complex == 0) ? ptr_data : ptr_data_im;
+          } else {
 #if USE_MPI
-  /* Get the data from the nodes. npix will tell us the total number of
-   * elements so we need to divide by the number of processes..
+              MPI_Recv(slab_buffer,memory_dims[0]*element_size,MPI_BYTE,
+                       islab,99-i_complex,MPI_COMM_WORLD,&mpi_status);
+#endif /* USE_MPI */
+              ptr_write = slab_buffer;
+          }
+          if (((status = H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                                             file_offsets,NULL,
+                                             file_counts,NULL)) < 0) ||
+              ((status = H5Dwrite(dataset,memory_datatype,memory_dataspace,
+                                  file_dataspace,H5P_DEFAULT,
+                                  ptr_write)) < 0)) {
+              strcpy(error_string,"Error in H5Dwrite()");
+              if (slab_buffer != NULL) 
+                  free(slab_buffer);
+              H5Sclose(memory_dataspace);
+              H5Sclose(file_dataspace);
+              return(DM_FILEIO_FAILURE);
+          }
+      } /* endfor(i_complex) */
+  } /* endfor(islab) */
+
+  if (slab_buffer != NULL) 
+      free(slab_buffer);
+  H5Sclose(memory_dataspace);
+  H5Sclose(file_dataspace);
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+herr_t dm_h5_set_array_extent(hid_t dataset,
+                              hsize_t *array_dims)
+{
+  hid_t cre_pid, dataspace;
+  hsize_t file_dims[H5S_MAX_RANK];
+  H5D_layout_t layout;
+  int n_dims, i;
+
+  if ((cre_pid = H5Dget_create_plist(dataset)) < 0) {
+      return(-1);
+  }
+  layout = H5Pget_layout(cre_pid);
+  H5Pclose(cre_pid);
+
+  if (layout == H5D_CHUNKED) {
+      return(H5Dset_extent(dataset,array_dims));
+  }
+
+  if ((dataspace = H5Dget_space(dataset)) < 0) {
+      return(-1);
+  }
+  if (((n_dims = H5Sget_simple_extent_ndims(dataspace)) < 0) ||
+      (H5Sget_simple_extent_dims(dataspace,file_dims,NULL) < 0)) {
+      H5Sclose(dataspace);
+      return(-1);
+  }
+  H5Sclose(dataspace);
+
+  for (i = 0; i < n_dims; i++) {
+      if (file_dims[i] != array_dims[i]) {
+          return(-1);
+      }
+  }
+  return(0);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_h5_adi_is_mappable(hid_t h5_file_id,
+                          dm_array_real_struct *ptr_adi_array_struct,
+                          char *filename,
+                          size_t filename_length,
+                          haddr_t *ptr_offset)
+{
+  hid_t fapl, dataset, datatype, dataspace, cre_pid;
+  hsize_t file_dims[3];
+  ssize_t name_length;
+  int n_dims, mappable;
+
+  /* The file has to be a single plain file, and everything written
+   * so far has to be on disk before we look at it through mmap().
    */
-      for (i = 0; i < p; i++) {
-      if (my_rank == 0) {
-              
-          slice_array =
-              (dm_array_real *)malloc(2*sizeof(dm_array_real)*
-                                      ptr_itn_array_struct->npix/p);
+  H5Fflush(h5_file_id,H5F_SCOPE_LOCAL);
+  if ((fapl = H5Fget_access_plist(h5_file_id)) < 0) {
+      return(0);
+  }
+  mappable = (H5Pget_driver(fapl) == H5FD_SEC2);
+  H5Pclose(fapl);
+  if (mappable == 0) {
+      return(0);
+  }
+  
+  name_length = H5Fget_name(h5_file_id,filename,filename_length);
+  if ((name_length <= 0) || ((size_t)name_length >= filename_length)) {
+      return(0);
+  }
+
+  if ((dataset = H5Dopen(h5_file_id,"/adi/adi_array")) < 0) {
+      return(0);
+  }
+
+  /* Only a contiguous layout without external storage has all the
+   * data in one piece, and there are no filters in that case.
+   */
+  if ((cre_pid = H5Dget_create_plist(dataset)) < 0) {
+      H5Dclose(dataset);
+      return(0);
+  }
+  mappable = ((H5Pget_layout(cre_pid) == H5D_CONTIGUOUS) &&
+              (H5Pget_external_count(cre_pid) == 0));
+  H5Pclose(cre_pid);
+  
+  /* The data have to be stored in the native type and byte order */
+  if (mappable == 1) {
+      if ((datatype = H5Dget_type(dataset)) < 0) {
+          mappable = 0;
+      } else {
+          mappable = (H5Tequal(datatype,DM_H5_ARRAY_REAL) > 0);
+          H5Tclose(datatype);
+      }
+  }
 
-          /* Determine the file_offsets here. Note that we have to divide by
-           * number of processes. Note that we always have at least 2
-           * dimensions because it is complex.
-           */
-          if (file_n_dims == 2) {
-              file_offsets[0] = i*ptr_itn_array_struct->nx/p;
-          } else if (file_n_dims == 3) {
-              file_offsets[0] = i*ptr_itn_array_struct->ny/p;
-          } else if (file_n_dims == 4) {
-              file_offsets[0] = i*ptr_itn_array_struct->nz/p;
-          }
-              
-          if ((status = H5Sselect_hyperslab(file_dataspace, H5S_SELECT_SET,
-                                            file_offsets, NULL,
-                                            file_counts, NULL)) < 0) {
-              strcpy(error_string,
-                     "Error in H5Sselect_hyperslab(itn_array)");
-              H5Sclose(file_dataspace);
-              H5Sclose(memory_dataspace);
-              H5Tclose(datatype);
-              H5Tclose(read_datatype);
-              H5Gclose(itn_group);
-              free(slice_array);
-              return(DM_FILEIO_FAILURE);
+  /* The dimensions have to match what we were asked for */
+  if (mappable == 1) {
+      if ((dataspace = H5Dget_space(dataset)) < 0) {
+          mappable = 0;
+      } else {
+          n_dims = H5Sget_simple_extent_ndims(dataspace);
+          if ((n_dims < 1) || (n_dims > 3) ||
+              (H5Sget_simple_extent_dims(dataspace,file_dims,NULL) < 0)) {
+              mappable = 0;
+          } else if (n_dims == 1) {
+              mappable = ((file_dims[0] == ptr_adi_array_struct->nx) &&
+                          (ptr_adi_array_struct->ny == 1) &&
+                          (ptr_adi_array_struct->nz == 1));
+          } else if (n_dims == 2) {
+              mappable = ((file_dims[0] == ptr_adi_array_struct->ny) &&
+                          (file_dims[1] == ptr_adi_array_struct->nx) &&
+                          (ptr_adi_array_struct->nz == 1));
+          } else {
+              mappable = ((file_dims[0] == ptr_adi_array_struct->nz) &&
+                          (file_dims[1] == ptr_adi_array_struct->ny) &&
+                          (file_dims[2] == ptr_adi_array_struct->nx));
           }
+          H5Sclose(dataspace);
+      }
+  }
 
-          /* Always read into slice array */
-          if ((status = H5Dread(dataset, read_datatype, memory_dataspace,
-                                file_dataspace,H5P_DEFAULT,
-                                slice_array)) < 0) {
-              strcpy(error_string, "Error in H5Dwrite (itn_array)!");
-              H5Sclose(file_dataspace);
-              H5Sclose(memory_dataspace);
-              H5Tclose(datatype);
-              H5Tclose(read_datatype);
-              H5Gclose(itn_group);
-              free(slice_array);
-              return(DM_FILEIO_FAILURE);
-          }
+  /* Storage that was never written has no address */
+  if (mappable == 1) {
+      *ptr_offset = H5Dget_offset(dataset);
+      mappable = ((*ptr_offset != HADDR_UNDEF) &&
+                  ((*ptr_offset % sizeof(dm_array_real)) == 0) &&
+                  (H5Dget_storage_size(dataset) >= 
+                   (hsize_t)ptr_adi_array_struct->npix*sizeof(dm_array_real)));
+  }
+  
+  H5Dclose(dataset);
+  return(mappable);
+}
 
-          if (i == 0) {
-              /* Map directly into itn_array_struct */
-              for (ipix=0; ipix<ptr_itn_array_struct->npix/p; ipix++) {
-                  c_re(ptr_itn_array_struct->complex_array,ipix) =
-                      (*(slice_array+2*ipix));
-                  c_im(ptr_itn_array_struct->complex_array,ipix) =
-                      (*(slice_array+2*ipix+1));
-              }
-          } else {
-              /* Send */
-              MPI_Send(slice_array,2*ptr_itn_array_struct->npix/p,MPI_ARRAY_REAL,
-                       i,99,MPI_COMM_WORLD);
-          } /* endif(i == 0) */
-          free(slice_array);
-      }  /* endif(my_rank == 0) */ 
+/*-------------------------------------------------------------------------*/
+int dm_h5_read_region(hid_t h5_file_id,
+                      char *dataset_name,
+                      hid_t memory_datatype,
+                      int is_complex,
+                      int nx, int ny, int nz,
+                      int *region_offsets,
+                      int *region_strides,
+                      void *ptr_data,
+                      void *ptr_data_im,
+                      size_t element_size,
+                      char *error_string,
+                      int my_rank,
+                      int p)
+{
+  hid_t dataset, dataspace;
+  hsize_t file_dims[4], offsets[4], strides[4], counts[4];
+  int i, n_dims, n_real_dims, region_is_valid, status;
+  int xyz_counts[3], xyz_offsets[3], xyz_strides[3];
 
-      if (i > 0) {
-          if (my_rank == i) {
-              /* the slice array will always be interleaved */
-              slice_array =
-                  (dm_array_real *)malloc(2*sizeof(dm_array_real)*
-                                          ptr_itn_array_struct->npix/p);
-              MPI_Recv(slice_array,2*ptr_itn_array_struct->npix/p,MPI_ARRAY_REAL,
-                       0,99,MPI_COMM_WORLD,&mpi_status);
-              
-              /* Now map using the predefined macros */
-              for (ipix=0; ipix<ptr_itn_array_struct->npix/p; ipix++) {
-                  c_re(ptr_itn_array_struct->complex_array,ipix) =
-                      (*(slice_array+2*ipix));
-                  c_im(ptr_itn_array_struct->complex_array,ipix) =
-                      (*(slice_array+2*ipix+1));
+  strcpy(error_string,"");
+  dataset = -1;
+  region_is_valid = 0;
+  n_dims = 0;
+  
+  if (my_rank == 0) {
+      if ((dataset = H5Dopen(h5_file_id,dataset_name)) < 0) {
+          sprintf(error_string,"H5Dopen(\"%s\") error",dataset_name);
+      } else if (((dataspace = H5Dget_space(dataset)) < 0) ||
+                 ((n_dims = H5Sget_simple_extent_ndims(dataspace)) < 1) ||
+                 (n_dims > 4) ||
+                 (H5Sget_simple_extent_dims(dataspace,file_dims,NULL) < 0)) {
+          sprintf(error_string,"H5Dget_space(\"%s\") error",dataset_name);
+          H5Sclose(dataspace);
+      } else {
+          H5Sclose(dataspace);
+          region_is_valid = 1;
+      }
+
+      /* The dimensionality of the region follows the file, so that
+       * a single z-slice of a 3D array can be read into a 2D array.
+       * The file stores the slowest (z) dimension first.
+       */
+      n_real_dims = n_dims - is_complex;
+      if ((region_is_valid == 1) &&
+          ((n_real_dims < 1) || (n_real_dims > 3) ||
+           ((is_complex == 1) && (file_dims[n_dims-1] != 2)) ||
+           ((n_real_dims < 3) && (nz != 1)) ||
+           ((n_real_dims < 2) && (ny != 1)))) {
+          sprintf(error_string,
+                  "\"%s\" has %d dimensions, can not read [%d,%d,%d] from it",
+                  dataset_name,n_real_dims,nx,ny,nz);
+          region_is_valid = 0;
+      }
+      
+      if (region_is_valid == 1) {
+          xyz_counts[0] = nx;
+          xyz_counts[1] = ny;
+          xyz_counts[2] = nz;
+          for (i=0; i<3; i++) {
+              xyz_offsets[i] = region_offsets[i];
+              xyz_strides[i] = 
+                  (region_strides == NULL) ? 1 : region_strides[i];
+          }
+          for (i=0; i<n_real_dims; i++) {
+              offsets[i] = xyz_offsets[n_real_dims-1-i];
+              strides[i] = xyz_strides[n_real_dims-1-i];
+              counts[i] = xyz_counts[n_real_dims-1-i];
+              if ((xyz_offsets[n_real_dims-1-i] < 0) ||
+                  (xyz_strides[n_real_dims-1-i] < 1) ||
+                  (xyz_counts[n_real_dims-1-i] < 1) ||
+                  ((offsets[i]+(counts[i]-1)*strides[i]) >= file_dims[i])) {
+                  sprintf(error_string,
+                          "Region does not fit into \"%s\" along %c",
+                          dataset_name,"xyz"[n_real_dims-1-i]);
+                  region_is_valid = 0;
               }
-              free(slice_array);
-          } /* endif(my_rank == i) */
-      } /* endif(i > 0) */
-  } /* endfor */
+          }
+          if (is_complex == 1) {
+              offsets[n_dims-1] = 0;
+              strides[n_dims-1] = 1;
+              counts[n_dims-1] = 2;
+          }
+      }
 
-  
-#else /* no USE_MPI */
-  slice_array = (dm_array_real *)malloc(2*sizeof(dm_array_real)*slice_npix);
-  if (slice_array == NULL) {
-    strcpy(error_string,"slice malloc() error");
-    H5Dclose(dataset);
-    H5Sclose(file_dataspace);
-    H5Sclose(memory_dataspace);
-    H5Tclose(read_datatype);
-    H5Gclose(itn_group);
-    return(DM_FILEIO_FAILURE);
+      if ((region_is_valid == 0) && (dataset >= 0)) {
+          H5Dclose(dataset);
+      }
+  } /* endif(my_rank == 0) */
+
+#if USE_MPI
+  /* Everybody has to know whether rank 0 is going to send data */
+  MPI_Bcast(&region_is_valid,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(&n_dims,1,MPI_INT,0,MPI_COMM_WORLD);
+  MPI_Bcast(counts,4*sizeof(hsize_t),MPI_BYTE,0,MPI_COMM_WORLD);
+  if ((region_is_valid == 0) && (my_rank != 0)) {
+      sprintf(error_string,"Can not read region of \"%s\"",dataset_name);
   }
-  for (iz=0; iz<(ptr_itn_array_struct->nz); iz++) {
-    file_offsets[0] = iz;
-    if ((status = H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
-				      file_offsets,NULL,
-				      file_counts,NULL)) < 0) {
-      strcpy(error_string,"Error in H5Sselect_hyperslab(itn_array)");
-      H5Dclose(dataset);
-      H5Sclose(file_dataspace);
-      H5Sclose(memory_dataspace);
-      H5Tclose(read_datatype);
-      H5Gclose(itn_group);
-      return(DM_FILEIO_FAILURE);
-    }
-    if ((status = H5Dread(dataset,read_datatype,memory_dataspace,
-			  file_dataspace,H5P_DEFAULT,slice_array)) < 0) {
-      strcpy(error_string,"Error in H5Dwrite(itn_array)");
-      H5Dclose(dataset);
-      H5Sclose(file_dataspace);
-      H5Sclose(memory_dataspace);
-      H5Tclose(read_datatype);
-      H5Gclose(itn_group);
+#endif
+  if (region_is_valid == 0) {
       return(DM_FILEIO_FAILURE);
-    }
-
-    zoffset = iz*slice_npix;
-    for (ipix=0; ipix<slice_npix; ipix++) {
-      c_re(ptr_itn_array_struct->complex_array,(ipix+zoffset)) =
-	(*(slice_array+2*ipix));
-      c_im(ptr_itn_array_struct->complex_array,(ipix+zoffset)) =
-	(*(slice_array+2*ipix+1));
-    }
   }
 
-  free(slice_array);
-#endif /* USE_MPI */
-
+  status = dm_h5_read_array_region(dataset,memory_datatype,n_dims,
+                                   is_complex,offsets,strides,counts,
+                                   ptr_data,ptr_data_im,element_size,
+                                   error_string,my_rank,p);
   if (my_rank == 0) {
       H5Dclose(dataset);
-      H5Sclose(file_dataspace);
-      H5Sclose(memory_dataspace);
-      H5Tclose(read_datatype);
-      H5Gclose(itn_group);
   }
-  return(DM_FILEIO_SUCCESS);
+  return(status);
 }
 
 /*-------------------------------------------------------------------------*/
-void dm_h5_insert_adi_struct_members(hid_t datatype)
+int dm_h5_read_array_region(hid_t dataset,
+                            hid_t memory_datatype,
+                            int n_dims,
+                            int is_complex,
+                            hsize_t *region_offsets,
+                            hsize_t *region_strides,
+                            hsize_t *region_dims,
+                            void *ptr_data,
+                            void *ptr_data_im,
+                            size_t element_size,
+                            char *error_string,
+                            int my_rank,
+                            int p)
 {
-  H5Tinsert(datatype,"photon_scaling", 
-	    HOFFSET(dm_adi_struct,photon_scaling),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"error_scaling", 
-	    HOFFSET(dm_adi_struct,error_scaling),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"lambda_meters", 
-	    HOFFSET(dm_adi_struct,lambda_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"camera_z_meters", 
-	    HOFFSET(dm_adi_struct,camera_z_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"camera_x_pixelsize_meters", 
-	    HOFFSET(dm_adi_struct,camera_x_pixelsize_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"camera_y_pixelsize_meters", 
-	    HOFFSET(dm_adi_struct,camera_y_pixelsize_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"camera_alpha_radians", 
-	    HOFFSET(dm_adi_struct,camera_alpha_radians),
-	    H5T_NATIVE_DOUBLE); 
-  H5Tinsert(datatype,"camera_beta_radians", 
-	    HOFFSET(dm_adi_struct,camera_beta_radians),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"camera_gamma_radians", 
-	    HOFFSET(dm_adi_struct,camera_gamma_radians),
-	    H5T_NATIVE_DOUBLE); 
-  H5Tinsert(datatype,"median_filter_width", 
-	    HOFFSET(dm_adi_struct,median_filter_width),
-	    H5T_NATIVE_DOUBLE); 
-  H5Tinsert(datatype,"median_filter_threshold", 
-	    HOFFSET(dm_adi_struct,median_filter_threshold),
-	    H5T_NATIVE_DOUBLE); 
-  H5Tinsert(datatype,"saturation_min", 
-	    HOFFSET(dm_adi_struct,saturation_min),
-	    H5T_NATIVE_DOUBLE); 
-  H5Tinsert(datatype,"saturation_max", 
-	    HOFFSET(dm_adi_struct,saturation_max),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"theta_x_radians", 
-	    HOFFSET(dm_adi_struct,theta_x_radians),
-	    H5T_NATIVE_DOUBLE);
-  if (DM_AINFO_VERSION > 1) {
-    H5Tinsert(datatype,"theta_y_radians", 
-	      HOFFSET(dm_adi_struct,theta_y_radians),
-	      H5T_NATIVE_DOUBLE);
-    H5Tinsert(datatype,"theta_z_radians", 
-	      HOFFSET(dm_adi_struct,theta_z_radians),
-	      H5T_NATIVE_DOUBLE);
-  } /* endif(DM_AINFO_VERSION > 1) */
-  H5Tinsert(datatype,"xcenter_offset_pixels", 
-	    HOFFSET(dm_adi_struct,xcenter_offset_pixels),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"ycenter_offset_pixels", 
-	    HOFFSET(dm_adi_struct,ycenter_offset_pixels),
-	    H5T_NATIVE_DOUBLE);
+  hid_t file_dataspace;
+  hsize_t file_offsets[4], file_counts[4], memory_dims[1];
+  int i, islab, n_slabs, i_complex, n_complex, split_dim;
+  char *slab_buffer;
+  void *ptr_read;
+#if USE_MPI
+  MPI_Status mpi_status;
+#endif
+
+  /* As in dm_h5_write_array_slabs(), split complex arrays take every
+   * other element along the fast dimension.
+   */
+  n_complex = (ptr_data_im == NULL) ? 1 : 2;
+  memory_dims[0] = 1;
+  for (i=0; i<n_dims; i++) {
+      memory_dims[0] *= region_dims[i];
+      file_offsets[i] = region_offsets[i];
+      file_counts[i] = region_dims[i];
+  }
+  memory_dims[0] /= n_complex;
+  if (n_complex == 2) {
+      file_counts[n_dims-1] = 1;
+  }
+
+  /* The processes get consecutive pieces of the region, which means
+   * splitting the slowest dimension that is longer than one.
+   */
+  split_dim = 0;
+  while ((split_dim < (n_dims-1)) && (region_dims[split_dim] == 1)) {
+      split_dim++;
+  }
+#if USE_MPI
+  n_slabs = p;
+  memory_dims[0] /= p;
+  file_counts[split_dim] = region_dims[split_dim]/p;
+#else /* no USE_MPI */
+  n_slabs = 1;
+#endif /* USE_MPI */
+
+#if USE_MPI
+  if (my_rank > 0) {
+      for (i_complex=0; i_complex<n_complex; i_complex++) {
+          MPI_Recv((i_complex == 0) ? ptr_data : ptr_data_im,
+                   memory_dims[0]*element_size,MPI_BYTE,
+                   0,99-i_complex,MPI_COMM_WORLD,&mpi_status);
+      }
+      return(DM_FILEIO_SUCCESS);
+  }
+#endif /* USE_MPI */
+
+  if ((file_dataspace = H5Dget_space(dataset)) < 0) {
+      strcpy(error_string,"H5Dget_space() error");
+      return(DM_FILEIO_FAILURE);
+  }
+  slab_buffer = NULL;
+  if (n_slabs > 1) {
+      if ((slab_buffer = (char *)malloc(memory_dims[0]*element_size)) 
+          == NULL) {
+          strcpy(error_string,"slab malloc() error");
+          H5Sclose(file_dataspace);
+          return(DM_FILEIO_FAILURE);
+      }
+  }
+
+  for (islab=0; islab<n_slabs; islab++) {
+      file_offsets[split_dim] = region_offsets[split_dim]+
+          islab*file_counts[split_dim]*region_strides[split_dim];
+      for (i_complex=0; i_complex<n_complex; i_complex++) {
+          if (n_complex == 2) {
+              file_offsets[n_dims-1] = i_complex;
+          }
+          if (islab == 0) {
+              ptr_read = (i_complex == 0) ? ptr_data : ptr_data_im;
+          } else {
+              ptr_read = slab_buffer;
+          }
+          if (dm_h5_read_hyperslab(dataset,file_dataspace,memory_datatype,
+                                   n_dims,n_dims-1-is_complex,
+                                   file_offsets,region_strides,file_counts,
+                                   ptr_read,element_size,error_string)
+              != DM_FILEIO_SUCCESS) {
+              if (slab_buffer != NULL) 
+                  free(slab_buffer);
+              H5Sclose(file_dataspace);
+              return(DM_FILEIO_FAILURE);
+          }
+#if USE_MPI
+          if (islab > 0) {
+              MPI_Send(slab_buffer,memory_dims[0]*element_size,MPI_BYTE,
+                       islab,99-i_complex,MPI_COMM_WORLD);
+          }
+#endif /* USE_MPI */
+      } /* endfor(i_complex) */
+  } /* endfor(islab) */
+
+  if (slab_buffer != NULL) 
+      free(slab_buffer);
+  H5Sclose(file_dataspace);
+  return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-void dm_h5_insert_spt_struct_members(hid_t datatype)
+void dm_h5_pick_pixels(char *ptr_out,
+                       char *ptr_in,
+                       hsize_t n_pixels,
+                       hsize_t stride,
+                       size_t element_size)
 {
-  H5Tinsert(datatype,"support_scaling", 
-	    HOFFSET(dm_spt_struct,support_scaling),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"pix_x_meters", 
-	    HOFFSET(dm_spt_struct,pix_x_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"pix_y_meters", 
-	    HOFFSET(dm_spt_struct,pix_y_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"pix_z_meters", 
-	    HOFFSET(dm_spt_struct,pix_z_meters),
-	    H5T_NATIVE_DOUBLE);
+  hsize_t i;
+
+  /* Fixed sizes let the compiler do the copies without memcpy() */
+  if (stride == 1) {
+      memcpy(ptr_out,ptr_in,n_pixels*element_size);
+  } else if (element_size == sizeof(u_int32_t)) {
+      for (i=0; i<n_pixels; i++) {
+          *((u_int32_t *)ptr_out+i) = *((u_int32_t *)ptr_in+i*stride);
+      }
+  } else if (element_size == sizeof(u_int64_t)) {
+      for (i=0; i<n_pixels; i++) {
+          *((u_int64_t *)ptr_out+i) = *((u_int64_t *)ptr_in+i*stride);
+      }
+  } else if (element_size == 1) {
+      for (i=0; i<n_pixels; i++) {
+          *(ptr_out+i) = *(ptr_in+i*stride);
+      }
+  } else {
+      for (i=0; i<n_pixels; i++) {
+          memcpy(ptr_out+i*element_size,ptr_in+i*stride*element_size,
+                 element_size);
+      }
+  }
 }
 
 /*-------------------------------------------------------------------------*/
-void dm_h5_insert_itn_struct_members(hid_t datatype)
-				     
+int dm_h5_read_hyperslab(hid_t dataset,
+                         hid_t file_dataspace,
+                         hid_t memory_datatype,
+                         int n_dims,
+                         int x_dim,
+                         hsize_t *offsets,
+                         hsize_t *strides,
+                         hsize_t *counts,
+                         void *ptr_data,
+                         size_t element_size,
+                         char *error_string)
 {
+  hid_t memory_dataspace;
+  hsize_t file_dims[4], block_offsets[4], block_strides[4], block_counts[4];
+  hsize_t pick_offsets[4], pitches[4], indices[4];
+  hsize_t n_outer, i_outer, outers_per_block, outer_step, i_block;
+  hsize_t in_index, outer_bytes;
+  size_t block_bytes;
+  char *block_buffer, *ptr_out, *ptr_in;
+  int i, first_inner, last_dim, is_strided, status;
+
+  is_strided = 0;
+  for (i=0; i<=x_dim; i++) {
+      if (strides[i] > 1) is_strided = 1;
+  }
 
-  H5Tinsert(datatype,"photon_scaling", 
-	    HOFFSET(dm_itn_struct,photon_scaling),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"pix_x_meters", 
-	    HOFFSET(dm_itn_struct,pix_x_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"pix_y_meters", 
-	    HOFFSET(dm_itn_struct,pix_y_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"pix_z_meters", 
-	    HOFFSET(dm_itn_struct,pix_z_meters),
-	    H5T_NATIVE_DOUBLE);
-  H5Tinsert(datatype,"iterate_count", 
-	    HOFFSET(dm_itn_struct,iterate_count),
-	    H5T_NATIVE_UINT32);
- 
+  /* Giving the memory dataspace the shape of the file selection lets
+   * HDF 5 copy whole rows instead of going element by element. 
+   */
+  if (is_strided == 0) {
+      if ((memory_dataspace = H5Screate_simple(n_dims,counts,NULL)) < 0) {
+          strcpy(error_string,"H5Screate_simple(memory) error");
+          return(DM_FILEIO_FAILURE);
+      }
+      status = 
+          ((H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                                offsets,strides,counts,NULL) < 0) ||
+           (H5Dread(dataset,memory_datatype,memory_dataspace,
+                    file_dataspace,H5P_DEFAULT,ptr_data) < 0));
+      H5Sclose(memory_dataspace);
+      if (status) {
+          strcpy(error_string,"Error in H5Dread()");
+          return(DM_FILEIO_FAILURE);
+      }
+      return(DM_FILEIO_SUCCESS);
+  }
+
+  /* HDF 5 is slow with strided selections, even when only whole rows
+   * are skipped. So everything inside the slowest dimension is read 
+   * from the first to the last pixel we want, or in full after x, and
+   * picked out in memory. Along the slowest dimension we read one 
+   * wanted slab at a time if they are large, or else blocks of 
+   * consecutive slabs, skipped ones included.
+   */
+  if (H5Sget_simple_extent_dims(file_dataspace,file_dims,NULL) < 0) {
+      strcpy(error_string,"H5Sget_simple_extent_dims() error");
+      return(DM_FILEIO_FAILURE);
+  }
+  first_inner = (x_dim > 0) ? 1 : 0;
+  last_dim = n_dims-1;
+  for (i=0; i<n_dims; i++) {
+      if (i < first_inner) {
+          block_offsets[i] = offsets[i];
+          block_strides[i] = strides[i];
+          block_counts[i] = counts[i];
+          pick_offsets[i] = 0;
+      } else if ((i <= x_dim) && 
+                 (2*((counts[i]-1)*strides[i]+1) < file_dims[i])) {
+          block_offsets[i] = offsets[i];
+          block_strides[i] = 1;
+          block_counts[i] = (counts[i]-1)*strides[i]+1;
+          pick_offsets[i] = 0;
+      } else {
+          block_offsets[i] = 0;
+          block_strides[i] = 1;
+          block_counts[i] = file_dims[i];
+          pick_offsets[i] = offsets[i];
+      }
+  }
+  pitches[last_dim] = 1;
+  for (i=last_dim-1; i>=0; i--) {
+      pitches[i] = pitches[i+1]*block_counts[i+1];
+  }
+  if (first_inner == 1) {
+      n_outer = counts[0];
+      outer_bytes = pitches[0]*element_size;
+      outer_step = strides[0];
+      if ((outer_step > 1) && (outer_bytes >= DM_H5_REGION_MIN_READ_BYTES)) {
+          outers_per_block = 1;
+      } else {
+          outers_per_block = 
+              DM_H5_REGION_BLOCK_BYTES/(outer_bytes*outer_step);
+      }
+      if (outers_per_block < 1) {
+          outers_per_block = 1;
+      } else if (outers_per_block > n_outer) {
+          outers_per_block = n_outer;
+      }
+      block_strides[0] = 1;
+      block_bytes = ((outers_per_block-1)*outer_step+1)*outer_bytes;
+  } else {
+      n_outer = 1;
+      outers_per_block = 1;
+      outer_step = 1;
+      block_bytes = block_counts[0]*pitches[0]*element_size;
+  }
+  if ((block_buffer = (char *)malloc(block_bytes)) == NULL) {
+      strcpy(error_string,"block malloc() error");
+      return(DM_FILEIO_FAILURE);
+  }
+
+  ptr_out = (char *)ptr_data;
+  for (i_outer=0; i_outer<n_outer; i_outer+=outers_per_block) {
+      if (first_inner == 1) {
+          block_offsets[0] = offsets[0]+i_outer*outer_step;
+          block_counts[0] = ((n_outer-i_outer) < outers_per_block) ?
+              (n_outer-i_outer) : outers_per_block;
+          block_counts[0] = (block_counts[0]-1)*outer_step+1;
+      }
+      if ((memory_dataspace = 
+           H5Screate_simple(n_dims,block_counts,NULL)) < 0) {
+          strcpy(error_string,"H5Screate_simple(memory) error");
+          free(block_buffer);
+          return(DM_FILEIO_FAILURE);
+      }
+      status = 
+          ((H5Sselect_hyperslab(file_dataspace,H5S_SELECT_SET,
+                                block_offsets,block_strides,
+                                block_counts,NULL) < 0) ||
+           (H5Dread(dataset,memory_datatype,memory_dataspace,
+                    file_dataspace,H5P_DEFAULT,block_buffer) < 0));
+      H5Sclose(memory_dataspace);
+      if (status) {
+          strcpy(error_string,"Error in H5Dread()");
+          free(block_buffer);
+          return(DM_FILEIO_FAILURE);
+      }
+
+      /* Walk the pixels we want of each block in file order */
+      for (i_block=0; i_block<((first_inner == 1) ? block_counts[0] : 1); 
+           i_block+=outer_step) {
+          for (i=first_inner; i<n_dims; i++) {
+              indices[i] = 0;
+          }
+          do {
+              in_index = (first_inner == 1) ? i_block*pitches[0] : 0;
+              for (i=first_inner; i<last_dim; i++) {
+                  in_index += 
+                      (pick_offsets[i]+indices[i]*strides[i])*pitches[i];
+              }
+              ptr_in = block_buffer+
+                  (in_index+pick_offsets[last_dim])*element_size;
+              dm_h5_pick_pixels(ptr_out,ptr_in,counts[last_dim],
+                                strides[last_dim],element_size);
+              ptr_out += counts[last_dim]*element_size;
+              i = last_dim-1;
+              while (i >= first_inner) {
+                  indices[i]++;
+                  if (indices[i] < counts[i]) break;
+                  indices[i] = 0;
+                  i--;
+              }
+          } while (i >= first_inner);
+      }
+  }
+  
+  free(block_buffer);
+  return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
 void dm_clear_comments(dm_comment_struct *ptr_comment_struct)
 {
-  size_t i_char, total_bytes;
-
-  total_bytes = ptr_comment_struct->n_strings_max *
-      ptr_comment_struct->string_length;
-  for (i_char=0; i_char<total_bytes; i_char++) {
-      *(ptr_comment_struct->string_array+i_char) = '\000';
-  }
-  for (i_char=0; i_char<(ptr_comment_struct->string_length); i_char++) {
-      *(ptr_comment_struct->specimen_name+i_char) = '\000';
-      *(ptr_comment_struct->collection_date+i_char) = '\000';
-  }
+  /* dm_add_string_to_comments() fills a whole slot of string_array,
+   * so there is no need to touch the slots we are throwing away.
+   */
+  memset(ptr_comment_struct->specimen_name,0,
+	 ptr_comment_struct->string_length);
+  memset(ptr_comment_struct->collection_date,0,
+	 ptr_comment_struct->string_length);
   ptr_comment_struct->n_strings = 0;
 }
 
 /*-------------------------------------------------------------------------*/
-void dm_add_string_to_comments(char *string_to_add,
-			       dm_comment_struct *ptr_comment_struct)
+int dm_add_string_to_comments(char *string_to_add,
+			      dm_comment_struct *ptr_comment_struct)
 {
   int i_char, i_offset, this_strlen, last_index;
-  char this_char;
+  char this_char, grow_error_string[80];
 
-  /* Do nothing if we have no room to add the string */
-  if (((ptr_comment_struct->n_strings)+1) > 
-      (ptr_comment_struct->n_strings_max)) return;
+  /* Make room for the string if string_array is full */
+  if (dm_grow_comments(ptr_comment_struct,
+		       (ptr_comment_struct->n_strings)+1,
+		       grow_error_string) != DM_FILEIO_SUCCESS) {
+    return(DM_FILEIO_FAILURE);
+  }
 
   /* Only copy characters up to the end of each string length, no matter
    * how long string_to_add is.
@@ -7366,7 +10292,7 @@ void dm_add_string_to_comments(char *string_to_add,
   i_char = 0;
   last_index = ptr_comment_struct->string_length-1;
   while (i_char < last_index) {
-    this_char = *(string_to_add+i_char);
+    this_char = (i_char < this_strlen) ? *(string_to_add+i_char) : '\000';
     if ((i_char < this_strlen) && (this_char != '\n') &&
 	(this_char != '\r')) {
       *(ptr_comment_struct->string_array+i_char+i_offset) = this_char;
@@ -7378,6 +10304,8 @@ void dm_add_string_to_comments(char *string_to_add,
   /* Make sure the string is null-terminated */
   *(ptr_comment_struct->string_array+last_index+i_offset) = '\000';
   ptr_comment_struct->n_strings += 1;
+
+  return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -7394,7 +10322,7 @@ void dm_add_specimen_name_to_comments(char *string_to_add,
   last_index = (ptr_comment_struct->string_length)-1;
   i_char = 0;
   while (i_char < last_index) {
-    this_char = *(string_to_add+i_char);
+    this_char = (i_char < this_strlen) ? *(string_to_add+i_char) : '\000';
     if ((i_char < this_strlen) && (this_char != '\n') &&
 	(this_char != '\r')) {
       *(ptr_comment_struct->specimen_name+i_char) = this_char;
@@ -7421,7 +10349,7 @@ void dm_add_collection_date_to_comments(char *string_to_add,
   last_index = (ptr_comment_struct->string_length)-1;
   i_char = 0;
   while (i_char < last_index) {
-    this_char = *(string_to_add+i_char);
+    this_char = (i_char < this_strlen) ? *(string_to_add+i_char) : '\000';
     if ((i_char < this_strlen) && (this_char != '\n') &&
 	(this_char != '\r')) {
       *(ptr_comment_struct->collection_date+i_char) = this_char;
@@ -7439,36 +10367,19 @@ void dm_clear_local_string_array(char *local_string_array,
 				 int string_length, 
 				 int n_frames)
 {
-  size_t i_char, total_bytes;
-  total_bytes = string_length * n_frames;
-  for (i_char=0; i_char<total_bytes; i_char++) {
-    *local_string_array = '\000';
-  }
+  memset(local_string_array,0,(size_t)string_length*n_frames);
 }
 
 /*-------------------------------------------------------------------------*/
 void dm_clear_ainfo(dm_ainfo_struct *ptr_ainfo_struct)
 {
-   size_t i_char, total_bytes;
-
-   total_bytes = ptr_ainfo_struct->n_frames_max *
-       ptr_ainfo_struct->string_length;
-   for (i_char=0; i_char<total_bytes; i_char++) {
-       *(ptr_ainfo_struct->filename_array+i_char) = '\000';
-       *(ptr_ainfo_struct->systime_array+i_char) = '\000';
-   }
-   for (i_char=0; i_char<(ptr_ainfo_struct->string_length); i_char++) {
-       *(ptr_ainfo_struct->file_directory+i_char) = '\000';
-   }
-   for (i_char=0; i_char<(ptr_ainfo_struct->n_frames_max); i_char++) {
-       *(ptr_ainfo_struct->theta_x_radians_array) = (double) 0;
-       if (DM_AINFO_VERSION > 1) {
-	 *(ptr_ainfo_struct->theta_y_radians_array) = (double) 0;
-	 *(ptr_ainfo_struct->theta_z_radians_array) = (double) 0;
-       } /* endif(DM_AINFO_VERSION > 1) */
-       *(ptr_ainfo_struct->xcenter_offset_pixels_array) = (double) 0;
-       *(ptr_ainfo_struct->ycenter_offset_pixels_array) = (double) 0;  
-   }
+   /* The dm_add_*_to_ainfo() routines write complete entries and
+    * dm_check_ainfo() pads everything up to n_frames, so entries
+    * past the offsets are never looked at. Resetting the offsets
+    * is all it takes.
+    */
+   memset(ptr_ainfo_struct->file_directory,0,
+	  ptr_ainfo_struct->string_length);
    ptr_ainfo_struct->n_frames = 0;
    ptr_ainfo_struct->file_directory_flag = 0;
    ptr_ainfo_struct->filenames_offset = 0;
@@ -7495,7 +10406,7 @@ void dm_add_file_directory_to_ainfo(char *directory_to_add,
   last_index = (ptr_ainfo_struct->string_length)-1;
   i_char = 0;
   while (i_char < last_index) {
-    this_char = *(directory_to_add+i_char);
+    this_char = (i_char < this_strlen) ? *(directory_to_add+i_char) : '\000';
     if ((i_char < this_strlen) && (this_char != '\n') &&
 	(this_char != '\r')) {
       *(ptr_ainfo_struct->file_directory+i_char) = this_char;
@@ -7509,15 +10420,17 @@ void dm_add_file_directory_to_ainfo(char *directory_to_add,
   ptr_ainfo_struct->file_directory_flag++;
 }
 /*-------------------------------------------------------------------------*/
-void dm_add_filename_to_ainfo(char *filename_to_add,
-			      dm_ainfo_struct *ptr_ainfo_struct)
+int dm_add_filename_to_ainfo(char *filename_to_add,
+			     dm_ainfo_struct *ptr_ainfo_struct)
 {
   int i_char, i_offset, this_strlen, last_index;
-  char this_char;
+  char this_char, grow_error_string[80];
 
-  /* Do nothing if we have no room to add the string */
-  if (((ptr_ainfo_struct->filenames_offset)+1) > 
-      (ptr_ainfo_struct->n_frames_max)) return;
+  /* Make room for the string if the arrays are full */
+  if (dm_grow_ainfo(ptr_ainfo_struct,(ptr_ainfo_struct->filenames_offset)+1,
+		    grow_error_string) != DM_FILEIO_SUCCESS) {
+    return(DM_FILEIO_FAILURE);
+  }
 
   /* Only copy characters up to the end of each string length, no matter
    * how long filename_to_add is.
@@ -7528,7 +10441,7 @@ void dm_add_filename_to_ainfo(char *filename_to_add,
   i_char = 0;
   last_index = ptr_ainfo_struct->string_length-1;
   while (i_char < last_index) {
-    this_char = *(filename_to_add+i_char);
+    this_char = (i_char < this_strlen) ? *(filename_to_add+i_char) : '\000';
     if ((i_char < this_strlen) && (this_char != '\n') &&
 	(this_char != '\r')) {
       *(ptr_ainfo_struct->filename_array+i_char+i_offset) = this_char;
@@ -7541,6 +10454,7 @@ void dm_add_filename_to_ainfo(char *filename_to_add,
   *(ptr_ainfo_struct->filename_array+last_index+i_offset) = '\000';
   ptr_ainfo_struct->filenames_offset += 1;
 
+  return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -7549,33 +10463,41 @@ int dm_add_double_to_ainfo(char *tagname,
 			   dm_ainfo_struct *ptr_ainfo_struct,
 			   char *error_string)
 {
+  double **ptr_array;
+  int *ptr_offset;
+
   /* Check tagname first to determine which double array is to be edited */
   if (strcmp(tagname,"theta_x") == 0) {
-    *(ptr_ainfo_struct->theta_x_radians_array 
-      + ptr_ainfo_struct->theta_x_offset) = double_to_add;
-    ptr_ainfo_struct->theta_x_offset++;
+    ptr_array = &(ptr_ainfo_struct->theta_x_radians_array);
+    ptr_offset = &(ptr_ainfo_struct->theta_x_offset);
   } else if ((DM_AINFO_VERSION > 1) && (strcmp(tagname,"theta_y") == 0)) {
-    *(ptr_ainfo_struct->theta_y_radians_array 
-      + ptr_ainfo_struct->theta_y_offset) = double_to_add;
-    ptr_ainfo_struct->theta_y_offset++;
+    ptr_array = &(ptr_ainfo_struct->theta_y_radians_array);
+    ptr_offset = &(ptr_ainfo_struct->theta_y_offset);
   } else if ((DM_AINFO_VERSION > 1) && (strcmp(tagname,"theta_z") == 0)) {
-    *(ptr_ainfo_struct->theta_z_radians_array 
-      + ptr_ainfo_struct->theta_z_offset) = double_to_add;
-    ptr_ainfo_struct->theta_z_offset++;
+    ptr_array = &(ptr_ainfo_struct->theta_z_radians_array);
+    ptr_offset = &(ptr_ainfo_struct->theta_z_offset);
   } else if (strcmp(tagname,"xcenter") == 0) {
-    *(ptr_ainfo_struct->xcenter_offset_pixels_array 
-      + ptr_ainfo_struct->xcenter_offset) = double_to_add;
-    ptr_ainfo_struct->xcenter_offset++;
+    ptr_array = &(ptr_ainfo_struct->xcenter_offset_pixels_array);
+    ptr_offset = &(ptr_ainfo_struct->xcenter_offset);
   } else if (strcmp(tagname,"ycenter") == 0) {
-    *(ptr_ainfo_struct->ycenter_offset_pixels_array 
-       + ptr_ainfo_struct->ycenter_offset) = double_to_add;
-     ptr_ainfo_struct->ycenter_offset++;
+    ptr_array = &(ptr_ainfo_struct->ycenter_offset_pixels_array);
+    ptr_offset = &(ptr_ainfo_struct->ycenter_offset);
   } else {
     strcpy(error_string,
 	   "dm_add_double_to_ainfo: No matching array for given tagname.");
     return(DM_FILEIO_FAILURE);
   }
 
+  /* Make room for the value if the arrays are full. This may
+   * move the arrays, which is why we hold on to ptr_array.
+   */
+  if (dm_grow_ainfo(ptr_ainfo_struct,(*ptr_offset)+1,
+		    error_string) != DM_FILEIO_SUCCESS) {
+    return(DM_FILEIO_FAILURE);
+  }
+  *((*ptr_array)+(*ptr_offset)) = double_to_add;
+  (*ptr_offset)++;
+
   return(DM_FILEIO_SUCCESS);
 }
 
@@ -7584,131 +10506,285 @@ int dm_read_ainfo_from_csv(char *csv_filename,
 			   dm_ainfo_struct *ptr_ainfo_struct,
 			   char *error_string)
 {
-  int i_char, i_array, offset, i, count, i_split, ainfo_tags, tag_count;
+  int tag_count, n_lines, tag, *ptr_offset;
   FILE *fp;
-  char *local_filename_array, this_char;
-  char *temp_string, *split_string[AINFO_TAGS];
-  size_t n_chars;
-  double *temp_double;
+  char *file_buffer, *line, *line_end, *next_line, *value, *value_end;
+  long file_size;
+  double *ptr_array;
+  int to_radians;
   
-  n_chars = 
-    (int)ptr_ainfo_struct->n_frames_max*ptr_ainfo_struct->string_length;
   if ((fp = fopen(csv_filename,"r")) == NULL) {
     strcpy(error_string,"Error opening csv_filename.\n");
     return(DM_FILEIO_FAILURE);
   }
 
-  local_filename_array = (char *)malloc(n_chars);
-
-  /* Read file character by character into local_filename_array */
-  count = 0;
-  while (fscanf(fp,"%c", (local_filename_array +count)) == 1) {
-    count++;
-    if (count == n_chars -1) {
-      strcpy(error_string, 
-	     "dm_read_ainfo_from_csv: Size of list of filenames exceeds allocated memory.");
-      free(local_filename_array);
-      fclose(fp);
-      return(DM_FILEIO_FAILURE);
-    }
+  /* Read the whole file with a single fread() into a buffer of 
+   * its own size, so there is no limit on the number of frames.
+   */
+  if ((fseek(fp,0L,SEEK_END) != 0) || ((file_size = ftell(fp)) < 0) ||
+      (fseek(fp,0L,SEEK_SET) != 0)) {
+    strcpy(error_string,
+	   "dm_read_ainfo_from_csv: Can not determine size of csv_filename.");
+    fclose(fp);
+    return(DM_FILEIO_FAILURE);
   }
+  if ((file_buffer = (char *)malloc((size_t)file_size+1)) == NULL) {
+    strcpy(error_string,"dm_read_ainfo_from_csv: malloc() error");
+    fclose(fp);
+    return(DM_FILEIO_FAILURE);
+  }
+  file_size = (long)fread(file_buffer,1,(size_t)file_size,fp);
   fclose(fp);
-  
+  *(file_buffer+file_size) = '\000';
+
+  /* Each line is "tag=value,value,...". We walk through the buffer
+   * once, terminating every value in place.
+   */
   tag_count = 0;
-  i_split = 0;
-  split_string[0] = strtok(local_filename_array,"\n");
-  while (split_string[i_split] != NULL) {
-    split_string[i_split+1] = strtok(NULL,"\n");
-    i_split++;
-    /* Make sure we don't try to use more pointer than we allocated */
-    if (i_split == ptr_ainfo_struct->ainfo_tags) {
-      break;
+  n_lines = 0;
+  line = file_buffer;
+  while (line < (file_buffer+file_size)) {
+    if ((line_end = strchr(line,'\n')) == NULL) {
+      line_end = file_buffer+file_size;
     }
-  }
-  
-  for (i=0;i<i_split;i++) {
-    if (strncmp(split_string[i], "directory", 9) == 0) {
-      /* Split at '=' sign, then move pointer to next character */
-      temp_string = strchr(split_string[i],'=');
-      temp_string++;
-      dm_add_file_directory_to_ainfo(temp_string,ptr_ainfo_struct);
-    } else if (strncmp(split_string[i], "filenames", 9) == 0) {
-      temp_string = strtok(split_string[i],",");
-      temp_string = strchr(temp_string,'=');
-      temp_string++;
-      while (temp_string != NULL) {
-	dm_add_filename_to_ainfo(temp_string, ptr_ainfo_struct);
-	temp_string = strtok(NULL,",");
-      }
-    } else if (strncmp(split_string[i], "systimes", 8) == 0) {
-      temp_string = strtok(split_string[i],",");
-      temp_string = strchr(temp_string,'=');
-      temp_string++;
-      while (temp_string != NULL) {
-	dm_add_systime_to_ainfo(temp_string, ptr_ainfo_struct);
-	temp_string = strtok(NULL,",");
-      }
-    } else if (strncmp(split_string[i], "gmr_x", 5) == 0) {
-      temp_string = strtok(split_string[i],",");
-      temp_string = strchr(temp_string,'=');
-      temp_string++;
-      while (temp_string != NULL) {
-	*(ptr_ainfo_struct->theta_x_radians_array + 
-	  ptr_ainfo_struct->theta_x_offset) = 
-	  PI*strtod(temp_string,NULL)/(180.0);
-	ptr_ainfo_struct->theta_x_offset++;
-	temp_string = strtok(NULL,",");
-      }
-    } else if (strncmp(split_string[i], "xcenter", 7) == 0) {
-      temp_string = strtok(split_string[i],",");
-      temp_string = strchr(temp_string,'=');
-      temp_string++;
-      while (temp_string != NULL) {
-	*(ptr_ainfo_struct->xcenter_offset_pixels_array + 
-	  ptr_ainfo_struct->xcenter_offset) = strtod(temp_string,NULL);
-	ptr_ainfo_struct->xcenter_offset++;
-	temp_string = strtok(NULL,",");
-      }
-    } else if (strncmp(split_string[i], "ycenter", 7) == 0) {
-      temp_string = strtok(split_string[i],",");
-      temp_string = strchr(temp_string,'=');
-      temp_string++;
-      while (temp_string != NULL) {
-	*(ptr_ainfo_struct->ycenter_offset_pixels_array + 
-	  ptr_ainfo_struct->ycenter_offset) = strtod(temp_string,NULL);
-	ptr_ainfo_struct->ycenter_offset++;
-	temp_string = strtok(NULL,",");
-      }
+    next_line = line_end+1;
+    *line_end = '\000';
+    if ((line_end > line) && (*(line_end-1) == '\r')) {
+      line_end--;
+      *line_end = '\000';
+    }
+    if (*line == '\000') {
+      line = next_line;
+      continue;
+    }
+    n_lines++;
+
+    /* tag: 0 directory, 1 filenames, 2 systimes, 3 doubles, -1 unknown */
+    ptr_offset = NULL;
+    to_radians = 0;
+    if (strncmp(line,"directory",9) == 0) {
+      tag = 0;
+    } else if (strncmp(line,"filenames",9) == 0) {
+      tag = 1;
+    } else if (strncmp(line,"systimes",8) == 0) {
+      tag = 2;
+    } else if (strncmp(line,"gmr_x",5) == 0) {
+      tag = 3;
+      ptr_offset = &(ptr_ainfo_struct->theta_x_offset);
+      to_radians = 1;
+    } else if (strncmp(line,"xcenter",7) == 0) {
+      tag = 3;
+      ptr_offset = &(ptr_ainfo_struct->xcenter_offset);
+    } else if (strncmp(line,"ycenter",7) == 0) {
+      tag = 3;
+      ptr_offset = &(ptr_ainfo_struct->ycenter_offset);
     } else {
       /* Count the tags that did not match any of the above statements*/
+      tag = -1;
       tag_count++;
     }
+    
+    if ((tag >= 0) && ((value = strchr(line,'=')) != NULL)) {
+      value++;
+      if (tag == 0) {
+	dm_add_file_directory_to_ainfo(value,ptr_ainfo_struct);
+	value = line_end;
+      }
+      while (value < line_end) {
+	if ((value_end = strchr(value,',')) == NULL) {
+	  value_end = line_end;
+	}
+	*value_end = '\000';
+	/* Empty values between two commas are skipped */
+	if (value_end > value) {
+	  if (tag == 1) {
+	    if (dm_add_filename_to_ainfo(value,ptr_ainfo_struct) 
+		!= DM_FILEIO_SUCCESS) {
+	      strcpy(error_string,
+		     "dm_read_ainfo_from_csv: dm_add_filename_to_ainfo() error");
+	      free(file_buffer);
+	      return(DM_FILEIO_FAILURE);
+	    }
+	  } else if (tag == 2) {
+	    if (dm_add_systime_to_ainfo(value,ptr_ainfo_struct) 
+		!= DM_FILEIO_SUCCESS) {
+	      strcpy(error_string,
+		     "dm_read_ainfo_from_csv: dm_add_systime_to_ainfo() error");
+	      free(file_buffer);
+	      return(DM_FILEIO_FAILURE);
+	    }
+	  } else {
+	    if ((*ptr_offset >= ptr_ainfo_struct->n_frames_max) &&
+		(dm_grow_ainfo(ptr_ainfo_struct,*ptr_offset+1,
+			       error_string) == DM_FILEIO_FAILURE)) {
+	      free(file_buffer);
+	      return(DM_FILEIO_FAILURE);
+	    }
+	    /* dm_grow_ainfo() may have moved the arrays */
+	    if (ptr_offset == &(ptr_ainfo_struct->theta_x_offset)) {
+	      ptr_array = ptr_ainfo_struct->theta_x_radians_array;
+	    } else if (ptr_offset == &(ptr_ainfo_struct->xcenter_offset)) {
+	      ptr_array = ptr_ainfo_struct->xcenter_offset_pixels_array;
+	    } else {
+	      ptr_array = ptr_ainfo_struct->ycenter_offset_pixels_array;
+	    }
+	    if (to_radians == 1) {
+	      *(ptr_array+(*ptr_offset)) = PI*strtod(value,NULL)/(180.0);
+	    } else {
+	      *(ptr_array+(*ptr_offset)) = strtod(value,NULL);
+	    }
+	    (*ptr_offset)++;
+	  }
+	}
+	value = value_end+1;
+      }
+    }
+    line = next_line;
   }
+  free(file_buffer);
   
   /* If the number of not matching tags equals the total number of tags,
    * then the csv file is not good.
    */
-  if (tag_count == i_split) {
+  if (tag_count == n_lines) {
     strcpy(error_string,
 	   "dm_read_ainfo_from_csv: File does not contain any matching arguments.\n");
     return(DM_FILEIO_FAILURE);
   }
   
-  free(local_filename_array);
   return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
-void dm_add_systime_to_ainfo(char *systime_to_add,
-			     dm_ainfo_struct *ptr_ainfo_struct)
+int dm_grow_ainfo(dm_ainfo_struct *ptr_ainfo_struct,
+		  int n_frames_needed,
+		  char *error_string)
+{
+  int n_frames_max, old_n_frames_max;
+  char *new_filename_array, *new_systime_array;
+  double *new_double_array;
+  size_t old_bytes, new_bytes;
+
+  old_n_frames_max = ptr_ainfo_struct->n_frames_max;
+  if (n_frames_needed <= old_n_frames_max) {
+    return(DM_FILEIO_SUCCESS);
+  }
+  
+  /* Double the size so that adding frames one by one stays cheap */
+  n_frames_max = (old_n_frames_max > 0) ? old_n_frames_max : 1;
+  while (n_frames_max < n_frames_needed) {
+    n_frames_max *= 2;
+  }
+
+  old_bytes = (size_t)old_n_frames_max*ptr_ainfo_struct->string_length;
+  new_bytes = (size_t)n_frames_max*ptr_ainfo_struct->string_length;
+  if ((new_filename_array = (char *)
+       realloc(ptr_ainfo_struct->filename_array,new_bytes)) == NULL) {
+    strcpy(error_string,"dm_grow_ainfo: realloc(filename_array) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  ptr_ainfo_struct->filename_array = new_filename_array;
+  memset(new_filename_array+old_bytes,0,new_bytes-old_bytes);
+  
+  if ((new_systime_array = (char *)
+       realloc(ptr_ainfo_struct->systime_array,new_bytes)) == NULL) {
+    strcpy(error_string,"dm_grow_ainfo: realloc(systime_array) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  ptr_ainfo_struct->systime_array = new_systime_array;
+  memset(new_systime_array+old_bytes,0,new_bytes-old_bytes);
+
+  new_bytes = (size_t)n_frames_max*sizeof(double);
+  if ((new_double_array = (double *)
+       realloc(ptr_ainfo_struct->theta_x_radians_array,new_bytes)) == NULL) {
+    strcpy(error_string,"dm_grow_ainfo: realloc(theta_x_radians_array) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  ptr_ainfo_struct->theta_x_radians_array = new_double_array;
+  
+  if (DM_AINFO_VERSION > 1) {
+    if ((new_double_array = (double *)
+	 realloc(ptr_ainfo_struct->theta_y_radians_array,new_bytes)) == NULL) {
+      strcpy(error_string,
+	     "dm_grow_ainfo: realloc(theta_y_radians_array) error");
+      return(DM_FILEIO_FAILURE);
+    }
+    ptr_ainfo_struct->theta_y_radians_array = new_double_array;
+    
+    if ((new_double_array = (double *)
+	 realloc(ptr_ainfo_struct->theta_z_radians_array,new_bytes)) == NULL) {
+      strcpy(error_string,
+	     "dm_grow_ainfo: realloc(theta_z_radians_array) error");
+      return(DM_FILEIO_FAILURE);
+    }
+    ptr_ainfo_struct->theta_z_radians_array = new_double_array;
+  } /* endif(DM_AINFO_VERSION > 1) */
+  
+  if ((new_double_array = (double *)
+       realloc(ptr_ainfo_struct->xcenter_offset_pixels_array,
+	       new_bytes)) == NULL) {
+    strcpy(error_string,
+	   "dm_grow_ainfo: realloc(xcenter_offset_pixels_array) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  ptr_ainfo_struct->xcenter_offset_pixels_array = new_double_array;
+  
+  if ((new_double_array = (double *)
+       realloc(ptr_ainfo_struct->ycenter_offset_pixels_array,
+	       new_bytes)) == NULL) {
+    strcpy(error_string,
+	   "dm_grow_ainfo: realloc(ycenter_offset_pixels_array) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  ptr_ainfo_struct->ycenter_offset_pixels_array = new_double_array;
+
+  ptr_ainfo_struct->n_frames_max = n_frames_max;
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_grow_comments(dm_comment_struct *ptr_comment_struct,
+		     int n_strings_needed,
+		     char *error_string)
+{
+  int n_strings_max;
+  char *new_string_array;
+
+  if (n_strings_needed <= ptr_comment_struct->n_strings_max) {
+    return(DM_FILEIO_SUCCESS);
+  }
+
+  /* Double the size so that adding strings one by one stays cheap */
+  n_strings_max = (ptr_comment_struct->n_strings_max > 0) ? 
+    ptr_comment_struct->n_strings_max : 1;
+  while (n_strings_max < n_strings_needed) {
+    n_strings_max *= 2;
+  }
+
+  if ((new_string_array = (char *)
+       realloc(ptr_comment_struct->string_array,
+	       (size_t)n_strings_max*ptr_comment_struct->string_length)) 
+      == NULL) {
+    strcpy(error_string,"dm_grow_comments: realloc(string_array) error");
+    return(DM_FILEIO_FAILURE);
+  }
+  ptr_comment_struct->string_array = new_string_array;
+  ptr_comment_struct->n_strings_max = n_strings_max;
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_add_systime_to_ainfo(char *systime_to_add,
+			    dm_ainfo_struct *ptr_ainfo_struct)
 {
   int i_char, i_offset, this_strlen, last_index;
-  char this_char;
+  char this_char, grow_error_string[80];
 
-  /* Do nothing if we have no room to add the string */
-  if (((ptr_ainfo_struct->systimes_offset)+1) > 
-      (ptr_ainfo_struct->n_frames_max)) return;
- 
+  /* Make room for the string if the arrays are full */
+  if (dm_grow_ainfo(ptr_ainfo_struct,(ptr_ainfo_struct->systimes_offset)+1,
+		    grow_error_string) != DM_FILEIO_SUCCESS) {
+    return(DM_FILEIO_FAILURE);
+  }
 
   /* Only copy characters up to the end of each string length, no matter
    * how long filename_to_add is.
@@ -7719,7 +10795,7 @@ void dm_add_systime_to_ainfo(char *systime_to_add,
   i_char = 0;
   last_index = ptr_ainfo_struct->string_length-1;
   while (i_char < last_index) {
-    this_char = *(systime_to_add+i_char);
+    this_char = (i_char < this_strlen) ? *(systime_to_add+i_char) : '\000';
     if ((i_char < this_strlen) && (this_char != '\n') &&
 	(this_char != '\r')) {
       *(ptr_ainfo_struct->systime_array+i_char+i_offset) = this_char;
@@ -7732,6 +10808,7 @@ void dm_add_systime_to_ainfo(char *systime_to_add,
   *(ptr_ainfo_struct->systime_array+last_index+i_offset) = '\000';
   ptr_ainfo_struct->systimes_offset += 1;
 
+  return(DM_FILEIO_SUCCESS);
 }
 
 /*-------------------------------------------------------------------------*/
@@ -7843,7 +10920,13 @@ int dm_check_ainfo(dm_ainfo_struct *ptr_ainfo_struct,
     int i_array;
 
     if (my_rank == 0) {
-        /* First check that no offset is greater than n_frames */
+        /* Make sure that every array can hold n_frames entries */
+        if (dm_grow_ainfo(ptr_ainfo_struct,ptr_ainfo_struct->n_frames,
+			  error_string) != DM_FILEIO_SUCCESS) {
+            return(DM_FILEIO_FAILURE);
+        }
+
+        /* Then check that no offset is greater than n_frames */
         if (ptr_ainfo_struct->filenames_offset > ptr_ainfo_struct->n_frames) {
             strcpy(error_string,"dm_check_ainfo: filename_array too long");
             return(DM_FILEIO_FAILURE);
@@ -7894,14 +10977,24 @@ int dm_check_ainfo(dm_ainfo_struct *ptr_ainfo_struct,
         if (ptr_ainfo_struct->filenames_offset < ptr_ainfo_struct->n_frames) {
             for (i_array=ptr_ainfo_struct->filenames_offset; 
                  i_array < ptr_ainfo_struct->n_frames; i_array++ ) {
-                dm_add_filename_to_ainfo(" ", ptr_ainfo_struct);
+                if (dm_add_filename_to_ainfo(" ", ptr_ainfo_struct) 
+                    != DM_FILEIO_SUCCESS) {
+                    strcpy(error_string,
+                           "dm_check_ainfo: dm_add_filename_to_ainfo() error");
+                    return(DM_FILEIO_FAILURE);
+                }
             }
         }
 
         if (ptr_ainfo_struct->systimes_offset < ptr_ainfo_struct->n_frames) {
             for (i_array=ptr_ainfo_struct->systimes_offset; 
                  i_array < ptr_ainfo_struct->n_frames; i_array++ ) {
-                dm_add_systime_to_ainfo(" ", ptr_ainfo_struct);
+                if (dm_add_systime_to_ainfo(" ", ptr_ainfo_struct) 
+                    != DM_FILEIO_SUCCESS) {
+                    strcpy(error_string,
+                           "dm_check_ainfo: dm_add_systime_to_ainfo() error");
+                    return(DM_FILEIO_FAILURE);
+                }
             }
         }
 
@@ -7954,3 +11047,463 @@ int dm_check_ainfo(dm_ainfo_struct *ptr_ainfo_struct,
 }
 
 
+
+/*-------------------------------------------------------------------------*/
+int dm_read_frame_stack(dm_ainfo_struct *ptr_ainfo_struct,
+			dm_frame_stack_struct *ptr_frame_stack_struct,
+			dm_array_real_struct *ptr_ras,
+			char *error_string,
+			int my_rank,
+			int p)
+{
+  dm_frame_pool_struct pool;
+  pthread_t *threads;
+  dm_array_real *merge_array, *slot_array;
+  dm_array_index_t npix;
+  int i_frame, i_thread, n_threads, status, slot;
+  double counters[3];
+  struct timeval tv_start, tv_stop;
+#if USE_MPI
+  int i;
+  dm_array_index_t ipix;
+  dm_array_real *slice_array;
+  MPI_Status mpi_status;
+#endif
+
+  strcpy(error_string,"");
+  status = DM_FILEIO_SUCCESS;
+  merge_array = NULL;
+  npix = (dm_array_index_t)ptr_ras->nx*ptr_ras->ny;
+  counters[0] = 0.;
+  counters[1] = 0.;
+  counters[2] = 0.;
+  
+  if ((ptr_ras->nz > 1) || (npix != ptr_ras->npix)) {
+    strcpy(error_string,"dm_read_frame_stack: real_array must be 2D");
+    return(DM_FILEIO_FAILURE);
+  }
+  
+  if (my_rank == 0) {
+    gettimeofday(&tv_start,NULL);
+    
+    /* Without MPI the frames are merged straight into real_array */
+    if (USE_MPI) {
+      if ((merge_array = (dm_array_real *)
+	   calloc(npix,sizeof(dm_array_real))) == NULL) {
+	strcpy(error_string,"dm_read_frame_stack: malloc(merge_array) error");
+	status = DM_FILEIO_FAILURE;
+      }
+    } else {
+      merge_array = ptr_ras->real_array;
+    }
+    
+    n_threads = ptr_frame_stack_struct->n_threads;
+    if (n_threads < 1) {
+      n_threads = 1;
+    }
+    pool.ptr_ainfo_struct = ptr_ainfo_struct;
+    pool.ptr_frame_stack_struct = ptr_frame_stack_struct;
+    pool.nx = ptr_ras->nx;
+    pool.ny = ptr_ras->ny;
+    pool.n_frames = ptr_ainfo_struct->filenames_offset;
+    pool.n_slots = ptr_frame_stack_struct->read_ahead;
+    if (pool.n_slots < n_threads) {
+      pool.n_slots = n_threads;
+    }
+    if (pool.n_slots > pool.n_frames) {
+      pool.n_slots = (pool.n_frames > 0) ? pool.n_frames : 1;
+    }
+    if (n_threads > pool.n_slots) {
+      n_threads = pool.n_slots;
+    }
+    pool.next_frame = 0;
+    pool.n_merged = 0;
+    pool.failed = 0;
+    pool.bytes_read = 0.;
+    strcpy(pool.error_string,"");
+    
+    pool.slot_arrays = NULL;
+    pool.slot_frames = NULL;
+    threads = NULL;
+    if (status == DM_FILEIO_SUCCESS) {
+      pool.slot_arrays = (dm_array_real *)
+	malloc((size_t)pool.n_slots*npix*sizeof(dm_array_real));
+      pool.slot_frames = (int *)malloc(pool.n_slots*sizeof(int));
+      threads = (pthread_t *)malloc(n_threads*sizeof(pthread_t));
+      if ((pool.slot_arrays == NULL) || (pool.slot_frames == NULL) ||
+	  (threads == NULL)) {
+	strcpy(error_string,"dm_read_frame_stack: malloc(slots) error");
+	status = DM_FILEIO_FAILURE;
+      }
+    }
+
+    if ((status == DM_FILEIO_SUCCESS) && (pool.n_frames > 0)) {
+      for (slot=0; slot<pool.n_slots; slot++) {
+	*(pool.slot_frames+slot) = -1;
+      }
+      pthread_mutex_init(&pool.mutex,NULL);
+      pthread_cond_init(&pool.slot_ready,NULL);
+      pthread_cond_init(&pool.slot_free,NULL);
+      
+      for (i_thread=0; i_thread<n_threads; i_thread++) {
+	if (pthread_create(threads+i_thread,NULL,
+			   dm_frame_stack_worker,&pool) != 0) {
+	  pthread_mutex_lock(&pool.mutex);
+	  pool.failed = 1;
+	  strcpy(pool.error_string,"dm_read_frame_stack: pthread_create error");
+	  pthread_cond_broadcast(&pool.slot_free);
+	  pthread_mutex_unlock(&pool.mutex);
+	  break;
+	}
+      }
+      n_threads = i_thread;
+      
+      /* Merge the frames in order, so that the sum does not depend
+       * on which thread read which frame.
+       */
+      for (i_frame=0; i_frame<pool.n_frames; i_frame++) {
+	slot = i_frame%pool.n_slots;
+	pthread_mutex_lock(&pool.mutex);
+	while (!pool.failed && (*(pool.slot_frames+slot) != i_frame)) {
+	  pthread_cond_wait(&pool.slot_ready,&pool.mutex);
+	}
+	pthread_mutex_unlock(&pool.mutex);
+	if (pool.failed) {
+	  break;
+	}
+	
+	slot_array = pool.slot_arrays+(size_t)slot*npix;
+	dm_merge_frame(ptr_ainfo_struct,i_frame,slot_array,merge_array,
+		       pool.nx,pool.ny);
+	
+	pthread_mutex_lock(&pool.mutex);
+	*(pool.slot_frames+slot) = -1;
+	pool.n_merged++;
+	pthread_cond_broadcast(&pool.slot_free);
+	pthread_mutex_unlock(&pool.mutex);
+      }
+      
+      for (i_thread=0; i_thread<n_threads; i_thread++) {
+	pthread_join(*(threads+i_thread),NULL);
+      }
+      pthread_cond_destroy(&pool.slot_free);
+      pthread_cond_destroy(&pool.slot_ready);
+      pthread_mutex_destroy(&pool.mutex);
+      
+      if (pool.failed) {
+	strcpy(error_string,pool.error_string);
+	status = DM_FILEIO_FAILURE;
+      }
+    }
+    
+    if (threads != NULL) free(threads);
+    if (pool.slot_frames != NULL) free(pool.slot_frames);
+    if (pool.slot_arrays != NULL) free(pool.slot_arrays);
+    
+    gettimeofday(&tv_stop,NULL);
+    counters[0] = (double)pool.n_merged;
+    counters[1] = pool.bytes_read;
+    counters[2] = (double)(tv_stop.tv_sec-tv_start.tv_sec)+
+      1.e-6*(double)(tv_stop.tv_usec-tv_start.tv_usec);
+  } /* endif(my_rank == 0) */
+
+#if USE_MPI
+  MPI_Bcast(&status,1,MPI_INT,0,MPI_COMM_WORLD);
+  if (status == DM_FILEIO_SUCCESS) {
+    if (my_rank == 0) {
+      /* Send each process its slab of the merged frames */
+      for (i=1; i<p; i++) {
+	MPI_Send(merge_array+i*ptr_ras->local_npix,ptr_ras->local_npix,
+		 MPI_ARRAY_REAL,i,99,MPI_COMM_WORLD);
+      }
+      for (ipix=0; ipix<ptr_ras->local_npix; ipix++) {
+	*(ptr_ras->real_array+ipix) += *(merge_array+ipix);
+      }
+    } else {
+      if ((slice_array = (dm_array_real *)
+	   malloc(ptr_ras->local_npix*sizeof(dm_array_real))) == NULL) {
+	/* Still receive the slab so that rank 0 can go on */
+	strcpy(error_string,"dm_read_frame_stack: malloc(slice_array) error");
+	status = DM_FILEIO_FAILURE;
+	MPI_Recv(ptr_ras->real_array,ptr_ras->local_npix,MPI_ARRAY_REAL,
+		 0,99,MPI_COMM_WORLD,&mpi_status);
+      } else {
+	MPI_Recv(slice_array,ptr_ras->local_npix,MPI_ARRAY_REAL,
+		 0,99,MPI_COMM_WORLD,&mpi_status);
+	for (ipix=0; ipix<ptr_ras->local_npix; ipix++) {
+	  *(ptr_ras->real_array+ipix) += *(slice_array+ipix);
+	}
+	free(slice_array);
+      }
+    }
+  } else if (my_rank != 0) {
+    strcpy(error_string,"dm_read_frame_stack: error on rank 0");
+  }
+  if ((my_rank == 0) && (merge_array != NULL)) {
+    free(merge_array);
+  }
+  MPI_Bcast(counters,3,MPI_DOUBLE,0,MPI_COMM_WORLD);
+#endif /* USE_MPI */
+
+  ptr_frame_stack_struct->n_frames_read = (int)counters[0];
+  ptr_frame_stack_struct->bytes_read = counters[1];
+  ptr_frame_stack_struct->seconds = counters[2];
+  if (counters[2] > 0.) {
+    ptr_frame_stack_struct->frames_per_second = counters[0]/counters[2];
+    ptr_frame_stack_struct->mb_per_second = 1.e-6*counters[1]/counters[2];
+  } else {
+    ptr_frame_stack_struct->frames_per_second = 0.;
+    ptr_frame_stack_struct->mb_per_second = 0.;
+  }
+
+  return(status);
+}
+
+/*-------------------------------------------------------------------------*/
+void *dm_frame_stack_worker(void *ptr_arg)
+{
+  dm_frame_pool_struct *ptr_pool;
+  void *raw_buffer;
+  size_t npix, raw_size;
+  int i_frame, slot;
+  char error_string[256];
+
+  ptr_pool = (dm_frame_pool_struct *)ptr_arg;
+  npix = (size_t)ptr_pool->nx*ptr_pool->ny;
+  switch (ptr_pool->ptr_frame_stack_struct->pixel_type) {
+  case DM_FRAME_UINT8:
+    raw_size = npix*sizeof(u_int8_t);
+    break;
+  case DM_FRAME_UINT16:
+    raw_size = npix*sizeof(u_int16_t);
+    break;
+  case DM_FRAME_UINT32:
+    raw_size = npix*sizeof(u_int32_t);
+    break;
+  case DM_FRAME_FLOAT:
+    raw_size = npix*sizeof(float);
+    break;
+  default:
+    raw_size = npix*sizeof(double);
+    break;
+  }
+  
+  pthread_mutex_lock(&ptr_pool->mutex);
+  if ((raw_buffer = malloc(raw_size)) == NULL) {
+    ptr_pool->failed = 1;
+    strcpy(ptr_pool->error_string,"dm_frame_stack_worker: malloc error");
+    pthread_cond_broadcast(&ptr_pool->slot_ready);
+  }
+
+  while (!ptr_pool->failed && (ptr_pool->next_frame < ptr_pool->n_frames)) {
+    /* Wait until the frame that last used this slot has been merged */
+    if (ptr_pool->next_frame >= (ptr_pool->n_merged+ptr_pool->n_slots)) {
+      pthread_cond_wait(&ptr_pool->slot_free,&ptr_pool->mutex);
+      continue;
+    }
+    i_frame = ptr_pool->next_frame;
+    ptr_pool->next_frame++;
+    pthread_mutex_unlock(&ptr_pool->mutex);
+
+    slot = i_frame%ptr_pool->n_slots;
+    if (dm_read_frame(ptr_pool,i_frame,raw_buffer,
+		      ptr_pool->slot_arrays+slot*npix,
+		      error_string) != DM_FILEIO_SUCCESS) {
+      pthread_mutex_lock(&ptr_pool->mutex);
+      if (!ptr_pool->failed) {
+	ptr_pool->failed = 1;
+	strcpy(ptr_pool->error_string,error_string);
+      }
+      pthread_cond_broadcast(&ptr_pool->slot_ready);
+      pthread_cond_broadcast(&ptr_pool->slot_free);
+      break;
+    }
+
+    pthread_mutex_lock(&ptr_pool->mutex);
+    *(ptr_pool->slot_frames+slot) = i_frame;
+    ptr_pool->bytes_read += (double)raw_size;
+    pthread_cond_broadcast(&ptr_pool->slot_ready);
+  }
+  pthread_mutex_unlock(&ptr_pool->mutex);
+
+  if (raw_buffer != NULL) free(raw_buffer);
+  return(NULL);
+}
+
+/*-------------------------------------------------------------------------*/
+int dm_read_frame(dm_frame_pool_struct *ptr_pool,
+		  int i_frame,
+		  void *raw_buffer,
+		  dm_array_real *frame_array,
+		  char *error_string)
+{
+  dm_frame_stack_struct *ptr_frame_stack_struct;
+  char filename[1024];
+  FILE *fp;
+  size_t npix, ipix, pixel_size, i_byte;
+  u_int8_t *ptr_byte, swap_byte;
+
+  ptr_frame_stack_struct = ptr_pool->ptr_frame_stack_struct;
+  npix = (size_t)ptr_pool->nx*ptr_pool->ny;
+  switch (ptr_frame_stack_struct->pixel_type) {
+  case DM_FRAME_UINT8:
+    pixel_size = sizeof(u_int8_t);
+    break;
+  case DM_FRAME_UINT16:
+    pixel_size = sizeof(u_int16_t);
+    break;
+  case DM_FRAME_UINT32:
+    pixel_size = sizeof(u_int32_t);
+    break;
+  case DM_FRAME_FLOAT:
+    pixel_size = sizeof(float);
+    break;
+  case DM_FRAME_DOUBLE:
+    pixel_size = sizeof(double);
+    break;
+  default:
+    sprintf(error_string,"dm_read_frame: unknown pixel_type %d",
+	    ptr_frame_stack_struct->pixel_type);
+    return(DM_FILEIO_FAILURE);
+  }
+
+  dm_frame_filename(ptr_pool->ptr_ainfo_struct,i_frame,
+		    filename,sizeof(filename));
+  if ((fp = fopen(filename,"rb")) == NULL) {
+    sprintf(error_string,"dm_read_frame: could not open frame %d",i_frame);
+    return(DM_FILEIO_FAILURE);
+  }
+  if ((ptr_frame_stack_struct->header_bytes > 0) &&
+      (fseek(fp,ptr_frame_stack_struct->header_bytes,SEEK_SET) != 0)) {
+    sprintf(error_string,"dm_read_frame: fseek error in frame %d",i_frame);
+    fclose(fp);
+    return(DM_FILEIO_FAILURE);
+  }
+  if (fread(raw_buffer,pixel_size,npix,fp) != npix) {
+    sprintf(error_string,"dm_read_frame: frame %d is too short",i_frame);
+    fclose(fp);
+    return(DM_FILEIO_FAILURE);
+  }
+  fclose(fp);
+
+  if (ptr_frame_stack_struct->swap_bytes && (pixel_size > 1)) {
+    ptr_byte = (u_int8_t *)raw_buffer;
+    for (ipix=0; ipix<npix; ipix++) {
+      for (i_byte=0; i_byte<pixel_size/2; i_byte++) {
+	swap_byte = *(ptr_byte+i_byte);
+	*(ptr_byte+i_byte) = *(ptr_byte+pixel_size-1-i_byte);
+	*(ptr_byte+pixel_size-1-i_byte) = swap_byte;
+      }
+      ptr_byte += pixel_size;
+    }
+  }
+
+  switch (ptr_frame_stack_struct->pixel_type) {
+  case DM_FRAME_UINT8:
+    for (ipix=0; ipix<npix; ipix++) {
+      *(frame_array+ipix) = (dm_array_real)*((u_int8_t *)raw_buffer+ipix);
+    }
+    break;
+  case DM_FRAME_UINT16:
+    for (ipix=0; ipix<npix; ipix++) {
+      *(frame_array+ipix) = (dm_array_real)*((u_int16_t *)raw_buffer+ipix);
+    }
+    break;
+  case DM_FRAME_UINT32:
+    for (ipix=0; ipix<npix; ipix++) {
+      *(frame_array+ipix) = (dm_array_real)*((u_int32_t *)raw_buffer+ipix);
+    }
+    break;
+  case DM_FRAME_FLOAT:
+    for (ipix=0; ipix<npix; ipix++) {
+      *(frame_array+ipix) = (dm_array_real)*((float *)raw_buffer+ipix);
+    }
+    break;
+  case DM_FRAME_DOUBLE:
+    for (ipix=0; ipix<npix; ipix++) {
+      *(frame_array+ipix) = (dm_array_real)*((double *)raw_buffer+ipix);
+    }
+    break;
+  }
+
+  return(DM_FILEIO_SUCCESS);
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_merge_frame(dm_ainfo_struct *ptr_ainfo_struct,
+		    int i_frame,
+		    dm_array_real *frame_array,
+		    dm_array_real *merge_array,
+		    int nx, int ny)
+{
+  int ix, iy, x_shift, y_shift, ix_start, ix_stop, iy_start, iy_stop;
+  double offset;
+  dm_array_real *ptr_frame, *ptr_merge;
+
+  /* Pixel (ix,iy) of the merged frames is pixel
+   * (ix+x_shift,iy+y_shift) of this frame, and pixels that fall
+   * outside of the frame are left alone.
+   */
+  x_shift = 0;
+  if (i_frame < ptr_ainfo_struct->xcenter_offset) {
+    offset = *(ptr_ainfo_struct->xcenter_offset_pixels_array+i_frame);
+    if (offset > -9999.) {
+      x_shift = (int)floor(offset+0.5);
+    }
+  }
+  y_shift = 0;
+  if (i_frame < ptr_ainfo_struct->ycenter_offset) {
+    offset = *(ptr_ainfo_struct->ycenter_offset_pixels_array+i_frame);
+    if (offset > -9999.) {
+      y_shift = (int)floor(offset+0.5);
+    }
+  }
+  
+  ix_start = (x_shift < 0) ? -x_shift : 0;
+  ix_stop = (x_shift > 0) ? (nx-x_shift) : nx;
+  iy_start = (y_shift < 0) ? -y_shift : 0;
+  iy_stop = (y_shift > 0) ? (ny-y_shift) : ny;
+  
+  for (iy=iy_start; iy<iy_stop; iy++) {
+    ptr_merge = merge_array+(size_t)iy*nx;
+    ptr_frame = frame_array+(size_t)(iy+y_shift)*nx+x_shift;
+    for (ix=ix_start; ix<ix_stop; ix++) {
+      *(ptr_merge+ix) += *(ptr_frame+ix);
+    }
+  }
+}
+
+/*-------------------------------------------------------------------------*/
+void dm_frame_filename(dm_ainfo_struct *ptr_ainfo_struct,
+		       int i_frame,
+		       char *filename,
+		       size_t filename_length)
+{
+  char *this_filename;
+  int dir_length;
+
+  this_filename = ptr_ainfo_struct->filename_array+
+    (size_t)i_frame*ptr_ainfo_struct->string_length;
+  
+  /* A blank file_directory (as added by dm_check_ainfo()) is ignored,
+   * and so is the directory for absolute filenames.
+   */
+  dir_length = 0;
+  if (ptr_ainfo_struct->file_directory_flag && (*this_filename != '/')) {
+    dir_length = (int)strlen(ptr_ainfo_struct->file_directory);
+    while ((dir_length > 0) &&
+	   (*(ptr_ainfo_struct->file_directory+dir_length-1) == ' ')) {
+      dir_length--;
+    }
+  }
+  
+  if (dir_length == 0) {
+    snprintf(filename,filename_length,"%s",this_filename);
+  } else if (*(ptr_ainfo_struct->file_directory+dir_length-1) == '/') {
+    snprintf(filename,filename_length,"%.*s%s",dir_length,
+	     ptr_ainfo_struct->file_directory,this_filename);
+  } else {
+    snprintf(filename,filename_length,"%.*s/%s",dir_length,
+	     ptr_ainfo_struct->file_directory,this_filename);
+  }
+}
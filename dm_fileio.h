@@ -4,6 +4,7 @@
 #define DM_FILEIO_H
 
 #include <hdf5.h>
+#include <pthread.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -16,6 +17,135 @@ extern "C"
 #define DM_FILEIO_FAILURE (-1)
 #define PI 3.14159256
 
+/* HDF 5 native datatype that matches dm_array_real */
+#ifdef DM_ARRAY_DOUBLE
+#define DM_H5_ARRAY_REAL H5T_NATIVE_DOUBLE
+#else
+#define DM_H5_ARRAY_REAL H5T_NATIVE_FLOAT
+#endif
+
+/* How string arrays such as the ainfo filenames are stored: either
+ * n_strings*string_length fixed-width strings, or packed back to back
+ * in a "<name>_chars" dataset with their starts in "<name>_offsets".
+ */
+#define DM_H5_STRINGS_FIXED 0
+#define DM_H5_STRINGS_PACKED 1
+
+/* Smallest chunk (in strings) of a new comment_strings dataset */
+#define DM_H5_COMMENT_CHUNK 64
+
+/* Largest block that a strided region read takes from the file at a
+ * time before picking out the pixels it wants in memory.
+ */
+#define DM_H5_REGION_BLOCK_BYTES (8*1024*1024)
+
+/* Slabs along the slowest axis of at least this size are read one at
+ * a time in a strided region read, smaller ones together with those 
+ * in between.
+ */
+#define DM_H5_REGION_MIN_READ_BYTES (64*1024)
+
+/* A session keeps the file, groups, datasets and compound datatypes
+ * open between repeated dm_h5_session_write_* calls, so that writing
+ * the same arrays again only costs the data transfer. Changes to
+ * adi_struct, spt_struct and itn_struct are kept in the session and
+ * written out together by dm_h5_session_flush().
+ */
+typedef struct {
+  hid_t dataset;
+  int n_dims;
+  hsize_t dims[4];
+} dm_h5_session_dataset_struct;
+
+typedef struct {
+  hid_t h5_file_id;
+  hid_t adi_group;
+  hid_t spt_group;
+  hid_t itn_group;
+  hid_t adi_struct_dataset;
+  hid_t spt_struct_dataset;
+  hid_t itn_struct_dataset;
+  hid_t adi_struct_datatype;
+  hid_t spt_struct_datatype;
+  hid_t itn_struct_datatype;
+  dm_h5_session_dataset_struct adi_array;
+  dm_h5_session_dataset_struct adi_error_array;
+  dm_h5_session_dataset_struct spt_array;
+  dm_h5_session_dataset_struct itn_array;
+  dm_h5_session_dataset_struct recon_errors;
+  dm_adi_struct adi_struct;
+  dm_spt_struct spt_struct;
+  dm_itn_struct itn_struct;
+  int adi_struct_dirty;
+  int spt_struct_dirty;
+  int itn_struct_dirty;
+} dm_h5_session_struct;
+
+/* A map describes how dm_h5_map_adi() filled in real_array. If
+ * is_mapped=1, real_array points into a private copy-on-write file
+ * mapping of map_length bytes at map_address: the array may be
+ * modified, but those writes never reach the file. Otherwise
+ * real_array was malloc'd and read with dm_h5_read_adi(). Either way
+ * the array is released by dm_h5_unmap_adi().
+ */
+typedef struct {
+  void *map_address;
+  size_t map_length;
+  int is_mapped;
+} dm_h5_map_struct;
+
+/* Pixel types of the raw detector frames read by dm_read_frame_stack() */
+#define DM_FRAME_UINT8 0
+#define DM_FRAME_UINT16 1
+#define DM_FRAME_UINT32 2
+#define DM_FRAME_FLOAT 3
+#define DM_FRAME_DOUBLE 4
+
+/* A frame stack describes the raw detector frames named in the
+ * filename_array of an ainfo_struct. Each file starts with
+ * header_bytes bytes that are skipped, followed by nx*ny pixels of
+ * pixel_type in row order, byte-swapped if swap_bytes=1. n_threads
+ * worker threads keep up to read_ahead frames read ahead of the merge.
+ * The remaining members are throughput counters that are filled in
+ * by dm_read_frame_stack().
+ */
+typedef struct {
+  int pixel_type;
+  long header_bytes;
+  int swap_bytes;
+  int n_threads;
+  int read_ahead;
+  int n_frames_read;
+  double bytes_read;
+  double seconds;
+  double frames_per_second;
+  double mb_per_second;
+} dm_frame_stack_struct;
+
+/* State shared between dm_read_frame_stack() and its worker threads.
+ * Frame i_frame is read into slot i_frame%n_slots, and slot_frames
+ * holds the frame number of each slot once it is ready to be merged
+ * (or -1).
+ */
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t slot_ready;
+  pthread_cond_t slot_free;
+  dm_ainfo_struct *ptr_ainfo_struct;
+  dm_frame_stack_struct *ptr_frame_stack_struct;
+  dm_array_real *slot_arrays;
+  int *slot_frames;
+  int n_slots;
+  int nx;
+  int ny;
+  int n_frames;
+  int next_frame;
+  int n_merged;
+  int failed;
+  double bytes_read;
+  char error_string[256];
+} dm_frame_pool_struct;
+
   /* Creating a new HDF 5 file for writing */
   int dm_h5_create(char *filename, hid_t *ptr_h5_file_id,
                    char *error_string, int my_rank);
@@ -43,12 +173,37 @@ extern "C"
   int dm_h5_add_comments(hid_t h5_file_id,
 			 dm_comment_struct *ptr_comment_struct,
 			 char *error_string, int my_rank);
+
+  /* Append n_strings lines to the comments of an already-opened
+   * HDF 5 file with one extend and one hyperslab write, starting a
+   * comments group if there is none. Only the new strings are
+   * written; n_comment_strings is not updated since the readers go
+   * by the size of comment_strings. Only rank 0 does any work, so 
+   * the other ranks do not have to call it.
+   */
+  int dm_h5_append_comments(hid_t h5_file_id,
+			    char **comment_strings,
+			    int n_strings,
+			    char *error_string, int my_rank);
+
+  /* Append a single line, see dm_h5_append_comments() */
+  int dm_h5_append_comment(hid_t h5_file_id,
+			   char *comment_string,
+			   char *error_string, int my_rank);
   
   /* Add the assembly info structure (ainfo).
    */
   int dm_h5_write_ainfo(hid_t h5_file_id,
 			dm_ainfo_struct *ptr_ainfo_struct,
 			char *error_string, int my_rank);
+
+  /* This works like dm_h5_write_ainfo(), but filename_array and
+   * systime_array are packed so that each string only takes its own
+   * length plus one byte. dm_h5_read_ainfo() reads both layouts.
+   */
+  int dm_h5_write_ainfo_packed(hid_t h5_file_id,
+			       dm_ainfo_struct *ptr_ainfo_struct,
+			       char *error_string, int my_rank);
   
   /* Add adi (assembled diffraction intensities) to an already-
    * opened HDF 5 file.  If adi_error_array.npix=0, then no
@@ -60,6 +215,17 @@ extern "C"
 		      dm_array_real_struct *ptr_adi_error_array_struct,
 		      char *error_string, int my_rank, int p);
   
+  /* This works like dm_h5_write_adi(), but a newly created adi_array
+   * and adi_error_array get a contiguous (unchunked, unfiltered)
+   * layout of fixed size, so that they can later be opened with
+   * dm_h5_map_adi(). Updating an existing file keeps its layout.
+   */
+  int dm_h5_write_adi_contiguous(hid_t h5_file_id,
+				 dm_adi_struct *ptr_adi_struct,
+				 dm_array_real_struct *ptr_adi_array_struct,
+				 dm_array_real_struct *ptr_adi_error_array_struct,
+				 char *error_string, int my_rank, int p);
+  
 
   /* Add spt (support mask) to an already-opened HDF 5 file.  
    */
@@ -67,6 +233,14 @@ extern "C"
 		      dm_spt_struct *ptr_spt_struct,
 		      dm_array_byte_struct *ptr_spt_array_struct,
 		      char *error_string, int my_rank, int p);
+
+  /* This routine works like dm_h5_write_spt() for a bit mask. The
+   * file still holds one byte (0 or 1) per pixel.
+   */
+  int dm_h5_write_spt_bit(hid_t h5_file_id,
+			  dm_spt_struct *ptr_spt_struct,
+			  dm_array_bit_struct *ptr_spt_bit_struct,
+			  char *error_string, int my_rank, int p);
   
   /* Add itn (complex iterate) to an already-opened HDF 5 file.  
    */
@@ -77,6 +251,35 @@ extern "C"
 		      char *error_string,
                       int my_rank,
                       int p);
+
+  /* Append the current iterate to the "/itn_history" group of an
+   * already-opened HDF 5 file, creating the group on the first call.
+   * Each call extends itn_history_array by one along its leading
+   * dimension and stores iterate_count, photon_scaling and recon_error
+   * of this iterate in the parallel 1D datasets of the same name.
+   */
+  int dm_h5_append_itn_history(hid_t h5_file_id,
+			       dm_itn_struct *ptr_itn_struct,
+			       dm_array_complex_struct *ptr_itn_array_struct,
+			       dm_array_real recon_error,
+			       char *error_string,
+			       int my_rank,
+			       int p);
+
+  /* Append n_iterates iterates, such as the starts of a 
+   * dm_array_ensemble_struct (its iterates and errors), to the 
+   * "/itn_history" group with dm_h5_append_itn_history(), each with
+   * its own recon_error and all with the same itn_struct. They are
+   * stored in order after the iterates already in the history.
+   */
+  int dm_h5_append_itn_ensemble(hid_t h5_file_id,
+				dm_itn_struct *ptr_itn_struct,
+				int n_iterates,
+				dm_array_complex_struct *itn_array_structs,
+				dm_array_real *recon_errors,
+				char *error_string,
+				int my_rank,
+				int p);
   
   /* This routine reads in the size of the comment string array */
   int dm_h5_read_comments_info(hid_t h5_file_id,
@@ -114,6 +317,8 @@ extern "C"
     int dm_h5_itn_group_exists(hid_t h5_file_id,int my_rank);
   /* This routine determines if a COMMENTS group exists */
     int dm_h5_comments_group_exists(hid_t h5_file_id,int my_rank);
+  /* This routine determines if an ITN_HISTORY group exists */
+    int dm_h5_itn_history_group_exists(hid_t h5_file_id,int my_rank);
   
   /* This routine reads the ADI structure and the size of the ADI array
    * from an already-opened HDF 5 file.  It also determines
@@ -142,6 +347,27 @@ extern "C"
                      int my_rank,
                      int p);
 
+  /* This routine makes adi_array_struct->real_array a view of the
+   * adi_array in an already-opened file by mapping the file into
+   * memory, so that pages are only read when they are touched. Set
+   * nx, ny, nz and npix as for dm_h5_read_adi(), but do not allocate
+   * real_array. The array must have a contiguous layout in the native
+   * dm_array_real type (see dm_h5_write_adi_contiguous()); otherwise
+   * the routine falls back to allocating real_array and calling
+   * dm_h5_read_adi(). The mapping is private, so changes to the array
+   * never reach the file. The adi_error_array is not mapped.
+   */
+  int dm_h5_map_adi(hid_t h5_file_id,
+		    dm_h5_map_struct *ptr_map,
+		    dm_array_real_struct *ptr_adi_array_struct,
+		    char *error_string,
+		    int my_rank,
+		    int p);
+
+  /* This routine releases an array set up by dm_h5_map_adi() */
+  void dm_h5_unmap_adi(dm_h5_map_struct *ptr_map,
+		       dm_array_real_struct *ptr_adi_array_struct);
+
   /* This routine reads the SPT structure and the size of the SPT array
    * from an already-opened HDF 5 file.
    */
@@ -159,6 +385,15 @@ extern "C"
                      int my_rank,
                      int p);
 
+  /* This routine reads spt_array into a bit mask, in which every
+   * non-zero pixel of the file is set.
+   */
+  int dm_h5_read_spt_bit(hid_t h5_file_id,
+			 dm_array_bit_struct *ptr_spt_bit_struct,
+			 char *error_string,
+			 int my_rank,
+			 int p);
+
   /* This routine reads the ITN structure and the size of the ITN array
    * from an already-opened HDF 5 file.
    */
@@ -177,16 +412,123 @@ extern "C"
                        char *error_string,
                        int my_rank,
                        int p);
+
+  /* These routines read only a region of adi_array, spt_array or
+   * itn_array. The region starts at region_offsets and takes every
+   * region_strides'th pixel, both given as [x,y,z]; region_strides
+   * may be NULL to read every pixel. The size of the region is the
+   * nx, ny, nz of the array struct, which has to be allocated for
+   * npix as usual and is distributed over the processes the same
+   * way. Leaving out z (or y) reads a single slice of a 3D (or 2D)
+   * array; for example nz=1 with region_offsets[2]=10 reads z-slice
+   * 10. Only rank 0 needs the offsets and strides.
+   */
+  int dm_h5_read_adi_region(hid_t h5_file_id,
+			    int *region_offsets,
+			    int *region_strides,
+			    dm_array_real_struct *ptr_adi_array_struct,
+			    char *error_string,
+			    int my_rank,
+			    int p);
+  int dm_h5_read_spt_region(hid_t h5_file_id,
+			    int *region_offsets,
+			    int *region_strides,
+			    dm_array_byte_struct *ptr_spt_array_struct,
+			    char *error_string,
+			    int my_rank,
+			    int p);
+  int dm_h5_read_itn_region(hid_t h5_file_id,
+			    int *region_offsets,
+			    int *region_strides,
+			    dm_array_complex_struct *ptr_itn_array_struct,
+			    char *error_string,
+			    int my_rank,
+			    int p);
+
+  /* This routine reads the size of the arrays in the ITN history and
+   * the number of iterates stored so far.
+   */
+  int dm_h5_read_itn_history_info(hid_t h5_file_id,
+				  int *ptr_nx, int *ptr_ny, int *ptr_nz,
+				  int *ptr_n_iterates,
+				  char *error_string,
+				  int my_rank);
+
+  /* This routine reads iterate number i_iterate (counting from 0) of
+   * the ITN history into itn_array_struct without touching the other
+   * iterates. iterate_count, photon_scaling and recon_error are those
+   * stored for this iterate.
+   */
+  int dm_h5_read_itn_history(hid_t h5_file_id,
+			     int i_iterate,
+			     dm_itn_struct *ptr_itn_struct,
+			     dm_array_real *ptr_recon_error,
+			     dm_array_complex_struct *ptr_itn_array_struct,
+			     char *error_string,
+			     int my_rank,
+			     int p);
+    
+  /* Open an HDF 5 file for a session of repeated writes. If create=1
+   * a new file is created, otherwise an existing file is opened for
+   * writing.
+   */
+  int dm_h5_session_open(char *filename,
+			 int create,
+			 dm_h5_session_struct *ptr_session,
+			 char *error_string,
+			 int my_rank);
+
+  /* These routines work like dm_h5_write_adi/spt/itn. The first call,
+   * and any call that changes the array size, goes through the regular
+   * routine. After that only the array data are written through the
+   * cached handles, and the metadata struct waits for the next flush.
+   */
+  int dm_h5_session_write_adi(dm_h5_session_struct *ptr_session,
+			      dm_adi_struct *ptr_adi_struct,
+			      dm_array_real_struct *ptr_adi_array_struct,
+			      dm_array_real_struct *ptr_adi_error_array_struct,
+			      char *error_string,
+			      int my_rank,
+			      int p);
+  int dm_h5_session_write_spt(dm_h5_session_struct *ptr_session,
+			      dm_spt_struct *ptr_spt_struct,
+			      dm_array_byte_struct *ptr_spt_array_struct,
+			      char *error_string,
+			      int my_rank,
+			      int p);
+  int dm_h5_session_write_itn(dm_h5_session_struct *ptr_session,
+			      dm_itn_struct *ptr_itn_struct,
+			      dm_array_complex_struct *ptr_itn_array_struct,
+			      dm_array_real_struct *ptr_recon_errors,
+			      char *error_string,
+			      int my_rank,
+			      int p);
+
+  /* Write out all pending metadata structs and flush the file */
+  int dm_h5_session_flush(dm_h5_session_struct *ptr_session,
+			  char *error_string,
+			  int my_rank);
+
+  /* Flush, close all cached handles and close the file */
+  int dm_h5_session_close(dm_h5_session_struct *ptr_session,
+			  char *error_string,
+			  int my_rank);
     
-    /* This routine clears the contents of the comment string array. */
+    /* This routine clears the contents of the comment string array.
+     * It only resets n_strings, so it takes the same time no matter
+     * how many strings the array can hold.
+     */
     void dm_clear_comments(dm_comment_struct *ptr_comment_struct);
   
   /* This routine adds a string to the comment string array.  If the
    * length of the new string is beyond what can be accomodated,
-   * the string_to_add is truncated.
+   * the string_to_add is truncated. If the array is full it is
+   * doubled with realloc(), so string_array has to come from
+   * malloc() (or be NULL with n_strings_max=0). Returns
+   * DM_FILEIO_FAILURE, without adding the string, if realloc() fails.
    */
-  void dm_add_string_to_comments(char *string_to_add,
-				 dm_comment_struct *ptr_comment_struct);
+  int dm_add_string_to_comments(char *string_to_add,
+				dm_comment_struct *ptr_comment_struct);
   
   /* This routine updates "specimen_name" within the comments.
    */
@@ -209,7 +551,8 @@ extern "C"
   
   /* This routine clears the contents of the ainfo arrays and offset
    * variables. It should be called whenever a new ainfo_struct is 
-   * initialized.
+   * initialized. Only the offsets and file_directory are reset, so
+   * it does not depend on n_frames_max.
    */
     void dm_clear_ainfo(dm_ainfo_struct *ptr_ainfo_struct);
 
@@ -220,18 +563,43 @@ extern "C"
 				      dm_ainfo_struct *ptr_ainfo_struct);
 
   /* This routine adds a filename to the array that contains all
-   * the filenames of 2 dimensional datasets merged together
+   * the filenames of 2 dimensional datasets merged together.
+   * Like the systime and double routines below, it enlarges the 
+   * frame arrays with dm_grow_ainfo() when they are full, so they
+   * have to come from malloc() (or be NULL with n_frames_max=0).
+   * Returns DM_FILEIO_FAILURE, without adding anything, if that fails.
    */
-  void dm_add_filename_to_ainfo(char *filename_to_add,
-				dm_ainfo_struct *ptr_ainfo_struct);
+  int dm_add_filename_to_ainfo(char *filename_to_add,
+			       dm_ainfo_struct *ptr_ainfo_struct);
   
   /* This routine reads-in the whole ainfo_struct from a 
-   * file containing tags and csv lists of values.
+   * file containing tags and csv lists of values. The file can
+   * have any number of frames: if there are more than n_frames_max,
+   * the arrays are enlarged with dm_grow_ainfo(), so they have to
+   * come from malloc(). The *_offset variables tell how many
+   * values were read.
    */
   int dm_read_ainfo_from_csv(char *csv_filename,
 			     dm_ainfo_struct *ptr_ainfo_struct,
 			     char *error_string);
 
+  /* This routine reads the raw frames named in ainfo_struct, shifts
+   * each one by its rounded xcenter and ycenter offsets (values of
+   * -9999.99 count as no offset), and adds their sum to real_array,
+   * so real_array should be cleared first to get just the merged
+   * frames, e.g. for adi_array. Only rank 0 reads the files, using
+   * the worker threads of frame_stack_struct, and the merged frames
+   * are then sent to the other processes. Frames must be the size of
+   * a 2D real_array, and the throughput counters of
+   * frame_stack_struct are set on every process.
+   */
+  int dm_read_frame_stack(dm_ainfo_struct *ptr_ainfo_struct,
+			  dm_frame_stack_struct *ptr_frame_stack_struct,
+			  dm_array_real_struct *ptr_ras,
+			  char *error_string,
+			  int my_rank,
+			  int p);
+
   /* This routine adds a double value to one of the double arrays 
    * in ainfo_struct specified by 'tagname'.
    */
@@ -240,10 +608,12 @@ extern "C"
 			     dm_ainfo_struct *ptr_ainfo_struct,
 			     char *error_string);
 
-  /* This routine adds a systime to the array of systimes
+  /* This routine adds a systime to the array of systimes. Like
+   * dm_add_filename_to_ainfo() it returns DM_FILEIO_FAILURE if the
+   * arrays can not be enlarged.
    */
-  void dm_add_systime_to_ainfo(char *systime_to_add,
-			       dm_ainfo_struct *ptr_ainfo_struct);
+  int dm_add_systime_to_ainfo(char *systime_to_add,
+			      dm_ainfo_struct *ptr_ainfo_struct);
 
   /* This routine prints out the filename_array line-by-line,
    * with a possible preceding and trailing string on each line.
@@ -265,8 +635,10 @@ extern "C"
   /* This routine checks if the arrays in ainfo_struct have the same
    * length. If not (i.e. user did not define some tags), then they 
    * are made the same length by adding default values for missing 
-   * entries. No array can be longer than n_frames. Note: this function
-   * is called automatically when writing ainfo_struct to HDF5 file
+   * entries. No array can be longer than n_frames, and the arrays
+   * are enlarged if n_frames is greater than n_frames_max. Note: this
+   * function is called automatically when writing ainfo_struct to 
+   * HDF5 file
    */
   int dm_check_ainfo(dm_ainfo_struct *ptr_ainfo_struct,
 		     char *error_string,
@@ -284,6 +656,208 @@ extern "C"
    * the itn_struct variables.
    */
   void dm_h5_insert_itn_struct_members(hid_t datatype);
+  /* These internal routines create, append to and read from the 
+   * extendible 1D datasets in the itn_history group.
+   */
+  int dm_h5_create_itn_history_value(hid_t history_group,
+				     char *name,
+				     hid_t datatype,
+				     char *error_string);
+  int dm_h5_append_itn_history_value(hid_t history_group,
+				     char *name,
+				     hid_t datatype,
+				     hsize_t i_iterate,
+				     void *ptr_value,
+				     char *error_string);
+  int dm_h5_read_itn_history_value(hid_t history_group,
+				   char *name,
+				   hid_t datatype,
+				   hsize_t i_iterate,
+				   void *ptr_value,
+				   char *error_string);
+  /* This internal routine does the work for dm_h5_write_adi() and
+   * dm_h5_write_adi_contiguous().
+   */
+  int dm_h5_write_adi_layout(hid_t h5_file_id,
+			     dm_adi_struct *ptr_adi_struct,
+			     dm_array_real_struct *ptr_adi_array_struct,
+			     dm_array_real_struct *ptr_adi_error_array_struct,
+			     int contiguous,
+			     char *error_string, int my_rank, int p);
+  /* This internal routine does the work for dm_h5_write_ainfo() and
+   * dm_h5_write_ainfo_packed().
+   */
+  int dm_h5_write_ainfo_encoding(hid_t h5_file_id,
+				 dm_ainfo_struct *ptr_ainfo_struct,
+				 int string_encoding,
+				 char *error_string, int my_rank);
+  /* These internal routines write and read an array of n_strings
+   * strings, string_length apart in memory, as dataset_name in the
+   * given string_encoding.
+   */
+  int dm_h5_write_string_array(hid_t group_id,
+			       char *dataset_name,
+			       char *string_array,
+			       int n_strings,
+			       int string_length,
+			       int string_encoding,
+			       char *error_string);
+  int dm_h5_read_string_array(hid_t group_id,
+			      char *dataset_name,
+			      char *string_array,
+			      int n_strings,
+			      int string_length,
+			      int string_encoding,
+			      char *error_string);
+  /* This internal routine checks a region against the dataset
+   * dataset_name and reads it with dm_h5_read_array_region().
+   */
+  int dm_h5_read_region(hid_t h5_file_id,
+			char *dataset_name,
+			hid_t memory_datatype,
+			int is_complex,
+			int nx, int ny, int nz,
+			int *region_offsets,
+			int *region_strides,
+			void *ptr_data,
+			void *ptr_data_im,
+			size_t element_size,
+			char *error_string,
+			int my_rank,
+			int p);
+  /* This internal routine is the reading counterpart of 
+   * dm_h5_write_array_slabs(). The region is given in file order,
+   * including the trailing dimension of 2 for complex arrays.
+   */
+  int dm_h5_read_array_region(hid_t dataset,
+			      hid_t memory_datatype,
+			      int n_dims,
+			      int is_complex,
+			      hsize_t *region_offsets,
+			      hsize_t *region_strides,
+			      hsize_t *region_dims,
+			      void *ptr_data,
+			      void *ptr_data_im,
+			      size_t element_size,
+			      char *error_string,
+			      int my_rank,
+			      int p);
+  /* This internal routine reads one hyperslab of dataset into 
+   * ptr_data. x_dim is the x dimension in file order. A hyperslab 
+   * with strides is read in unit-stride blocks and the pixels are 
+   * picked out in memory, since HDF 5 is slow with such selections.
+   */
+  int dm_h5_read_hyperslab(hid_t dataset,
+			   hid_t file_dataspace,
+			   hid_t memory_datatype,
+			   int n_dims,
+			   int x_dim,
+			   hsize_t *offsets,
+			   hsize_t *strides,
+			   hsize_t *counts,
+			   void *ptr_data,
+			   size_t element_size,
+			   char *error_string);
+  /* This internal routine copies every stride'th of n_pixels elements
+   * of element_size bytes from ptr_in to ptr_out.
+   */
+  void dm_h5_pick_pixels(char *ptr_out,
+			 char *ptr_in,
+			 hsize_t n_pixels,
+			 hsize_t stride,
+			 size_t element_size);
+  /* This internal routine enlarges the frame arrays of ainfo_struct
+   * with realloc() to hold at least n_frames_needed frames. 
+   */
+  int dm_grow_ainfo(dm_ainfo_struct *ptr_ainfo_struct,
+		    int n_frames_needed,
+		    char *error_string);
+  /* This internal routine enlarges string_array of comment_struct
+   * with realloc() to hold at least n_strings_needed strings. 
+   */
+  int dm_grow_comments(dm_comment_struct *ptr_comment_struct,
+		       int n_strings_needed,
+		       char *error_string);
+  /* These internal routines are used by dm_read_frame_stack(). The
+   * worker thread takes a dm_frame_pool_struct, the others read
+   * frame i_frame into frame_array, add it to the nx*ny merge_array
+   * with the frame's offsets, and build its path in filename.
+   */
+  void *dm_frame_stack_worker(void *ptr_arg);
+  int dm_read_frame(dm_frame_pool_struct *ptr_pool,
+		    int i_frame,
+		    void *raw_buffer,
+		    dm_array_real *frame_array,
+		    char *error_string);
+  void dm_merge_frame(dm_ainfo_struct *ptr_ainfo_struct,
+		      int i_frame,
+		      dm_array_real *frame_array,
+		      dm_array_real *merge_array,
+		      int nx, int ny);
+  void dm_frame_filename(dm_ainfo_struct *ptr_ainfo_struct,
+			 int i_frame,
+			 char *filename,
+			 size_t filename_length);
+  /* This internal routine raises comment_string_length in the file
+   * to new_string_length if it is smaller.
+   */
+  int dm_h5_update_comment_string_length(hid_t h5_file_id,
+					 int new_string_length,
+					 char *error_string);
+  /* This internal routine returns a malloc()'ed array of hvl_t 
+   * entries pointing at the strings in comment_struct, or NULL.
+   */
+  hvl_t *dm_h5_comments_to_vlen(dm_comment_struct *ptr_comment_struct);
+  /* This internal routine calls H5Dset_extent() for a chunked 
+   * dataset. A contiguous dataset can not change size, so it only
+   * succeeds if array_dims matches the existing size.
+   */
+  herr_t dm_h5_set_array_extent(hid_t dataset,
+				hsize_t *array_dims);
+  /* This internal routine returns 1 if adi_array in an open file can
+   * be mapped straight into memory, and finds its file name and the
+   * address of its data.
+   */
+  int dm_h5_adi_is_mappable(hid_t h5_file_id,
+			    dm_array_real_struct *ptr_adi_array_struct,
+			    char *filename,
+			    size_t filename_length,
+			    haddr_t *ptr_offset);
+  /* These internal routines manage the handles of a session */
+  void dm_h5_session_array_dims(int nx, int ny, int nz,
+				int is_complex,
+				int *ptr_n_dims,
+				hsize_t *array_dims);
+  int dm_h5_session_dataset_matches(dm_h5_session_dataset_struct *ptr_dataset,
+				    int n_dims,
+				    hsize_t *array_dims);
+  int dm_h5_session_open_group(hid_t h5_file_id,
+			       char *group_name,
+			       char *struct_name,
+			       hid_t *ptr_group,
+			       hid_t *ptr_struct_dataset,
+			       char *error_string);
+  int dm_h5_session_open_dataset(hid_t group,
+				 char *name,
+				 dm_h5_session_dataset_struct *ptr_dataset,
+				 char *error_string);
+  void dm_h5_session_close_dataset(dm_h5_session_dataset_struct *ptr_dataset);
+  void dm_h5_session_close_handles(dm_h5_session_struct *ptr_session);
+  /* This internal routine writes an array that is distributed over
+   * the processes into an open dataset of the same size. For split
+   * complex arrays ptr_data_im points to the imaginary part, 
+   * otherwise it is NULL.
+   */
+  int dm_h5_write_array_slabs(hid_t dataset,
+			      hid_t memory_datatype,
+			      int n_dims,
+			      hsize_t *array_dims,
+			      void *ptr_data,
+			      void *ptr_data_im,
+			      size_t element_size,
+			      char *error_string,
+			      int my_rank,
+			      int p);
   
 #ifdef __cplusplus
 }  /* extern "C" */
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include "../dm.h"
+#include "../dm_array.h"
+#include <stdlib.h>
+#include <math.h>
+
+
+void dm_bench_math_help() {
+
+  printf("Usage: dm_bench_math [-n x -r y]\n");
+  printf("  -n x: use x complex values per process. \n");
+  printf("  -r y: time y passes over the array. \n");
+}
+
+/*-------------------------------------------------------------*/
+/* The spacing of dm_array_real numbers at value */
+long double dm_bench_math_ulp(long double value) {
+  dm_array_real rounded;
+
+  rounded = (dm_array_real)fabsl(value);
+#if defined(DM_ARRAY_DOUBLE)
+  return((long double)(nextafter(rounded,2.*rounded+1.)-rounded));
+#else
+  return((long double)(nextafterf(rounded,2.f*rounded+1.f)-rounded));
+#endif
+}
+
+/*-------------------------------------------------------------*/
+int main(int argc, char **argv) {
+  char this_arg[128];
+  char *level_names[3];
+  dm_array_complex_struct complex_array;
+  dm_array_real_struct real_array;
+  dm_array_complex_struct *ptr_cas;
+  dm_array_real_struct *ptr_ras;
+  int my_rank, p, i_arg, i_rep, n_reps, accuracy;
+  long ipix, npix, seed;
+  long double exact, error, max_ulp, max_abs;
+  dm_array_real scale;
+  dm_time_t ts, te;
+  double tdelta;
+
+  dm_init(&p,&my_rank);
+
+  /* define defaults that user can change through CLA */
+  npix = 1<<20;
+  n_reps = 20;
+  i_arg = 1;
+
+  while (i_arg < argc) {
+      strcpy( this_arg, argv[i_arg] );
+      if ((strncasecmp("-?",this_arg,2) == 0) ||
+          (strncasecmp("-H",this_arg,2) == 0)) {
+	dm_bench_math_help();
+	exit(1);
+      } else if (strncasecmp("-N",this_arg,2) == 0) {
+	sscanf(argv[i_arg+1],"%ld",&npix);
+	i_arg = i_arg+2;
+      } else if (strncasecmp("-R",this_arg,2) == 0) {
+	sscanf(argv[i_arg+1],"%d",&n_reps);
+	i_arg = i_arg+2;
+      } else {
+	i_arg++;
+      }
+  }
+
+  level_names[DM_ARRAY_MATH_LIBM] = "libm";
+  level_names[DM_ARRAY_MATH_FAST] = "fast";
+  level_names[DM_ARRAY_MATH_FASTEST] = "fastest";
+
+  ptr_cas = &complex_array;
+  ptr_ras = &real_array;
+  complex_array.npix = npix*p;
+  real_array.npix = npix*p;
+  DM_ARRAY_COMPLEX_STRUCT_INIT(ptr_cas,complex_array.npix,p);
+  DM_ARRAY_REAL_STRUCT_INIT(ptr_ras,real_array.npix,p);
+
+  /* Values in all four quadrants with magnitudes from 1e-3 to 1e3,
+   * and the axes and diagonals, where the reductions switch.
+   */
+  seed = -(my_rank+1);
+  for (ipix=0; ipix<npix; ipix++) {
+      scale = (dm_array_real)pow(10.,6.*dm_rand(&seed)-3.);
+      c_re(complex_array.complex_array,ipix) =
+	  scale*(2.*dm_rand(&seed)-1.);
+      c_im(complex_array.complex_array,ipix) =
+	  scale*(2.*dm_rand(&seed)-1.);
+      if ((ipix % 97) == 0) {
+	  c_im(complex_array.complex_array,ipix) =
+	      ((ipix % 3) - 1)*c_re(complex_array.complex_array,ipix);
+      } else if ((ipix % 89) == 0) {
+	  c_re(complex_array.complex_array,ipix) = 0.;
+      }
+  }
+
+  for (accuracy=DM_ARRAY_MATH_LIBM; accuracy<=DM_ARRAY_MATH_FASTEST;
+       accuracy++) {
+      dm_time(&ts);
+      for (i_rep=0; i_rep<n_reps; i_rep++) {
+	  dm_array_phase_fast(&real_array,&complex_array,accuracy);
+      }
+      dm_time(&te);
+      tdelta = dm_time_diff(ts,te);
+
+      max_ulp = 0.;
+      max_abs = 0.;
+      for (ipix=0; ipix<npix; ipix++) {
+	  exact = atan2l((long double)c_im(complex_array.complex_array,ipix),
+			 (long double)c_re(complex_array.complex_array,ipix));
+	  error = fabsl((long double)*(real_array.real_array+ipix)-exact);
+	  if (error > max_abs) max_abs = error;
+	  if (exact != 0. && (error/dm_bench_math_ulp(exact)) > max_ulp) {
+	      max_ulp = error/dm_bench_math_ulp(exact);
+	  }
+      }
+      printf("[%d] phase %-8s %8.1f Melements/s  max error %.2f ULP, %.2e rad\n",
+	     my_rank,level_names[accuracy],
+	     1.e-6*(double)npix*(double)n_reps/tdelta,
+	     (double)max_ulp,(double)max_abs);
+  }
+
+  for (accuracy=DM_ARRAY_MATH_LIBM; accuracy<=DM_ARRAY_MATH_FASTEST;
+       accuracy++) {
+      dm_time(&ts);
+      for (i_rep=0; i_rep<n_reps; i_rep++) {
+	  dm_array_magnitude_complex_fast(&real_array,&complex_array,accuracy);
+      }
+      dm_time(&te);
+      tdelta = dm_time_diff(ts,te);
+
+      max_ulp = 0.;
+      for (ipix=0; ipix<npix; ipix++) {
+	  exact = sqrtl((long double)c_re(complex_array.complex_array,ipix)*
+			(long double)c_re(complex_array.complex_array,ipix)+
+			(long double)c_im(complex_array.complex_array,ipix)*
+			(long double)c_im(complex_array.complex_array,ipix));
+	  error = fabsl((long double)*(real_array.real_array+ipix)-exact);
+	  if (exact != 0. && (error/dm_bench_math_ulp(exact)) > max_ulp) {
+	      max_ulp = error/dm_bench_math_ulp(exact);
+	  }
+      }
+      printf("[%d] magnitude %-8s %8.1f Melements/s  max error %.2f ULP\n",
+	     my_rank,level_names[accuracy],
+	     1.e-6*(double)npix*(double)n_reps/tdelta,(double)max_ulp);
+  }
+
+  DM_ARRAY_COMPLEX_FREE(complex_array.complex_array);
+  free(real_array.real_array);
+
+  dm_exit();
+  return(0);
+}
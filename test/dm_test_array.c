@@ -15,16 +15,134 @@ void dm_test_array_help() {
 }
 
 
+/*-------------------------------------------------------------*/
+/* The spacing of dm_array_real numbers at value */
+double dm_test_array_ulp(double value) {
+  dm_array_real rounded;
+
+  rounded = (dm_array_real)fabs(value);
+#if defined(DM_ARRAY_DOUBLE)
+  return(nextafter(rounded,2.*rounded+1.)-rounded);
+#else
+  return((double)(nextafterf(rounded,2.f*rounded+1.f)-rounded));
+#endif
+}
+
+
+/*-------------------------------------------------------------*/
+/* Is there a spike at global pixel ix,iy,iz? They are 4 pixels 
+ * apart and at least 2 from the edges, so that no window of the 
+ * median filter, clipped or not, holds more than one of them.
+ */
+int dm_test_array_is_spike(dm_array_real_struct *ptr_ras,
+                           int ix, int iy, int iz) {
+  return((((ix%4) == 2) && (ix < (ptr_ras->nx-2))) &&
+         ((ptr_ras->ny == 1) || (((iy%4) == 2) && (iy < (ptr_ras->ny-2)))) &&
+         ((ptr_ras->nz == 1) || (((iz%4) == 2) && (iz < (ptr_ras->nz-2)))));
+}
+
+
+/*-------------------------------------------------------------*/
+/* Is global pixel ix,iy,iz inside the disc (or ball) of the given
+ * radius about the centre of the array?
+ */
+int dm_test_array_in_disc(dm_array_byte_struct *ptr_bas,
+                          int ix, int iy, int iz, double radius) {
+  double dx, dy, dz;
+
+  dx = ix-ptr_bas->nx/2;
+  dy = iy-ptr_bas->ny/2;
+  dz = iz-ptr_bas->nz/2;
+  return((dx*dx+dy*dy+dz*dz) <= radius*radius);
+}
+
+
+/*-------------------------------------------------------------*/
+/* The disc dilated (or eroded) by a square of 2*size+1 pixels on a
+ * side, worked out pixel by pixel. Pixels outside of the array do
+ * not count.
+ */
+int dm_test_array_morph_disc(dm_array_byte_struct *ptr_bas,
+                             int ix, int iy, int iz, double radius,
+                             int size, int is_erode) {
+  int jx, jy, jz, size_y, size_z;
+
+  size_y = (ptr_bas->ny > 1) ? size : 0;
+  size_z = (ptr_bas->nz > 1) ? size : 0;
+  for (jz = iz-size_z; jz <= iz+size_z; jz++) {
+      if ((jz < 0) || (jz >= ptr_bas->nz)) continue;
+      for (jy = iy-size_y; jy <= iy+size_y; jy++) {
+          if ((jy < 0) || (jy >= ptr_bas->ny)) continue;
+          for (jx = ix-size; jx <= ix+size; jx++) {
+              if ((jx < 0) || (jx >= ptr_bas->nx)) continue;
+              if (dm_test_array_in_disc(ptr_bas,jx,jy,jz,radius) != 
+                  is_erode) {
+                  return(!is_erode);
+              }
+          }
+      }
+  }
+  return(is_erode);
+}
+
+
+/*-------------------------------------------------------------*/
+/* A known complex object at global pixel ix,iy,iz, moved by shift
+ * (whole pixels, wrapping around) and turned by phase: zero outside
+ * of a box of about half the size of the array about its centre,
+ * and with no symmetry inside of it.
+ */
+void dm_test_array_object(dm_array_complex_struct *ptr_cas,
+                          int ix, int iy, int iz, int *shift,
+                          double phase, double *ptr_re, double *ptr_im) {
+  double re, im;
+
+  ix = (ix-shift[0]+ptr_cas->nx)%ptr_cas->nx;
+  iy = (iy-shift[1]+ptr_cas->ny)%ptr_cas->ny;
+  iz = (iz-shift[2]+ptr_cas->nz)%ptr_cas->nz;
+  if ((abs(ix-ptr_cas->nx/2) > ptr_cas->nx/4) ||
+      (abs(iy-ptr_cas->ny/2) > ptr_cas->ny/4) ||
+      (abs(iz-ptr_cas->nz/2) > ptr_cas->nz/4)) {
+      *ptr_re = 0.;
+      *ptr_im = 0.;
+      return;
+  }
+  re = 1.+0.25*((7*ix+3*iy+iz)%5);
+  im = 0.5*((ix*iy+2*iz)%3);
+  *ptr_re = re*cos(phase)-im*sin(phase);
+  *ptr_im = re*sin(phase)+im*cos(phase);
+}
+
+
 /*-------------------------------------------------------------*/
 main(int argc, char **argv) {
   char this_arg[128], error_string[128];
-  dm_array_complex_struct array_2d_cas, copied_array;
+  dm_array_complex_struct array_2d_cas, copied_array, scratch_array;
   dm_array_real_struct intens_array, real_array;
   dm_array_byte_struct byte_array;
+  dm_array_bit_struct bit_array;
+  dm_array_span_struct spans;
+  dm_adi_struct adi_struct;
+  dm_array_index_t n_changed;
+  dm_array_halo_struct halo;
+  dm_array_ensemble_struct ensemble, threaded_ensemble;
+  dm_array_real hio_errors[3];
+  dm_array_average_struct average;
+  dm_array_real prtf[4];
+  double prtf_counts[4];
+  int object_shift[3], moved_shift[3];
+  double shift[3], moved[3], expected_re, expected_im;
+  double global_phase, phase_sums[2];
+  double this_old_mag, this_new_mag, this_error, max_diff;
+  int n_failed, n_wrong, ix, iy, iz, can_fft, n_spikes;
+  dm_array_index_t i_global, n_halo;
+  dm_array_real *halo_values;
+  double disc_radius;
   int my_rank, p, i, nffts, j, i_arg;
   int nx,n_dims,is_fftonly;
   dm_array_real power_before, max_value;
-  dm_array_complex *value_to_add;
+  dm_array_complex *value_to_add, *rand_values;
+  u_int32_t philox_counter[4], philox_key[2], philox_out[4];
   dm_array_complex *multipl_value; /* Compiler needs size of structures */
   float temp_re, temp_im;
   int print_limit, debugWait;
@@ -37,6 +155,17 @@ main(int argc, char **argv) {
   /* define hardwired defaults */
   print_limit = 5;
   i_arg = 1;
+  n_failed = 0;
+  
+  /* Without dist_fft, dm_array_fft() transforms each process's own 
+   * slabs as if they were the whole array, so the tests that need a
+   * real transform of a distributed array are skipped.
+   */
+#if (USE_MPI && !(defined(__APPLE__) && defined(DIST_FFT)))
+  can_fft = (p == 1);
+#else
+  can_fft = 1;
+#endif
   
   /* define defaults that user can change through CLA */
   nx = 64;
@@ -123,7 +252,7 @@ main(int argc, char **argv) {
   dm_array_zero_complex(&array_2d_cas);
 
   /* Initialize the array with random real part */
-  dm_array_rand(&array_2d_cas);
+  dm_array_rand(&array_2d_cas,0);
   printf("After initializing with random values from rank %d: \n",my_rank);
   for (i = 0; i < print_limit; i++) {
       temp_re = c_re(array_2d_cas.complex_array,i);
@@ -131,6 +260,78 @@ main(int argc, char **argv) {
       printf("{%f,%f} ", temp_re,temp_im);
   }
   printf("\n");
+
+  /* With a seed the values must not depend on the number of threads.
+   * Seed 0 is key {0,0}, and the counter of global pixel 0 is 
+   * {0,0,0,0}, so its values come from the Philox4x32-10 known-answer
+   * vector for those, which dm_rand_philox() must also give along
+   * with the one for the digits of pi.
+   */
+  array_2d_cas.local_offset = my_rank*array_2d_cas.local_npix;
+  DM_ARRAY_COMPLEX_MALLOC(rand_values,array_2d_cas.local_npix);
+  n_wrong = 0;
+  for (j = 1; j <= 3; j += 2) {
+      dm_array_rand_seeded(&array_2d_cas,1,0,j);
+      printf("Random values with seed 0 on %d threads from rank %d: \n",
+             j,my_rank);
+      for (i = 0; i < print_limit; i++) {
+          temp_re = c_re(array_2d_cas.complex_array,i);
+          temp_im = c_im(array_2d_cas.complex_array,i);
+          printf("{%f,%f} ", temp_re,temp_im);
+      }
+      printf("\n");
+      for (i = 0; i < array_2d_cas.local_npix; i++) {
+          if (j == 1) {
+              c_re(rand_values,i) = c_re(array_2d_cas.complex_array,i);
+              c_im(rand_values,i) = c_im(array_2d_cas.complex_array,i);
+          } else if ((c_re(rand_values,i) != 
+                      c_re(array_2d_cas.complex_array,i)) ||
+                     (c_im(rand_values,i) != 
+                      c_im(array_2d_cas.complex_array,i))) {
+              n_wrong++;
+          }
+      }
+  }
+  DM_ARRAY_COMPLEX_FREE(rand_values);
+  if (my_rank == 0) {
+#ifdef DM_ARRAY_DOUBLE
+      expected_re = (double)((((u_int64_t)(0x6627e8d5 >> 5)) << 26) |
+                             (u_int64_t)(0xe169c58d >> 6))/9007199254740992.;
+      expected_im = (double)((((u_int64_t)(0xbc57ac4c >> 5)) << 26) |
+                             (u_int64_t)(0x9b00dbd8 >> 6))/9007199254740992.;
+#else
+      expected_re = (0x6627e8d5 >> 8)/16777216.;
+      expected_im = (0xbc57ac4c >> 8)/16777216.;
+#endif /* DM_ARRAY_DOUBLE */
+      if ((c_re(array_2d_cas.complex_array,0) != expected_re) ||
+          (c_im(array_2d_cas.complex_array,0) != expected_im)) n_wrong++;
+  }
+  for (i = 0; i < 4; i++) philox_counter[i] = 0;
+  philox_key[0] = philox_key[1] = 0;
+  dm_rand_philox(philox_counter,philox_key,philox_out);
+  if ((philox_out[0] != 0x6627e8d5) || (philox_out[1] != 0xe169c58d) ||
+      (philox_out[2] != 0xbc57ac4c) || (philox_out[3] != 0x9b00dbd8)) {
+      n_wrong++;
+  }
+  philox_counter[0] = 0x243f6a88;
+  philox_counter[1] = 0x85a308d3;
+  philox_counter[2] = 0x13198a2e;
+  philox_counter[3] = 0x03707344;
+  philox_key[0] = 0xa4093822;
+  philox_key[1] = 0x299f31d0;
+  dm_rand_philox(philox_counter,philox_key,philox_out);
+  if ((philox_out[0] != 0xd16cfe09) || (philox_out[1] != 0x94fdcceb) ||
+      (philox_out[2] != 0x5001e420) || (philox_out[3] != 0x24126ea1)) {
+      n_wrong++;
+  }
+  if (n_wrong == 0) {
+      printf("Seeded random values on 1 and 3 threads on rank %d: passed\n",
+             my_rank);
+  } else {
+      printf("Seeded random values on 1 and 3 threads on rank %d: FAILED (%d)\n",
+             my_rank,n_wrong);
+      n_failed++;
+  }
   
   /* Add a complex scalar */
   c_re(value_to_add,0) = .00001;
@@ -238,12 +439,91 @@ main(int argc, char **argv) {
                  (dm_array_real)max_value);
       } 
 
+      /* Test the median filter on a ramp of 100+ix+iy+iz with 
+       * spikes, with a 3-wide window and with a 9-wide one that 
+       * slides over the ranks in 2D and 3D. Exactly the spikes must
+       * change, each to within 3 of the ramp (the most the clipped 
+       * windows around them and the other spikes in them can move
+       * the median), and nothing else.
+       */
+      for (j = 0; j < 2; j++) {
+          for (i = 0; i < real_array.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(real_array.npix/p)+i;
+              ix = i_global%real_array.nx;
+              iy = (i_global/real_array.nx)%real_array.ny;
+              iz = i_global/((dm_array_index_t)real_array.nx*real_array.ny);
+              *(real_array.real_array+i) = (dm_array_real)(100+ix+iy+iz);
+              if (dm_test_array_is_spike(&real_array,ix,iy,iz)) {
+                  *(real_array.real_array+i) = 1.e6;
+              }
+          }
+          adi_struct.median_filter_width = (j == 0) ? 3. : 9.;
+          adi_struct.median_filter_threshold = 0.5;
+          n_wrong = 0;
+          if (dm_array_median_filter(&real_array,&adi_struct,4,&n_changed,
+                                     my_rank,p) != 0) n_wrong++;
+          n_spikes = 0;
+          for (i = 0; i < real_array.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(real_array.npix/p)+i;
+              ix = i_global%real_array.nx;
+              iy = (i_global/real_array.nx)%real_array.ny;
+              iz = i_global/((dm_array_index_t)real_array.nx*real_array.ny);
+              this_error = fabs(*(real_array.real_array+i)-(100.+ix+iy+iz));
+              if (dm_test_array_is_spike(&real_array,ix,iy,iz)) {
+                  n_spikes++;
+                  if (this_error > 3.) n_wrong++;
+              } else if (this_error != 0.) {
+                  n_wrong++;
+              }
+          }
+#if USE_MPI
+          MPI_Allreduce(MPI_IN_PLACE,&n_spikes,1,MPI_INT,MPI_SUM,
+                        MPI_COMM_WORLD);
+#endif /* USE_MPI */
+          if (n_changed != n_spikes) n_wrong++;
+          if (n_wrong == 0) {
+              printf("Median filter of width %d changed %d spikes on rank %d: passed\n",
+                     (int)adi_struct.median_filter_width,(int)n_changed,
+                     my_rank);
+          } else {
+              printf("Median filter of width %d changed %d spikes on rank %d: FAILED (%d)\n",
+                     (int)adi_struct.median_filter_width,(int)n_changed,
+                     my_rank,n_wrong);
+              n_failed++;
+          }
+      }
+      
+      /* Test the saturation mask inside [105,110], then with only the
+       * lower limit as saturation_max is not above saturation_min.
+       */
+      for (j = 0; j < 2; j++) {
+          adi_struct.saturation_min = 105.;
+          adi_struct.saturation_max = (j == 0) ? 110. : 0.;
+          dm_array_saturation_mask(&byte_array,&real_array,&adi_struct);
+          n_wrong = 0;
+          for (i = 0; i < real_array.npix/p; i++) {
+              temp_re = *(real_array.real_array+i);
+              if (*(byte_array.byte_array+i) != 
+                  ((temp_re >= 105.) && ((j == 1) || (temp_re <= 110.)))) {
+                  n_wrong++;
+              }
+          }
+          if (n_wrong == 0) {
+              printf("Saturation mask %s on rank %d: passed\n",
+                     (j == 0) ? "[105,110]" : "[105,...]",my_rank);
+          } else {
+              printf("Saturation mask %s on rank %d: FAILED (%d)\n",
+                     (j == 0) ? "[105,110]" : "[105,...]",my_rank,n_wrong);
+              n_failed++;
+          }
+      }
+
       /* Now zero both real array */
       dm_array_zero_real(&real_array);
       dm_array_zero_real(&intens_array);
       
-      /* Load a Gaussian */
-      dm_array_load_gaussian(&copied_array,30.,30.,30.,0,0,p,my_rank);
+      /* Load a Gaussian with a different sigma along each axis */
+      dm_array_load_gaussian(&copied_array,3.,4.,5.,0,0,p,my_rank);
       printf("After loading a Gaussian from rank %d: \n",my_rank);
       for (i = 0; i < print_limit; i++) {
           temp_re = c_re(copied_array.complex_array,i);
@@ -251,6 +531,69 @@ main(int argc, char **argv) {
           printf("{%f,%f} ", temp_re,temp_im);
       }
       printf("\n");
+      for (i = 0; i < copied_array.local_npix; i++) {
+          *(real_array.real_array+i) = c_re(copied_array.complex_array,i);
+      }
+
+      /* The same Gaussian from its 1D profiles, on 2 threads */
+      {
+          dm_array_real *x_profile, *y_profile, *z_profile;
+          
+          x_profile = (dm_array_real *)
+              malloc(copied_array.nx*sizeof(dm_array_real));
+          y_profile = (dm_array_real *)
+              malloc(copied_array.ny*sizeof(dm_array_real));
+          z_profile = (dm_array_real *)
+              malloc(copied_array.nz*sizeof(dm_array_real));
+          dm_array_gaussian_profile(x_profile,copied_array.nx,3.,0);
+          dm_array_gaussian_profile(y_profile,copied_array.ny,4.,0);
+          dm_array_gaussian_profile(z_profile,copied_array.nz,5.,0);
+          copied_array.local_offset = my_rank*copied_array.local_npix;
+          dm_array_load_separable(&copied_array,x_profile,y_profile,
+                                  z_profile,0,2);
+          free(x_profile);
+          free(y_profile);
+          free(z_profile);
+      }
+      printf("After loading a separable Gaussian from rank %d: \n",my_rank);
+      for (i = 0; i < print_limit; i++) {
+          temp_re = c_re(copied_array.complex_array,i);
+          temp_im = c_im(copied_array.complex_array,i);
+          printf("{%f,%f} ", temp_re,temp_im);
+      }
+      printf("\n");
+
+      /* Both must agree with each other, and with the Gaussian at the
+       * global position of every local pixel, so that each process
+       * checks its own part of the array.
+       */
+      n_wrong = 0;
+      max_diff = 0.;
+      for (i = 0; i < copied_array.local_npix; i++) {
+          i_global = (dm_array_index_t)my_rank*copied_array.local_npix+i;
+          ix = i_global%copied_array.nx;
+          iy = (i_global/copied_array.nx)%copied_array.ny;
+          iz = i_global/((dm_array_index_t)copied_array.nx*copied_array.ny);
+          this_error = 
+              exp(-0.5*((ix-copied_array.nx/2)*(ix-copied_array.nx/2)/9.+
+                        (iy-copied_array.ny/2)*(iy-copied_array.ny/2)/16.+
+                        (iz-copied_array.nz/2)*(iz-copied_array.nz/2)/25.));
+          this_error = fabs(c_re(copied_array.complex_array,i)-this_error);
+          if (this_error > max_diff) max_diff = this_error;
+          if ((this_error > 1.e-6) ||
+              (fabs(c_re(copied_array.complex_array,i)-
+                    *(real_array.real_array+i)) > 1.e-6) ||
+              (c_im(copied_array.complex_array,i) != 0.)) n_wrong++;
+      }
+      if (n_wrong == 0) {
+          printf("Separable and direct Gaussian (max error %.2g) on rank %d: passed\n",
+                 max_diff,my_rank);
+      } else {
+          printf("Separable and direct Gaussian (max error %.2g) on rank %d: FAILED (%d)\n",
+                 max_diff,my_rank,n_wrong);
+          n_failed++;
+      }
+      dm_array_zero_real(&real_array);
       dm_array_zero_complex(&copied_array);
       
       dm_time(&ts);
@@ -286,6 +629,211 @@ main(int argc, char **argv) {
       tdelta = dm_time_diff(ts,te);
       printf("Tdelta: %f\n",tdelta);
       
+      /* Test the halo exchange 2 slabs wide on an array that holds
+       * its global index: the halo below must be the last slabs of
+       * the process below and the one above the first slabs of the
+       * process above. The first and last processes get no halo on
+       * the outside, and without MPI there is none at all.
+       */
+      for (i = 0; i < copied_array.npix/p; i++) {
+          i_global = (dm_array_index_t)my_rank*(copied_array.npix/p)+i;
+          c_re(copied_array.complex_array,i) = (dm_array_real)i_global;
+          c_im(copied_array.complex_array,i) = -(dm_array_real)i_global;
+      }
+      if (dm_array_halo_init(&halo,DM_ARRAY_HALO_COMPLEX,
+                             copied_array.nx,copied_array.ny,
+                             copied_array.nz,copied_array.npix/p,2,
+                             my_rank,p) == 0) {
+          dm_array_halo_exchange_complex(&copied_array,&halo);
+          dm_array_halo_wait(&halo);
+          n_wrong = 0;
+          j = (halo.local_slabs < 2) ? halo.local_slabs : 2;
+          if (halo.halo_lo != ((USE_MPI && (my_rank > 0)) ? j : 0)) {
+              n_wrong++;
+          }
+          if (halo.halo_hi != ((USE_MPI && (my_rank < (p-1))) ? j : 0)) {
+              n_wrong++;
+          }
+          for (j = 0; j < 2; j++) {
+              if (j == 0) {
+                  halo_values = (dm_array_real *)halo.lo_array;
+                  n_halo = (dm_array_index_t)halo.halo_lo*halo.slab_npix;
+                  i_global = (dm_array_index_t)my_rank*
+                      (copied_array.npix/p)-n_halo;
+              } else {
+                  halo_values = (dm_array_real *)halo.hi_array;
+                  n_halo = (dm_array_index_t)halo.halo_hi*halo.slab_npix;
+                  i_global = (dm_array_index_t)(my_rank+1)*
+                      (copied_array.npix/p);
+              }
+              for (i = 0; i < n_halo; i++, i_global++) {
+#if DM_ARRAY_SPLIT
+                  temp_re = *(halo_values+i);
+                  temp_im = *(halo_values+n_halo+i);
+#else
+                  temp_re = *(halo_values+2*i);
+                  temp_im = *(halo_values+2*i+1);
+#endif /* DM_ARRAY_SPLIT */
+                  if ((temp_re != (dm_array_real)i_global) ||
+                      (temp_im != -(dm_array_real)i_global)) n_wrong++;
+              }
+          }
+          if (n_wrong == 0) {
+              printf("Halo of %d slabs below and %d above on rank %d: passed\n",
+                     halo.halo_lo,halo.halo_hi,my_rank);
+          } else {
+              printf("Halo of %d slabs below and %d above on rank %d: FAILED (%d)\n",
+                     halo.halo_lo,halo.halo_hi,my_rank,n_wrong);
+              n_failed++;
+          }
+          dm_array_halo_free(&halo);
+      }
+      dm_array_copy_complex(&copied_array,&array_2d_cas);
+      
+      /* Test a shrink-wrap support update on a disc of radius nx/4:
+       * after a blur with sigma 1 and a threshold at half of the
+       * maximum, the support must hold everything more than 1.5
+       * pixels inside of the edge and nothing more than 1.5 outside.
+       */
+      disc_radius = 0.25*nx;
+      for (i = 0; i < byte_array.npix/p; i++) {
+          i_global = (dm_array_index_t)my_rank*(byte_array.npix/p)+i;
+          ix = i_global%byte_array.nx;
+          iy = (i_global/byte_array.nx)%byte_array.ny;
+          iz = i_global/((dm_array_index_t)byte_array.nx*byte_array.ny);
+          c_re(copied_array.complex_array,i) = 
+              dm_test_array_in_disc(&byte_array,ix,iy,iz,disc_radius);
+          c_im(copied_array.complex_array,i) = 0.;
+      }
+      dm_array_shrinkwrap(&byte_array,&copied_array,&real_array,
+                          1.,0.5,0,0,4,my_rank,p);
+      n_wrong = 0;
+      for (i = 0; i < byte_array.npix/p; i++) {
+          i_global = (dm_array_index_t)my_rank*(byte_array.npix/p)+i;
+          ix = i_global%byte_array.nx;
+          iy = (i_global/byte_array.nx)%byte_array.ny;
+          iz = i_global/((dm_array_index_t)byte_array.nx*byte_array.ny);
+          if (dm_test_array_in_disc(&byte_array,ix,iy,iz,disc_radius-1.5)) {
+              if (*(byte_array.byte_array+i) != 1) n_wrong++;
+          } else if (!dm_test_array_in_disc(&byte_array,ix,iy,iz,
+                                            disc_radius+1.5)) {
+              if (*(byte_array.byte_array+i) != 0) n_wrong++;
+          }
+      }
+      if (n_wrong == 0) {
+          printf("Shrink-wrap of a disc on rank %d: passed\n",my_rank);
+      } else {
+          printf("Shrink-wrap of a disc on rank %d: FAILED (%d pixels)\n",
+                 my_rank,n_wrong);
+          n_failed++;
+      }
+
+      /* Dilate and erode a disc that reaches to within 2 pixels of the
+       * edges by 2 on 3 threads, and compare with the same done one
+       * pixel at a time.
+       */
+      disc_radius = 0.5*nx-2.;
+      for (j = 0; j < 2; j++) {
+          for (i = 0; i < byte_array.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(byte_array.npix/p)+i;
+              ix = i_global%byte_array.nx;
+              iy = (i_global/byte_array.nx)%byte_array.ny;
+              iz = i_global/((dm_array_index_t)byte_array.nx*byte_array.ny);
+              *(byte_array.byte_array+i) = (u_int8_t)
+                  dm_test_array_in_disc(&byte_array,ix,iy,iz,disc_radius);
+          }
+          if (j == 0) {
+              dm_array_dilate_byte(&byte_array,2,3,my_rank,p);
+          } else {
+              dm_array_erode_byte(&byte_array,2,3,my_rank,p);
+          }
+          n_wrong = 0;
+          for (i = 0; i < byte_array.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(byte_array.npix/p)+i;
+              ix = i_global%byte_array.nx;
+              iy = (i_global/byte_array.nx)%byte_array.ny;
+              iz = i_global/((dm_array_index_t)byte_array.nx*byte_array.ny);
+              if (*(byte_array.byte_array+i) != 
+                  dm_test_array_morph_disc(&byte_array,ix,iy,iz,
+                                           disc_radius,2,j)) {
+                  n_wrong++;
+              }
+          }
+          if (n_wrong == 0) {
+              printf("%s of a disc on rank %d: passed\n",
+                     (j == 0) ? "Dilation" : "Erosion",my_rank);
+          } else {
+              printf("%s of a disc on rank %d: FAILED (%d pixels)\n",
+                     (j == 0) ? "Dilation" : "Erosion",my_rank,n_wrong);
+              n_failed++;
+          }
+      }
+      
+      /* Test the bit mask against the byte mask it was made from */
+      bit_array.nx = byte_array.nx;
+      bit_array.ny = byte_array.ny;
+      bit_array.nz = byte_array.nz;
+      bit_array.npix = byte_array.npix;
+      DM_ARRAY_BIT_STRUCT_INIT((&bit_array),bit_array.npix,p);
+      dm_array_byte_to_bit(&bit_array,&byte_array);
+      power_before = dm_array_total_power_complex(&array_2d_cas,
+                                                  &byte_array,0);
+      max_value = dm_array_total_power_complex_bit(&array_2d_cas,
+                                                   &bit_array,0);
+      if (fabs(max_value-power_before) <= 1.e-5*fabs(power_before)) {
+          printf("Power inside support %.6f (byte), %.6f (bit) on rank %d: passed\n",
+                 (dm_array_real)power_before,(dm_array_real)max_value,
+                 my_rank);
+      } else {
+          printf("Power inside support %.6f (byte), %.6f (bit) on rank %d: FAILED\n",
+                 (dm_array_real)power_before,(dm_array_real)max_value,
+                 my_rank);
+          n_failed++;
+      }
+      
+      /* The bit copy must keep exactly the pixels of the byte mask */
+      dm_array_zero_complex(&copied_array);
+      dm_array_copy_complex_bit(&copied_array,&array_2d_cas,&bit_array);
+      dm_array_multiply_complex_bit(&copied_array,&bit_array);
+      n_wrong = 0;
+      for (i = 0; i < array_2d_cas.npix/p; i++) {
+          if (*(byte_array.byte_array+i)) {
+              if ((c_re(copied_array.complex_array,i) != 
+                   c_re(array_2d_cas.complex_array,i)) ||
+                  (c_im(copied_array.complex_array,i) != 
+                   c_im(array_2d_cas.complex_array,i))) n_wrong++;
+          } else if ((c_re(copied_array.complex_array,i) != 0.) ||
+                     (c_im(copied_array.complex_array,i) != 0.)) {
+              n_wrong++;
+          }
+      }
+      if (n_wrong == 0) {
+          printf("Copy through the bit mask on rank %d: passed\n",my_rank);
+      } else {
+          printf("Copy through the bit mask on rank %d: FAILED (%d pixels)\n",
+                 my_rank,n_wrong);
+          n_failed++;
+      }
+      dm_array_bit_to_byte(&byte_array,&bit_array);
+      free(bit_array.bit_array);
+      
+      /* Test the span index of the same support */
+      if (dm_array_span_init(&spans,&byte_array) == 0) {
+          max_value = dm_array_total_power_complex_span(&array_2d_cas,
+                                                        &spans,0);
+          if (fabs(max_value-power_before) <= 1.e-5*fabs(power_before)) {
+              printf("Power inside %d spans %.6f on rank %d: passed\n",
+                     (int)spans.n_spans,(dm_array_real)max_value,my_rank);
+          } else {
+              printf("Power inside %d spans %.6f on rank %d: FAILED\n",
+                     (int)spans.n_spans,(dm_array_real)max_value,my_rank);
+              n_failed++;
+          }
+          dm_array_copy_complex_span(&copied_array,&array_2d_cas,&spans);
+          dm_array_multiply_complex_span(&copied_array,&spans);
+          dm_array_span_free(&spans);
+      }
+      
       /* Test multiply complex scalar */
       c_re(multipl_value,0) = -1.;
       c_im(multipl_value,0) = 2.;
@@ -334,18 +882,143 @@ main(int argc, char **argv) {
       }
       printf("\n");
 
-      /* Add something to the magnitudes and replace the existing ones */
+      /* Test the fast phase and magnitude against atan2() and hypot()
+       * in double, within the bounds in dm_array.h. In float builds
+       * the reference is exact to far below a float ULP, so the bounds
+       * are used as they are. In double builds the reference is itself
+       * rounded to double, so one more ULP is allowed.
+       */
+      for (j = DM_ARRAY_MATH_FAST; j <= DM_ARRAY_MATH_FASTEST; j++) {
+          dm_array_phase_fast(&real_array,&array_2d_cas,j);
+          n_wrong = 0;
+          max_diff = 0.;
+          for (i = 0; i < real_array.npix/p; i++) {
+              this_old_mag = atan2((double)c_im(array_2d_cas.complex_array,i),
+                                   (double)c_re(array_2d_cas.complex_array,i));
+              this_error = fabs(*(real_array.real_array+i)-this_old_mag);
+              if (j == DM_ARRAY_MATH_FAST) {
+                  this_error = this_error/dm_test_array_ulp(this_old_mag);
+#if defined(DM_ARRAY_DOUBLE)
+                  if (this_error > 3.3+1.) n_wrong++;
+#else
+                  if (this_error > 2.3) n_wrong++;
+#endif
+              } else if (this_error > 
+                         2.4e-5+dm_test_array_ulp(this_old_mag)) {
+                  n_wrong++;
+              }
+              if (this_error > max_diff) max_diff = this_error;
+          }
+          if (n_wrong == 0) {
+              printf("Phase %s, max error %g %s on rank %d: passed\n",
+                     (j == DM_ARRAY_MATH_FAST) ? "fast" : "fastest",
+                     max_diff,(j == DM_ARRAY_MATH_FAST) ? "ULP" : "rad",
+                     my_rank);
+          } else {
+              printf("Phase %s, max error %g %s on rank %d: FAILED (%d pixels)\n",
+                     (j == DM_ARRAY_MATH_FAST) ? "fast" : "fastest",
+                     max_diff,(j == DM_ARRAY_MATH_FAST) ? "ULP" : "rad",
+                     my_rank,n_wrong);
+              n_failed++;
+          }
+
+          dm_array_magnitude_complex_fast(&real_array,&array_2d_cas,j);
+          n_wrong = 0;
+          max_diff = 0.;
+          for (i = 0; i < real_array.npix/p; i++) {
+              this_old_mag = hypot((double)c_re(array_2d_cas.complex_array,i),
+                                   (double)c_im(array_2d_cas.complex_array,i));
+              this_error = fabs(*(real_array.real_array+i)-this_old_mag)/
+                  dm_test_array_ulp(this_old_mag);
+#if defined(DM_ARRAY_DOUBLE)
+              if (this_error > 1.2+1.) n_wrong++;
+#else
+              if (this_error > 1.2) n_wrong++;
+#endif
+              if (this_error > max_diff) max_diff = this_error;
+          }
+          if (n_wrong == 0) {
+              printf("Magnitude %s, max error %g ULP on rank %d: passed\n",
+                     (j == DM_ARRAY_MATH_FAST) ? "fast" : "fastest",
+                     max_diff,my_rank);
+          } else {
+              printf("Magnitude %s, max error %g ULP on rank %d: FAILED (%d pixels)\n",
+                     (j == DM_ARRAY_MATH_FAST) ? "fast" : "fastest",
+                     max_diff,my_rank,n_wrong);
+              n_failed++;
+          }
+      }
+
+      /* Add something to the magnitudes and replace the existing ones.
+       * Every 7th magnitude is left unknown (zero).
+       */
       for (i = 0; i < real_array.npix/p; i++) {
-          *(real_array.real_array+i) = (dm_array_real)(my_rank+10);
+          if ((i%7) == 0) {
+              *(real_array.real_array+i) = 0.;
+          } else {
+              *(real_array.real_array+i) = (dm_array_real)(my_rank+10);
+          }
       }
 
-      /* Let's make up an error array. */
+      /* Let's make up an error array. The error band is wide enough
+       * for some of the old magnitudes to fall inside it.
+       */
       for (i = 0; i < intens_array.npix/p; i++) {
-          *(intens_array.real_array+i) = (dm_array_real)0.5;
+          *(intens_array.real_array+i) = (dm_array_real)(0.5*(i%23));
+      }
+
+      /* Reference result from the original scalar loop */
+      dm_array_copy_complex(&copied_array,&array_2d_cas);
+      for (i = 0; i < copied_array.local_npix; i++) {
+          if (*(real_array.real_array+i)) {
+              temp_re = c_re(copied_array.complex_array,i);
+              temp_im = c_im(copied_array.complex_array,i);
+              this_old_mag = sqrt(temp_re*temp_re + temp_im*temp_im);
+              this_new_mag = *(real_array.real_array+i);
+              this_error = *(intens_array.real_array+i);
+              if (this_old_mag > (this_new_mag+this_error)) {
+                  this_new_mag += this_error;
+              } else if (this_old_mag < (this_new_mag-this_error)) {
+                  this_new_mag -= this_error;
+              } else {
+                  this_new_mag = this_old_mag;
+              }
+              if (this_old_mag) {
+                  c_re(copied_array.complex_array,i) *= 
+                      this_new_mag/this_old_mag;
+                  c_im(copied_array.complex_array,i) *= 
+                      this_new_mag/this_old_mag;
+              } else {
+                  c_re(copied_array.complex_array,i) += this_new_mag;
+              }
+          }
       }
 
       /* if not using errors, pass NULL pointer as third argument. */
-      dm_array_transfer_magnitudes(&array_2d_cas,&real_array,&intens_array);
+      dm_array_transfer_magnitudes(&array_2d_cas,&real_array,&intens_array,0);
+
+      max_diff = 0.;
+      for (i = 0; i < array_2d_cas.local_npix; i++) {
+          this_error = 
+              fabs(c_re(array_2d_cas.complex_array,i)-
+                   c_re(copied_array.complex_array,i))+
+              fabs(c_im(array_2d_cas.complex_array,i)-
+                   c_im(copied_array.complex_array,i));
+          if (this_error > max_diff) max_diff = this_error;
+      }
+      if (max_diff <= 1.e-4*(my_rank+20)) {
+          printf("Transfer magnitudes against scalar loop on rank %d: passed\n",
+                 my_rank);
+      } else {
+          printf("Transfer magnitudes against scalar loop on rank %d: FAILED (%g)\n",
+                 my_rank,max_diff);
+          n_failed++;
+      }
+
+      /* Doing it again should leave almost no Fourier space error */
+      temp_re = dm_array_transfer_magnitudes_error(&array_2d_cas,&real_array,
+                                                   &intens_array,0);
+      printf("Fourier space error from rank %d: %f\n", my_rank, temp_re);
        
       /* Test magnitude after */
       dm_array_magnitude_complex(&real_array, &array_2d_cas);
@@ -374,6 +1047,112 @@ main(int argc, char **argv) {
           printf("%f ", temp_re);
       }
       printf("\n");
+
+      /* Test polar form: magnitude and phase from one pass */
+      dm_array_polar(&real_array, &intens_array, &array_2d_cas);
+      printf("Polar {magnitude,phase} from rank %d: \n",my_rank);
+      for (i = 0; i < print_limit; i++) {
+          temp_re =  real_array.real_array[i];
+          temp_im =  intens_array.real_array[i];
+          printf("{%f,%f} ", temp_re,temp_im);
+      }
+      printf("\n");
+
+      /* Test intensity and magnitude from one pass */
+      dm_array_intensity_magnitude(&intens_array, &real_array, &array_2d_cas);
+      printf("{Intensity,magnitude} from rank %d: \n",my_rank);
+      for (i = 0; i < print_limit; i++) {
+          temp_re =  intens_array.real_array[i];
+          temp_im =  real_array.real_array[i];
+          printf("{%f,%f} ", temp_re,temp_im);
+      }
+      printf("\n");
+
+      /* Both must agree with dm_array_magnitude_complex(), 
+       * dm_array_phase() and dm_array_intensity() with both outputs
+       * and with either one of them NULL. The outputs are set to -1
+       * first so that one that is not filled in shows up.
+       */
+      {
+          dm_array_real *ref_mag, *ref_phase, *ref_intens;
+          int i_pass;
+          
+          ref_mag = (dm_array_real *)
+              malloc(real_array.local_npix*sizeof(dm_array_real));
+          ref_phase = (dm_array_real *)
+              malloc(real_array.local_npix*sizeof(dm_array_real));
+          ref_intens = (dm_array_real *)
+              malloc(real_array.local_npix*sizeof(dm_array_real));
+          dm_array_magnitude_complex(&real_array,&array_2d_cas);
+          dm_array_intensity(&intens_array,&array_2d_cas);
+          for (i = 0; i < real_array.local_npix; i++) {
+              *(ref_mag+i) = *(real_array.real_array+i);
+              *(ref_intens+i) = *(intens_array.real_array+i);
+          }
+          dm_array_phase(&real_array,&array_2d_cas);
+          for (i = 0; i < real_array.local_npix; i++) {
+              *(ref_phase+i) = *(real_array.real_array+i);
+          }
+
+          n_wrong = 0;
+          for (i_pass = 0; i_pass < 6; i_pass++) {
+              for (i = 0; i < real_array.local_npix; i++) {
+                  *(real_array.real_array+i) = -1.;
+                  *(intens_array.real_array+i) = -1.;
+              }
+              switch (i_pass) {
+              case 0:
+                  dm_array_polar(&real_array,&intens_array,&array_2d_cas);
+                  break;
+              case 1:
+                  dm_array_polar(&real_array,NULL,&array_2d_cas);
+                  break;
+              case 2:
+                  dm_array_polar(NULL,&intens_array,&array_2d_cas);
+                  break;
+              case 3:
+                  dm_array_intensity_magnitude(&intens_array,&real_array,
+                                               &array_2d_cas);
+                  break;
+              case 4:
+                  dm_array_intensity_magnitude(&intens_array,NULL,
+                                               &array_2d_cas);
+                  break;
+              default:
+                  dm_array_intensity_magnitude(NULL,&real_array,
+                                               &array_2d_cas);
+                  break;
+              }
+              for (i = 0; i < real_array.local_npix; i++) {
+                  /* real_array holds the magnitude, intens_array the
+                   * phase from dm_array_polar() or the intensity
+                   */
+                  if ((i_pass != 2) && (i_pass != 4) &&
+                      (fabs(*(real_array.real_array+i)-*(ref_mag+i)) >
+                       1.e-6*(*(ref_mag+i)))) n_wrong++;
+                  if (((i_pass == 0) || (i_pass == 2)) &&
+                      (fabs(*(intens_array.real_array+i)-*(ref_phase+i)) >
+                       1.e-6)) n_wrong++;
+                  if (((i_pass == 3) || (i_pass == 4)) &&
+                      (fabs(*(intens_array.real_array+i)-*(ref_intens+i)) >
+                       1.e-6*(*(ref_intens+i)))) n_wrong++;
+              }
+          }
+          /* With no outputs at all nothing may happen */
+          dm_array_polar(NULL,NULL,&array_2d_cas);
+          dm_array_intensity_magnitude(NULL,NULL,&array_2d_cas);
+          free(ref_mag);
+          free(ref_phase);
+          free(ref_intens);
+      }
+      if (n_wrong == 0) {
+          printf("Polar and intensity_magnitude with NULL outputs on rank %d: passed\n",
+                 my_rank);
+      } else {
+          printf("Polar and intensity_magnitude with NULL outputs on rank %d: FAILED (%d)\n",
+                 my_rank,n_wrong);
+          n_failed++;
+      }
       
       /* Test complex array copying */
       dm_array_copy_complex(&copied_array,&array_2d_cas);
@@ -384,6 +1163,383 @@ main(int argc, char **argv) {
           printf("{%f,%f} ", temp_re,temp_im);
       }
       printf("\n");
+
+      /* Test removing the global phase inside the support: a positive
+       * real object rotated by 0.7 inside the support, and something
+       * with another phase outside of it that must not count. The 
+       * phase found must be 0.7, and the sum inside the support real
+       * and positive afterwards.
+       */
+      for (i = 0; i < copied_array.local_npix; i++) {
+          i_global = (dm_array_index_t)my_rank*copied_array.local_npix+i;
+          *(byte_array.byte_array+i) = (u_int8_t)((i_global%3) != 0);
+          this_error = (*(byte_array.byte_array+i)) ? 
+              (1.+0.25*(i_global%5)) : 10.;
+          c_re(copied_array.complex_array,i) = this_error*
+              cos((*(byte_array.byte_array+i)) ? 0.7 : -2.);
+          c_im(copied_array.complex_array,i) = this_error*
+              sin((*(byte_array.byte_array+i)) ? 0.7 : -2.);
+      }
+      global_phase = 
+          dm_array_remove_global_phase(&copied_array,&byte_array,2);
+      printf("Removed global phase %f, after that from rank %d: \n",
+             global_phase,my_rank);
+      for (i = 0; i < print_limit; i++) {
+          temp_re =  c_re(copied_array.complex_array,i);
+          temp_im = c_im(copied_array.complex_array,i);
+          printf("{%f,%f} ", temp_re,temp_im);
+      }
+      printf("\n");
+      phase_sums[0] = 0.;
+      phase_sums[1] = 0.;
+      for (i = 0; i < copied_array.local_npix; i++) {
+          if (*(byte_array.byte_array+i)) {
+              phase_sums[0] += c_re(copied_array.complex_array,i);
+              phase_sums[1] += c_im(copied_array.complex_array,i);
+          }
+      }
+#if USE_MPI
+      MPI_Allreduce(MPI_IN_PLACE,phase_sums,2,MPI_DOUBLE,MPI_SUM,
+                    MPI_COMM_WORLD);
+#endif /* USE_MPI */
+      if ((fabs(global_phase-0.7) < 1.e-5) &&
+          (phase_sums[0] > 0.) &&
+          (fabs(phase_sums[1]) < 1.e-5*phase_sums[0])) {
+          printf("Global phase %f removed on rank %d: passed\n",
+                 global_phase,my_rank);
+      } else {
+          printf("Global phase %f removed on rank %d: FAILED (sum {%g,%g})\n",
+                 global_phase,my_rank,
+                 phase_sums[0],phase_sums[1]);
+          n_failed++;
+      }
+      dm_array_copy_complex(&copied_array,&array_2d_cas);
+
+      /* Test a few HIO then error reduction iterations from 3 starts,
+       * on the magnitudes of a known object in a box of about half the
+       * size of the array. Error reduction must end up below where HIO
+       * left off, and 3 threads must give exactly what 1 thread gives.
+       */
+      if (can_fft) {
+          for (i = 0; i < byte_array.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(byte_array.npix/p)+i;
+              ix = i_global%byte_array.nx;
+              iy = (i_global/byte_array.nx)%byte_array.ny;
+              iz = i_global/((dm_array_index_t)byte_array.nx*byte_array.ny);
+              *(byte_array.byte_array+i) = (u_int8_t)
+                  ((abs(ix-byte_array.nx/2) <= byte_array.nx/4) &&
+                   (abs(iy-byte_array.ny/2) <= byte_array.ny/4) &&
+                   (abs(iz-byte_array.nz/2) <= byte_array.nz/4));
+              c_re(copied_array.complex_array,i) = 
+                  *(byte_array.byte_array+i)*(1.+0.25*((7*ix+3*iy+iz)%5));
+              c_im(copied_array.complex_array,i) = 0.;
+          }
+          dm_array_fft(&copied_array,p,DM_ARRAY_CREATE_FFT_PLAN | 
+                       DM_ARRAY_FFT_ESTIMATE,my_rank);
+          dm_array_fft(&copied_array,p,DM_ARRAY_FORWARD_FFT,my_rank);
+          dm_array_magnitude_complex(&real_array,&copied_array);
+          dm_array_fft(&copied_array,p,DM_ARRAY_DESTROY_FFT_PLAN,my_rank);
+          
+          if ((dm_array_ensemble_init(&ensemble,&real_array,&byte_array,3,
+                                      DM_ARRAY_FFT_ESTIMATE,p,
+                                      my_rank) == 0) &&
+              (dm_array_ensemble_init(&threaded_ensemble,&real_array,
+                                      &byte_array,3,DM_ARRAY_FFT_ESTIMATE,
+                                      p,my_rank) == 0)) {
+              dm_array_ensemble_start(&ensemble,7,1);
+              dm_array_ensemble_run(&ensemble,30,0.9,1);
+              for (i = 0; i < ensemble.n_starts; i++) {
+                  hio_errors[i] = ensemble.errors[i];
+              }
+              dm_array_ensemble_run(&ensemble,20,0.,1);
+              dm_array_ensemble_start(&threaded_ensemble,7,3);
+              dm_array_ensemble_run(&threaded_ensemble,30,0.9,3);
+              dm_array_ensemble_run(&threaded_ensemble,20,0.,3);
+              
+              printf("Ensemble errors (HIO, then ER) from rank %d: ",my_rank);
+              n_wrong = 0;
+              for (i = 0; i < ensemble.n_starts; i++) {
+                  printf("%f %f  ",hio_errors[i],ensemble.errors[i]);
+                  if (!(ensemble.errors[i] < hio_errors[i])) n_wrong++;
+              }
+              printf("\n");
+              if (n_wrong == 0) {
+                  printf("Ensemble error drops from HIO to ER on rank %d: passed\n",
+                         my_rank);
+              } else {
+                  printf("Ensemble error drops from HIO to ER on rank %d: FAILED\n",
+                         my_rank);
+                  n_failed++;
+              }
+              
+              n_wrong = 0;
+              for (j = 0; j < ensemble.n_starts; j++) {
+                  if (threaded_ensemble.errors[j] != ensemble.errors[j]) {
+                      n_wrong++;
+                  }
+                  for (i = 0; i < ensemble.iterates->local_npix; i++) {
+                      if ((c_re((ensemble.iterates+j)->complex_array,i) != 
+                           c_re((threaded_ensemble.iterates+j)->complex_array,
+                                i)) ||
+                          (c_im((ensemble.iterates+j)->complex_array,i) != 
+                           c_im((threaded_ensemble.iterates+j)->complex_array,
+                                i))) {
+                          n_wrong++;
+                      }
+                  }
+              }
+              if (n_wrong == 0) {
+                  printf("Ensemble on 1 and 3 threads on rank %d: passed\n",
+                         my_rank);
+              } else {
+                  printf("Ensemble on 1 and 3 threads on rank %d: FAILED (%d)\n",
+                         my_rank,n_wrong);
+                  n_failed++;
+              }
+              dm_array_ensemble_free(&threaded_ensemble);
+              dm_array_ensemble_free(&ensemble);
+          }
+          dm_array_copy_complex(&copied_array,&array_2d_cas);
+      } else {
+          printf("Ensemble on rank %d: skipped, dm_array_fft() needs dist_fft with MPI\n",
+                 my_rank);
+      }
+
+      /* Test averaging a known object with a copy of itself moved by
+       * whole pixels and turned by a constant phase. The shift that 
+       * lines the copy up must undo the move, the average must be 
+       * the object, and with two identical iterates the PRTF must be
+       * 1 wherever there are pixels.
+       */
+      if (can_fft) {
+          object_shift[0] = 0;
+          object_shift[1] = 0;
+          object_shift[2] = 0;
+          moved_shift[0] = 3;
+          moved_shift[1] = (array_2d_cas.ny > 1) ? -2 : 0;
+          moved_shift[2] = (array_2d_cas.nz > 1) ? 1 : 0;
+          for (i = 0; i < array_2d_cas.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(array_2d_cas.npix/p)+i;
+              ix = i_global%array_2d_cas.nx;
+              iy = (i_global/array_2d_cas.nx)%array_2d_cas.ny;
+              iz = i_global/((dm_array_index_t)array_2d_cas.nx*
+                             array_2d_cas.ny);
+              dm_test_array_object(&array_2d_cas,ix,iy,iz,object_shift,0.,
+                                   &this_old_mag,&this_new_mag);
+              c_re(copied_array.complex_array,i) = this_old_mag;
+              c_im(copied_array.complex_array,i) = this_new_mag;
+              dm_test_array_object(&array_2d_cas,ix,iy,iz,moved_shift,0.7,
+                                   &this_old_mag,&this_new_mag);
+              c_re(array_2d_cas.complex_array,i) = this_old_mag;
+              c_im(array_2d_cas.complex_array,i) = this_new_mag;
+          }
+          if (dm_array_average_init(&average,&array_2d_cas,
+                                    DM_ARRAY_FFT_ESTIMATE,p,my_rank) == 0) {
+              dm_array_average_add(&average,&copied_array,1,shift);
+              dm_array_average_add(&average,&array_2d_cas,1,shift);
+              n_wrong = 0;
+              for (i = 0; i < 3; i++) {
+                  if (fabs(shift[i]+moved_shift[i]) > 1.e-6) n_wrong++;
+              }
+              if (n_wrong == 0) {
+                  printf("Average shift {%f,%f,%f} on rank %d: passed\n",
+                         shift[0],shift[1],shift[2],my_rank);
+              } else {
+                  printf("Average shift {%f,%f,%f} on rank %d: FAILED\n",
+                         shift[0],shift[1],shift[2],my_rank);
+                  n_failed++;
+              }
+              
+              dm_array_average_get(&average,&array_2d_cas,NULL,NULL);
+              max_diff = 0.;
+              for (i = 0; i < array_2d_cas.local_npix; i++) {
+                  this_error = 
+                      fabs(c_re(array_2d_cas.complex_array,i)-
+                           c_re(copied_array.complex_array,i))+
+                      fabs(c_im(array_2d_cas.complex_array,i)-
+                           c_im(copied_array.complex_array,i));
+                  if (this_error > max_diff) max_diff = this_error;
+              }
+              if (max_diff <= 1.e-3) {
+                  printf("Average against the object on rank %d: passed\n",
+                         my_rank);
+              } else {
+                  printf("Average against the object on rank %d: FAILED (%g)\n",
+                         my_rank,max_diff);
+                  n_failed++;
+              }
+              
+              dm_array_average_prtf(&average,NULL,4,prtf,prtf_counts);
+              printf("PRTF from rank %d: ",my_rank);
+              n_wrong = 0;
+              for (i = 0; i < 4; i++) {
+                  printf("%f ",prtf[i]);
+                  if ((prtf_counts[i] > 0.) && (fabs(prtf[i]-1.) > 1.e-3)) {
+                      n_wrong++;
+                  }
+              }
+              printf("\n");
+              if (n_wrong == 0) {
+                  printf("PRTF of two copies on rank %d: passed\n",my_rank);
+              } else {
+                  printf("PRTF of two copies on rank %d: FAILED\n",my_rank);
+                  n_failed++;
+              }
+              dm_array_average_free(&average);
+          }
+      } else {
+          printf("Average on rank %d: skipped, dm_array_fft() needs dist_fft with MPI\n",
+                 my_rank);
+      }
+      dm_array_rand(&array_2d_cas,0);
+      dm_array_copy_complex(&copied_array,&array_2d_cas);
+
+      /* Test registration on the object and a copy of it moved by a
+       * known fractional shift, upsampled by 20 and by 100: the shift
+       * found must undo the move to within 1/upsample, and change sign
+       * with the two swapped.
+       */
+      if (can_fft) {
+          scratch_array.nx = array_2d_cas.nx;
+          scratch_array.ny = array_2d_cas.ny;
+          scratch_array.nz = array_2d_cas.nz;
+          scratch_array.npix = array_2d_cas.npix;
+          DM_ARRAY_COMPLEX_STRUCT_INIT((&scratch_array),scratch_array.npix,p);
+          dm_array_fft(&scratch_array,p,DM_ARRAY_CREATE_FFT_PLAN | 
+                       DM_ARRAY_FFT_ESTIMATE,my_rank);
+          dm_array_fft(&copied_array,p,DM_ARRAY_CREATE_FFT_PLAN | 
+                       DM_ARRAY_FFT_ESTIMATE,my_rank);
+          dm_array_fft(&array_2d_cas,p,DM_ARRAY_CREATE_FFT_PLAN | 
+                       DM_ARRAY_FFT_ESTIMATE,my_rank);
+          object_shift[0] = 0;
+          object_shift[1] = 0;
+          object_shift[2] = 0;
+          for (i = 0; i < array_2d_cas.npix/p; i++) {
+              i_global = (dm_array_index_t)my_rank*(array_2d_cas.npix/p)+i;
+              ix = i_global%array_2d_cas.nx;
+              iy = (i_global/array_2d_cas.nx)%array_2d_cas.ny;
+              iz = i_global/((dm_array_index_t)array_2d_cas.nx*
+                             array_2d_cas.ny);
+              dm_test_array_object(&array_2d_cas,ix,iy,iz,object_shift,0.,
+                                   &this_old_mag,&this_new_mag);
+              c_re(copied_array.complex_array,i) = this_old_mag;
+              c_im(copied_array.complex_array,i) = this_new_mag;
+          }
+          dm_array_copy_complex(&array_2d_cas,&copied_array);
+          moved[0] = 1.33;
+          moved[1] = (array_2d_cas.ny > 1) ? -0.61 : 0.;
+          moved[2] = (array_2d_cas.nz > 1) ? 0.47 : 0.;
+          dm_array_shift_complex(&array_2d_cas,moved,p,my_rank);
+          dm_array_fft(&copied_array,p,DM_ARRAY_FORWARD_FFT,my_rank);
+          dm_array_fft(&array_2d_cas,p,DM_ARRAY_FORWARD_FFT,my_rank);
+          
+          for (j = 0; j < 4; j++) {
+              /* Upsampling by 20, then by 100 */
+              if ((j%2) == 0) {
+                  temp_re = dm_array_register(&copied_array,&array_2d_cas,
+                                              &scratch_array,
+                                              (j < 2) ? 20 : 100,shift);
+              } else {
+                  temp_re = dm_array_register(&array_2d_cas,&copied_array,
+                                              &scratch_array,
+                                              (j < 2) ? 20 : 100,shift);
+              }
+              n_wrong = 0;
+              for (i = 0; i < 3; i++) {
+                  if (fabs(shift[i]+(((j%2) == 0) ? moved[i] : -moved[i])) > 
+                      ((j < 2) ? 1./20. : 1./100.)) {
+                      n_wrong++;
+                  }
+              }
+              printf("Register %s at upsample %d shift {%f,%f,%f}, error %f on rank %d: %s\n",
+                     ((j%2) == 0) ? "moved to object" : "object to moved",
+                     (j < 2) ? 20 : 100,shift[0],shift[1],shift[2],temp_re,
+                     my_rank,(n_wrong == 0) ? "passed" : "FAILED");
+              if (n_wrong) n_failed++;
+          }
+          
+          dm_array_fft(&array_2d_cas,p,DM_ARRAY_DESTROY_FFT_PLAN,my_rank);
+          dm_array_fft(&copied_array,p,DM_ARRAY_DESTROY_FFT_PLAN,my_rank);
+          dm_array_fft(&scratch_array,p,DM_ARRAY_DESTROY_FFT_PLAN,my_rank);
+          DM_ARRAY_COMPLEX_FREE(scratch_array.complex_array);
+          dm_array_rand(&array_2d_cas,0);
+          dm_array_copy_complex(&copied_array,&array_2d_cas);
+      } else {
+          printf("Register on rank %d: skipped, dm_array_fft() needs dist_fft with MPI\n",
+                 my_rank);
+      }
+
+      /* Test a sub-pixel shift there and back, which must give the
+       * array back, then a quarter turn about z, which must move each
+       * pixel exactly to its place a quarter of the way round pixel
+       * (nx/2,ny/2) as the shears are then whole pixels.
+       */
+      if (can_fft) {
+          dm_array_fft(&copied_array,p,DM_ARRAY_CREATE_FFT_PLAN | 
+                       DM_ARRAY_FFT_ESTIMATE,my_rank);
+          dm_array_copy_complex(&copied_array,&array_2d_cas);
+          shift[0] = 0.5;
+          shift[1] = -0.25;
+          shift[2] = 0.;
+          dm_array_shift_complex(&copied_array,shift,p,my_rank);
+          shift[0] = -0.5;
+          shift[1] = 0.25;
+          dm_array_shift_complex(&copied_array,shift,p,my_rank);
+          max_diff = 0.;
+          for (i = 0; i < copied_array.local_npix; i++) {
+              this_error = 
+                  fabs(c_re(copied_array.complex_array,i)-
+                       c_re(array_2d_cas.complex_array,i))+
+                  fabs(c_im(copied_array.complex_array,i)-
+                       c_im(array_2d_cas.complex_array,i));
+              if (this_error > max_diff) max_diff = this_error;
+          }
+          if (max_diff <= 1.e-3) {
+              printf("Shift there and back on rank %d: passed\n",my_rank);
+          } else {
+              printf("Shift there and back on rank %d: FAILED (%g)\n",
+                     my_rank,max_diff);
+              n_failed++;
+          }
+          dm_array_fft(&copied_array,p,DM_ARRAY_DESTROY_FFT_PLAN,my_rank);
+      } else {
+          printf("Shift on rank %d: skipped, dm_array_fft() needs dist_fft with MPI\n",
+                 my_rank);
+      }
+      
+      dm_array_copy_complex(&copied_array,&array_2d_cas);
+      if ((copied_array.nx == copied_array.ny) &&
+          (dm_array_rotate_complex(&copied_array,2,
+                                   0.5*3.14159265358979) == 0)) {
+          max_diff = 0.;
+          for (i = 0; i < copied_array.local_npix; i++) {
+              ix = i%copied_array.nx;
+              iy = (i/copied_array.nx)%copied_array.ny;
+              iz = i/(copied_array.nx*copied_array.ny);
+              j = ((copied_array.nx/2+iy-copied_array.ny/2+
+                    copied_array.nx)%copied_array.nx)+
+                  ((copied_array.ny/2-ix+copied_array.nx/2+
+                    copied_array.ny)%copied_array.ny)*copied_array.nx+
+                  iz*copied_array.nx*copied_array.ny;
+              this_error = 
+                  fabs(c_re(copied_array.complex_array,i)-
+                       c_re(array_2d_cas.complex_array,j))+
+                  fabs(c_im(copied_array.complex_array,i)-
+                       c_im(array_2d_cas.complex_array,j));
+              if (this_error > max_diff) max_diff = this_error;
+          }
+          if (max_diff <= 1.e-3) {
+              printf("Quarter turn on rank %d: passed\n",my_rank);
+          } else {
+              printf("Quarter turn on rank %d: FAILED (%g)\n",
+                     my_rank,max_diff);
+              n_failed++;
+          }
+      } else {
+          printf("Quarter turn on rank %d: skipped, the array is flat or split\n",
+                 my_rank);
+      }
+      dm_array_copy_complex(&copied_array,&array_2d_cas);
       
       /* Test multiply complex_byte */
       dm_array_multiply_complex_byte(&array_2d_cas,&byte_array);
@@ -486,8 +1642,9 @@ main(int argc, char **argv) {
       free(byte_array.byte_array);
       DM_ARRAY_COMPLEX_FREE(multipl_value);
   }
+  if (n_failed) printf("%d checks FAILED on rank %d.\n",n_failed,my_rank);
   dm_exit();
   
 
-  return(0); 
+  return(n_failed ? 1 : 0); 
 }
@@ -25,9 +25,16 @@ int main(int argc, char *argv[]) {
   dm_itn_struct my_itn_struct;
   dm_array_real_struct my_adi_array_struct, my_adi_error_array_struct;
   dm_array_real_struct recon_errors;
+  dm_array_real_struct my_adi_map_array_struct;
+  dm_h5_map_struct my_adi_map;
   dm_array_complex_struct my_itn_array_struct;
   dm_array_byte_struct my_spt_array_struct;
+  dm_array_bit_struct my_spt_bit_struct;
   dm_comment_struct my_comment_struct;
+  dm_h5_session_struct my_session;
+  dm_array_real_struct check_real_struct;
+  dm_array_byte_struct check_byte_struct;
+  dm_array_complex_struct check_complex_struct;
   hid_t h5_file_id;
   int n_dims, i_arg, is_readonly, make_error, error_is_present;
   int ix, iy, iz, nx, ny, nz, half_nx, half_ny, half_nz;
@@ -35,11 +42,28 @@ int main(int argc, char *argv[]) {
   int xmax,ymax,zmax;
   int adi_array_allocated, adi_error_array_allocated;
   int spt_array_allocated, itn_array_allocated, comstr_allocated;
-  int ainfo_allocated, status;
+  int ainfo_allocated, packed_ainfo, status;
   int recon_errors_allocated;
   dm_array_index_t i;
   int n_strings, n_frames, string_length;
-  double temp_double;
+  int n_iterates, n_csv_frames, n_stack_frames, n_set_pixels;
+  int n_session_writes, i_write, n_differ;
+  int full_dims[3], region_dims[3], region_offsets[3], region_strides[3];
+  int i_region, i_axis, n_real_dims, n_compared, n_failed;
+  dm_array_index_t full_offset, i_global, i_src;
+  char *region_names[3] = {"crop","stride","slice"};
+  FILE *fp_csv;
+  dm_frame_stack_struct my_frame_stack_struct;
+  u_int16_t *frame_buffer;
+  dm_array_real recon_error, ensemble_errors[3];
+  dm_array_complex_struct ensemble_structs[3];
+  dm_comment_struct check_comment_struct;
+  char *batch_comments[4] = {"Appended on its own.",
+			     "First of a batch.",
+			     "Second of a batch.",
+			     "Third of a batch."};
+  double temp_double, tdelta, full_time, region_time;
+  dm_time_t ts, te;
   time_t t;
   int my_rank,p;
   int DebugWait,print_limit;
@@ -58,9 +82,14 @@ int main(int argc, char *argv[]) {
   spt_array_allocated = 0;
   itn_array_allocated = 0;
   ainfo_allocated = 0;
+  packed_ainfo = 0;
   recon_errors_allocated = 0;
   is_readonly = 1;
   n_dims = 2;
+  n_csv_frames = 0;
+  n_stack_frames = 0;
+  n_session_writes = 0;
+  n_failed = 0;
   DebugWait = 0;
 
   while (i_arg < argc) {
@@ -84,6 +113,18 @@ int main(int argc, char *argv[]) {
     } else if (strncasecmp("-E",this_arg,2) == 0) {
       make_error = 1;
       i_arg++;
+    } else if (strncasecmp("-P",this_arg,2) == 0) {
+      packed_ainfo = 1;
+      i_arg++;
+    } else if (strncasecmp("-B",this_arg,2) == 0) {
+      sscanf(argv[i_arg+1],"%d",&n_csv_frames);
+      i_arg = i_arg+2;
+    } else if (strncasecmp("-F",this_arg,2) == 0) {
+      sscanf(argv[i_arg+1],"%d",&n_stack_frames);
+      i_arg = i_arg+2;
+    } else if (strncasecmp("-S",this_arg,2) == 0) {
+      sscanf(argv[i_arg+1],"%d",&n_session_writes);
+      i_arg = i_arg+2;
     } else if (strncasecmp("-N",this_arg,2) == 0) {
       sscanf(argv[i_arg+1],"%d",&n_dims);
       i_arg = i_arg+2;
@@ -101,6 +142,424 @@ int main(int argc, char *argv[]) {
   printf("Using dm_array_real=float\n");
 #endif
 
+  if (n_csv_frames > 0) {
+    if (my_rank == 0) {
+      /* Write a manifest with n_csv_frames frames and time how long
+       * dm_read_ainfo_from_csv() takes to read it back. The arrays
+       * start out at MAX_FRAMES and have to grow.
+       */
+      strcpy(csv_filename,"dm_test_fileio.csv");
+      if ((fp_csv = fopen(csv_filename,"w")) == NULL) {
+        printf("Could not open \"%s\"\n",csv_filename);
+        exit(1);
+      }
+      fprintf(fp_csv,"directory=/users/local/data/nov2005/\nfilenames=");
+      for (i=0; i<n_csv_frames; i++) {
+        fprintf(fp_csv,"%sframe_%06d.tif",(i == 0) ? "" : ",",(int)i);
+      }
+      fprintf(fp_csv,"\nsystimes=");
+      for (i=0; i<n_csv_frames; i++) {
+        fprintf(fp_csv,"%s%d",(i == 0) ? "" : ",",1130000000+(int)i);
+      }
+      fprintf(fp_csv,"\ngmr_x=");
+      for (i=0; i<n_csv_frames; i++) {
+        fprintf(fp_csv,"%s%.2f",(i == 0) ? "" : ",",
+		-70.+140.*(double)i/(double)n_csv_frames);
+      }
+      fprintf(fp_csv,"\nxcenter=");
+      for (i=0; i<n_csv_frames; i++) {
+        fprintf(fp_csv,"%s%.2f",(i == 0) ? "" : ",",-0.5);
+      }
+      fprintf(fp_csv,"\nycenter=");
+      for (i=0; i<n_csv_frames; i++) {
+        fprintf(fp_csv,"%s%.2f",(i == 0) ? "" : ",",-1.);
+      }
+      fprintf(fp_csv,"\n");
+      fclose(fp_csv);
+
+      my_ainfo_struct.n_frames_max = MAX_FRAMES;
+      my_ainfo_struct.string_length = AINFO_STRLEN;
+      my_ainfo_struct.ainfo_tags = AINFO_TAGS;
+      my_ainfo_struct.file_directory =
+        (char *)malloc(my_ainfo_struct.string_length);    
+      my_ainfo_struct.filename_array = 
+        (char *)malloc(my_ainfo_struct.n_frames_max*
+		       my_ainfo_struct.string_length);
+      my_ainfo_struct.systime_array = 
+        (char *)malloc(my_ainfo_struct.n_frames_max*
+		       my_ainfo_struct.string_length);
+      my_ainfo_struct.theta_x_radians_array = 
+        (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
+      my_ainfo_struct.theta_y_radians_array = 
+        (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
+      my_ainfo_struct.theta_z_radians_array = 
+        (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
+      my_ainfo_struct.xcenter_offset_pixels_array = 
+        (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
+      my_ainfo_struct.ycenter_offset_pixels_array = 
+        (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double)); 
+      ainfo_allocated = 1;
+      dm_clear_ainfo(&my_ainfo_struct);
+    
+      dm_time(&ts);
+      if (dm_read_ainfo_from_csv(csv_filename, &my_ainfo_struct,
+				 error_string) != DM_FILEIO_SUCCESS) {
+        printf("%s\n",error_string);
+        exit(1);  
+      }
+      dm_time(&te);
+      tdelta = dm_time_diff(ts,te);
+      printf("Read %d frames from \"%s\" in %f\n",
+	     my_ainfo_struct.filenames_offset,csv_filename,tdelta);
+      if ((my_ainfo_struct.filenames_offset != n_csv_frames) ||
+	  (my_ainfo_struct.systimes_offset != n_csv_frames) ||
+	  (my_ainfo_struct.theta_x_offset != n_csv_frames) ||
+	  (my_ainfo_struct.xcenter_offset != n_csv_frames) ||
+	  (my_ainfo_struct.ycenter_offset != n_csv_frames)) {
+        printf("Expected %d frames in every array\n",n_csv_frames);
+        exit(1);
+      }
+      printf("Last filename: \"%s\"\n",
+	     my_ainfo_struct.filename_array+
+	     (n_csv_frames-1)*my_ainfo_struct.string_length);
+      remove(csv_filename);
+    } /* endif(my_rank == 0) */
+    dm_exit();
+    exit(0);
+  }
+
+  if (n_stack_frames > 0) {
+    /* Write n_stack_frames raw 256x256 frames, each with one more
+     * count per pixel than the last, and merge them with
+     * dm_read_frame_stack(). The ainfo arrays start out empty and
+     * grow as the frames are added.
+     */
+    nx = 256;
+    ny = 256;
+    my_ainfo_struct.n_frames_max = 0;
+    my_ainfo_struct.string_length = AINFO_STRLEN;
+    my_ainfo_struct.ainfo_tags = AINFO_TAGS;
+    my_ainfo_struct.file_directory =
+      (char *)malloc(my_ainfo_struct.string_length);    
+    my_ainfo_struct.filename_array = NULL;
+    my_ainfo_struct.systime_array = NULL;
+    my_ainfo_struct.theta_x_radians_array = NULL;
+    my_ainfo_struct.theta_y_radians_array = NULL;
+    my_ainfo_struct.theta_z_radians_array = NULL;
+    my_ainfo_struct.xcenter_offset_pixels_array = NULL;
+    my_ainfo_struct.ycenter_offset_pixels_array = NULL;
+    dm_clear_ainfo(&my_ainfo_struct);
+    
+    frame_buffer = (u_int16_t *)malloc(nx*ny*sizeof(u_int16_t));
+    for (i_arg=0; i_arg<n_stack_frames; i_arg++) {
+      sprintf(filename,"dm_test_frame_%04d.raw",i_arg);
+      if (dm_add_filename_to_ainfo(filename,&my_ainfo_struct) 
+	  != DM_FILEIO_SUCCESS) {
+	printf("dm_add_filename_to_ainfo() failed\n");
+	exit(1);
+      }
+      if (my_rank == 0) {
+	for (i=0; i<nx*ny; i++) {
+	  *(frame_buffer+i) = (u_int16_t)(i_arg+1);
+	}
+	if ((fp_csv = fopen(filename,"wb")) == NULL) {
+	  printf("Could not open \"%s\"\n",filename);
+	  exit(1);
+	}
+	fwrite(frame_buffer,sizeof(u_int16_t),nx*ny,fp_csv);
+	fclose(fp_csv);
+      }
+    }
+    free(frame_buffer);
+    
+    my_adi_array_struct.nx = nx;
+    my_adi_array_struct.ny = ny;
+    my_adi_array_struct.nz = 1;
+    my_adi_array_struct.npix = nx*ny;
+    DM_ARRAY_REAL_STRUCT_INIT((&my_adi_array_struct),
+			      my_adi_array_struct.npix,p);
+    my_adi_array_struct.local_offset = my_rank*my_adi_array_struct.local_npix;
+    for (i=0; i<my_adi_array_struct.local_npix; i++) {
+      *(my_adi_array_struct.real_array+i) = 0.;
+    }
+    
+    my_frame_stack_struct.pixel_type = DM_FRAME_UINT16;
+    my_frame_stack_struct.header_bytes = 0;
+    my_frame_stack_struct.swap_bytes = 0;
+    my_frame_stack_struct.n_threads = 4;
+    my_frame_stack_struct.read_ahead = 8;
+    if (dm_read_frame_stack(&my_ainfo_struct,&my_frame_stack_struct,
+			    &my_adi_array_struct,error_string,
+			    my_rank,p) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    if (my_rank == 0) {
+      printf("Merged %d frames (%.1f MB) in %f: %.1f frames/s, %.1f MB/s\n",
+	     my_frame_stack_struct.n_frames_read,
+	     1.e-6*my_frame_stack_struct.bytes_read,
+	     my_frame_stack_struct.seconds,
+	     my_frame_stack_struct.frames_per_second,
+	     my_frame_stack_struct.mb_per_second);
+      printf("Pixel 0 is %g, expected %d\n",
+	     (double)*(my_adi_array_struct.real_array),
+	     n_stack_frames*(n_stack_frames+1)/2);
+      for (i_arg=0; i_arg<n_stack_frames; i_arg++) {
+	remove(my_ainfo_struct.filename_array+
+	       i_arg*my_ainfo_struct.string_length);
+      }
+    }
+    dm_exit();
+    exit(0);
+  }
+
+  if (n_session_writes > 0) {
+    /* Write adi, spt and itn n_session_writes times through one
+     * session, changing the data and the structs every time, then
+     * read the file back and compare with what was written last.
+     */
+    nx = 64;
+    ny = 64;
+    nz = (n_dims == 3) ? 64 : 1;
+    strcpy(filename,"dm_test_session.h5");
+    
+    my_adi_array_struct.nx = nx;
+    my_adi_array_struct.ny = ny;
+    my_adi_array_struct.nz = nz;
+    my_adi_array_struct.npix = (dm_array_index_t)nx*ny*nz;
+    DM_ARRAY_REAL_STRUCT_INIT((&my_adi_array_struct),
+			      my_adi_array_struct.npix,p);
+    my_adi_array_struct.local_offset = my_rank*my_adi_array_struct.local_npix;
+    adi_array_allocated = 1;
+    my_adi_error_array_struct.nx = 0;
+    my_adi_error_array_struct.ny = 0;
+    my_adi_error_array_struct.nz = 0;
+    my_adi_error_array_struct.npix = 0;
+    my_adi_error_array_struct.real_array = NULL;
+
+    my_spt_array_struct.nx = nx;
+    my_spt_array_struct.ny = ny;
+    my_spt_array_struct.nz = nz;
+    my_spt_array_struct.npix = my_adi_array_struct.npix;
+    DM_ARRAY_BYTE_STRUCT_INIT((&my_spt_array_struct),
+			      my_spt_array_struct.npix,p);
+    spt_array_allocated = 1;
+
+    my_itn_array_struct.nx = nx;
+    my_itn_array_struct.ny = ny;
+    my_itn_array_struct.nz = nz;
+    my_itn_array_struct.npix = my_adi_array_struct.npix;
+    DM_ARRAY_COMPLEX_STRUCT_INIT((&my_itn_array_struct),
+				 my_itn_array_struct.npix,p);
+    itn_array_allocated = 1;
+
+    /* recon_errors grows by one element per write */
+    recon_errors.nx = 0;
+    recon_errors.ny = 1;
+    recon_errors.nz = 1;
+    recon_errors.npix = 0;
+    recon_errors.real_array = NULL;
+    if (my_rank == 0) {
+      recon_errors.real_array = 
+	(dm_array_real *)malloc(n_session_writes*sizeof(dm_array_real));
+      recon_errors_allocated = 1;
+    }
+
+    memset(&my_adi_struct,0,sizeof(dm_adi_struct));
+    memset(&my_spt_struct,0,sizeof(dm_spt_struct));
+    memset(&my_itn_struct,0,sizeof(dm_itn_struct));
+
+    if (dm_h5_session_open(filename,1,&my_session,
+			   error_string,my_rank) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    dm_time(&ts);
+    for (i_write=0; i_write<n_session_writes; i_write++) {
+      for (i=0; i<my_adi_array_struct.local_npix; i++) {
+	*(my_adi_array_struct.real_array+i) = (dm_array_real)
+	  (my_adi_array_struct.local_offset+i+i_write);
+	*(my_spt_array_struct.byte_array+i) = 
+	  (my_adi_array_struct.local_offset+i+i_write) % 256;
+	c_re(my_itn_array_struct.complex_array,i) = (dm_array_real)
+	  (my_adi_array_struct.local_offset+i)*(i_write+1);
+	c_im(my_itn_array_struct.complex_array,i) = (dm_array_real)
+	  (-(double)i_write);
+      }
+      if (my_rank == 0) {
+	*(recon_errors.real_array+i_write) = 
+	  (dm_array_real)1./(dm_array_real)(i_write+1);
+	recon_errors.nx = i_write+1;
+	recon_errors.npix = i_write+1;
+      }
+      my_adi_struct.photon_scaling = (double)i_write;
+      my_spt_struct.support_scaling = (double)i_write;
+      my_itn_struct.iterate_count = i_write;
+
+      if ((dm_h5_session_write_adi(&my_session,&my_adi_struct,
+				   &my_adi_array_struct,
+				   &my_adi_error_array_struct,
+				   error_string,my_rank,p) 
+	   != DM_FILEIO_SUCCESS) ||
+	  (dm_h5_session_write_spt(&my_session,&my_spt_struct,
+				   &my_spt_array_struct,
+				   error_string,my_rank,p) 
+	   != DM_FILEIO_SUCCESS) ||
+	  (dm_h5_session_write_itn(&my_session,&my_itn_struct,
+				   &my_itn_array_struct,&recon_errors,
+				   error_string,my_rank,p) 
+	   != DM_FILEIO_SUCCESS)) {
+	printf("%s\n",error_string);
+	dm_h5_session_close(&my_session,error_string,my_rank);
+	exit(1);
+      }
+    }
+    if (dm_h5_session_close(&my_session,error_string,my_rank) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    dm_time(&te);
+    tdelta = dm_time_diff(ts,te);
+    printf("Wrote %d sessions of adi, spt and itn in %f\n",
+	   n_session_writes,tdelta);
+
+    /* Read everything back */
+    if (dm_h5_openread(filename,&h5_file_id,error_string,my_rank) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    n_differ = 0;
+    if (dm_h5_read_adi_info(h5_file_id,&ix,&iy,&iz,&error_is_present,
+			    &my_adi_struct,error_string,my_rank) 
+	== DM_FILEIO_FAILURE) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    /* Only rank 0 reads the structs */
+    if ((ix != nx) || (iy != ny) || (iz != nz) || 
+	((my_rank == 0) && 
+	 (my_adi_struct.photon_scaling != (double)(n_session_writes-1)))) {
+      printf("Session adi_struct or size differs\n");
+      n_differ++;
+    }
+    check_real_struct.nx = nx;
+    check_real_struct.ny = ny;
+    check_real_struct.nz = nz;
+    check_real_struct.npix = my_adi_array_struct.npix;
+    DM_ARRAY_REAL_STRUCT_INIT((&check_real_struct),check_real_struct.npix,p);
+    if (dm_h5_read_adi(h5_file_id,&check_real_struct,
+		       &my_adi_error_array_struct,
+		       error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    for (i=0; i<my_adi_array_struct.local_npix; i++) {
+      if (*(check_real_struct.real_array+i) != 
+	  *(my_adi_array_struct.real_array+i)) {
+	printf("Session \"adi_array\" differs at %d\n",(int)i);
+	n_differ++;
+	break;
+      }
+    }
+    free(check_real_struct.real_array);
+
+    if (dm_h5_read_spt_info(h5_file_id,&ix,&iy,&iz,&my_spt_struct,
+			    error_string,my_rank) == DM_FILEIO_FAILURE) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    if ((my_rank == 0) &&
+	(my_spt_struct.support_scaling != (double)(n_session_writes-1))) {
+      printf("Session spt_struct differs\n");
+      n_differ++;
+    }
+    check_byte_struct.nx = nx;
+    check_byte_struct.ny = ny;
+    check_byte_struct.nz = nz;
+    check_byte_struct.npix = my_spt_array_struct.npix;
+    DM_ARRAY_BYTE_STRUCT_INIT((&check_byte_struct),check_byte_struct.npix,p);
+    if (dm_h5_read_spt(h5_file_id,&check_byte_struct,
+		       error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    for (i=0; i<my_spt_array_struct.local_npix; i++) {
+      if (*(check_byte_struct.byte_array+i) != 
+	  *(my_spt_array_struct.byte_array+i)) {
+	printf("Session \"spt_array\" differs at %d\n",(int)i);
+	n_differ++;
+	break;
+      }
+    }
+    free(check_byte_struct.byte_array);
+
+    if (dm_h5_read_itn_info(h5_file_id,&ix,&iy,&iz,&recon_errors_npix,
+			    &my_itn_struct,error_string,my_rank) 
+	== DM_FILEIO_FAILURE) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    if ((my_rank == 0) &&
+	((my_itn_struct.iterate_count != n_session_writes-1) ||
+	 (recon_errors_npix != n_session_writes))) {
+      printf("Session itn_struct or recon_errors size differs\n");
+      n_differ++;
+    }
+    check_complex_struct.nx = nx;
+    check_complex_struct.ny = ny;
+    check_complex_struct.nz = nz;
+    check_complex_struct.npix = my_itn_array_struct.npix;
+    DM_ARRAY_COMPLEX_STRUCT_INIT((&check_complex_struct),
+				 check_complex_struct.npix,p);
+    if (my_rank == 0) {
+      /* dm_h5_read_itn() fills recon_errors, so compare it here */
+      for (i=0; i<recon_errors.npix; i++) {
+	*(recon_errors.real_array+i) = 0.;
+      }
+    }
+    if (dm_h5_read_itn(h5_file_id,&recon_errors,&check_complex_struct,
+		       error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    for (i=0; i<my_itn_array_struct.local_npix; i++) {
+      if ((c_re(check_complex_struct.complex_array,i) != 
+	   c_re(my_itn_array_struct.complex_array,i)) ||
+	  (c_im(check_complex_struct.complex_array,i) != 
+	   c_im(my_itn_array_struct.complex_array,i))) {
+	printf("Session \"itn_array\" differs at %d\n",(int)i);
+	n_differ++;
+	break;
+      }
+    }
+    DM_ARRAY_COMPLEX_FREE(check_complex_struct.complex_array);
+    if (my_rank == 0) {
+      for (i=0; i<recon_errors.npix; i++) {
+	if (*(recon_errors.real_array+i) != 
+	    (dm_array_real)1./(dm_array_real)(i+1)) {
+	  printf("Session \"recon_errors\" differs at %d\n",(int)i);
+	  n_differ++;
+	  break;
+	}
+      }
+    }
+    dm_h5_close(h5_file_id,my_rank);
+
+    printf("Session round trip on rank %d: %s\n",my_rank,
+	   (n_differ == 0) ? "passed" : "FAILED");
+    if (my_rank == 0) remove(filename);
+    dm_exit();
+    exit((n_differ == 0) ? 0 : 1);
+  }
+
   if (is_readonly == 0) {
     /* This is how we initialize dm_comment_struct */
     my_comment_struct.n_strings_max = MAX_COMMENT_STRINGS;
@@ -115,14 +574,26 @@ int main(int argc, char *argv[]) {
     comstr_allocated = 1;
     dm_clear_comments(&my_comment_struct);
     
-    dm_add_string_to_comments("This is the first comment line.",
-			      &my_comment_struct);
-    dm_add_string_to_comments("This is something equally useless.",
-			      &my_comment_struct);
-    dm_add_string_to_comments("Now this is getting ridiculous!",
-			      &my_comment_struct);
-    dm_add_string_to_comments("Let's get this over with already...",
-			      &my_comment_struct);
+    if ((dm_add_string_to_comments("This is the first comment line.",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS) ||
+	(dm_add_string_to_comments("This is something equally useless.",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS) ||
+	(dm_add_string_to_comments("Now this is getting ridiculous!",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS) ||
+	(dm_add_string_to_comments("Let's get this over with already...",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS)) {
+      printf("dm_add_string_to_comments() failed\n");
+      exit(1);
+    }
+    /* string_array grows past MAX_COMMENT_STRINGS if it has to */
+    for (i=0; i<MAX_COMMENT_STRINGS; i++) {
+      sprintf(this_arg,"Processing stage %d",(int)i);
+      if (dm_add_string_to_comments(this_arg,&my_comment_struct) 
+	  != DM_FILEIO_SUCCESS) {
+	printf("dm_add_string_to_comments() failed\n");
+	exit(1);
+      }
+    }
     dm_add_specimen_name_to_comments("Yeast cell",&my_comment_struct);
     time(&t);
     dm_add_collection_date_to_comments(ctime(&t),&my_comment_struct);
@@ -143,6 +614,10 @@ int main(int argc, char *argv[]) {
 		     my_ainfo_struct.string_length);
     my_ainfo_struct.theta_x_radians_array = 
       (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
+    my_ainfo_struct.theta_y_radians_array = 
+      (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
+    my_ainfo_struct.theta_z_radians_array = 
+      (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
     my_ainfo_struct.xcenter_offset_pixels_array = 
       (double *)malloc(my_ainfo_struct.n_frames_max*sizeof(double));
     my_ainfo_struct.ycenter_offset_pixels_array = 
@@ -167,7 +642,11 @@ int main(int argc, char *argv[]) {
 
     /* Don't specify all entries to see if dm_check_ainfo works */
     for (iy=0; iy<my_ainfo_struct.n_frames-2; iy++) {
-      dm_add_systime_to_ainfo("today", &my_ainfo_struct);
+      if (dm_add_systime_to_ainfo("today", &my_ainfo_struct) 
+	  != DM_FILEIO_SUCCESS) {
+	printf("dm_add_systime_to_ainfo() failed\n");
+	exit(1);
+      }
       if (dm_add_double_to_ainfo("xcenter",-0.5, &my_ainfo_struct,
 				 error_string) != DM_FILEIO_SUCCESS) {
 	printf("%s\n",error_string);
@@ -352,6 +831,12 @@ int main(int argc, char *argv[]) {
       dm_h5_close(h5_file_id,my_rank);
       exit(1);
     }
+    if (dm_h5_append_comment(h5_file_id,"Appended after create.",
+			     error_string,my_rank) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
 
     if (dm_h5_write_adi(h5_file_id,&my_adi_struct,
 			&my_adi_array_struct,&my_adi_error_array_struct,
@@ -361,8 +846,14 @@ int main(int argc, char *argv[]) {
       exit(1);
     }
     
-    if (dm_h5_write_ainfo(h5_file_id,&my_ainfo_struct,
-			  error_string,my_rank) != DM_FILEIO_SUCCESS) {
+    if (packed_ainfo) {
+      status = dm_h5_write_ainfo_packed(h5_file_id,&my_ainfo_struct,
+					error_string,my_rank);
+    } else {
+      status = dm_h5_write_ainfo(h5_file_id,&my_ainfo_struct,
+				 error_string,my_rank);
+    }
+    if (status != DM_FILEIO_SUCCESS) {
         printf("%s\n",error_string);
         dm_h5_close(h5_file_id,my_rank);
         exit(1);
@@ -385,6 +876,205 @@ int main(int argc, char *argv[]) {
     }
     dm_h5_close(h5_file_id,my_rank);
     printf("Wrote file \"%s\"\n", filename);
+
+    /* Write the same adi_array with a contiguous layout to a file of
+     * its own, which dm_h5_map_adi() has to map rather than read.
+     */
+    strcpy(filename,"dm_test_contiguous.h5");
+    if (dm_h5_create(filename,&h5_file_id,
+		     error_string,my_rank) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    if (dm_h5_write_adi_contiguous(h5_file_id,&my_adi_struct,
+				   &my_adi_array_struct,
+				   &my_adi_error_array_struct,
+				   error_string,my_rank,p) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    dm_h5_close(h5_file_id,my_rank);
+    if (dm_h5_openread(filename,&h5_file_id,error_string,my_rank) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    my_adi_map_array_struct.nx = my_adi_array_struct.nx;
+    my_adi_map_array_struct.ny = my_adi_array_struct.ny;
+    my_adi_map_array_struct.nz = my_adi_array_struct.nz;
+    my_adi_map_array_struct.npix = my_adi_array_struct.npix;
+    if (dm_h5_map_adi(h5_file_id,&my_adi_map,&my_adi_map_array_struct,
+		      error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    n_differ = (my_adi_map.is_mapped == 1) ? 0 : 1;
+    for (i=0; i<my_adi_array_struct.local_npix; i++) {
+      if (*(my_adi_map_array_struct.real_array+i) != 
+	  *(my_adi_array_struct.real_array+i)) {
+	printf("Mapped \"adi_array\" differs at %d\n",(int)i);
+	n_differ++;
+	break;
+      }
+    }
+    printf("Map of contiguous \"adi_array\" (is_mapped=%d) on rank %d: %s\n",
+	   my_adi_map.is_mapped,my_rank,(n_differ == 0) ? "passed" : "FAILED");
+    if (n_differ > 0) n_failed++;
+    dm_h5_unmap_adi(&my_adi_map,&my_adi_map_array_struct);
+    dm_h5_close(h5_file_id,my_rank);
+    if (my_rank == 0) remove(filename);
+
+    /* Write three starts of an ensemble with their own errors to the
+     * iterate history and read them back in order.
+     */
+    strcpy(filename,"dm_test_ensemble.h5");
+    for (i_write=0; i_write<3; i_write++) {
+      ensemble_structs[i_write].nx = 16;
+      ensemble_structs[i_write].ny = 16;
+      ensemble_structs[i_write].nz = (n_dims == 3) ? 16 : 1;
+      ensemble_structs[i_write].npix = 
+	(dm_array_index_t)16*16*ensemble_structs[i_write].nz;
+      DM_ARRAY_COMPLEX_STRUCT_INIT((&ensemble_structs[i_write]),
+				   ensemble_structs[i_write].npix,p);
+      ensemble_structs[i_write].local_offset = 
+	my_rank*ensemble_structs[i_write].local_npix;
+      for (i=0; i<ensemble_structs[i_write].local_npix; i++) {
+	c_re(ensemble_structs[i_write].complex_array,i) = (dm_array_real)
+	  (ensemble_structs[i_write].local_offset+i+1000*i_write);
+	c_im(ensemble_structs[i_write].complex_array,i) = 
+	  (dm_array_real)(-i_write);
+      }
+      ensemble_errors[i_write] = (dm_array_real)0.25*(i_write+1);
+    }
+    if (dm_h5_create(filename,&h5_file_id,
+		     error_string,my_rank) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    if (dm_h5_append_itn_ensemble(h5_file_id,&my_itn_struct,3,
+				  ensemble_structs,ensemble_errors,
+				  error_string,my_rank,p) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    dm_h5_close(h5_file_id,my_rank);
+    if (dm_h5_openread(filename,&h5_file_id,error_string,my_rank) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    n_differ = 0;
+    if ((dm_h5_read_itn_history_info(h5_file_id,&nx,&ny,&nz,&n_iterates,
+				     error_string,my_rank) 
+	 == DM_FILEIO_FAILURE) || (n_iterates != 3)) {
+      printf("Ensemble history has %d iterates\n",n_iterates);
+      n_differ++;
+    }
+    check_complex_struct.nx = ensemble_structs[0].nx;
+    check_complex_struct.ny = ensemble_structs[0].ny;
+    check_complex_struct.nz = ensemble_structs[0].nz;
+    check_complex_struct.npix = ensemble_structs[0].npix;
+    DM_ARRAY_COMPLEX_STRUCT_INIT((&check_complex_struct),
+				 check_complex_struct.npix,p);
+    for (i_write=0; (n_differ == 0) && (i_write<3); i_write++) {
+      if (dm_h5_read_itn_history(h5_file_id,i_write,&my_itn_struct,
+				 &recon_error,&check_complex_struct,
+				 error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+	printf("%s\n",error_string);
+	n_differ++;
+	break;
+      }
+      /* Only rank 0 reads the recon_error */
+      if ((my_rank == 0) && (recon_error != ensemble_errors[i_write])) {
+	printf("Ensemble recon_error %d differs\n",i_write);
+	n_differ++;
+      }
+      for (i=0; i<check_complex_struct.local_npix; i++) {
+	if ((c_re(check_complex_struct.complex_array,i) != 
+	     c_re(ensemble_structs[i_write].complex_array,i)) ||
+	    (c_im(check_complex_struct.complex_array,i) != 
+	     c_im(ensemble_structs[i_write].complex_array,i))) {
+	  printf("Ensemble iterate %d differs at %d\n",i_write,(int)i);
+	  n_differ++;
+	  break;
+	}
+      }
+    }
+    DM_ARRAY_COMPLEX_FREE(check_complex_struct.complex_array);
+    for (i_write=0; i_write<3; i_write++) {
+      DM_ARRAY_COMPLEX_FREE(ensemble_structs[i_write].complex_array);
+    }
+    dm_h5_close(h5_file_id,my_rank);
+    printf("Ensemble of 3 iterates in the history on rank %d: %s\n",
+	   my_rank,(n_differ == 0) ? "passed" : "FAILED");
+    if (n_differ > 0) n_failed++;
+    if (my_rank == 0) remove(filename);
+
+    /* Append one comment line and then three in one batch, which
+     * must come back after the comments written at create, in order.
+     */
+    strcpy(filename,"dm_test_comments.h5");
+    if (dm_h5_create(filename,&h5_file_id,
+		     error_string,my_rank) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    if ((dm_h5_create_comments(h5_file_id,&my_comment_struct,
+			       error_string,my_rank) != DM_FILEIO_SUCCESS) ||
+	(dm_h5_append_comment(h5_file_id,batch_comments[0],
+			      error_string,my_rank) != DM_FILEIO_SUCCESS) ||
+	(dm_h5_append_comments(h5_file_id,batch_comments+1,3,
+			       error_string,my_rank) != DM_FILEIO_SUCCESS)) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    dm_h5_close(h5_file_id,my_rank);
+    if (dm_h5_openread(filename,&h5_file_id,error_string,my_rank) 
+	!= DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      exit(1);
+    }
+    check_comment_struct.n_strings_max = 1;
+    check_comment_struct.string_length = STRLEN;
+    check_comment_struct.string_array = (char *)malloc(STRLEN);
+    check_comment_struct.specimen_name = (char *)malloc(STRLEN);
+    check_comment_struct.collection_date = (char *)malloc(STRLEN);
+    dm_clear_comments(&check_comment_struct);
+    if (dm_h5_read_comments(h5_file_id,&check_comment_struct,
+			    error_string,my_rank) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
+    dm_h5_close(h5_file_id,my_rank);
+    /* Only rank 0 reads the comments */
+    n_differ = 0;
+    if (my_rank == 0) {
+      if (check_comment_struct.n_strings != my_comment_struct.n_strings+4) {
+	n_differ++;
+      } else {
+	for (i_write=0; i_write<4; i_write++) {
+	  if (strcmp(check_comment_struct.string_array+
+		     (my_comment_struct.n_strings+i_write)*
+		     check_comment_struct.string_length,
+		     batch_comments[i_write]) != 0) n_differ++;
+	}
+      }
+      printf("Appended %d comments read back on rank %d: %s\n",
+	     check_comment_struct.n_strings-my_comment_struct.n_strings,
+	     my_rank,(n_differ == 0) ? "passed" : "FAILED");
+      remove(filename);
+    }
+    if (n_differ > 0) n_failed++;
+    free(check_comment_struct.string_array);
+    free(check_comment_struct.specimen_name);
+    free(check_comment_struct.collection_date);
     
   } else if (is_readonly == 1) {
     /* OK, in this case we are going to read in a file */
@@ -544,6 +1234,7 @@ int main(int argc, char *argv[]) {
           zmax = my_adi_array_struct.nz/p;
       }
       
+      dm_time(&ts);
       if (dm_h5_read_adi(h5_file_id,&my_adi_array_struct,
 			 &my_adi_error_array_struct,
 			 error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
@@ -551,6 +1242,35 @@ int main(int argc, char *argv[]) {
 	dm_h5_close(h5_file_id,my_rank);
 	exit(1);
       }
+      dm_time(&te);
+      tdelta = dm_time_diff(ts,te);
+      printf("Time to read \"adi_array\": %f\n",tdelta);
+
+      /* Now open the same array through dm_h5_map_adi() */
+      my_adi_map_array_struct.nx = nx;
+      my_adi_map_array_struct.ny = ny;
+      my_adi_map_array_struct.nz = nz;
+      my_adi_map_array_struct.npix = my_adi_array_struct.npix;
+      dm_time(&ts);
+      if (dm_h5_map_adi(h5_file_id,&my_adi_map,&my_adi_map_array_struct,
+			error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
+	printf("%s\n", error_string);
+	dm_h5_close(h5_file_id,my_rank);
+	exit(1);
+      }
+      dm_time(&te);
+      tdelta = dm_time_diff(ts,te);
+      printf("Time to %s \"adi_array\": %f\n",
+	     (my_adi_map.is_mapped == 1) ? "map" : "read (not mappable)",
+	     tdelta);
+      for (i=0; i<my_adi_array_struct.local_npix; i++) {
+	if (*(my_adi_map_array_struct.real_array+i) != 
+	    *(my_adi_array_struct.real_array+i)) {
+	  printf("Mapped \"adi_array\" differs at %d\n",(int)i);
+	  break;
+	}
+      }
+      dm_h5_unmap_adi(&my_adi_map,&my_adi_map_array_struct);
 
       printf("adi_struct.lambda_meters = %.3le\n",
 	     (double)my_adi_struct.lambda_meters);
@@ -647,7 +1367,30 @@ int main(int argc, char *argv[]) {
 	}
 	printf("\n");
       }
-    } 
+
+      /* Read it again as a bit mask and count the pixels set */
+      my_spt_bit_struct.nx = nx;
+      my_spt_bit_struct.ny = ny;
+      my_spt_bit_struct.nz = nz;
+      my_spt_bit_struct.npix = my_spt_array_struct.npix;
+      DM_ARRAY_BIT_STRUCT_INIT((&my_spt_bit_struct),
+			       my_spt_bit_struct.npix,p);
+      if (dm_h5_read_spt_bit(h5_file_id,&my_spt_bit_struct,
+			     error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+	printf("Error reading \"/spt\" array as bits\n");
+	dm_h5_close(h5_file_id,my_rank);
+	exit(1);
+      }
+      n_set_pixels = 0;
+      for (i=0; i<my_spt_bit_struct.local_npix; i++) {
+	if ((*(my_spt_bit_struct.bit_array+i/64) >> (i%64)) & 1) {
+	  n_set_pixels++;
+	}
+      }
+      printf("%d of %d local \"spt_array\" pixels are set\n",
+	     n_set_pixels,(int)my_spt_bit_struct.local_npix);
+      free(my_spt_bit_struct.bit_array);
+    }
 
     if (dm_h5_itn_group_exists(h5_file_id,my_rank) == 1) {
       printf("File has a group \"/itn\"\n");
@@ -708,12 +1451,16 @@ int main(int argc, char *argv[]) {
           zmax = my_itn_array_struct.nz/p;
       }
 
+      dm_time(&ts);
       if (dm_h5_read_itn(h5_file_id,&recon_errors,&my_itn_array_struct,
 			 error_string,my_rank,p) == DM_FILEIO_FAILURE) {
 	printf("Error reading \"/itn\" array\n");
 	dm_h5_close(h5_file_id,my_rank);
 	exit(1);
       }
+      dm_time(&te);
+      tdelta = dm_time_diff(ts,te);
+      printf("Time to read \"itn_array\": %f\n",tdelta);
 
       if (my_rank == 0) {
           if (recon_errors.npix > 0) {
@@ -741,6 +1488,208 @@ int main(int argc, char *argv[]) {
       }
       
     }
+
+    /* Read a crop, every other pixel and a single slice of each 
+     * array and compare with the full arrays read above. Under MPI
+     * a rank only checks the pixels whose source it holds itself.
+     */
+    if ((adi_array_allocated == 1) && (spt_array_allocated == 1) &&
+	(itn_array_allocated == 1) &&
+	(my_spt_array_struct.npix == my_adi_array_struct.npix) &&
+	(my_itn_array_struct.npix == my_adi_array_struct.npix)) {
+      full_dims[0] = my_adi_array_struct.nx;
+      full_dims[1] = my_adi_array_struct.ny;
+      full_dims[2] = my_adi_array_struct.nz;
+      n_real_dims = (full_dims[2] > 1) ? 3 : ((full_dims[1] > 1) ? 2 : 1);
+      full_offset = my_rank*my_adi_array_struct.local_npix;
+      for (i_region=0; i_region<((n_real_dims > 1) ? 3 : 2); i_region++) {
+	for (i_axis=0; i_axis<3; i_axis++) {
+	  if (full_dims[i_axis] == 1) {
+	    region_dims[i_axis] = 1;
+	    region_offsets[i_axis] = 0;
+	    region_strides[i_axis] = 1;
+	  } else if (i_region == 1) {
+	    region_dims[i_axis] = full_dims[i_axis]/2;
+	    region_offsets[i_axis] = 1;
+	    region_strides[i_axis] = 2;
+	  } else if ((i_region == 2) && (i_axis == n_real_dims-1)) {
+	    region_dims[i_axis] = 1;
+	    region_offsets[i_axis] = full_dims[i_axis]/2;
+	    region_strides[i_axis] = 1;
+	  } else {
+	    region_dims[i_axis] = full_dims[i_axis]/2;
+	    region_offsets[i_axis] = full_dims[i_axis]/4;
+	    region_strides[i_axis] = 1;
+	  }
+	}
+	check_real_struct.nx = region_dims[0];
+	check_real_struct.ny = region_dims[1];
+	check_real_struct.nz = region_dims[2];
+	check_real_struct.npix = (dm_array_index_t)region_dims[0]*
+	  (dm_array_index_t)region_dims[1]*(dm_array_index_t)region_dims[2];
+	check_byte_struct.nx = check_real_struct.nx;
+	check_byte_struct.ny = check_real_struct.ny;
+	check_byte_struct.nz = check_real_struct.nz;
+	check_byte_struct.npix = check_real_struct.npix;
+	check_complex_struct.nx = check_real_struct.nx;
+	check_complex_struct.ny = check_real_struct.ny;
+	check_complex_struct.nz = check_real_struct.nz;
+	check_complex_struct.npix = check_real_struct.npix;
+	DM_ARRAY_REAL_STRUCT_INIT((&check_real_struct),
+				  check_real_struct.npix,p);
+	DM_ARRAY_BYTE_STRUCT_INIT((&check_byte_struct),
+				  check_byte_struct.npix,p);
+	DM_ARRAY_COMPLEX_STRUCT_INIT((&check_complex_struct),
+				     check_complex_struct.npix,p);
+
+	dm_time(&ts);
+	if ((dm_h5_read_adi_region(h5_file_id,region_offsets,region_strides,
+				   &check_real_struct,error_string,my_rank,p)
+	     != DM_FILEIO_SUCCESS) ||
+	    (dm_h5_read_spt_region(h5_file_id,region_offsets,region_strides,
+				   &check_byte_struct,error_string,my_rank,p)
+	     != DM_FILEIO_SUCCESS) ||
+	    (dm_h5_read_itn_region(h5_file_id,region_offsets,region_strides,
+				   &check_complex_struct,error_string,
+				   my_rank,p) != DM_FILEIO_SUCCESS)) {
+	  printf("%s\n",error_string);
+	  dm_h5_close(h5_file_id,my_rank);
+	  exit(1);
+	}
+	dm_time(&te);
+	tdelta = dm_time_diff(ts,te);
+
+	n_compared = 0;
+	n_differ = 0;
+	for (i=0; i<check_real_struct.local_npix; i++) {
+	  i_global = my_rank*check_real_struct.local_npix+i;
+	  ix = i_global % region_dims[0];
+	  iy = (i_global/region_dims[0]) % region_dims[1];
+	  iz = i_global/(region_dims[0]*region_dims[1]);
+	  i_src = 
+	    (dm_array_index_t)(region_offsets[0]+ix*region_strides[0])+
+	    (dm_array_index_t)(region_offsets[1]+iy*region_strides[1])*
+	    full_dims[0]+
+	    (dm_array_index_t)(region_offsets[2]+iz*region_strides[2])*
+	    full_dims[0]*full_dims[1];
+	  if ((i_src < full_offset) || 
+	      (i_src >= (full_offset+my_adi_array_struct.local_npix))) {
+	    continue;
+	  }
+	  i_src -= full_offset;
+	  n_compared++;
+	  if ((*(check_real_struct.real_array+i) != 
+	       *(my_adi_array_struct.real_array+i_src)) ||
+	      (*(check_byte_struct.byte_array+i) != 
+	       *(my_spt_array_struct.byte_array+i_src)) ||
+	      (c_re(check_complex_struct.complex_array,i) !=
+	       c_re(my_itn_array_struct.complex_array,i_src)) ||
+	      (c_im(check_complex_struct.complex_array,i) !=
+	       c_im(my_itn_array_struct.complex_array,i_src))) {
+	    n_differ++;
+	  }
+	}
+	printf("Region %s [%d,%d,%d] on rank %d in %f: %d pixels compared, %s\n",
+	       region_names[i_region],region_dims[0],region_dims[1],
+	       region_dims[2],my_rank,tdelta,n_compared,
+	       (n_differ == 0) ? "passed" : "FAILED");
+	if (n_differ > 0) n_failed++;
+	free(check_real_struct.real_array);
+	free(check_byte_struct.byte_array);
+	DM_ARRAY_COMPLEX_FREE(check_complex_struct.complex_array);
+      }
+
+      /* A preview of every other pixel must not take longer than 
+       * reading the whole array it replaces. Both take the best of 
+       * three reads, so that the page cache is warm for either, and
+       * a millisecond is allowed for the noise of reads of small 
+       * arrays that take less than that.
+       */
+      for (i_axis=0; i_axis<3; i_axis++) {
+	region_dims[i_axis] = (full_dims[i_axis] == 1) ? 1 : 
+	  full_dims[i_axis]/2;
+	region_offsets[i_axis] = 0;
+	region_strides[i_axis] = 2;
+      }
+      check_real_struct.nx = region_dims[0];
+      check_real_struct.ny = region_dims[1];
+      check_real_struct.nz = region_dims[2];
+      check_real_struct.npix = (dm_array_index_t)region_dims[0]*
+	(dm_array_index_t)region_dims[1]*(dm_array_index_t)region_dims[2];
+      DM_ARRAY_REAL_STRUCT_INIT((&check_real_struct),
+				check_real_struct.npix,p);
+      full_time = 0.;
+      region_time = 0.;
+      for (i_write=0; i_write<3; i_write++) {
+	dm_time(&ts);
+	status = dm_h5_read_adi(h5_file_id,&my_adi_array_struct,
+				&my_adi_error_array_struct,error_string,
+				my_rank,p);
+	dm_time(&te);
+	tdelta = dm_time_diff(ts,te);
+	if ((i_write == 0) || (tdelta < full_time)) full_time = tdelta;
+	dm_time(&ts);
+	if ((status != DM_FILEIO_SUCCESS) ||
+	    (dm_h5_read_adi_region(h5_file_id,region_offsets,region_strides,
+				   &check_real_struct,error_string,my_rank,p)
+	     != DM_FILEIO_SUCCESS)) {
+	  printf("%s\n",error_string);
+	  dm_h5_close(h5_file_id,my_rank);
+	  exit(1);
+	}
+	dm_time(&te);
+	tdelta = dm_time_diff(ts,te);
+	if ((i_write == 0) || (tdelta < region_time)) region_time = tdelta;
+      }
+      printf("Preview [%d,%d,%d] in %f, full array in %f on rank %d: %s\n",
+	     region_dims[0],region_dims[1],region_dims[2],region_time,
+	     full_time,my_rank,
+	     (region_time <= (full_time+1.e-3)) ? "passed" : "FAILED");
+      if (region_time > (full_time+1.e-3)) n_failed++;
+      free(check_real_struct.real_array);
+    }
+
+    if (dm_h5_itn_history_group_exists(h5_file_id,my_rank) == 1) {
+      if (dm_h5_read_itn_history_info(h5_file_id,&nx,&ny,&nz,&n_iterates,
+				      error_string,my_rank) 
+	  == DM_FILEIO_FAILURE) {
+	printf("%s\n",error_string);
+	dm_h5_close(h5_file_id,my_rank);
+	exit(1);
+      }
+      printf("File has a group \"/itn_history\" with %d iterates\n",
+	     n_iterates);
+
+      /* Only the newest iterate is read in */
+      if ((itn_array_allocated == 1) && 
+	  ((my_itn_array_struct.nx != nx) || (my_itn_array_struct.ny != ny) ||
+	   (my_itn_array_struct.nz != nz))) {
+	DM_ARRAY_COMPLEX_FREE(my_itn_array_struct.complex_array);
+	itn_array_allocated = 0;
+      }
+      if (itn_array_allocated == 0) {
+	my_itn_array_struct.nx = nx;
+	my_itn_array_struct.ny = ny;
+	my_itn_array_struct.nz = nz;
+	my_itn_array_struct.npix = 
+	  (dm_array_index_t)nx*(dm_array_index_t)ny*(dm_array_index_t)nz;
+	DM_ARRAY_COMPLEX_STRUCT_INIT((&my_itn_array_struct),
+				     my_itn_array_struct.npix,p);
+	itn_array_allocated = 1;
+      }
+      if (dm_h5_read_itn_history(h5_file_id,n_iterates-1,&my_itn_struct,
+				 &recon_error,&my_itn_array_struct,
+				 error_string,my_rank,p) == DM_FILEIO_FAILURE) {
+	printf("%s\n",error_string);
+	dm_h5_close(h5_file_id,my_rank);
+	exit(1);
+      }
+      if (my_rank == 0) {
+	printf("Iterate %d: iterate_count=%d, recon_error=%f\n",
+	       n_iterates-1,(int)my_itn_struct.iterate_count,
+	       (float)recon_error);
+      }
+    }
     dm_h5_close(h5_file_id,my_rank);
 
   } else if (is_readonly == 2) {
@@ -775,12 +1724,15 @@ int main(int argc, char *argv[]) {
     dm_clear_comments(&my_comment_struct);
     comstr_allocated = 1;
 
-    dm_add_string_to_comments("In a world without",
-			      &my_comment_struct);
-    dm_add_string_to_comments("FENCES and WALLS, ",
-			      &my_comment_struct);
-    dm_add_string_to_comments("we don't need no WINDOWS or GATES!",
-			      &my_comment_struct);
+    if ((dm_add_string_to_comments("In a world without",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS) ||
+	(dm_add_string_to_comments("FENCES and WALLS, ",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS) ||
+	(dm_add_string_to_comments("we don't need no WINDOWS or GATES!",
+				   &my_comment_struct) != DM_FILEIO_SUCCESS)) {
+      printf("dm_add_string_to_comments() failed\n");
+      exit(1);
+    }
 
     if (dm_h5_add_comments(h5_file_id,&my_comment_struct,
 			   error_string,my_rank) != DM_FILEIO_SUCCESS) {
@@ -958,6 +1910,19 @@ int main(int argc, char *argv[]) {
       dm_h5_close(h5_file_id,my_rank);
       exit(1);
     }
+
+    /* Also keep this iterate in the iterate history, together with
+     * the last of the recon_errors.
+     */
+    recon_error = (dm_array_real)1./
+      (2.*(dm_array_real)my_itn_struct.iterate_count);
+    if (dm_h5_append_itn_history(h5_file_id,&my_itn_struct,
+				 &my_itn_array_struct,recon_error,
+				 error_string,my_rank,p) != DM_FILEIO_SUCCESS) {
+      printf("%s\n",error_string);
+      dm_h5_close(h5_file_id,my_rank);
+      exit(1);
+    }
     printf("Updated file \"%s\"\n",filename);
 
     dm_h5_close(h5_file_id,my_rank);
@@ -981,6 +1946,8 @@ int main(int argc, char *argv[]) {
     free(my_ainfo_struct.filename_array);
     free(my_ainfo_struct.systime_array);
     free(my_ainfo_struct.theta_x_radians_array);
+    free(my_ainfo_struct.theta_y_radians_array);
+    free(my_ainfo_struct.theta_z_radians_array);
     free(my_ainfo_struct.xcenter_offset_pixels_array);
     free(my_ainfo_struct.ycenter_offset_pixels_array);
   }
@@ -992,7 +1959,7 @@ int main(int argc, char *argv[]) {
 
   dm_exit();
 
-  return(0);
+  return((n_failed == 0) ? 0 : 1);
 }     
 
 void dm_test_fileio_help() {
@@ -1002,4 +1969,8 @@ void dm_test_fileio_help() {
   printf("  -write makes its own filename.  Options:\n");
   printf("    -n x: make the array have x dimensions (e.g., \"-n 2\")\n");
   printf("    -error: add an error array to the ADI file.\n");
+  printf("    -packed: write the ainfo strings packed.\n");
+  printf("  -B n: time dm_read_ainfo_from_csv() on a manifest of n frames.\n");
+  printf("  -F n: time dm_read_frame_stack() on n raw frames.\n");
+  printf("  -S n: write n times through a session and read back.\n");
 }